@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+#include "NetlistParser.h"
+#include "Circuit.h"
+
+static double
+now()
+{
+  timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + 1e-9 * t.tv_nsec;
+}
+
+/// Build the circuit of a deck, then look up refs node names and refs
+/// device names spread over the circuit, the way .measure and .plot
+/// resolve their references, and run the cell arc queries for every arc
+int main(int argc, char** argv)
+{
+  if (argc != 3) {
+    printf("usage: %s deck.cir refs\n", argv[0]);
+    return 1;
+  }
+  NA::NetlistParser parser(argv[1]);
+  NA::Circuit ckt(parser, parser.analysisParameters()[0]);
+  size_t refs = std::strtoul(argv[2], nullptr, 10);
+  size_t nodeCount = ckt.nodeNumber();
+  size_t devCount = ckt.deviceNumber();
+  std::vector<std::string> nodes;
+  std::vector<std::string> devs;
+  for (size_t i=0; i<refs; ++i) {
+    nodes.push_back(ckt.node((i * 7919) % nodeCount)._name);
+    devs.push_back(ckt.device((i * 104729) % devCount)._name);
+  }
+
+  /// The indices are built by the first lookup
+  double start = now();
+  size_t check = ckt.findNodeByName(nodes[0])._nodeId;
+  double indexEnd = now();
+  for (size_t i=0; i<refs; ++i) {
+    check += ckt.findNodeByName(nodes[i])._nodeId;
+    check += ckt.findDeviceByName(devs[i])._devId;
+  }
+  double lookupEnd = now();
+  for (const NA::CellArc& arc : ckt.cellArcs()) {
+    check += ckt.cellArc(arc.fromPinFullName(), arc.toPinFullName()) != nullptr;
+    check += ckt.cellArcFromPins(arc.toPinFullName()).size();
+    check += ckt.cellArcToPins(arc.fromPinFullName()).size();
+    check += ckt.cellArcsOfDevice(&ckt.device(arc.driverResistorId())).size();
+  }
+  double arcEnd = now();
+
+  printf("%lu devices, %lu nodes, %lu cell arcs (check %lu)\n",
+         devCount, nodeCount, ckt.cellArcs().size(), check);
+  printf("First lookup: %.3f milliseconds\n", 1e3 * (indexEnd - start));
+  printf("%lu name lookups: %.3f milliseconds\n", 2 * refs, 1e3 * (lookupEnd - indexEnd));
+  printf("%lu cell arcs x 4 queries: %.3f milliseconds\n",
+         ckt.cellArcs().size(), 1e3 * (arcEnd - lookupEnd));
+  return 0;
+}
@@ -0,0 +1,22 @@
+#include <cstdio>
+#include <ctime>
+#include "NetlistParser.h"
+
+/// Time NetlistParser alone on a deck, devices are parsed on the first
+/// access, so they are read inside the timed region
+int main(int argc, char** argv)
+{
+  if (argc != 2) {
+    printf("usage: %s deck.cir\n", argv[0]);
+    return 1;
+  }
+  timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  NA::NetlistParser parser(argv[1]);
+  size_t devices = parser.devices().size();
+  timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  double seconds = (end.tv_sec - start.tv_sec) + 1e-9 * (end.tv_nsec - start.tv_nsec);
+  printf("Parsed %lu devices of %s in %.3f seconds\n", devices, argv[1], seconds);
+  return 0;
+}
@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+"""Write an RC ladder deck for the netlist benchmarks.
+
+usage: gen_ladder.py SECTIONS DECK
+
+The ladder is driven by V1 through R0, and every section adds one series
+resistor and one grounded capacitor, so the deck has 2*SECTIONS+2 devices
+and SECTIONS+2 nodes. Values are pseudo random with a fixed seed, so the
+same SECTIONS always gives the same deck.
+"""
+
+import random
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit(__doc__)
+    sections = int(sys.argv[1])
+    rng = random.Random(1)
+    with open(sys.argv[2], "w") as deck:
+        deck.write("* synthetic RC ladder, %d sections\n" % sections)
+        deck.write("V1 in 0 1\n")
+        deck.write("R0 in net_0 10\n")
+        lines = []
+        for i in range(1, sections + 1):
+            lines.append("R%d net_%d net_%d %.2fk\n" % (i, i - 1, i, rng.uniform(0.1, 9.9)))
+            lines.append("C%d net_%d 0 %.2ff\n" % (i, i, rng.uniform(0.5, 5.0)))
+            if len(lines) >= 65536:
+                deck.writelines(lines)
+                lines = []
+        deck.writelines(lines)
+        deck.write(".tran 1p 1n\n")
+        deck.write(".end\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,25 @@
+#!/bin/bash
+# Build the benchmarks, generate the ladder decks into a work directory
+# and run the benchmarks on one CPU.
+# usage: bench/run.sh [work_dir]
+#
+# parser: RC ladder of 2M sections, 4,000,002 devices, 130 MB
+# lookup: RC ladder of 100k sections, 200,002 devices, 10000 name lookups
+#
+# To measure an older tree, build its libtrans.a and link the benchmark
+# sources against it with the same command as "make bench".
+
+set -e
+cd "$(dirname "$0")/.."
+make bench
+WORK=${1:-/tmp/trans_bench}
+mkdir -p "$WORK"
+[ -f "$WORK/ladder_2m.cir" ] || python3 bench/gen_ladder.py 2000000 "$WORK/ladder_2m.cir"
+[ -f "$WORK/ladder_100k.cir" ] || python3 bench/gen_ladder.py 100000 "$WORK/ladder_100k.cir"
+
+ONE_CPU=""
+if command -v taskset > /dev/null; then
+  ONE_CPU="taskset -c 0"
+fi
+$ONE_CPU ./build/bench/ParserBench "$WORK/ladder_2m.cir"
+$ONE_CPU ./build/bench/LookupBench "$WORK/ladder_100k.cir" 5000
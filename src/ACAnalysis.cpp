@@ -0,0 +1,206 @@
+#include <cstdio>
+#include <cmath>
+#include <Eigen/SparseLU>
+#include "ACAnalysis.h"
+#include "MNAStamper.h"
+#include "Parallel.h"
+#include "Debug.h"
+
+namespace NA {
+
+using namespace Eigen;
+
+ACAnalysis::ACAnalysis(const Circuit& circuit, const AnalysisParameter& param)
+: _circuit(circuit), _param(param), _result(&circuit, param._name)
+{
+  _eqnDim = _result.indexMap().size();
+}
+
+bool
+ACAnalysis::check() const
+{
+  if (_param._acPoints == 0 || _param._fStart <= 0 ||
+      _param._fStop < _param._fStart) {
+    printf("ERROR: Invalid frequency range of AC analysis %s\n", _param._name.data());
+    return false;
+  }
+  if (_eqnDim == 0) {
+    printf("ERROR: Nothing to solve in AC analysis %s\n", _param._name.data());
+    return false;
+  }
+  return true;
+}
+
+std::vector<double>
+ACAnalysis::frequencies() const
+{
+  std::vector<double> freqs;
+  double fStart = _param._fStart;
+  double fStop = _param._fStop;
+  size_t n = _param._acPoints;
+  if (_param._acSweep == ACSweep::Lin) {
+    freqs.reserve(n);
+    if (n == 1) {
+      freqs.push_back(fStart);
+      return freqs;
+    }
+    double step = (fStop - fStart) / (n - 1);
+    for (size_t i=0; i<n; ++i) {
+      freqs.push_back(fStart + i * step);
+    }
+    return freqs;
+  }
+  /// Dec and Oct sweeps take n points per decade or per octave
+  double base = (_param._acSweep == ACSweep::Dec) ? 10 : 2;
+  double ratio = std::pow(base, 1.0 / n);
+  size_t total = std::floor(std::log(fStop / fStart) / std::log(ratio) + 1e-9) + 1;
+  freqs.reserve(total);
+  for (size_t i=0; i<total; ++i) {
+    freqs.push_back(fStart * std::pow(ratio, i));
+  }
+  return freqs;
+}
+
+void
+ACAnalysis::buildSparsePattern(const MatrixXd& G, const MatrixXd& C,
+                               SparseMatrix<double>& Gs,
+                               SparseMatrix<double>& Cs) const
+{
+  std::vector<Triplet<double>> gTriplets;
+  std::vector<Triplet<double>> cTriplets;
+  for (Index j=0; j<G.cols(); ++j) {
+    for (Index i=0; i<G.rows(); ++i) {
+      if (G(i, j) != 0 || C(i, j) != 0) {
+        gTriplets.emplace_back(i, j, G(i, j));
+        cTriplets.emplace_back(i, j, C(i, j));
+      }
+    }
+  }
+  Gs.resize(G.rows(), G.cols());
+  Cs.resize(C.rows(), C.cols());
+  Gs.setFromTriplets(gTriplets.begin(), gTriplets.end());
+  Cs.setFromTriplets(cTriplets.begin(), cTriplets.end());
+  Gs.makeCompressed();
+  Cs.makeCompressed();
+}
+
+void
+ACAnalysis::solve(const SparseMatrix<double>& Gs,
+                  const SparseMatrix<double>& Cs,
+                  const VectorXcd& b,
+                  const std::vector<double>& freqs,
+                  std::vector<VectorXcd>& solutions) const
+{
+  solutions.assign(freqs.size(), VectorXcd());
+  /// Every thread works on a contiguous block of frequencies with its own
+  /// solver, the symbolic analysis is done once per thread and only the
+  /// numerical factorization is repeated at each frequency
+  size_t threads = threadNumber(freqs.size());
+  size_t blockSize = (freqs.size() + threads - 1) / threads;
+  parallelFor(threads, [&](size_t t) {
+    size_t begin = t * blockSize;
+    size_t end = std::min(begin + blockSize, freqs.size());
+    if (begin >= end) {
+      return;
+    }
+    SparseMatrix<Complex> A = Gs.cast<Complex>();
+    const double* gValues = Gs.valuePtr();
+    const double* cValues = Cs.valuePtr();
+    Complex* aValues = A.valuePtr();
+    const Index nnz = A.nonZeros();
+    SparseLU<SparseMatrix<Complex>, COLAMDOrdering<int>> solver;
+    solver.analyzePattern(A);
+    for (size_t i=begin; i<end; ++i) {
+      double omega = 2 * M_PI * freqs[i];
+      for (Index k=0; k<nnz; ++k) {
+        aValues[k] = Complex(gValues[k], omega * cValues[k]);
+      }
+      solver.factorize(A);
+      if (solver.info() != Eigen::Success) {
+        printf("ERROR: Factorization failed at frequency %G: %s\n",
+               freqs[i], solver.lastErrorMessage().data());
+        solutions[i].setConstant(_eqnDim, Complex(NAN, NAN));
+        continue;
+      }
+      solutions[i] = solver.solve(b);
+    }
+  });
+}
+
+/// Only sources with an AC spec drive the circuit, all other voltage
+/// sources are shorts and all other current sources are opens
+bool
+ACAnalysis::buildStimulus(VectorXcd& b) const
+{
+  b.setZero(_eqnDim);
+  bool hasStimulus = false;
+  for (const Device& dev : _circuit.devicesToSimulate()) {
+    if (dev._acMag == 0) {
+      continue;
+    }
+    Complex phasor = std::polar(dev._acMag, dev._acPhase * M_PI / 180);
+    if (dev._type == DeviceType::VoltageSource) {
+      b(_result.deviceVectorIndex(dev._devId)) += phasor;
+      hasStimulus = true;
+    } else if (dev._type == DeviceType::CurrentSource) {
+      if (_circuit.isGroundNode(dev._posNode) == false) {
+        b(_result.nodeVectorIndex(dev._posNode)) -= phasor;
+      }
+      if (_circuit.isGroundNode(dev._negNode) == false) {
+        b(_result.nodeVectorIndex(dev._negNode)) += phasor;
+      }
+      hasStimulus = true;
+    }
+  }
+  return hasStimulus;
+}
+
+void
+ACAnalysis::run()
+{
+  if (check() == false) {
+    return;
+  }
+  MNAStamper stamper(_param, _circuit, _result);
+  MatrixXd G;
+  G.setZero(_eqnDim, _eqnDim);
+  MatrixXd C;
+  C.setZero(_eqnDim, _eqnDim);
+  VectorXd E;
+  E.setZero(_eqnDim);
+  stamper.stamp(G, C, E);
+  /// Undo the moment scaling applied by MNAStamper in s-domain
+  double k = _circuit.scalingFactor();
+  C /= k;
+  E /= k;
+  if (Debug::enabled(DebugModule::Sim)) {
+    Debug::printEquation(G, E);
+    Debug::printEquation(C, E);
+  }
+
+  SparseMatrix<double> Gs;
+  SparseMatrix<double> Cs;
+  buildSparsePattern(G, C, Gs, Cs);
+  VectorXcd b;
+  if (buildStimulus(b) == false) {
+    printf("ERROR: No AC source in AC analysis %s\n", _param._name.data());
+    return;
+  }
+  const std::vector<double>& freqs = frequencies();
+  std::vector<VectorXcd> solutions;
+  solve(Gs, Cs, b, freqs, solutions);
+
+  std::vector<double>& ticks = _result.ticks();
+  std::deque<double>& values = _result.values();
+  std::deque<double>& imagValues = _result.imagValues();
+  for (size_t i=0; i<freqs.size(); ++i) {
+    ticks.push_back(freqs[i]);
+    const VectorXcd& x = solutions[i];
+    for (size_t j=0; j<_eqnDim; ++j) {
+      values.push_back(x(j).real());
+      imagValues.push_back(x(j).imag());
+    }
+  }
+}
+
+}
@@ -0,0 +1,52 @@
+#ifndef _AC_ANALYSIS_H_
+#define _AC_ANALYSIS_H_
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#include "Base.h"
+#include "Circuit.h"
+#include "SimResult.h"
+
+namespace NA {
+
+/// Small signal frequency sweep. (G + jwC)x = b is solved at every
+/// frequency point, b is built from the "AC mag [phase]" specs of the
+/// independent sources.
+class ACAnalysis {
+  public:
+    typedef std::complex<double> Complex;
+
+    ACAnalysis(const Circuit& circuit, const AnalysisParameter& param);
+
+    void run();
+
+    const SimResult& result() const { return _result; }
+
+  private:
+    bool check() const;
+    std::vector<double> frequencies() const;
+    bool buildStimulus(Eigen::VectorXcd& b) const;
+    /// Build G and C with the same sparse pattern, so that the values
+    /// of G + jwC can be assembled without touching the pattern
+    void buildSparsePattern(const Eigen::MatrixXd& G, const Eigen::MatrixXd& C,
+                            Eigen::SparseMatrix<double>& Gs,
+                            Eigen::SparseMatrix<double>& Cs) const;
+    void solve(const Eigen::SparseMatrix<double>& Gs,
+               const Eigen::SparseMatrix<double>& Cs,
+               const Eigen::VectorXcd& b,
+               const std::vector<double>& freqs,
+               std::vector<Eigen::VectorXcd>& solutions) const;
+
+  private:
+    const Circuit&    _circuit;
+    AnalysisParameter _param;
+    SimResult         _result;
+    size_t            _eqnDim;
+};
+
+}
+
+#endif
@@ -1,27 +1,76 @@
 #include "Base.h"
 #include "LibData.h"
+#include <algorithm>
 
 namespace NA {
 
 
+/// Index of the end point of the segment containing time, which is the
+/// first point after time, or size if time is past the last point
+static inline size_t
+segmentEnd(const std::vector<double>& times, double time)
+{
+  return std::upper_bound(times.begin() + 1, times.end(), time) - times.begin();
+}
+
 double 
 PWLValue::valueAtTime(double time) const
 {
-  if (time < _time[0]) {
+  if (_time.empty() || time < _time[0]) {
     return 0;
   }
-  for (size_t i=1; i<_time.size(); ++i) {
-    if (time < _time[i]) {
-      double v1 = _value[i-1];
-      double v2 = _value[i];
-      double t1 = _time[i-1];
-      double t2 = _time[i];
-      //printf("DEBUG: time %g goes into [%g, %g] interval, voltage: [%g, %g], interpolated voltage: %g\n", 
-      //  time, t1, t2, v1, v2, v1 + (v2-v1)/(t2-t1)*(time-t1));
-      return v1 + (v2-v1)/(t2-t1)*(time-t1);
+  size_t i = segmentEnd(_time, time);
+  if (i == _time.size()) {
+    return _value.back();
+  }
+  double v1 = _value[i-1];
+  double v2 = _value[i];
+  double t1 = _time[i-1];
+  double t2 = _time[i];
+  return v1 + (v2-v1)/(t2-t1)*(time-t1);
+}
+
+PWLEvaluator::PWLEvaluator(const PWLValue* pwl)
+: _pwl(pwl)
+{
+  const std::vector<double>& times = pwl->_time;
+  const std::vector<double>& values = pwl->_value;
+  if (times.size() > 1) {
+    _slopes.resize(times.size() - 1);
+    for (size_t i=0; i<_slopes.size(); ++i) {
+      _slopes[i] = (values[i+1]-values[i])/(times[i+1]-times[i]);
     }
   }
-  return _value.back();
+}
+
+double 
+PWLEvaluator::valueAtTime(double time) const
+{
+  /// Forward moves longer than this are binary searched
+  static constexpr size_t maxScan = 8;
+  const std::vector<double>& times = _pwl->_time;
+  if (times.empty() || time < times[0]) {
+    return 0;
+  }
+  size_t size = times.size();
+  size_t i = _cursor;
+  if (i > size || time < times[i-1]) {
+    i = segmentEnd(times, time);
+  } else {
+    size_t scanned = 0;
+    while (i < size && time >= times[i]) {
+      if (++scanned == maxScan) {
+        i = segmentEnd(times, time);
+        break;
+      }
+      ++i;
+    }
+  }
+  _cursor = i;
+  if (i == size) {
+    return _pwl->_value.back();
+  }
+  return _pwl->_value[i-1] + _slopes[i-1]*(time-times[i-1]);
 }
 
 double 
@@ -1,6 +1,7 @@
 #ifndef _TRAN_BASE_H_
 #define _TRAN_BASE_H_
 
+#include <cstddef>
 #include <vector>
 #include <string>
 
@@ -14,6 +15,8 @@ enum class AnalysisType : unsigned char {
   PZ,   /// Pole-Zero anlaysis
   TF,   /// Transfer function analysis
   FD,   /// Full-stage delay analysis
+  AC,   /// Small signal frequency sweep
+  Elmore, /// Moments and Elmore/D2M delays of RC networks
 };
 
 enum class SimResultType : unsigned char {
@@ -26,6 +29,18 @@ enum class IntegrateMethod : unsigned char {
   BackwardEuler,
   Trapezoidal,
   Gear2,
+  Exponential, /// exact for linear circuits, see ExponentialIntegrator
+  BDF, /// variable step and order, see StepControl
+};
+
+/// BDF formula of order _order at t[n+1] on variable steps,
+///   x'(t[n+1]) ~ sum of _alpha[j]*x(t[n+1-j]) for j = 0.._history
+/// _alpha[0] only depends on the step and the order, see StepControl
+struct BDFCoefficients {
+  static constexpr size_t maxOrder = 6;
+  size_t _order = 1;
+  size_t _history = 1;
+  double _alpha[maxOrder+2] = {0};
 };
 
 enum class NetworkModel : unsigned char {
@@ -54,17 +69,40 @@ enum class LoaderModel : unsigned char {
   Varied,
 };
 
+enum class PZMethod : unsigned char {
+  /// Explicit moment matching (AWE), moments are computed by repeated
+  /// solves and poles come from the Hankel system of the moments
+  Moment,
+  /// Arnoldi process on G^-1*C, poles are taken from the eigenvalues 
+  /// of the projected Hessenberg matrix
+  Arnoldi,
+};
+
+enum class ACSweep : unsigned char {
+  Dec, /// Points per decade
+  Oct, /// Points per octave
+  Lin, /// Total number of points, linearly spaced
+};
+
 struct AnalysisParameter {
-  ~AnalysisParameter() 
-  {
-    if (_type == AnalysisType::PZ) {
-      delete _inDev;
-      delete _outNode;
-    }
-  }
   AnalysisType _type = AnalysisType::None;
   bool         _hasMeasurePoints = false;
   std::string  _name;
+  /// Input device and output nodes of pole-zero and Elmore analysis, 
+  /// kept out of the union below as they own memory. Output node names 
+  /// may contain wildcards '*' and '?'
+  std::string              _inDev;
+  std::vector<std::string> _outNodes;
+  /// RC reduction before transient simulation, nodes with time constants
+  /// up to _reduceTol times the simulation tick are eliminated
+  bool         _reduce = false;
+  double       _reduceTol = 0.1;
+  /// Variable order BDF, the highest order and the LTE tolerances: relative
+  /// to the value, absolute for voltages and absolute for currents
+  unsigned     _maxOrder = 6;
+  double       _relTol = 1e-3;
+  double       _vnTol = 1e-6;
+  double       _absTol = 1e-12;
   union {
     /// Parameters for transient analysis
     struct {
@@ -76,8 +114,14 @@ struct AnalysisParameter {
     /// Parameters for pole-zero analysis
     struct {
       unsigned int  _order = 0;
-      std::string*  _inDev;
-      std::string*  _outNode;
+      PZMethod      _pzMethod = PZMethod::Arnoldi;
+    };
+    /// Parameters for AC sweep
+    struct {
+      ACSweep _acSweep;
+      size_t  _acPoints;
+      double  _fStart;
+      double  _fStop;
     };
     /// Parameters for full-stage delay calculation
     struct {
@@ -118,6 +162,8 @@ struct Device {
     double    _value;
     size_t    _PWLData = 0;
   };
+  double      _acMag = 0; /// AC stimulus of independent sources, zero if none
+  double      _acPhase = 0; /// in degrees
 };
 
 struct Node {
@@ -140,6 +186,24 @@ struct PWLValue {
   std::vector<double> _value;
 };
 
+/// Evaluates a PWLValue keeping a cursor on the segment of the last query.
+/// Queries at non-decreasing times, as in time marching, move the cursor
+/// forward for amortized O(1) cost, other queries binary search the
+/// segment. Segment slopes are computed once, so the evaluator has to be
+/// built again when the points of the PWLValue change.
+class PWLEvaluator {
+  public:
+    PWLEvaluator() = default;
+    PWLEvaluator(const PWLValue* pwl);
+
+    double valueAtTime(double time) const;
+
+  private:
+    const PWLValue*     _pwl = nullptr;
+    std::vector<double> _slopes; /// slope of segment [i, i+1]
+    mutable size_t      _cursor = 1; /// end point of the last segment
+};
+
 struct WaveformPoint {
   double _time = 0;
   double _value = 0;
@@ -5,9 +5,12 @@
 #include <unordered_set>
 #include "Debug.h"
 #include "Circuit.h"
+#include "CircuitSnapshot.h"
+#include "CircuitReduction.h"
 #include "Base.h"
 #include "NetlistParser.h"
 #include "Timer.h"
+#include "StringUtil.h"
 
 namespace NA {
 
@@ -34,17 +37,13 @@ findDeviceId(size_t nodeId1, size_t nodeId2,
   return static_cast<size_t>(-1);
 }
 
-typedef std::unordered_map<std::string, size_t> StringIdMap;
-
 static void 
-incrCountMap(StringIdMap& countMap, const std::string& key)
+incrCount(std::vector<size_t>& counts, SymbolId node)
 {
-  auto it = countMap.find(key);
-  if (it == countMap.end()) {
-    countMap.insert({key, 1});
-  } else {
-    it->second += 1;
+  if (node >= counts.size()) {
+    counts.resize(node+1, 0);
   }
+  counts[node] += 1;
 }
 
 static inline std::string 
@@ -83,30 +82,31 @@ internalLoaderCapName(const std::string& inst, const std::string& pin)
 }
 
 static void
-addInternalPosNodeForGate(StringIdMap& countMap, const ParserDevice& dev, const LibData& libData)
+addInternalPosNodeForGate(std::vector<size_t>& counts, SymbolTable& nodeNames,
+                          const ParserDevice& dev, const LibData& libData)
 {
-  const std::string& libCell = dev._libCellName;
+  SymbolId cellId = libData.cellId(dev._libCellName);
   const auto& pinMap = dev._pinMap;
   for (const auto& kv : pinMap) {
     const std::string& pinName = kv.first;
-    const std::string& nodeName = kv.second;
-    incrCountMap(countMap, nodeName);
-    if (libData.isOutputPin(libCell, pinName)) {
-      const std::string& internalNode = internalVPosNodeName(dev._name, pinName);
+    incrCount(counts, kv.second);
+    if (libData.isOutputPin(cellId, libData.pinId(pinName))) {
+      const std::string& internalNodeName = internalVPosNodeName(dev._name, pinName);
+      SymbolId internalNode = nodeNames.intern(internalNodeName);
       /// this internal node connects to voltage source and the resistor, 
       /// so increment it twice
-      incrCountMap(countMap, internalNode);
-      incrCountMap(countMap, internalNode);
+      incrCount(counts, internalNode);
+      incrCount(counts, internalNode);
       if (Debug::enabled(DebugModule::Circuit)) {
-        printf("Created internal node %s\n", internalNode.data());
+        printf("Created internal node %s\n", internalNodeName.data());
       }
     }
   }
 }
 
-std::string
-Circuit::allNodes(const std::vector<ParserDevice>& devs, 
-                  std::vector<std::string>& allNodeNames, 
+SymbolId
+Circuit::allNodes(const std::vector<ParserDevice>& devs, SymbolTable& nodeNames,
+                  std::vector<SymbolId>& allNodeIds, 
                   const std::vector<std::string>& driverPinNames)
 {
   bool addInternalVPosNode = false;
@@ -116,11 +116,11 @@ Circuit::allNodes(const std::vector<ParserDevice>& devs,
     } 
   }
   
-  StringIdMap nodeConnectionCount;
+  std::vector<size_t> nodeConnectionCount(nodeNames.size(), 0);
   for (const ParserDevice& dev : devs) {
     if (dev._type == DeviceType::Cell) {
       if (addInternalVPosNode) {
-        addInternalPosNodeForGate(nodeConnectionCount, dev, _libData);
+        addInternalPosNodeForGate(nodeConnectionCount, nodeNames, dev, *_libData);
       } else if (_param._driverModel == DriverModel::PWLCurrent) {
         bool add = false;
         for (const std::string& driverPinName : driverPinNames) {
@@ -130,48 +130,57 @@ Circuit::allNodes(const std::vector<ParserDevice>& devs,
           }
         }
         if (add) {
-          addInternalPosNodeForGate(nodeConnectionCount, dev, _libData);
+          addInternalPosNodeForGate(nodeConnectionCount, nodeNames, dev, *_libData);
         }
       }
     } else {
-      incrCountMap(nodeConnectionCount, dev._posNode);
-      incrCountMap(nodeConnectionCount, dev._negNode);
+      incrCount(nodeConnectionCount, dev._posNode);
+      incrCount(nodeConnectionCount, dev._negNode);
     }
   }
   size_t maxCount = 0;
-  std::string maxNode;
-  for (const auto& kv : nodeConnectionCount) {
-    if (kv.second > maxCount || 
-       (kv.second == maxCount && kv.first.compare(maxNode) < 0)) {
-      maxCount = kv.second;
-      maxNode = kv.first;
+  SymbolId maxNode = invalidSymbol;
+  for (SymbolId node=0; node<nodeConnectionCount.size(); ++node) {
+    size_t count = nodeConnectionCount[node];
+    if (count == 0) {
+      continue;
+    }
+    if (count > maxCount || 
+       (count == maxCount && nodeNames.name(node).compare(nodeNames.name(maxNode)) < 0)) {
+      maxCount = count;
+      maxNode = node;
     }
-    allNodeNames.push_back(kv.first);
+    allNodeIds.push_back(node);
   }
   return maxNode;
 }
 
 static size_t
-findNodeByName(const StringIdMap& nodeIdMap, 
-               const std::string& name)
+findNodeBySymbol(const std::vector<size_t>& nodeIds, SymbolId node)
 {
-  const auto& it = nodeIdMap.find(name);
-  if (it == nodeIdMap.end()) {
+  if (node >= nodeIds.size()) {
     return static_cast<size_t>(-1);
   }
-  return it->second;
+  return nodeIds[node];
+}
+
+static const char*
+symbolName(const SymbolTable& names, SymbolId node)
+{
+  return node < names.size() ? names.name(node).data() : "";
 }
 
 bool
-createDevice(Device& dev, const ParserDevice& pDev, const StringIdMap& nodeIdMap)
+createDevice(Device& dev, const ParserDevice& pDev, 
+             const SymbolTable& nodeNames, const std::vector<size_t>& nodeIds)
 {
-  size_t posNode = findNodeByName(nodeIdMap, pDev._posNode);
-  size_t negNode = findNodeByName(nodeIdMap, pDev._negNode);
+  size_t posNode = findNodeBySymbol(nodeIds, pDev._posNode);
+  size_t negNode = findNodeBySymbol(nodeIds, pDev._negNode);
   if (posNode == static_cast<size_t>(-1)) {
-    printf("Cannot find node \"%s\" referenced by device %s\n", pDev._posNode.data(), pDev._name.data());
+    printf("Cannot find node \"%s\" referenced by device %s\n", symbolName(nodeNames, pDev._posNode), pDev._name.data());
   }
   if (negNode == static_cast<size_t>(-1)) {
-    printf("Cannot find node \"%s\" referenced by device %s\n", pDev._negNode.data(), pDev._name.data());
+    printf("Cannot find node \"%s\" referenced by device %s\n", symbolName(nodeNames, pDev._negNode), pDev._name.data());
   }
   if (posNode == static_cast<size_t>(-1) || negNode == static_cast<size_t>(-1)) {
     return false;
@@ -182,13 +191,13 @@ createDevice(Device& dev, const ParserDevice& pDev, const StringIdMap& nodeIdMap
   
   if (pDev._type == DeviceType::CCCS || pDev._type == DeviceType::CCVS || 
       pDev._type == DeviceType::VCCS || pDev._type == DeviceType::VCVS) {
-    size_t posSampleNode = findNodeByName(nodeIdMap, pDev._posSampleNode);
-    size_t negSampleNode = findNodeByName(nodeIdMap, pDev._negSampleNode);
+    size_t posSampleNode = findNodeBySymbol(nodeIds, pDev._posSampleNode);
+    size_t negSampleNode = findNodeBySymbol(nodeIds, pDev._negSampleNode);
     if (posSampleNode == static_cast<size_t>(-1)) {
-      printf("Cannot find node \"%s\" referenced by device %s\n", pDev._posNode.data(), pDev._name.data());
+      printf("Cannot find node \"%s\" referenced by device %s\n", symbolName(nodeNames, pDev._posSampleNode), pDev._name.data());
     }
     if (negSampleNode == static_cast<size_t>(-1)) {
-      printf("Cannot find node \"%s\" referenced by device %s\n", pDev._posNode.data(), pDev._name.data());
+      printf("Cannot find node \"%s\" referenced by device %s\n", symbolName(nodeNames, pDev._negSampleNode), pDev._name.data());
     }
     if (posSampleNode == static_cast<size_t>(-1) || negSampleNode == static_cast<size_t>(-1)) {
       return false;
@@ -204,15 +213,18 @@ createDevice(Device& dev, const ParserDevice& pDev, const StringIdMap& nodeIdMap
   } else {
     dev._value = pDev._value;
   }
+  dev._acMag = pDev._acMag;
+  dev._acPhase = pDev._acPhase;
   return true;
 }
 
 ParserDevice 
-createDriverVoltageSourceParserDevice(const std::string& inst, const std::string& pin, const std::string& gnd)
+createDriverVoltageSourceParserDevice(const std::string& inst, const std::string& pin, 
+                                      SymbolId vposNode, SymbolId gnd)
 {
   ParserDevice dev;
   dev._name = internalRampVoltageSourceName(inst, pin);
-  dev._posNode = internalVPosNodeName(inst, pin);
+  dev._posNode = vposNode;
   dev._negNode = gnd;
   dev._type = DeviceType::VoltageSource;
   dev._isPWLValue = false;
@@ -222,11 +234,12 @@ createDriverVoltageSourceParserDevice(const std::string& inst, const std::string
 }
 
 ParserDevice 
-createDriverResistorParserDevice(const std::string& inst, const std::string& pin, const std::string& pinNode)
+createDriverResistorParserDevice(const std::string& inst, const std::string& pin, 
+                                 SymbolId vposNode, SymbolId pinNode)
 {
   ParserDevice dev;
   dev._name = internalDriverResistorName(inst, pin);
-  dev._posNode = internalVPosNodeName(inst, pin);
+  dev._posNode = vposNode;
   dev._negNode = pinNode;
   dev._type = DeviceType::Resistor;
   dev._isPWLValue = false;
@@ -237,7 +250,7 @@ createDriverResistorParserDevice(const std::string& inst, const std::string& pin
 
 ParserDevice 
 createDriverCurrentSourceParserDevice(const std::string& inst, const std::string& pin, 
-                           const std::string& gnd, const std::string& pinNode)
+                           SymbolId gnd, SymbolId pinNode)
 {
   ParserDevice dev;
   dev._name = internalCurrentSourceName(inst, pin);
@@ -252,7 +265,7 @@ createDriverCurrentSourceParserDevice(const std::string& inst, const std::string
 
 ParserDevice 
 createLoaderCapParserDevice(const std::string& inst, const std::string& pin, 
-                           const std::string& gnd, const std::string& pinNode)
+                           SymbolId gnd, SymbolId pinNode)
 {
   ParserDevice dev;
   dev._name = internalLoaderCapName(inst, pin);
@@ -266,13 +279,13 @@ createLoaderCapParserDevice(const std::string& inst, const std::string& pin,
 }
 
 Device*
-Circuit::createDevice(const ParserDevice& pDev, const StringIdMap& nodeIdMap)
+Circuit::createDevice(const ParserDevice& pDev, const NodeIdMap& nodeIdMap)
 {
   Device dev;
   size_t devId = _devices.size();
   dev._devId = devId;
   dev._isInternal = pDev._isInternal;
-  if (::NA::createDevice(dev, pDev, nodeIdMap) == true) {
+  if (::NA::createDevice(dev, pDev, nodeIdMap._names, nodeIdMap._nodeIds) == true) {
     _devices.push_back(dev);
     updateNodeConnection(dev);
     return &(_devices.back());
@@ -282,22 +295,32 @@ Circuit::createDevice(const ParserDevice& pDev, const StringIdMap& nodeIdMap)
 }
 
 void
-Circuit::elaborateGateDevice(const ParserDevice& dev, const StringIdMap& nodeIdMap, 
+Circuit::elaborateGateDevice(const ParserDevice& dev, NodeIdMap& nodeIdMap, 
                              const std::vector<std::string>& cellOutPinsToCalcDelay)
 {
   std::vector<Device> devs;
   const std::string& libCell = dev._libCellName;
+  SymbolId cellId = _libData->cellId(libCell);
   const auto& pinMap = dev._pinMap;
-  const std::string& gndNode = _nodes[_groundNodeId]._name;
+  SymbolId gndNode = nodeIdMap._names.find(_nodes[_groundNodeId]._name);
   std::vector<std::string> outputPins;
   for (const auto& kv : pinMap) {
     const std::string& pinName = kv.first;
-    const std::string& nodeName = kv.second;
-    if (_libData.isOutputPin(libCell, pinName)) {
+    SymbolId nodeName = kv.second;
+    SymbolId pinId = _libData->pinId(pinName);
+    if (_libData->isOutputPin(cellId, pinId)) {
       outputPins.push_back(pinName);
     } else {
-      const ParserDevice& Cl = createLoaderCapParserDevice(dev._name, pinName, gndNode, nodeName);
-      createDevice(Cl, nodeIdMap);
+      ParserDevice Cl = createLoaderCapParserDevice(dev._name, pinName, gndNode, nodeName);
+      FixedLoadCap pinCap;
+      pinCap.setPinName(pinName);
+      pinCap.setCaps(_libData->fixedLoadCap(cellId, pinId, true), 
+                     _libData->fixedLoadCap(cellId, pinId, false));
+      Cl._value = pinCap.value(true);
+      Device* loaderCap = createDevice(Cl, nodeIdMap);
+      if (loaderCap != nullptr) {
+        _loaderCaps.insert({loaderCap->_devId, pinCap});
+      }
     }
   }
   for (const std::string& outPin : outputPins) {
@@ -311,12 +334,13 @@ Circuit::elaborateGateDevice(const ParserDevice& dev, const StringIdMap& nodeIdM
         }
       }
     }
-    const std::vector<std::string>& inputPins = _libData.cellArcInputPins(libCell, outPin);
+    const std::vector<SymbolId>& inputPins = _libData->cellArcInputPins(cellId, _libData->pinId(outPin));
     if (inputPins.empty()) {
       printf("ERROR: Lib data for cell arc to pin %s of cell %s is missing\n", outPin.data(), libCell.data());
       continue;
     }
-    for (const std::string& inPin : inputPins) {
+    for (SymbolId inPinId : inputPins) {
+     const std::string& inPin = _libData->pinName(inPinId);
      //const ParserDevice& Cl = createLoaderCapParserDevice(dev._name, inPin, gndNode, nodeName);
      //Device& loadCap = findDeviceByName(Cl._name);
      //if (loadCap._devId == invalidId) {
@@ -324,20 +348,20 @@ Circuit::elaborateGateDevice(const ParserDevice& dev, const StringIdMap& nodeIdM
      //}
      const auto& foundInputNode = pinMap.find(inPin);
      if (foundInputNode != pinMap.end()) {
-       const std::string& inputNode = foundInputNode->second;
-       size_t inputNodeId = ::NA::findNodeByName(nodeIdMap, inputNode);
+       size_t inputNodeId = findNodeBySymbol(nodeIdMap._nodeIds, foundInputNode->second);
        const auto& foundOutputNode = pinMap.find(outPin);
        if (foundOutputNode != pinMap.end()) {
-         CellArc cellArcData(&_libData, dev._name, libCell, inPin, outPin);
+         CellArc cellArcData(_libData.get(), dev._name, libCell, inPin, outPin);
          if (cellArcData.empty()) {
            printf("ERROR: Lib data for cell arc %s->%s of cell %s is missing\n", inPin.data(), outPin.data(), libCell.data());
            continue;
          }
          cellArcData.setInputTranNode(inputNodeId);
-         const std::string& outputNode = foundOutputNode->second;
-         size_t outputNodeId = ::NA::findNodeByName(nodeIdMap, outputNode);
+         SymbolId outputNode = foundOutputNode->second;
+         size_t outputNodeId = findNodeBySymbol(nodeIdMap._nodeIds, outputNode);
          if (useCSM == false) {
-           const ParserDevice& VRampPDev = createDriverVoltageSourceParserDevice(dev._name, outPin, gndNode);
+           SymbolId vposNode = nodeIdMap._names.intern(internalVPosNodeName(dev._name, outPin));
+           const ParserDevice& VRampPDev = createDriverVoltageSourceParserDevice(dev._name, outPin, vposNode, gndNode);
            Device* driverSource = createDevice(VRampPDev, nodeIdMap);
            driverSource->_isPWLValue = true;
            driverSource->_PWLData = _PWLData.size();
@@ -346,11 +370,9 @@ Circuit::elaborateGateDevice(const ParserDevice& dev, const StringIdMap& nodeIdM
            empty._value.push_back(0);
            _PWLData.push_back(empty);
            cellArcData.setDriverSourceId(driverSource->_devId);
-           const ParserDevice& Rd = createDriverResistorParserDevice(dev._name, outPin, outputNode);
+           const ParserDevice& Rd = createDriverResistorParserDevice(dev._name, outPin, vposNode, outputNode);
            Device* driverRes = createDevice(Rd, nodeIdMap);
            cellArcData.setDriverResistorId(driverRes->_devId);
-           std::pair<std::string, std::string> key({cellArcData.fromPinFullName(), cellArcData.toPinFullName()});
-           _cellArcMap.insert({key, _cellArcs.size()});
            _cellArcs.push_back(cellArcData);
          } else {
            const ParserDevice& Id = createDriverCurrentSourceParserDevice(dev._name, outPin, gndNode, outputNode);
@@ -362,8 +384,6 @@ Circuit::elaborateGateDevice(const ParserDevice& dev, const StringIdMap& nodeIdM
            empty._value.push_back(0);
            _PWLData.push_back(empty);
            cellArcData.setDriverSourceId(driverSource->_devId);
-           std::pair<std::string, std::string> key({cellArcData.fromPinFullName(), cellArcData.toPinFullName()});
-           _cellArcMap.insert({key, _cellArcs.size()});
            _cellArcs.push_back(cellArcData);
          }
          _driverOutputNodes.push_back(outputNodeId);
@@ -415,23 +435,42 @@ printInfo(const std::string& simName, const std::vector<Device>& devs,
 }
 
 Circuit::Circuit(const NetlistParser& parser, const AnalysisParameter& param)
-: _param(param), _PWLData(parser.PWLData())
+: _param(param), _libData(std::make_shared<LibData>())
 {
-  if (parser.libDataFiles().empty() == false) {
-    _libData.read(parser.libDataFiles());
-  }
-
   timespec cktStart;
+  CircuitSnapshot snapshot(this);
   clock_gettime(CLOCK_REALTIME, &cktStart);
-  
-  buildCircuit(parser);
+  bool fromSnapshot = parser.useSnapshot() && snapshot.load(parser);
+  if (fromSnapshot) {
+    printf("Circuit for %s loaded from snapshot %s\n", simName().data(),
+           CircuitSnapshot::snapshotFile(parser, simName()).data());
+    printf("Ground node identified as node \"%s\"\n", _nodes[_groundNodeId]._name.data());
+  } else {
+    _PWLData = parser.PWLData();
+    if (parser.libDataFiles().empty() == false) {
+      _libData->read(parser.libDataFiles(), parser.libCellNames());
+    }
+
+    clock_gettime(CLOCK_REALTIME, &cktStart);
+    
+    buildCircuit(parser);
+  }
   
   timespec cktEnd;
   clock_gettime(CLOCK_REALTIME, &cktEnd);
 
-  resetSimulationScope();
+  if (fromSnapshot == false && parser.useSnapshot()) {
+    snapshot.write(parser);
+  }
+
+  if (_param._type == AnalysisType::Tran && _param._reduce) {
+    CircuitReduction reduction(this);
+    reduction.run(parser);
+  } else {
+    resetSimulationScope();
+  }
   if (_cellArcs.empty() == false) { 
-    printInfo(simName(), _devices, _nodes, _libData);
+    printInfo(simName(), _devices, _nodes, *_libData);
   }
   printf("Time spent in building circuit for %s: %.3f milliseconds\n",
          simName().data(), 1e-6*timeDiffNs(cktEnd, cktStart));
@@ -464,31 +503,36 @@ void
 Circuit::buildCircuit(const NetlistParser& parser)
 {
   const std::vector<ParserDevice>& parserDevs = parser.devices();
-  std::vector<std::string> allNodeNames;
-  std::string groundNodeName = allNodes(parserDevs, allNodeNames, parser.cellOutPinsToCalcDelay());
+  NodeIdMap nodeIdMap;
+  nodeIdMap._names = parser.nodeNames();
+  std::vector<SymbolId> allNodeIds;
+  SymbolId groundNode = allNodes(parserDevs, nodeIdMap._names, allNodeIds, parser.cellOutPinsToCalcDelay());
   if (parser.userGroundNet().size() > 0) {
-    groundNodeName = parser.userGroundNet();
+    groundNode = nodeIdMap._names.intern(parser.userGroundNet());
   }
-  std::unordered_map<std::string, size_t> nodeIdMap;
+  std::string groundNodeName = groundNode != invalidSymbol ? nodeIdMap._names.name(groundNode) : "";
   printf("Ground node identified as node \"%s\"\n", groundNodeName.data());
-  _nodes.reserve(allNodeNames.size());
+  nodeIdMap._nodeIds.assign(nodeIdMap._names.size(), invalidId);
+  _nodes.reserve(allNodeIds.size() + 1);
   Node ground;
   ground._name = groundNodeName;
   ground._nodeId = 0;
   ground._isGround = true;
   _nodes.push_back(ground);
-  nodeIdMap.insert({ground._name, ground._nodeId});
+  if (groundNode != invalidSymbol) {
+    nodeIdMap._nodeIds[groundNode] = ground._nodeId;
+  }
   _groundNodeId = ground._nodeId;
-  for (const std::string& nodeName : allNodeNames) {
-    if (nodeName == groundNodeName) {
+  for (SymbolId node : allNodeIds) {
+    if (node == groundNode) {
       continue;
     }
     Node n;
-    n._name = nodeName;
+    n._name = nodeIdMap._names.name(node);
     n._nodeId = _nodes.size();
     n._isGround = false;
     _nodes.push_back(n);
-    nodeIdMap.insert({n._name, n._nodeId});
+    nodeIdMap._nodeIds[node] = n._nodeId;
   }
 
   _devices.reserve(parserDevs.size());
@@ -562,13 +606,68 @@ Circuit::PWLData(const Device& dev)
   return _PWLData[dev._PWLData];
 }
 
+std::vector<double>
+Circuit::sourceBreakpoints(double endTime) const
+{
+  std::vector<double> times;
+  for (const Device& dev : devicesToSimulate()) {
+    if ((dev._type == DeviceType::VoltageSource || dev._type == DeviceType::CurrentSource) &&
+        dev._isPWLValue) {
+      for (double t : PWLData(dev)._time) {
+        if (t > 0 && t < endTime) {
+          times.push_back(t);
+        }
+      }
+    }
+  }
+  std::sort(times.begin(), times.end());
+  times.erase(std::unique(times.begin(), times.end()), times.end());
+  return times;
+}
+
+const Circuit::Indices&
+Circuit::indices() const
+{
+  std::shared_ptr<const Indices> found = std::atomic_load(&_indices);
+  if (found) {
+    return *found;
+  }
+  std::shared_ptr<Indices> indices = std::make_shared<Indices>();
+  indices->_nodes.build(_nodes.size(), [this](size_t nodeId) -> const std::string& {
+    return _nodes[nodeId]._name;
+  });
+  indices->_devices.build(_devices.size(), [this](size_t devId) -> const std::string& {
+    return _devices[devId]._name;
+  });
+  for (size_t i=0; i<_cellArcs.size(); ++i) {
+    const CellArc& arc = _cellArcs[i];
+    indices->_cellArcMap.insert({{arc.fromPinFullName(), arc.toPinFullName()}, i});
+    indices->_arcsFromPin[arc.fromPinFullName()].push_back(i);
+    indices->_arcsToPin[arc.toPinFullName()].push_back(i);
+    indices->_arcsOfInputNode[arc.inputTranNode()].push_back(i);
+    if (arc.driverResistorId() != invalidId) {
+      indices->_arcsOfDriver[arc.driverResistorId()].push_back(i);
+    }
+    if (arc.driverSourceId() != invalidId) {
+      indices->_arcsOfDriver[arc.driverSourceId()].push_back(i);
+    }
+  }
+  /// Threads building the indices at the same time all use the first one stored
+  std::shared_ptr<const Indices> stored = indices;
+  if (std::atomic_compare_exchange_strong(&_indices, &found, stored)) {
+    return *stored;
+  }
+  return *found;
+}
+
 const Device& 
 Circuit::findDeviceByName(const std::string& name) const
 {
-  for (const Device& dev : _devices) {
-    if (dev._name == name) {
-      return dev;
-    }
+  SymbolId id = indices()._devices.find(name, [this](size_t devId) -> const std::string& {
+    return _devices[devId]._name;
+  });
+  if (id != invalidSymbol) {
+    return _devices[id];
   }
   static Device empty;
   empty._type = DeviceType::Total;
@@ -578,15 +677,35 @@ Circuit::findDeviceByName(const std::string& name) const
 const Node&
 Circuit::findNodeByName(const std::string& name) const
 {
-  for (const Node& node : _nodes) {
-    if (node._name == name) {
-      return node;
-    }
+  SymbolId id = indices()._nodes.find(name, [this](size_t nodeId) -> const std::string& {
+    return _nodes[nodeId]._name;
+  });
+  if (id != invalidSymbol) {
+    return _nodes[id];
   }
   static Node empty;
   return empty;
 }
 
+std::vector<size_t>
+Circuit::findNodesByPattern(const std::string& pattern) const
+{
+  std::vector<size_t> nodeIds;
+  if (hasWildcard(pattern) == false) {
+    const Node& node = findNodeByName(pattern);
+    if (node._nodeId != invalidId) {
+      nodeIds.push_back(node._nodeId);
+    }
+    return nodeIds;
+  }
+  for (const Node& node : _nodes) {
+    if (node._isGround == false && wildcardMatch(pattern, node._name)) {
+      nodeIds.push_back(node._nodeId);
+    }
+  }
+  return nodeIds;
+}
+
 static std::vector<const Device*> 
 getConnectedDevices(size_t nodeId, const Circuit* ckt)
 {
@@ -641,22 +760,23 @@ Circuit::traceDevice(size_t devId) const
 const CellArc*
 Circuit::cellArc(const std::string& fromPin, const std::string& toPin) const
 {
-  for (const CellArc& arc : _cellArcs) {
-    if (arc.fromPinFullName() == fromPin && 
-        arc.toPinFullName() == toPin) {
-      return &arc;
-    }
+  const CellArcMap& cellArcMap = indices()._cellArcMap;
+  const auto& found = cellArcMap.find({fromPin, toPin});
+  if (found == cellArcMap.end()) {
+    return nullptr;
   }
-  return nullptr;
+  return &(_cellArcs[found->second]);
 }
 
 std::vector<std::string>
 Circuit::cellArcFromPins(const std::string& toPin) const
 {
   std::vector<std::string> frPins;
-  for (const CellArc& arc : _cellArcs) {
-    if (arc.toPinFullName() == toPin) {
-      frPins.push_back(arc.fromPinFullName());
+  const PinArcMap& arcsToPin = indices()._arcsToPin;
+  const auto& found = arcsToPin.find(toPin);
+  if (found != arcsToPin.end()) {
+    for (size_t arcId : found->second) {
+      frPins.push_back(_cellArcs[arcId].fromPinFullName());
     }
   }
   return frPins;
@@ -666,9 +786,11 @@ std::vector<std::string>
 Circuit::cellArcToPins(const std::string& fromPin) const
 {
   std::vector<std::string> toPins;
-  for (const CellArc& arc : _cellArcs) {
-    if (arc.fromPinFullName() == fromPin) {
-      toPins.push_back(arc.toPinFullName());
+  const PinArcMap& arcsFromPin = indices()._arcsFromPin;
+  const auto& found = arcsFromPin.find(fromPin);
+  if (found != arcsFromPin.end()) {
+    for (size_t arcId : found->second) {
+      toPins.push_back(_cellArcs[arcId].toPinFullName());
     }
   }
   return toPins;
@@ -681,24 +803,30 @@ Circuit::cellArcsOfDevice(const Device* dev) const
   if (dev->_isInternal == false) {
     return arcs;
   }
-  for (const CellArc& arc : _cellArcs) {
-    if (dev->_type == DeviceType::Capacitor) {
-      if (arc.inputTranNode() == dev->_posNode) {
-        arcs.push_back(const_cast<CellArc*>(&arc));
-      }
-    } else if (dev->_type == DeviceType::Resistor) {
-      if (arc.driverResistorId() == dev->_devId) {
-        arcs.push_back(const_cast<CellArc*>(&arc));
-      } 
-    } else {
-      if (arc.driverSourceId() == dev->_devId) {
-        arcs.push_back(const_cast<CellArc*>(&arc));
-      }
+  /// Loader capacitors are found by the input node of the arc, driver
+  /// resistors and sources by their IDs
+  const Indices& index = indices();
+  const IdArcMap& arcMap = dev->_type == DeviceType::Capacitor ? index._arcsOfInputNode : index._arcsOfDriver;
+  size_t key = dev->_type == DeviceType::Capacitor ? dev->_posNode : dev->_devId;
+  const auto& found = arcMap.find(key);
+  if (found != arcMap.end()) {
+    for (size_t arcId : found->second) {
+      arcs.push_back(const_cast<CellArc*>(&_cellArcs[arcId]));
     }
   }
   return arcs;
 }
 
+const FixedLoadCap*
+Circuit::loaderCap(size_t devId) const
+{
+  const auto& it = _loaderCaps.find(devId);
+  if (it == _loaderCaps.end()) {
+    return nullptr;
+  }
+  return &(it->second);
+}
+
 void
 Circuit::resetSimulationScope()
 {
@@ -730,32 +858,16 @@ Circuit::markSimulationScope(const std::vector<const Device*>& devs)
   _nodesToSimulate.erase(it2, _nodesToSimulate.end());
 }
 
-std::vector<Device>
-Circuit::devicesToSimulate() const
-{
-  std::vector<Device> devs;
-  for (size_t devId : _devicesToSimulate) {
-    devs.push_back(device(devId));
-  }
-  return devs;
-}
-
-std::vector<Node>
-Circuit::nodesToSimulate() const
-{
-  std::vector<Node> nodes;
-  for (size_t nodeId : _nodesToSimulate) {
-    nodes.push_back(node(nodeId));
-  }
-  return nodes;
-}
-
 CellArc::CellArc(const LibData* libData, const std::string& inst, const std::string& cell, 
                 const std::string& fromPin, const std::string& toPin) 
-: _instName(inst), _cellName(cell), _fromPin(fromPin), _toPin(toPin)
-{
-  _nldmArc = libData->findNLDMArc(cell, fromPin, toPin);
-  _ccsArc = libData->findCCSArc(cell, fromPin, toPin);
+: _instName(inst), _fromPin(fromPin), _toPin(toPin),
+  _fromPinFullName(inst + "/" + fromPin), _toPinFullName(inst + "/" + toPin)
+{
+  _cellId = libData->cellId(cell);
+  _fromPinId = libData->pinId(fromPin);
+  SymbolId toPinId = libData->pinId(toPin);
+  _nldmArc = libData->findNLDMArc(_cellId, _fromPinId, toPinId);
+  _ccsArc = libData->findCCSArc(_cellId, _fromPinId, toPinId);
 }
 
 static double
@@ -2,11 +2,13 @@
 #define _TRAN_CKT_H_
 
 #include <cstddef>
+#include <memory>
 #include <vector>
 #include <unordered_map>
 #include "Base.h"
 #include "NetlistParser.h"
 #include "LibData.h"
+#include "Span.h"
 
 namespace NA {
 
@@ -44,16 +46,17 @@ class CellArc {
     size_t inputNode() const;
     size_t outputNode(const Circuit* ckt) const;
 
-    std::string fromPinFullName() const { return _instName + "/" + _fromPin; }
-    std::string toPinFullName() const { return _instName + "/" + _toPin; }
+    const std::string& fromPinFullName() const { return _fromPinFullName; }
+    const std::string& toPinFullName() const { return _toPinFullName; }
 
     std::string instance() const { return _instName; }
     std::string fromPin() const { return _fromPin; }
     std::string toPin() const { return _toPin; }
+    SymbolId cellId() const { return _cellId; }
 
     double fixedLoadCap(bool isRise) const 
     {
-      return _nldmArc->owner()->fixedLoadCap(_cellName, _fromPin, isRise);
+      return _nldmArc->owner()->fixedLoadCap(_cellId, _fromPinId, isRise);
     }
 
     size_t inputLoadCapacitor(const Circuit* ckt) const;
@@ -63,9 +66,13 @@ class CellArc {
     size_t         _driverResistor = static_cast<size_t>(-1);
     size_t         _driverSource = static_cast<size_t>(-1);
     std::string    _instName;
-    std::string    _cellName;
     std::string    _fromPin;
     std::string    _toPin;
+    /// "inst/pin" names, built once as they are compared in every arc search
+    std::string    _fromPinFullName;
+    std::string    _toPinFullName;
+    SymbolId       _cellId = invalidSymbol;
+    SymbolId       _fromPinId = invalidSymbol;
     const NLDMArc* _nldmArc = nullptr;
     const CCSArc*  _ccsArc = nullptr;
 };
@@ -77,6 +84,9 @@ struct HashStringPair {
 };
 
 class Circuit {
+  friend class CircuitSnapshot;
+  friend class CircuitReduction;
+
   public:
     Circuit(const NetlistParser& parser, const AnalysisParameter& param);
 
@@ -85,9 +95,9 @@ class Circuit {
     size_t nodeNumber() const { return _nodes.size(); }
     size_t deviceNumber() const { return _devices.size(); }
 
-    std::vector<Node> nodes() const { return _nodes; }
-    std::vector<Device> devices() const { return _devices; }
-    std::vector<PWLValue> PWLData() const { return _PWLData; }
+    Span<Node> nodes() const { return _nodes; }
+    Span<Device> devices() const { return _devices; }
+    Span<PWLValue> PWLData() const { return _PWLData; }
     const PWLValue& PWLData(const Device& dev) const;
     PWLValue& PWLData(const Device& dev);
     const Device& device(size_t id) const { return _devices[id]; }
@@ -96,6 +106,9 @@ class Circuit {
 
     const Device& findDeviceByName(const std::string& name) const;
     const Node& findNodeByName(const std::string& name) const;
+    /// Node IDs matching the name, which may contain wildcards '*' and '?'.
+    /// Ground node is only returned when it is named explicitly
+    std::vector<size_t> findNodesByPattern(const std::string& pattern) const;
 
     bool isGroundNode(size_t nodeId) const { return _groundNodeId == nodeId; }
 
@@ -109,32 +122,61 @@ class Circuit {
 
     /// Find CellArc data
     const CellArc* cellArc(const std::string& fromPin, const std::string& toPin) const;
-    const LibData* libData() const { return &_libData; }
+    const LibData* libData() const { return _libData.get(); }
     std::vector<std::string> cellArcFromPins(const std::string& toPin) const;
     std::vector<std::string> cellArcToPins(const std::string& fromPin) const;
     std::vector<CellArc*> cellArcsOfDevice(const Device* dev) const;
+    const std::vector<CellArc>& cellArcs() const { return _cellArcs; }
+    /// Lib pin capacitance of the loader capacitor created on a cell input pin,
+    /// nullptr if the device is not a loader capacitor
+    const FixedLoadCap* loaderCap(size_t devId) const;
 
     /// Set the scope of devices and nodes to run transient simulation
     void markSimulationScope(const std::vector<const Device*>& devs);
     void resetSimulationScope();
 
-    std::vector<Device> devicesToSimulate() const;
-    std::vector<Node> nodesToSimulate() const;
+    /// Views of the devices and nodes in the simulation scope, in ID order.
+    /// They are invalidated when the scope is marked or reset again
+    IndexedSpan<Device> devicesToSimulate() const { return IndexedSpan<Device>(_devices, _devicesToSimulate); }
+    IndexedSpan<Node> nodesToSimulate() const { return IndexedSpan<Node>(_nodes, _nodesToSimulate); }
+    /// Sorted times in (0, endTime) where PWL sources in the scope change slope
+    std::vector<double> sourceBreakpoints(double endTime) const;
 
     void debugPrint() const;
 
   private:
-    std::string allNodes(const std::vector<ParserDevice>& devs, std::vector<std::string>& allNodes, 
-                         const std::vector<std::string>& pinNameToCalcDelay);
-    typedef std::unordered_map<std::string, size_t> StringIdMap;
-    void elaborateGateDevice(const ParserDevice& dev, const StringIdMap& nodeIdMap, 
+    /// Node names of the netlist and the internal nodes, with the ID of
+    /// the circuit node of each name
+    struct NodeIdMap {
+      SymbolTable         _names;
+      std::vector<size_t> _nodeIds;
+    };
+    SymbolId allNodes(const std::vector<ParserDevice>& devs, SymbolTable& nodeNames,
+                      std::vector<SymbolId>& allNodes, 
+                      const std::vector<std::string>& pinNameToCalcDelay);
+    void elaborateGateDevice(const ParserDevice& dev, NodeIdMap& nodeIdMap, 
                              const std::vector<std::string>& cellOutPinsToCalcDelay);
-    Device* createDevice(const ParserDevice& pDev, const StringIdMap& nodeIdMap);
+    Device* createDevice(const ParserDevice& pDev, const NodeIdMap& nodeIdMap);
     void updateNodeConnection(const Device& dev);
     void buildCircuit(const NetlistParser& parser);
+    struct Indices;
+    /// Indices of names and cell arcs, built on the first lookup
+    const Indices& indices() const;
 
   private:
     typedef std::unordered_map<std::pair<std::string, std::string>, size_t, HashStringPair> CellArcMap;
+    /// Pin full names, or node or device IDs, to indices of _cellArcs
+    typedef std::unordered_map<std::string, std::vector<size_t>> PinArcMap;
+    typedef std::unordered_map<size_t, std::vector<size_t>> IdArcMap;
+    struct Indices {
+      NameIndex  _nodes;
+      NameIndex  _devices;
+      CellArcMap _cellArcMap;
+      PinArcMap  _arcsFromPin;
+      PinArcMap  _arcsToPin;
+      IdArcMap   _arcsOfInputNode;
+      IdArcMap   _arcsOfDriver;
+    };
     
     size_t                         _groundNodeId;
     size_t                         _order;
@@ -143,11 +185,16 @@ class Circuit {
     std::vector<Node>              _nodes;
     std::vector<Device>            _devices;
     std::vector<PWLValue>          _PWLData;
-    LibData                        _libData;
+    /// Cell arcs point into the lib data, so it stays at one address when 
+    /// the circuit is moved, and copies made for parallel analyses share it
+    std::shared_ptr<LibData>       _libData;
     std::vector<size_t>            _driverOutputNodes;
     std::vector<size_t>            _loaderInputNodes;
+    std::unordered_map<size_t, FixedLoadCap> _loaderCaps;
     std::vector<CellArc>           _cellArcs;
-    CellArcMap                     _cellArcMap;
+    /// Most runs look up a few names only, and copies of the circuit
+    /// made for parallel analyses share the indices
+    mutable std::shared_ptr<const Indices> _indices;
     std::vector<size_t>            _nodesToSimulate;
     std::vector<size_t>            _devicesToSimulate;
 }; 
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include "CircuitReduction.h"
+#include "Circuit.h"
+#include "NetlistParser.h"
+#include "Timer.h"
+
+namespace NA {
+
+static constexpr size_t invalidId = static_cast<size_t>(-1);
+/// Nodes with more neighbors are kept, as eliminating a node adds a
+/// resistor and a capacitor between every pair of its neighbors
+static constexpr size_t maxDegree = 6;
+
+/// Conductance and capacitance between two nodes. The original devices
+/// are kept when their value is not changed by merging or elimination
+struct ReductionEdge {
+  size_t _node1 = invalidId;
+  size_t _node2 = invalidId;
+  double _g = 0;
+  double _c = 0;
+  size_t _res = invalidId;
+  size_t _cap = invalidId;
+  bool   _resModified = false;
+  bool   _capModified = false;
+  bool   _removed = false;
+
+  size_t otherNode(size_t node) const { return node == _node1 ? _node2 : _node1; }
+};
+
+class ReductionGraph {
+  public:
+    ReductionGraph(size_t nodeCount)
+    : _adjacency(nodeCount) {}
+
+    const std::vector<ReductionEdge>& edges() const { return _edges; }
+    ReductionEdge& edge(size_t id) { return _edges[id]; }
+
+    /// Edge between node1 and node2, a new one is added if there is none
+    size_t findOrAddEdge(size_t node1, size_t node2)
+    {
+      /// Ground has as many edges as capacitors, search the other side
+      const std::vector<size_t>& edges =
+        _adjacency[node1].size() <= _adjacency[node2].size() ? _adjacency[node1] : _adjacency[node2];
+      for (size_t id : edges) {
+        const ReductionEdge& e = _edges[id];
+        if (e._removed == false &&
+            ((e._node1 == node1 && e._node2 == node2) ||
+             (e._node1 == node2 && e._node2 == node1))) {
+          return id;
+        }
+      }
+      size_t id = _edges.size();
+      ReductionEdge e;
+      e._node1 = node1;
+      e._node2 = node2;
+      _edges.push_back(e);
+      _adjacency[node1].push_back(id);
+      _adjacency[node2].push_back(id);
+      return id;
+    }
+
+    void addResistor(const Device& dev)
+    {
+      ReductionEdge& e = _edges[findOrAddEdge(dev._posNode, dev._negNode)];
+      if (e._g != 0 || e._res != invalidId) {
+        e._resModified = true;
+      }
+      e._g += 1 / dev._value;
+      e._res = dev._devId;
+    }
+
+    void addCapacitor(const Device& dev)
+    {
+      ReductionEdge& e = _edges[findOrAddEdge(dev._posNode, dev._negNode)];
+      if (e._c != 0 || e._cap != invalidId) {
+        e._capModified = true;
+      }
+      e._c += dev._value;
+      e._cap = dev._devId;
+    }
+
+    /// Live edges of node, removed ones are dropped from its list
+    const std::vector<size_t>& nodeEdges(size_t node)
+    {
+      std::vector<size_t>& edges = _adjacency[node];
+      size_t count = 0;
+      for (size_t id : edges) {
+        if (_edges[id]._removed == false) {
+          edges[count++] = id;
+        }
+      }
+      edges.resize(count);
+      return edges;
+    }
+
+    /// TICER elimination of node, which has neighbors through edges
+    void eliminate(size_t node, const std::vector<size_t>& edges, double totalG)
+    {
+      /// Copied as adding edges moves them
+      std::vector<ReductionEdge> nodeEdges;
+      for (size_t id : edges) {
+        nodeEdges.push_back(_edges[id]);
+        _edges[id]._removed = true;
+      }
+      for (size_t i=0; i<nodeEdges.size(); ++i) {
+        const ReductionEdge& ei = nodeEdges[i];
+        for (size_t j=i+1; j<nodeEdges.size(); ++j) {
+          const ReductionEdge& ej = nodeEdges[j];
+          double g = ei._g * ej._g / totalG;
+          double c = (ei._g * ej._c + ej._g * ei._c) / totalG;
+          if (g == 0 && c == 0) {
+            continue;
+          }
+          ReductionEdge& e = _edges[findOrAddEdge(ei.otherNode(node), ej.otherNode(node))];
+          if (g != 0) {
+            e._g += g;
+            e._resModified = true;
+          }
+          if (c != 0) {
+            e._c += c;
+            e._capModified = true;
+          }
+        }
+      }
+    }
+
+  private:
+    std::vector<ReductionEdge>       _edges;
+    std::vector<std::vector<size_t>> _adjacency;
+};
+
+static inline bool
+isReducible(const Device& dev)
+{
+  if (dev._isInternal || dev._posNode == dev._negNode) {
+    return false;
+  }
+  if (dev._type == DeviceType::Resistor) {
+    return dev._value > 0;
+  }
+  return dev._type == DeviceType::Capacitor;
+}
+
+void
+CircuitReduction::markProbes(const NetlistParser& parser, std::vector<bool>& keepNode,
+                             std::vector<bool>& keepDevice) const
+{
+  const Circuit& ckt = *_owner;
+  const std::string& simName = ckt._param._name;
+  auto keepNodeNamed = [&](const std::string& name) {
+    const Node& node = ckt.findNodeByName(name);
+    if (node._nodeId != invalidId) {
+      keepNode[node._nodeId] = true;
+    }
+  };
+  auto keepDeviceNamed = [&](const std::string& name) {
+    const Device& dev = ckt.findDeviceByName(name);
+    if (dev._devId != invalidId) {
+      keepDevice[dev._devId] = true;
+    }
+  };
+  for (const PlotData& plot : parser.plotData()) {
+    for (size_t i=0; i<plot._nodeToPlot.size(); ++i) {
+      if (plot._nodeSimName[i] == simName) {
+        keepNodeNamed(plot._nodeToPlot[i]);
+      }
+    }
+    for (size_t i=0; i<plot._deviceToPlot.size(); ++i) {
+      if (plot._devSimName[i] == simName) {
+        keepDeviceNamed(plot._deviceToPlot[i]);
+      }
+    }
+  }
+  for (const MeasurePoint& mp : parser.measurePoints(simName)) {
+    if (mp._triggerType == SimResultType::Voltage) {
+      keepNodeNamed(mp._trigger);
+    } else {
+      keepDeviceNamed(mp._trigger);
+    }
+    if (mp._targetType == SimResultType::Voltage) {
+      keepNodeNamed(mp._target);
+    } else {
+      keepDeviceNamed(mp._target);
+    }
+  }
+}
+
+void
+CircuitReduction::run(const NetlistParser& parser)
+{
+  timespec start;
+  clock_gettime(CLOCK_REALTIME, &start);
+  Circuit& ckt = *_owner;
+  size_t nodeCount = ckt._nodes.size();
+  size_t deviceCount = ckt._devices.size();
+  std::vector<bool> keepNode(nodeCount, false);
+  std::vector<bool> keepDevice(deviceCount, false);
+  keepNode[ckt._groundNodeId] = true;
+  markProbes(parser, keepNode, keepDevice);
+
+  ReductionGraph graph(nodeCount);
+  std::vector<size_t> devicesToSimulate;
+  for (const Device& dev : ckt._devices) {
+    if (keepDevice[dev._devId] == false && isReducible(dev)) {
+      if (dev._type == DeviceType::Resistor) {
+        graph.addResistor(dev);
+      } else {
+        graph.addCapacitor(dev);
+      }
+      continue;
+    }
+    devicesToSimulate.push_back(dev._devId);
+    for (size_t node : {dev._posNode, dev._negNode, dev._posSampleNode, dev._negSampleNode}) {
+      if (node != invalidId) {
+        keepNode[node] = true;
+      }
+    }
+  }
+
+  /// Neighbors of an eliminated node are visited again, as their time
+  /// constants and degrees are changed
+  double maxTau = ckt._param._reduceTol * ckt._param._simTick;
+  std::vector<bool> isEliminated(nodeCount, false);
+  std::vector<bool> isQueued(nodeCount, false);
+  std::vector<size_t> queue;
+  for (size_t node=nodeCount; node-- > 0; ) {
+    if (keepNode[node] == false) {
+      queue.push_back(node);
+      isQueued[node] = true;
+    }
+  }
+  std::vector<size_t> edges;
+  while (queue.empty() == false) {
+    size_t node = queue.back();
+    queue.pop_back();
+    isQueued[node] = false;
+    edges = graph.nodeEdges(node);
+    if (edges.size() > maxDegree) {
+      continue;
+    }
+    double totalG = 0;
+    double totalC = 0;
+    for (size_t id : edges) {
+      totalG += graph.edge(id)._g;
+      totalC += graph.edge(id)._c;
+    }
+    if (edges.empty() == false && (totalG <= 0 || totalC > maxTau * totalG)) {
+      continue;
+    }
+    graph.eliminate(node, edges, totalG);
+    isEliminated[node] = true;
+    for (size_t id : edges) {
+      size_t neighbor = graph.edge(id).otherNode(node);
+      if (keepNode[neighbor] == false && isEliminated[neighbor] == false &&
+          isQueued[neighbor] == false) {
+        queue.push_back(neighbor);
+        isQueued[neighbor] = true;
+      }
+    }
+  }
+
+  /// Devices of the reduced edges, new ones are added for changed values
+  size_t newDevices = 0;
+  auto addDevice = [&](DeviceType type, const ReductionEdge& e, double value) {
+    Device dev;
+    dev._type = type;
+    dev._name = std::string("reduced/") + (type == DeviceType::Resistor ? "R" : "C") +
+                std::to_string(newDevices++);
+    dev._devId = ckt._devices.size();
+    dev._posNode = e._node1;
+    dev._negNode = e._node2;
+    dev._value = value;
+    ckt._devices.push_back(dev);
+    ckt.updateNodeConnection(dev);
+    devicesToSimulate.push_back(dev._devId);
+  };
+  for (const ReductionEdge& e : graph.edges()) {
+    if (e._removed) {
+      continue;
+    }
+    if (e._g != 0) {
+      if (e._resModified) {
+        addDevice(DeviceType::Resistor, e, 1 / e._g);
+      } else {
+        devicesToSimulate.push_back(e._res);
+      }
+    }
+    if (e._c != 0) {
+      if (e._capModified) {
+        addDevice(DeviceType::Capacitor, e, e._c);
+      } else {
+        devicesToSimulate.push_back(e._cap);
+      }
+    }
+  }
+  /// Names of the new devices are indexed on the next lookup
+  ckt._indices.reset();
+
+  std::sort(devicesToSimulate.begin(), devicesToSimulate.end());
+  ckt._devicesToSimulate.swap(devicesToSimulate);
+  ckt._nodesToSimulate.clear();
+  for (size_t node=0; node<nodeCount; ++node) {
+    if (isEliminated[node] == false) {
+      ckt._nodesToSimulate.push_back(node);
+    }
+  }
+
+  timespec end;
+  clock_gettime(CLOCK_REALTIME, &end);
+  printf("Circuit for %s reduced from %lu nodes and %lu devices to %lu nodes and %lu devices "
+         "in %.3f milliseconds\n", ckt.simName().data(), nodeCount, deviceCount,
+         ckt._nodesToSimulate.size(), ckt._devicesToSimulate.size(), 1e-6*timeDiffNs(end, start));
+}
+
+}
@@ -0,0 +1,43 @@
+#ifndef _NA_CIRCUITREDUCTION_H_
+#define _NA_CIRCUITREDUCTION_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace NA {
+
+class Circuit;
+class NetlistParser;
+
+/// Reduction of the RC part of a circuit before transient simulation,
+/// enabled with `.option reduce=1`. Resistors and capacitors between the
+/// same two nodes are merged, then internal nodes are eliminated one by
+/// one with TICER: a node is eliminated when its time constant, total
+/// capacitance over total conductance, is at most reducetol times the
+/// simulation tick. Its resistors and capacitors are replaced by ones
+/// between each pair of its neighbors. Nodes without capacitance, like
+/// the ones in series resistor chains and at dangling resistors, are
+/// eliminated exactly.
+/// Ground, nodes of sources, inductors, cell devices and probed devices,
+/// and nodes plotted or measured are kept. Devices and nodes are never
+/// removed from the circuit, the reduced circuit is the simulation scope.
+class CircuitReduction {
+  public:
+    CircuitReduction(Circuit* owner)
+    : _owner(owner) {}
+
+    /// Reduce owner keeping what parser probes for the analysis of owner,
+    /// and set the simulation scope of owner to the reduced circuit
+    void run(const NetlistParser& parser);
+
+  private:
+    void markProbes(const NetlistParser& parser, std::vector<bool>& keepNode,
+                    std::vector<bool>& keepDevice) const;
+
+  private:
+    Circuit* _owner;
+};
+
+}
+
+#endif
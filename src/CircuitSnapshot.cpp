@@ -0,0 +1,522 @@
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "CircuitSnapshot.h"
+#include "Circuit.h"
+#include "NetlistParser.h"
+
+namespace NA {
+
+static const char snapshotMagic[8] = {'T', 'T', 'C', 'K', 'T', 'B', 'I', 'N'};
+/// Increase when the layout below or the elaboration of cells changes
+static const uint32_t snapshotVersion = 2;
+
+/// Layout of the snapshot file, all sections start at multiples of 8 bytes
+struct SnapshotSection {
+  uint64_t _offset = 0; /// Bytes from the start of the file
+  uint64_t _count = 0;
+};
+
+/// Characters in the chars section
+struct SnapshotString {
+  uint64_t _offset = 0;
+  uint64_t _size = 0;
+};
+
+/// Node and device IDs are 32 bits, invalid IDs are kept as invalid.
+/// Node connections are not stored, they are rebuilt from the devices
+struct SnapshotDevice {
+  uint32_t _posNode = 0;
+  uint32_t _negNode = 0;
+  uint32_t _posSampleNode = 0;
+  uint32_t _negSampleNode = 0;
+  uint32_t _sampleDevice = 0;
+  uint8_t  _type = 0;
+  uint8_t  _isPWLValue = 0;
+  uint8_t  _isInternal = 0;
+  uint8_t  _pad = 0;
+  /// Bits of _value, or _PWLData of PWL sources
+  uint64_t _value = 0;
+  double   _acMag = 0;
+  double   _acPhase = 0;
+};
+
+struct SnapshotPWL {
+  /// Doubles in the PWL points section, times then values
+  uint64_t _offset = 0;
+  uint32_t _timeSize = 0;
+  uint32_t _valueSize = 0;
+};
+
+struct SnapshotLoaderCap {
+  uint64_t       _devId = 0;
+  SnapshotString _pin;
+  double         _rise = 0;
+  double         _fall = 0;
+};
+
+struct SnapshotCellArc {
+  SnapshotString _inst;
+  SnapshotString _cell;
+  SnapshotString _fromPin;
+  SnapshotString _toPin;
+  uint64_t       _inputTranNode = 0;
+  uint64_t       _driverResistor = 0;
+  uint64_t       _driverSource = 0;
+};
+
+struct SnapshotHeader {
+  char            _magic[8];
+  uint32_t        _version = 0;
+  uint32_t        _pad = 0;
+  uint64_t        _key = 0;
+  uint64_t        _nodeCount = 0;
+  uint64_t        _groundNodeId = 0;
+  uint64_t        _order = 0;
+  double          _scalingFactor = 0;
+  SnapshotSection _chars;
+  /// Names of the nodes and of the devices in ID order, each ends with '\0'
+  SnapshotSection _nodeNames;
+  SnapshotSection _deviceNames;
+  SnapshotSection _devices;
+  SnapshotSection _PWLs;
+  SnapshotSection _PWLPoints;
+  SnapshotSection _driverOutputNodes;
+  SnapshotSection _loaderInputNodes;
+  SnapshotSection _loaderCaps;
+  SnapshotSection _cellArcs;
+  /// Lib cells instantiated by the netlist
+  SnapshotSection _libCells;
+};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "Snapshot sections must be 8 byte aligned");
+static_assert(sizeof(Device::_value) == sizeof(uint64_t), "Device values are stored as 64 bits");
+
+static const uint32_t invalidSnapshotId = static_cast<uint32_t>(-1);
+
+static uint32_t
+snapshotId(size_t id)
+{
+  return id == static_cast<size_t>(-1) ? invalidSnapshotId : static_cast<uint32_t>(id);
+}
+
+static size_t
+circuitId(uint32_t id)
+{
+  return id == invalidSnapshotId ? static_cast<size_t>(-1) : id;
+}
+
+static uint64_t
+padded(uint64_t bytes)
+{
+  return (bytes + 7) & ~static_cast<uint64_t>(7);
+}
+
+template <typename T>
+static void
+setSection(SnapshotSection& section, const std::vector<T>& data, uint64_t& offset)
+{
+  section._offset = offset;
+  section._count = data.size();
+  offset += padded(data.size() * sizeof(T));
+}
+
+template <typename T>
+static void
+writeSection(std::ofstream& out, const std::vector<T>& data)
+{
+  uint64_t bytes = data.size() * sizeof(T);
+  out.write(reinterpret_cast<const char*>(data.data()), bytes);
+  static const char zeros[8] = {0};
+  out.write(zeros, padded(bytes) - bytes);
+}
+
+template <typename T>
+static bool
+checkSection(const SnapshotSection& section, uint64_t size)
+{
+  return section._offset % 8 == 0 && section._offset <= size &&
+         section._count <= (size - section._offset) / sizeof(T);
+}
+
+/// Flattens the content of a circuit into the snapshot sections
+struct SnapshotBuilder {
+  SnapshotString addString(const std::string& str)
+  {
+    SnapshotString data;
+    data._offset = _chars.size();
+    data._size = str.size();
+    _chars.insert(_chars.end(), str.begin(), str.end());
+    return data;
+  }
+
+  static void addName(std::vector<char>& names, const std::string& name)
+  {
+    names.insert(names.end(), name.begin(), name.end());
+    names.push_back('\0');
+  }
+
+  bool write(const std::string& file, SnapshotHeader& header) const
+  {
+    uint64_t offset = sizeof(SnapshotHeader);
+    setSection(header._chars, _chars, offset);
+    setSection(header._nodeNames, _nodeNames, offset);
+    setSection(header._deviceNames, _deviceNames, offset);
+    setSection(header._devices, _devices, offset);
+    setSection(header._PWLs, _PWLs, offset);
+    setSection(header._PWLPoints, _PWLPoints, offset);
+    setSection(header._driverOutputNodes, _driverOutputNodes, offset);
+    setSection(header._loaderInputNodes, _loaderInputNodes, offset);
+    setSection(header._loaderCaps, _loaderCaps, offset);
+    setSection(header._cellArcs, _cellArcs, offset);
+    setSection(header._libCells, _libCells, offset);
+
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeSection(out, _chars);
+    writeSection(out, _nodeNames);
+    writeSection(out, _deviceNames);
+    writeSection(out, _devices);
+    writeSection(out, _PWLs);
+    writeSection(out, _PWLPoints);
+    writeSection(out, _driverOutputNodes);
+    writeSection(out, _loaderInputNodes);
+    writeSection(out, _loaderCaps);
+    writeSection(out, _cellArcs);
+    writeSection(out, _libCells);
+    return static_cast<bool>(out);
+  }
+
+  std::vector<char>              _chars;
+  std::vector<char>              _nodeNames;
+  std::vector<char>              _deviceNames;
+  std::vector<SnapshotDevice>    _devices;
+  std::vector<SnapshotPWL>       _PWLs;
+  std::vector<double>            _PWLPoints;
+  std::vector<uint64_t>          _driverOutputNodes;
+  std::vector<uint64_t>          _loaderInputNodes;
+  std::vector<SnapshotLoaderCap> _loaderCaps;
+  std::vector<SnapshotCellArc>   _cellArcs;
+  std::vector<SnapshotString>    _libCells;
+};
+
+/// Read access to a mapped snapshot file
+class SnapshotView {
+  public:
+    SnapshotView(const char* base, uint64_t size)
+    : _base(base), _size(size),
+      _header(reinterpret_cast<const SnapshotHeader*>(base)) {}
+
+    bool check() const
+    {
+      const SnapshotHeader& h = *_header;
+      return checkSection<char>(h._chars, _size) &&
+             checkSection<char>(h._nodeNames, _size) &&
+             checkSection<char>(h._deviceNames, _size) &&
+             checkSection<SnapshotDevice>(h._devices, _size) &&
+             checkSection<SnapshotPWL>(h._PWLs, _size) &&
+             checkSection<double>(h._PWLPoints, _size) &&
+             checkSection<uint64_t>(h._driverOutputNodes, _size) &&
+             checkSection<uint64_t>(h._loaderInputNodes, _size) &&
+             checkSection<SnapshotLoaderCap>(h._loaderCaps, _size) &&
+             checkSection<SnapshotCellArc>(h._cellArcs, _size) &&
+             checkSection<SnapshotString>(h._libCells, _size);
+    }
+
+    const SnapshotHeader& header() const { return *_header; }
+
+    template <typename T>
+    const T* section(const SnapshotSection& section) const
+    {
+      return reinterpret_cast<const T*>(_base + section._offset);
+    }
+
+    std::string string(const SnapshotString& str) const
+    {
+      return std::string(section<char>(_header->_chars) + str._offset, str._size);
+    }
+
+    /// Assign the next name in sec at offset to name, false if the
+    /// section ends before the name
+    bool nextName(const SnapshotSection& sec, uint64_t& offset, std::string& name) const
+    {
+      const char* names = section<char>(sec);
+      const void* found = offset < sec._count ? memchr(names + offset, '\0', sec._count - offset) : nullptr;
+      if (found == nullptr) {
+        return false;
+      }
+      uint64_t size = static_cast<const char*>(found) - (names + offset);
+      name.assign(names + offset, size);
+      offset += size + 1;
+      return true;
+    }
+
+    std::vector<size_t> ids(const SnapshotSection& sec) const
+    {
+      const uint64_t* data = section<uint64_t>(sec);
+      return std::vector<size_t>(data, data + sec._count);
+    }
+
+  private:
+    const char*           _base;
+    uint64_t              _size;
+    const SnapshotHeader* _header;
+};
+
+std::string
+CircuitSnapshot::snapshotFile(const NetlistParser& parser, const std::string& simName)
+{
+  return parser.fileName() + "." + simName + ".ckt";
+}
+
+uint64_t
+CircuitSnapshot::key(const NetlistParser& parser) const
+{
+  /// Lib files are checked by size and modification time like the lib
+  /// data cache, hashing their content would cost as much as reading them
+  uint64_t key = parser.contentHash();
+  auto mix = [&key](uint64_t value) { key = key * 1099511628211ULL + value; };
+  std::hash<std::string> hashString;
+  for (const std::string& libFile : parser.libDataFiles()) {
+    mix(hashString(libFile));
+    struct stat st;
+    if (stat(libFile.data(), &st) == 0) {
+      mix(static_cast<uint64_t>(st.st_size));
+      mix(static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec);
+    }
+  }
+  mix(hashString(parser.userGroundNet()));
+  for (const std::string& pin : parser.cellOutPinsToCalcDelay()) {
+    mix(hashString(pin));
+  }
+  mix(static_cast<uint64_t>(_owner->_param._driverModel));
+  return key;
+}
+
+bool
+CircuitSnapshot::write(const NetlistParser& parser) const
+{
+  const Circuit& ckt = *_owner;
+  SnapshotHeader header;
+  memcpy(header._magic, snapshotMagic, sizeof(snapshotMagic));
+  header._version = snapshotVersion;
+  header._key = key(parser);
+  header._groundNodeId = ckt._groundNodeId;
+  header._order = ckt._order;
+  header._scalingFactor = ckt._scalingFactor;
+
+  if (ckt._nodes.size() >= invalidSnapshotId || ckt._devices.size() >= invalidSnapshotId) {
+    printf("WARNING: Circuit is too large for a snapshot\n");
+    return false;
+  }
+  header._nodeCount = ckt._nodes.size();
+
+  SnapshotBuilder builder;
+  for (const Node& node : ckt._nodes) {
+    SnapshotBuilder::addName(builder._nodeNames, node._name);
+  }
+  builder._devices.reserve(ckt._devices.size());
+  for (const Device& dev : ckt._devices) {
+    SnapshotBuilder::addName(builder._deviceNames, dev._name);
+    SnapshotDevice data;
+    data._posNode = snapshotId(dev._posNode);
+    data._negNode = snapshotId(dev._negNode);
+    data._posSampleNode = snapshotId(dev._posSampleNode);
+    data._negSampleNode = snapshotId(dev._negSampleNode);
+    data._sampleDevice = snapshotId(dev._sampleDevice);
+    data._type = static_cast<uint8_t>(dev._type);
+    data._isPWLValue = dev._isPWLValue;
+    data._isInternal = dev._isInternal;
+    memcpy(&data._value, &dev._value, sizeof(data._value));
+    data._acMag = dev._acMag;
+    data._acPhase = dev._acPhase;
+    builder._devices.push_back(data);
+  }
+  for (const PWLValue& pwl : ckt._PWLData) {
+    SnapshotPWL data;
+    data._offset = builder._PWLPoints.size();
+    data._timeSize = pwl._time.size();
+    data._valueSize = pwl._value.size();
+    builder._PWLPoints.insert(builder._PWLPoints.end(), pwl._time.begin(), pwl._time.end());
+    builder._PWLPoints.insert(builder._PWLPoints.end(), pwl._value.begin(), pwl._value.end());
+    builder._PWLs.push_back(data);
+  }
+  builder._driverOutputNodes.assign(ckt._driverOutputNodes.begin(), ckt._driverOutputNodes.end());
+  builder._loaderInputNodes.assign(ckt._loaderInputNodes.begin(), ckt._loaderInputNodes.end());
+  for (const auto& kv : ckt._loaderCaps) {
+    SnapshotLoaderCap data;
+    data._devId = kv.first;
+    data._pin = builder.addString(kv.second.pinName());
+    data._rise = kv.second.value(true);
+    data._fall = kv.second.value(false);
+    builder._loaderCaps.push_back(data);
+  }
+  for (const CellArc& arc : ckt._cellArcs) {
+    SnapshotCellArc data;
+    data._inst = builder.addString(arc.instance());
+    data._cell = builder.addString(ckt._libData->cellName(arc.cellId()));
+    data._fromPin = builder.addString(arc.fromPin());
+    data._toPin = builder.addString(arc.toPin());
+    data._inputTranNode = arc.inputTranNode();
+    data._driverResistor = arc.driverResistorId();
+    data._driverSource = arc.driverSourceId();
+    builder._cellArcs.push_back(data);
+  }
+  for (const std::string& cell : parser.libCellNames()) {
+    builder._libCells.push_back(builder.addString(cell));
+  }
+
+  /// Write to a temporary file first, so a process reading the snapshot
+  /// never sees a partial file
+  std::string file = snapshotFile(parser, ckt.simName());
+  std::string tmpFile = file + "." + std::to_string(getpid()) + "." +
+                        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  if (builder.write(tmpFile, header) == false ||
+      std::rename(tmpFile.data(), file.data()) != 0) {
+    std::remove(tmpFile.data());
+    printf("WARNING: Cannot write circuit snapshot %s\n", file.data());
+    return false;
+  }
+  return true;
+}
+
+bool
+CircuitSnapshot::load(const NetlistParser& parser)
+{
+  Circuit& ckt = *_owner;
+  std::string file = snapshotFile(parser, ckt.simName());
+  int fd = open(file.data(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  std::shared_ptr<const void> mapping(addr, [size](const void* p) {
+    munmap(const_cast<void*>(p), size);
+  });
+
+  SnapshotView view(static_cast<const char*>(addr), size);
+  const SnapshotHeader& header = view.header();
+  if (memcmp(header._magic, snapshotMagic, sizeof(snapshotMagic)) != 0 ||
+      header._version != snapshotVersion ||
+      header._key != key(parser) ||
+      view.check() == false) {
+    return false;
+  }
+
+  if (header._groundNodeId >= header._nodeCount) {
+    return false;
+  }
+  ckt._nodes.resize(header._nodeCount);
+  uint64_t nameOffset = 0;
+  for (size_t i=0; i<ckt._nodes.size(); ++i) {
+    Node& node = ckt._nodes[i];
+    node._nodeId = i;
+    node._isGround = i == header._groundNodeId;
+    if (view.nextName(header._nodeNames, nameOffset, node._name) == false) {
+      ckt._nodes.clear();
+      return false;
+    }
+  }
+
+  const SnapshotDevice* devices = view.section<SnapshotDevice>(header._devices);
+  ckt._devices.resize(header._devices._count);
+  std::vector<uint32_t> connCounts(ckt._nodes.size(), 0);
+  nameOffset = 0;
+  for (size_t i=0; i<ckt._devices.size(); ++i) {
+    const SnapshotDevice& data = devices[i];
+    Device& dev = ckt._devices[i];
+    if (data._posNode >= connCounts.size() || data._negNode >= connCounts.size() ||
+        view.nextName(header._deviceNames, nameOffset, dev._name) == false) {
+      ckt._nodes.clear();
+      ckt._devices.clear();
+      return false;
+    }
+    dev._devId = i;
+    dev._posNode = data._posNode;
+    dev._negNode = data._negNode;
+    dev._posSampleNode = circuitId(data._posSampleNode);
+    dev._negSampleNode = circuitId(data._negSampleNode);
+    dev._sampleDevice = circuitId(data._sampleDevice);
+    dev._type = static_cast<DeviceType>(data._type);
+    dev._isPWLValue = data._isPWLValue;
+    dev._isInternal = data._isInternal;
+    memcpy(&dev._value, &data._value, sizeof(data._value));
+    dev._acMag = data._acMag;
+    dev._acPhase = data._acPhase;
+    ++connCounts[dev._posNode];
+    ++connCounts[dev._negNode];
+  }
+  for (size_t i=0; i<ckt._nodes.size(); ++i) {
+    ckt._nodes[i]._connection.reserve(connCounts[i]);
+  }
+  for (const Device& dev : ckt._devices) {
+    ckt.updateNodeConnection(dev);
+  }
+
+  const SnapshotPWL* PWLs = view.section<SnapshotPWL>(header._PWLs);
+  const double* points = view.section<double>(header._PWLPoints);
+  ckt._PWLData.resize(header._PWLs._count);
+  for (size_t i=0; i<ckt._PWLData.size(); ++i) {
+    const double* times = points + PWLs[i]._offset;
+    const double* values = times + PWLs[i]._timeSize;
+    ckt._PWLData[i]._time.assign(times, times + PWLs[i]._timeSize);
+    ckt._PWLData[i]._value.assign(values, values + PWLs[i]._valueSize);
+  }
+  ckt._driverOutputNodes = view.ids(header._driverOutputNodes);
+  ckt._loaderInputNodes = view.ids(header._loaderInputNodes);
+
+  const SnapshotLoaderCap* loaderCaps = view.section<SnapshotLoaderCap>(header._loaderCaps);
+  for (size_t i=0; i<header._loaderCaps._count; ++i) {
+    FixedLoadCap cap;
+    cap.setPinName(view.string(loaderCaps[i]._pin));
+    cap.setCaps(loaderCaps[i]._rise, loaderCaps[i]._fall);
+    ckt._loaderCaps.insert({loaderCaps[i]._devId, cap});
+  }
+
+  /// Cell arcs point into the lib data, only the instantiated cells are read
+  if (parser.libDataFiles().empty() == false) {
+    const SnapshotString* libCells = view.section<SnapshotString>(header._libCells);
+    std::vector<std::string> cells;
+    for (size_t i=0; i<header._libCells._count; ++i) {
+      cells.push_back(view.string(libCells[i]));
+    }
+    ckt._libData->read(parser.libDataFiles(), cells);
+  }
+  const SnapshotCellArc* cellArcs = view.section<SnapshotCellArc>(header._cellArcs);
+  for (size_t i=0; i<header._cellArcs._count; ++i) {
+    const SnapshotCellArc& data = cellArcs[i];
+    CellArc arc(ckt._libData.get(), view.string(data._inst), view.string(data._cell),
+                view.string(data._fromPin), view.string(data._toPin));
+    arc.setInputTranNode(data._inputTranNode);
+    arc.setDriverResistorId(data._driverResistor);
+    arc.setDriverSourceId(data._driverSource);
+    ckt._cellArcs.push_back(arc);
+  }
+
+  ckt._groundNodeId = header._groundNodeId;
+  ckt._order = header._order;
+  ckt._scalingFactor = header._scalingFactor;
+  return true;
+}
+
+}
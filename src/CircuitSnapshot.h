@@ -0,0 +1,42 @@
+#ifndef _NA_CIRCUITSNAPSHOT_H_
+#define _NA_CIRCUITSNAPSHOT_H_
+
+#include <cstdint>
+#include <string>
+
+namespace NA {
+
+class Circuit;
+class NetlistParser;
+
+/// Binary snapshot of an elaborated circuit, written next to the netlist
+/// as "netlist.name.ckt" for analysis name when `.option snapshot=1` is
+/// given. The snapshot has a versioned header with a key made of the hash
+/// of the netlist device lines, the size and modification time of the lib
+/// files and the options used in elaboration, and flat arrays of nodes,
+/// devices, PWL data, cell arcs and loader caps. A valid snapshot is
+/// mapped with mmap and copied into the circuit, so the netlist devices
+/// are not parsed and no cell is elaborated again.
+class CircuitSnapshot {
+  public:
+    CircuitSnapshot(Circuit* owner)
+    : _owner(owner) {}
+
+    static std::string snapshotFile(const NetlistParser& parser, const std::string& simName);
+
+    /// Load the snapshot of the circuit into owner, false if there is no
+    /// valid snapshot for the current netlist and lib files
+    bool load(const NetlistParser& parser);
+    /// Write the snapshot of owner built from parser
+    bool write(const NetlistParser& parser) const;
+
+  private:
+    uint64_t key(const NetlistParser& parser) const;
+
+  private:
+    Circuit* _owner;
+};
+
+}
+
+#endif
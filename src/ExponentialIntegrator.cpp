@@ -0,0 +1,365 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <unsupported/Eigen/MatrixFunctions>
+#include "ExponentialIntegrator.h"
+#include "Circuit.h"
+#include "MNAStamper.h"
+#include "SimResult.h"
+#include "Debug.h"
+
+namespace NA {
+
+/// Largest subspace before a step is split in two
+static constexpr size_t maxKrylovDim = 60;
+/// Relative change of the projected solution between two subspace sizes
+/// under which the subspace is accepted
+static constexpr double krylovTol = 1e-9;
+/// Reciprocal condition number of C under which it is taken as singular
+static constexpr double singularTol = 1e-13;
+
+bool
+ExponentialIntegrator::formulate()
+{
+  size_t dim = _result.indexMap().size();
+  Eigen::MatrixXd G = Eigen::MatrixXd::Zero(dim, dim);
+  Eigen::MatrixXd C = Eigen::MatrixXd::Zero(dim, dim);
+  Eigen::VectorXd b = Eigen::VectorXd::Zero(dim);
+  MNAStamper stamper(_param, _circuit, _result);
+  /// Backward Euler stamps C/h in C and keeps all incidence in G
+  stamper.stamp(G, C, b, IntegrateMethod::BackwardEuler);
+  C *= _param._simTick;
+
+  /// Fixed nodes follow their sources and are neither dynamic nor algebraic
+  _fixedNodes = _result.fixedNodes();
+  std::vector<bool> isFixed(dim, false);
+  for (const FixedNode& fixed : _fixedNodes) {
+    isFixed[fixed._nodeIndex] = true;
+    isFixed[fixed._branchIndex] = true;
+  }
+  _dynamicIndex.clear();
+  _algebraicIndex.clear();
+  for (size_t i=0; i<dim; ++i) {
+    if (isFixed[i]) {
+      continue;
+    }
+    if ((C.row(i).array() != 0).any() || (C.col(i).array() != 0).any()) {
+      _dynamicIndex.push_back(i);
+    } else {
+      _algebraicIndex.push_back(i);
+    }
+  }
+  size_t nD = _dynamicIndex.size();
+  size_t nA = _algebraicIndex.size();
+  size_t nF = _fixedNodes.size();
+  Eigen::MatrixXd GDD(nD, nD), GDA(nD, nA), GAD(nA, nD), GAA(nA, nA);
+  _C.resize(nD, nD);
+  _GDF.resize(nD, nF);
+  _CDF.resize(nD, nF);
+  _GAF.resize(nA, nF);
+  for (size_t i=0; i<nD; ++i) {
+    for (size_t j=0; j<nD; ++j) {
+      _C(i, j) = C(_dynamicIndex[i], _dynamicIndex[j]);
+      GDD(i, j) = G(_dynamicIndex[i], _dynamicIndex[j]);
+    }
+    for (size_t j=0; j<nA; ++j) {
+      GDA(i, j) = G(_dynamicIndex[i], _algebraicIndex[j]);
+      GAD(j, i) = G(_algebraicIndex[j], _dynamicIndex[i]);
+    }
+    for (size_t k=0; k<nF; ++k) {
+      _GDF(i, k) = G(_dynamicIndex[i], _fixedNodes[k]._nodeIndex);
+      _CDF(i, k) = C(_dynamicIndex[i], _fixedNodes[k]._nodeIndex);
+    }
+  }
+  for (size_t i=0; i<nA; ++i) {
+    for (size_t j=0; j<nA; ++j) {
+      GAA(i, j) = G(_algebraicIndex[i], _algebraicIndex[j]);
+    }
+    for (size_t k=0; k<nF; ++k) {
+      _GAF(i, k) = G(_algebraicIndex[i], _fixedNodes[k]._nodeIndex);
+    }
+  }
+  _fixedRowsG.resize(nF, dim);
+  _fixedRowsC.resize(nF, dim);
+  for (size_t k=0; k<nF; ++k) {
+    _fixedRowsG.row(k) = G.row(_fixedNodes[k]._nodeIndex);
+    _fixedRowsG(k, _fixedNodes[k]._branchIndex) = 0;
+    _fixedRowsC.row(k) = C.row(_fixedNodes[k]._nodeIndex);
+  }
+  _fixedSlopes.setZero(nF);
+
+  if (nA > 0) {
+    Eigen::FullPivLU<Eigen::MatrixXd> GAALU(GAA);
+    if (GAALU.isInvertible() == false) {
+      printf("WARNING: Unknowns without capacitance or inductance in %s can not be solved from G, "
+             "using trap instead of exp\n", _param._name.data());
+      return false;
+    }
+    _GAAInv = GAALU.inverse();
+  } else {
+    _GAAInv.resize(0, 0);
+  }
+  _P = _GAAInv * GAD;
+  _W = GDA * _GAAInv;
+  _S = GDD - GDA * _P;
+  /// Capacitors only connected between nodes without capacitance to ground
+  /// leave C singular, as do loops of capacitors and voltage sources
+  if (nD > 0 && _C.partialPivLu().rcond() < singularTol) {
+    printf("WARNING: Capacitance matrix of %s is singular, using trap instead of exp\n",
+           _param._name.data());
+    return false;
+  }
+  _shiftedLU.clear();
+  return true;
+}
+
+/// Times in (0, endTime) where the slope of a source changes
+Eigen::VectorXd
+ExponentialIntegrator::sources(double time) const
+{
+  Eigen::VectorXd b(_result.indexMap().size());
+  MNAStamper stamper(_param, _circuit, _result);
+  stamper.stampSources(b, time);
+  return b;
+}
+
+/// Voltages of fixed nodes, sources of the algebraic unknowns and the
+/// right hand side of C*x_D' + S*x_D = r on the dynamic unknowns, without
+/// the currents of capacitors to fixed nodes
+void
+ExponentialIntegrator::splitSources(const Eigen::VectorXd& b, Eigen::VectorXd& bA,
+                                    Eigen::VectorXd& r, Eigen::VectorXd& vF) const
+{
+  vF.resize(_fixedNodes.size());
+  for (size_t k=0; k<_fixedNodes.size(); ++k) {
+    vF(k) = b(_fixedNodes[k]._branchIndex);
+  }
+  bA.resize(_algebraicIndex.size());
+  for (size_t i=0; i<_algebraicIndex.size(); ++i) {
+    bA(i) = b(_algebraicIndex[i]);
+  }
+  bA -= _GAF * vF;
+  r.resize(_dynamicIndex.size());
+  for (size_t i=0; i<_dynamicIndex.size(); ++i) {
+    r(i) = b(_dynamicIndex[i]);
+  }
+  r -= _GDF * vF + _W * bA;
+}
+
+/// Shifts are powers of 2 times the tick, so steps of similar lengths
+/// share the factorization
+const Eigen::PartialPivLU<Eigen::MatrixXd>&
+ExponentialIntegrator::shiftedLU(double gamma)
+{
+  auto iter = _shiftedLU.find(gamma);
+  if (iter == _shiftedLU.end()) {
+    Eigen::MatrixXd K = _C + gamma * _S;
+    iter = _shiftedLU.emplace(gamma, K.partialPivLu()).first;
+  }
+  return iter->second;
+}
+
+/// Shift-and-invert Arnoldi on the augmented system z' = A*z with
+/// z = [x; t/gamma; 1], A = [M, gamma*u1, u0; 0, 0, 1/gamma; 0, 0, 0].
+/// The basis spans powers of (I - gamma*A)^-1 applied to z0, with the
+/// projection H of that operator A is approximated by (I - H^-1)/gamma.
+/// The subspace grows until the solution at the end of the step, at the
+/// first output and in between stops changing
+bool
+ExponentialIntegrator::buildSubspace(const Eigen::VectorXd& x0, const Eigen::VectorXd& r0,
+                                     const Eigen::VectorXd& r1, double stepTime, double firstOutput)
+{
+  size_t nD = _dynamicIndex.size();
+  size_t dim = nD + 2;
+  double tick = _param._simTick;
+  double gamma = tick * std::exp2(std::round(std::log2(stepTime / (10 * tick))));
+  const Eigen::PartialPivLU<Eigen::MatrixXd>& KLU = shiftedLU(gamma);
+
+  Eigen::VectorXd z0(dim);
+  z0 << x0, 0, 1;
+  _beta = z0.norm();
+  size_t maxDim = std::min(dim, maxKrylovDim);
+  Eigen::MatrixXd V = Eigen::MatrixXd::Zero(dim, maxDim + 1);
+  Eigen::MatrixXd H = Eigen::MatrixXd::Zero(maxDim + 1, maxDim);
+  V.col(0) = z0 / _beta;
+
+  const double checkTimes[3] = {stepTime, firstOutput, std::sqrt(stepTime * firstOutput)};
+  std::vector<Eigen::VectorXd> prevCoeffs;
+  const double breakdownTol = 1e-12;
+  for (size_t j=0; j<maxDim; ++j) {
+    /// w = (I - gamma*A)^-1 * v, from the bottom row up
+    const Eigen::VectorXd& v = V.col(j);
+    Eigen::VectorXd w(dim);
+    w(nD + 1) = v(nD + 1);
+    w(nD) = v(nD) + w(nD + 1);
+    Eigen::VectorXd rhs = _C * v.head(nD) + gamma * (gamma * w(nD) * r1 + w(nD + 1) * r0);
+    w.head(nD) = KLU.solve(rhs);
+    double wNorm = w.norm();
+    for (size_t pass=0; pass<2; ++pass) {
+      for (size_t i=0; i<=j; ++i) {
+        double h = V.col(i).dot(w);
+        H(i, j) += h;
+        w -= h * V.col(i);
+      }
+    }
+    size_t m = j + 1;
+    double h = w.norm();
+    bool isExhausted = m == dim || h <= breakdownTol * wNorm;
+    if (isExhausted == false) {
+      H(m, j) = h;
+      V.col(m) = w / h;
+    }
+    if (isExhausted == false && m < maxDim && (m < 4 || m % 2 != 0)) {
+      continue;
+    }
+    Eigen::MatrixXd Hm = H.topLeftCorner(m, m);
+    Hm = (Eigen::MatrixXd::Identity(m, m) - Hm.partialPivLu().inverse()) / gamma;
+    std::vector<Eigen::VectorXd> coeffs;
+    bool converged = isExhausted;
+    if (prevCoeffs.empty() == false) {
+      converged = true;
+    }
+    for (size_t k=0; k<3; ++k) {
+      Eigen::MatrixXd E = (checkTimes[k] * Hm).exp();
+      coeffs.push_back(E.col(0));
+      if (prevCoeffs.empty() == false) {
+        Eigen::VectorXd diff = coeffs[k];
+        diff.head(prevCoeffs[k].size()) -= prevCoeffs[k];
+        if (diff.norm() > krylovTol * coeffs[k].norm()) {
+          converged = isExhausted;
+        }
+      }
+    }
+    if (converged) {
+      _V = V.leftCols(m);
+      _Hm = Hm;
+      return true;
+    }
+    prevCoeffs.swap(coeffs);
+  }
+  return false;
+}
+
+Eigen::VectorXd
+ExponentialIntegrator::dynamicState(const Eigen::VectorXd& coeff) const
+{
+  return _beta * (_V.topRows(_dynamicIndex.size()) * coeff);
+}
+
+/// Currents of the grounded sources come from the rows of their nodes,
+/// with the currents of capacitors at the nodes
+void
+ExponentialIntegrator::saveTick(double time, const Eigen::VectorXd& xD, const Eigen::VectorXd& dxD)
+{
+  Eigen::VectorXd b = sources(time);
+  Eigen::VectorXd bA, r, vF;
+  splitSources(b, bA, r, vF);
+  Eigen::VectorXd xA = _GAAInv * bA - _P * xD;
+  Eigen::VectorXd x = Eigen::VectorXd::Zero(b.size());
+  for (size_t i=0; i<_dynamicIndex.size(); ++i) {
+    x(_dynamicIndex[i]) = xD(i);
+  }
+  for (size_t i=0; i<_algebraicIndex.size(); ++i) {
+    x(_algebraicIndex[i]) = xA(i);
+  }
+  if (_fixedNodes.empty() == false) {
+    Eigen::VectorXd dx = Eigen::VectorXd::Zero(b.size());
+    for (size_t i=0; i<_dynamicIndex.size(); ++i) {
+      dx(_dynamicIndex[i]) = dxD(i);
+    }
+    for (size_t k=0; k<_fixedNodes.size(); ++k) {
+      x(_fixedNodes[k]._nodeIndex) = vF(k);
+      dx(_fixedNodes[k]._nodeIndex) = _fixedSlopes(k);
+    }
+    for (size_t k=0; k<_fixedNodes.size(); ++k) {
+      const FixedNode& fixed = _fixedNodes[k];
+      x(fixed._branchIndex) = b(fixed._nodeIndex) - _fixedRowsG.row(k).dot(x) -
+                              _fixedRowsC.row(k).dot(dx);
+    }
+  }
+  _result.ticks().push_back(time);
+  _result.values().insert(_result.values().end(), x.begin(), x.end());
+  if (Debug::enabled(DebugModule::Sim)) {
+    Debug::printSolution(time, "x", x, _result.indexMap(), _circuit);
+  }
+}
+
+bool
+ExponentialIntegrator::run(const std::function<bool(void)>& terminate)
+{
+  if (formulate() == false) {
+    return false;
+  }
+  /// Same ticks as the other methods, up to the first one past simEnd
+  double tick = _param._simTick;
+  double endTime = 0;
+  do {
+    endTime += tick;
+  } while (endTime <= _param._simTime);
+
+  std::vector<double> times = _circuit.sourceBreakpoints(endTime);
+  times.push_back(endTime);
+  size_t nD = _dynamicIndex.size();
+  bool needDerivative = nD > 0 && _fixedNodes.empty() == false;
+  Eigen::VectorXd xD = Eigen::VectorXd::Zero(nD);
+  Eigen::VectorXd dxD = Eigen::VectorXd::Zero(nD);
+  double nextTick = tick;
+  double startTime = 0;
+  size_t steps = 0;
+  for (double breakpoint : times) {
+    while (startTime < breakpoint) {
+      double stepEnd = breakpoint;
+      while (true) {
+        /// Sources are sampled inside the step, as they may jump at its ends
+        double stepTime = stepEnd - startTime;
+        Eigen::VectorXd bA, ra, rb, vFa, vFb;
+        splitSources(sources(startTime + stepTime / 3), bA, ra, vFa);
+        splitSources(sources(startTime + 2 * stepTime / 3), bA, rb, vFb);
+        _fixedSlopes = (vFb - vFa) * (3 / stepTime);
+        Eigen::VectorXd r1 = (rb - ra) * (3 / stepTime);
+        Eigen::VectorXd r0 = ra - r1 * (stepTime / 3) - _CDF * _fixedSlopes;
+        double firstOutput = std::min(nextTick - startTime, stepTime);
+        if (nD == 0 || buildSubspace(xD, r0, r1, stepTime, firstOutput)) {
+          break;
+        }
+        stepEnd = startTime + stepTime / 2;
+      }
+      ++steps;
+      if (nextTick <= stepEnd) {
+        Eigen::VectorXd coeff;
+        Eigen::MatrixXd E;
+        if (nD > 0) {
+          coeff = ((nextTick - startTime) * _Hm).exp().col(0);
+          E = (tick * _Hm).exp();
+        }
+        while (nextTick <= stepEnd) {
+          if (nD > 0) {
+            xD = dynamicState(coeff);
+          }
+          if (needDerivative) {
+            dxD = dynamicState(_Hm * coeff);
+          }
+          saveTick(nextTick, xD, dxD);
+          if (terminate()) {
+            return true;
+          }
+          if (nD > 0) {
+            coeff = E * coeff;
+          }
+          nextTick += tick;
+        }
+      }
+      if (nD > 0) {
+        xD = dynamicState(((stepEnd - startTime) * _Hm).exp().col(0));
+      }
+      startTime = stepEnd;
+    }
+  }
+  if (Debug::enabled(DebugModule::Sim)) {
+    printf("Exponential integration of %s: %lu steps, %lu shifted factorizations\n",
+           _param._name.data(), steps, _shiftedLU.size());
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,79 @@
+#ifndef _NA_EXPONENTIALINTEGRATOR_H_
+#define _NA_EXPONENTIALINTEGRATOR_H_
+
+#include <functional>
+#include <map>
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Dense>
+#include "Base.h"
+#include "SimResult.h"
+
+namespace NA {
+
+class Circuit;
+
+/// Transient simulation of linear circuits with the exact solution of
+/// C*x' + G*x = b(t), selected with `.option method=exp`.
+/// Nodes tied to ground by a voltage source follow the source. Other
+/// unknowns without capacitance or inductance are algebraic, they are
+/// eliminated with the Schur complement of their G block, which leaves
+/// x' = M*x + u(t) on the dynamic unknowns. Sources are linear between PWL
+/// breakpoints, so over a step of length h from x0
+///   x(h) = exp(h*M)*x0 + h*phi1(h*M)*u0 + h^2*phi2(h*M)*u1
+/// which is the action of the exponential of M augmented with u0 and u1 on
+/// [x0; 0; 1]. The action is computed on a shift-and-invert Krylov subspace
+/// of (I - gamma*M)^-1, built with a LU factorization of C + gamma*G, so
+/// stiff RC networks converge in a few dozen vectors. A step spans the
+/// whole gap between two breakpoints, and every tick inside it is taken
+/// from the same subspace.
+class ExponentialIntegrator {
+  public:
+    ExponentialIntegrator(const Circuit& ckt, const AnalysisParameter& param, SimResult& result)
+    : _circuit(ckt), _param(param), _result(result) {}
+
+    /// Simulate until simEnd or until terminate() returns true, the result
+    /// has the same ticks as the other methods. False with nothing
+    /// simulated if the circuit has no regular ODE form, like capacitors
+    /// only connected to nodes without capacitance to ground
+    bool run(const std::function<bool(void)>& terminate);
+
+  private:
+    bool formulate();
+    Eigen::VectorXd sources(double time) const;
+    void splitSources(const Eigen::VectorXd& b, Eigen::VectorXd& bA, Eigen::VectorXd& r,
+                      Eigen::VectorXd& vF) const;
+    const Eigen::PartialPivLU<Eigen::MatrixXd>& shiftedLU(double gamma);
+    bool buildSubspace(const Eigen::VectorXd& x0, const Eigen::VectorXd& r0,
+                       const Eigen::VectorXd& r1, double stepTime, double firstOutput);
+    Eigen::VectorXd dynamicState(const Eigen::VectorXd& coeff) const;
+    void saveTick(double time, const Eigen::VectorXd& xD, const Eigen::VectorXd& dxD);
+
+  private:
+    const Circuit&         _circuit;
+    AnalysisParameter      _param;
+    SimResult&             _result;
+    std::vector<FixedNode> _fixedNodes;
+    std::vector<size_t>    _dynamicIndex; /// dynamic unknown to full index
+    std::vector<size_t>    _algebraicIndex; /// algebraic unknown to full index
+    Eigen::MatrixXd        _C;   /// C of the dynamic unknowns
+    Eigen::MatrixXd        _S;   /// Schur complement of G on the dynamic unknowns
+    Eigen::MatrixXd        _GAAInv; /// inverse of G of the algebraic unknowns
+    Eigen::MatrixXd        _P;   /// x_A = _GAAInv*b_A - _P*x_D
+    Eigen::MatrixXd        _W;   /// r = b_D - _W*b_A
+    Eigen::MatrixXd        _GDF; /// fixed node columns of G, dynamic rows
+    Eigen::MatrixXd        _GAF; /// fixed node columns of G, algebraic rows
+    Eigen::MatrixXd        _CDF; /// fixed node columns of C, dynamic rows
+    Eigen::MatrixXd        _fixedRowsG; /// fixed node rows, for source currents
+    Eigen::MatrixXd        _fixedRowsC;
+    Eigen::VectorXd        _fixedSlopes; /// slopes of fixed voltages in the step
+    std::map<double, Eigen::PartialPivLU<Eigen::MatrixXd>> _shiftedLU; /// C + gamma*S by gamma
+    /// Subspace of the current step, exp(t*A)*z0 ~ _beta*_V*exp(t*_Hm)*e1
+    Eigen::MatrixXd        _V;
+    Eigen::MatrixXd        _Hm;
+    double                 _beta = 0;
+};
+
+}
+
+#endif
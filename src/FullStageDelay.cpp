@@ -0,0 +1,594 @@
+#include <cstdio>
+#include <cmath>
+#include <atomic>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include "FullStageDelay.h"
+#include "LibData.h"
+#include "Simulator.h"
+#include "SimResult.h"
+#include "Parallel.h"
+#include "StringUtil.h"
+#include "Debug.h"
+
+namespace NA {
+
+static const size_t invalidId = static_cast<size_t>(-1);
+/// Ceff iteration stops when the relative change of Ceff is below ceffTolerance
+static const double ceffTolerance = 1e-3;
+static const size_t maxIterations = 20;
+/// Number of time steps to cover the driver ramp and the net time constant
+static const double stepsPerStage = 200;
+
+FullStageDelay::FullStageDelay(const Circuit& circuit, const AnalysisParameter& param,
+                               const std::vector<std::string>& outPins)
+: _circuit(circuit), _param(param), _outPins(outPins)
+{
+}
+
+/// Normalized response of a lumped RC load with time constant tau, to a unit
+/// ramp starting from time 0 with ramp time rampTime
+static double
+rampResponse(double t, double rampTime, double tau)
+{
+  if (t <= 0) {
+    return 0;
+  }
+  if (tau <= 0) {
+    return std::min(t / rampTime, 1.0);
+  }
+  if (rampTime <= 0) {
+    return 1 - std::exp(-t / tau);
+  }
+  if (t <= rampTime) {
+    return (t - tau * (1 - std::exp(-t / tau))) / rampTime;
+  }
+  return 1 - tau * (std::exp((rampTime - t) / tau) - std::exp(-t / tau)) / rampTime;
+}
+
+/// Time when rampResponse reaches level, the response is monotonic
+static double
+rampCrossTime(double level, double rampTime, double tau)
+{
+  double lower = 0;
+  double upper = rampTime + 50 * tau;
+  for (size_t i=0; i<50; ++i) {
+    double t = 0.5 * (lower + upper);
+    if (rampResponse(t, rampTime, tau) < level) {
+      lower = t;
+    } else {
+      upper = t;
+    }
+  }
+  return 0.5 * (lower + upper);
+}
+
+/// Find the ramp time and ramp start time of the driver voltage source, so
+/// that the voltage of a lumped load with time constant tau crosses delayThres
+/// at time delay and has the transition time of transition
+static void
+matchRamp(double delay, double transition, double tau,
+          double lowThres, double highThres, double delayThres,
+          double& rampStart, double& rampTime)
+{
+  double minTransition = tau * std::log((1 - lowThres) / (1 - highThres));
+  if (transition <= minTransition) {
+    rampTime = 0;
+  } else {
+    /// Transition time of the response is at least (highThres-lowThres)*rampTime
+    double lower = 0;
+    double upper = transition / (highThres - lowThres);
+    for (size_t i=0; i<50; ++i) {
+      double t = 0.5 * (lower + upper);
+      double tran = rampCrossTime(highThres, t, tau) - rampCrossTime(lowThres, t, tau);
+      if (tran < transition) {
+        lower = t;
+      } else {
+        upper = t;
+      }
+    }
+    rampTime = 0.5 * (lower + upper);
+  }
+  /// Keep the PWL points apart for a step-like ramp
+  rampTime = std::max(rampTime, transition * 1e-3);
+  rampStart = delay - rampCrossTime(delayThres, rampTime, tau);
+}
+
+/// Driver resistance from the load sensitivity of the output transition,
+/// for a step through R into C, transition is R*C*ln((1-low)/(1-high))
+static double
+driverResistance(const NLDMLUT& tranLUT, double inputTran, double load,
+                 double lowThres, double highThres)
+{
+  double dc = 0.05 * load;
+  double slope = (tranLUT.value(inputTran, load + dc) -
+                  tranLUT.value(inputTran, load - dc)) / (2 * dc);
+  double res = slope / std::log((1 - lowThres) / (1 - highThres));
+  /// Tables with flat transition still need a finite resistor
+  return std::max(res, 1e-3);
+}
+
+/// Ceff that takes the same charge as the net at the end of the ramp
+static double
+chargeCeff(double charge, double res, double rampTime, double totalCap)
+{
+  double lower = totalCap * 1e-3;
+  double upper = totalCap;
+  if (upper * rampResponse(rampTime, rampTime, res * upper) <= charge) {
+    return totalCap;
+  }
+  for (size_t i=0; i<60; ++i) {
+    double c = 0.5 * (lower + upper);
+    if (c * rampResponse(rampTime, rampTime, res * c) < charge) {
+      lower = c;
+    } else {
+      upper = c;
+    }
+  }
+  return 0.5 * (lower + upper);
+}
+
+/// Node voltage at given time, interpolated from the latest two steps
+static double
+latestVoltageAt(const SimResult& result, size_t nodeId, double time)
+{
+  size_t n = result.size();
+  double t2 = result.tick(n-1);
+  double v2 = result.nodeVoltage(nodeId, n-1);
+  double t1 = 0;
+  double v1 = 0;
+  if (n > 1) {
+    t1 = result.tick(n-2);
+    v1 = result.nodeVoltage(nodeId, n-2);
+  }
+  return linearInterpolate(t1, t2, v1, v2, time);
+}
+
+static double
+netCharge(const SimResult& result, const std::vector<const Device*>& caps, double time)
+{
+  double charge = 0;
+  for (const Device* cap : caps) {
+    double v = latestVoltageAt(result, cap->_posNode, time) -
+               latestVoltageAt(result, cap->_negNode, time);
+    charge += cap->_value * v;
+  }
+  return charge;
+}
+
+bool
+FullStageDelay::check() const
+{
+  if (_param._driverModel == DriverModel::PWLCurrent) {
+    printf("ERROR: Current source driver model is not supported in full-stage delay calculation\n");
+    return false;
+  }
+  if (_param._loaderModel == LoaderModel::Varied) {
+    printf("WARNING: Varied loader model is not supported, fixed pin capacitance is used\n");
+  }
+  if (_param._netModel == NetworkModel::PZ) {
+    printf("WARNING: AWE net model is not supported, transient simulation is used\n");
+  }
+  if (_circuit.cellArcs().empty()) {
+    printf("ERROR: No cell arc is found for full-stage delay calculation %s\n", _param._name.data());
+    return false;
+  }
+  return true;
+}
+
+void
+FullStageDelay::buildStages()
+{
+  const std::vector<CellArc>& arcs = _circuit.cellArcs();
+  _nodeStage.assign(_circuit.nodeNumber(), invalidId);
+  _arcStage.assign(arcs.size(), invalidId);
+  _arcResults.assign(arcs.size(), ArcResult());
+  std::unordered_map<size_t, size_t> outputNodeStage;
+  for (size_t arcId=0; arcId<arcs.size(); ++arcId) {
+    const CellArc& arc = arcs[arcId];
+    if (arc.driverResistorId() == invalidId) {
+      continue;
+    }
+    size_t outputNode = arc.outputNode(&_circuit);
+    const auto& found = outputNodeStage.find(outputNode);
+    size_t stageId = _stages.size();
+    if (found == outputNodeStage.end()) {
+      Stage stage;
+      stage._outputNode = outputNode;
+      _stages.push_back(stage);
+      outputNodeStage.insert({outputNode, stageId});
+    } else {
+      stageId = found->second;
+    }
+    _stages[stageId]._arcs.push_back(arcId);
+    _arcStage[arcId] = stageId;
+  }
+
+  for (size_t stageId=0; stageId<_stages.size(); ++stageId) {
+    Stage& stage = _stages[stageId];
+    const CellArc& arc = arcs[stage._arcs[0]];
+    for (const Device* dev : _circuit.traceDevice(arc.driverResistorId())) {
+      stage._netNodes.push_back(dev->_posNode);
+      stage._netNodes.push_back(dev->_negNode);
+    }
+    std::sort(stage._netNodes.begin(), stage._netNodes.end());
+    stage._netNodes.erase(std::unique(stage._netNodes.begin(), stage._netNodes.end()),
+                          stage._netNodes.end());
+    for (size_t nodeId : stage._netNodes) {
+      if (_circuit.isGroundNode(nodeId)) {
+        continue;
+      }
+      if (_nodeStage[nodeId] != invalidId) {
+        printf("WARNING: Node %s is driven by both %s and %s\n",
+               _circuit.node(nodeId)._name.data(),
+               arcs[_stages[_nodeStage[nodeId]]._arcs[0]].toPinFullName().data(),
+               arc.toPinFullName().data());
+        continue;
+      }
+      _nodeStage[nodeId] = stageId;
+    }
+  }
+
+  for (size_t stageId=0; stageId<_stages.size(); ++stageId) {
+    Stage& stage = _stages[stageId];
+    for (size_t arcId : stage._arcs) {
+      size_t faninStage = _nodeStage[arcs[arcId].inputNode()];
+      if (faninStage != invalidId && faninStage != stageId) {
+        stage._fanins.push_back(faninStage);
+      }
+    }
+    std::sort(stage._fanins.begin(), stage._fanins.end());
+    stage._fanins.erase(std::unique(stage._fanins.begin(), stage._fanins.end()),
+                        stage._fanins.end());
+  }
+
+  /// Requested stages and their fanin cones are calculated
+  std::vector<size_t> wavefront;
+  for (size_t arcId=0; arcId<arcs.size(); ++arcId) {
+    size_t stageId = _arcStage[arcId];
+    if (stageId == invalidId || _stages[stageId]._needed) {
+      continue;
+    }
+    bool needed = _outPins.empty();
+    for (const std::string& pin : _outPins) {
+      if (wildcardMatch(pin, arcs[arcId].toPinFullName())) {
+        needed = true;
+        break;
+      }
+    }
+    if (needed) {
+      _stages[stageId]._needed = true;
+      wavefront.push_back(stageId);
+    }
+  }
+  while (wavefront.empty() == false) {
+    size_t stageId = wavefront.back();
+    wavefront.pop_back();
+    for (size_t faninStage : _stages[stageId]._fanins) {
+      if (_stages[faninStage]._needed == false) {
+        _stages[faninStage]._needed = true;
+        wavefront.push_back(faninStage);
+      }
+    }
+  }
+}
+
+bool
+FullStageDelay::levelizeStages()
+{
+  std::vector<size_t> pendingFanins(_stages.size(), 0);
+  std::vector<std::vector<size_t>> fanouts(_stages.size());
+  std::vector<size_t> current;
+  size_t remaining = 0;
+  for (size_t stageId=0; stageId<_stages.size(); ++stageId) {
+    const Stage& stage = _stages[stageId];
+    if (stage._needed == false) {
+      continue;
+    }
+    ++remaining;
+    pendingFanins[stageId] = stage._fanins.size();
+    for (size_t faninStage : stage._fanins) {
+      fanouts[faninStage].push_back(stageId);
+    }
+    if (stage._fanins.empty()) {
+      current.push_back(stageId);
+    }
+  }
+  _levels.clear();
+  while (current.empty() == false) {
+    std::vector<size_t> next;
+    for (size_t stageId : current) {
+      _stages[stageId]._level = _levels.size();
+      for (size_t fanoutStage : fanouts[stageId]) {
+        if (--pendingFanins[fanoutStage] == 0) {
+          next.push_back(fanoutStage);
+        }
+      }
+    }
+    remaining -= current.size();
+    _levels.push_back(current);
+    current.swap(next);
+  }
+  if (remaining == 0) {
+    return true;
+  }
+  /// Stages on a loop take the input transitions of each other from
+  /// the input sources, they are put in the last level
+  std::vector<size_t> loopStages;
+  for (size_t stageId=0; stageId<_stages.size(); ++stageId) {
+    if (_stages[stageId]._needed && pendingFanins[stageId] > 0) {
+      _stages[stageId]._level = _levels.size();
+      loopStages.push_back(stageId);
+    }
+  }
+  _levels.push_back(loopStages);
+  return false;
+}
+
+double
+FullStageDelay::inputTransition(const Circuit& ckt, size_t arcId, bool isInputRise) const
+{
+  const CellArc& arc = ckt.cellArcs()[arcId];
+  size_t inputNode = arc.inputNode();
+  size_t faninStage = _nodeStage[inputNode];
+  /// Only results of lower levels are complete when this stage is calculated
+  if (faninStage != invalidId &&
+      _stages[faninStage]._level < _stages[_arcStage[arcId]]._level) {
+    double tran = 0;
+    for (size_t faninArc : _stages[faninStage]._arcs) {
+      const ArcResult& arcResult = _arcResults[faninArc];
+      const EdgeResult& result = isInputRise ? arcResult._rise : arcResult._fall;
+      if (result._valid == false) {
+        continue;
+      }
+      for (const PinTiming& pin : result._pins) {
+        if (pin._nodeId == inputNode) {
+          tran = std::max(tran, pin._transition);
+        }
+      }
+    }
+    if (tran > 0) {
+      return tran;
+    }
+  }
+  return arc.inputTransition(&ckt);
+}
+
+bool
+FullStageDelay::calcEdge(Circuit& ckt, const Stage& stage, size_t arcId,
+                         bool isRise, double inputTran, EdgeResult& result) const
+{
+  const CellArc& arc = ckt.cellArcs()[arcId];
+  const LibData* libData = arc.libData();
+  const NLDMArc* nldmArc = arc.nldmData();
+  const NLDMLUT& delayLUT = nldmArc->getLUT(isRise ? LUTType::RiseDelay : LUTType::FallDelay);
+  const NLDMLUT& tranLUT = nldmArc->getLUT(isRise ? LUTType::RiseTransition : LUTType::FallTransition);
+  if (delayLUT.empty() || tranLUT.empty()) {
+    return false;
+  }
+  double voltage = libData->voltage();
+  /// The simulator starts from 0V, falling transitions are simulated as
+  /// the complementary rising transitions with mirrored thresholds
+  double lowThres = libData->riseTransitionLowThres() / 100;
+  double highThres = libData->riseTransitionHighThres() / 100;
+  double delayThres = libData->riseDelayThres() / 100;
+  if (isRise == false) {
+    lowThres = 1 - libData->fallTransitionHighThres() / 100;
+    highThres = 1 - libData->fallTransitionLowThres() / 100;
+    delayThres = 1 - libData->fallDelayThres() / 100;
+  }
+  if (inputTran <= 0) {
+    inputTran = delayLUT.index1Values()[0];
+  }
+
+  /// The net traced from the driver resistor, without the drivers of
+  /// other arcs to the same output pin
+  std::unordered_set<size_t> otherDrivers;
+  for (size_t otherArc : stage._arcs) {
+    if (otherArc != arcId) {
+      otherDrivers.insert(ckt.cellArcs()[otherArc].driverSourceId());
+      otherDrivers.insert(ckt.cellArcs()[otherArc].driverResistorId());
+    }
+  }
+  std::vector<const Device*> devs;
+  std::vector<const Device*> caps;
+  std::vector<PinTiming> pins;
+  PinTiming outputPin;
+  outputPin._nodeId = arc.outputNode(&ckt);
+  outputPin._pinName = arc.toPinFullName();
+  pins.push_back(outputPin);
+  double totalCap = 0;
+  double netRes = 0;
+  for (const Device* dev : ckt.traceDevice(arc.driverResistorId())) {
+    if (otherDrivers.find(dev->_devId) != otherDrivers.end()) {
+      continue;
+    }
+    devs.push_back(dev);
+    if (dev->_type == DeviceType::Capacitor) {
+      const FixedLoadCap* pinCap = ckt.loaderCap(dev->_devId);
+      if (pinCap != nullptr) {
+        ckt.device(dev->_devId)._value = pinCap->value(isRise);
+        PinTiming pin;
+        pin._nodeId = dev->_posNode;
+        /// Loader capacitors are named as inst/pin/Cl
+        pin._pinName = dev->_name.substr(0, dev->_name.rfind('/'));
+        pins.push_back(pin);
+      }
+      totalCap += dev->_value;
+      caps.push_back(dev);
+    } else if (dev->_type == DeviceType::Resistor && dev->_devId != arc.driverResistorId()) {
+      netRes += dev->_value;
+    }
+  }
+  if (totalCap <= 0) {
+    printf("ERROR: No capacitance is found on the net driven by %s\n", arc.toPinFullName().data());
+    return false;
+  }
+  ckt.markSimulationScope(devs);
+
+  Device& driverRes = ckt.device(arc.driverResistorId());
+  PWLValue& ramp = ckt.PWLData(ckt.device(arc.driverSourceId()));
+  AnalysisParameter tranParam;
+  tranParam._type = AnalysisType::Tran;
+  tranParam._name = _param._name;
+  tranParam._relTotal = 1e-3;
+  tranParam._intMethod = IntegrateMethod::Gear2;
+  double ceff = totalCap;
+  for (size_t iter=1; ; ++iter) {
+    double delay = delayLUT.value(inputTran, ceff);
+    double tran = tranLUT.value(inputTran, ceff);
+    double res = driverResistance(tranLUT, inputTran, ceff, lowThres, highThres);
+    double rampStart = 0;
+    double rampTime = 0;
+    matchRamp(delay, tran, res * ceff, lowThres, highThres, delayThres, rampStart, rampTime);
+    /// Simulation starts at the beginning of the ramp
+    driverRes._value = res;
+    ramp._time = {0, rampTime};
+    ramp._value = {0, voltage};
+    double netTau = (res + netRes) * totalCap;
+    tranParam._simTick = (rampTime + netTau) / stepsPerStage;
+    tranParam._simTime = rampTime + 20 * netTau + 20 * tranParam._simTick;
+
+    Simulator sim(ckt, tranParam);
+    for (const PinTiming& pin : pins) {
+      sim.setTerminationVoltage(pin._nodeId, true, voltage * (1 + highThres) / 2);
+    }
+    /// Charge taken by the net is recorded as soon as the ramp ends
+    double charge = -1;
+    sim.setUpdateFunction([&]() {
+      const SimResult& simResult = sim.simulationResult();
+      if (charge < 0 && simResult.empty() == false && simResult.currentTime() >= rampTime) {
+        charge = netCharge(simResult, caps, rampTime);
+      }
+      return false;
+    });
+    sim.run();
+    const SimResult& simResult = sim.simulationResult();
+    if (charge < 0) {
+      charge = netCharge(simResult, caps, simResult.currentTime());
+    }
+    double newCeff = chargeCeff(charge / voltage, res, rampTime, totalCap);
+    if (Debug::enabled(DebugModule::Sim)) {
+      printf("DEBUG: %s iteration %lu: Ceff %G delay %G transition %G Rd %G ramp %G@%G new Ceff %G\n",
+             arc.toPinFullName().data(), iter, ceff, delay, tran, res, rampTime, rampStart, newCeff);
+    }
+    bool converged = std::abs(newCeff - ceff) <= ceffTolerance * ceff;
+    if (converged == false && iter < maxIterations) {
+      ceff = newCeff;
+      continue;
+    }
+    if (converged == false) {
+      printf("WARNING: Ceff of %s->%s does not converge in %lu iterations\n",
+             arc.fromPinFullName().data(), arc.toPinFullName().data(), maxIterations);
+    }
+    for (PinTiming& pin : pins) {
+      const Waveform& waveform = simResult.nodeVoltageWaveform(pin._nodeId);
+      double tDelay = waveform.measure(voltage * delayThres);
+      double tLow = waveform.measure(voltage * lowThres);
+      double tHigh = waveform.measure(voltage * highThres);
+      pin._delay = tDelay + rampStart;
+      pin._transition = tHigh - tLow;
+    }
+    result._valid = true;
+    result._inputTransition = inputTran;
+    result._totalCap = totalCap;
+    result._ceff = ceff;
+    result._driverResistance = res;
+    result._gateDelay = delay;
+    result._gateTransition = tran;
+    result._iterations = iter;
+    result._pins.swap(pins);
+    break;
+  }
+  return true;
+}
+
+void
+FullStageDelay::calcStage(Circuit& ckt, const Stage& stage)
+{
+  for (size_t arcId : stage._arcs) {
+    const CellArc& arc = ckt.cellArcs()[arcId];
+    ArcResult& arcResult = _arcResults[arcId];
+    for (bool isRise : {true, false}) {
+      bool isInputRise = arc.isInvertedArc() ? !isRise : isRise;
+      double inputTran = inputTransition(ckt, arcId, isInputRise);
+      EdgeResult& result = isRise ? arcResult._rise : arcResult._fall;
+      calcEdge(ckt, stage, arcId, isRise, inputTran, result);
+    }
+  }
+}
+
+void
+FullStageDelay::printResults() const
+{
+  const std::vector<CellArc>& arcs = _circuit.cellArcs();
+  for (size_t arcId=0; arcId<arcs.size(); ++arcId) {
+    const CellArc& arc = arcs[arcId];
+    bool requested = _outPins.empty();
+    for (const std::string& pin : _outPins) {
+      if (wildcardMatch(pin, arc.toPinFullName())) {
+        requested = true;
+        break;
+      }
+    }
+    if (requested == false || _arcStage[arcId] == invalidId) {
+      continue;
+    }
+    for (bool isRise : {true, false}) {
+      const EdgeResult& result = isRise ? _arcResults[arcId]._rise : _arcResults[arcId]._fall;
+      if (result._valid == false) {
+        continue;
+      }
+      printf("Arc %s->%s %s: input transition %.6G, total cap %.6G, Ceff %.6G, "
+             "Rd %.6G, gate delay %.6G, gate transition %.6G, %lu iterations\n",
+             arc.fromPinFullName().data(), arc.toPinFullName().data(),
+             isRise ? "rise" : "fall", result._inputTransition, result._totalCap,
+             result._ceff, result._driverResistance, result._gateDelay,
+             result._gateTransition, result._iterations);
+      for (const PinTiming& pin : result._pins) {
+        printf("  Pin %s: delay %.6G transition %.6G\n",
+               pin._pinName.data(), pin._delay, pin._transition);
+      }
+    }
+  }
+}
+
+void
+FullStageDelay::run()
+{
+  if (check() == false) {
+    return;
+  }
+  buildStages();
+  if (levelizeStages() == false) {
+    printf("WARNING: Loops are found among cell stages, input transitions on the loops "
+           "are taken from input sources\n");
+  }
+  size_t maxLevelSize = 0;
+  size_t stageCount = 0;
+  for (const std::vector<size_t>& level : _levels) {
+    maxLevelSize = std::max(maxLevelSize, level.size());
+    stageCount += level.size();
+  }
+  printf("%lu stages in %lu levels to calculate\n", stageCount, _levels.size());
+
+  /// Every worker thread owns a copy of the circuit, as the simulation
+  /// scope, driver resistors and ramp sources are changed per stage
+  std::vector<std::unique_ptr<Circuit>> circuits(threadNumber(maxLevelSize));
+  for (const std::vector<size_t>& level : _levels) {
+    std::atomic<size_t> next(0);
+    parallelFor(threadNumber(level.size()), [&](size_t t) {
+      if (circuits[t] == nullptr) {
+        circuits[t].reset(new Circuit(_circuit));
+      }
+      for (size_t i = next++; i < level.size(); i = next++) {
+        calcStage(*circuits[t], _stages[level[i]]);
+      }
+    });
+  }
+  printResults();
+}
+
+}
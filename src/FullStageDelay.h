@@ -0,0 +1,97 @@
+#ifndef _FULL_STAGE_DELAY_H_
+#define _FULL_STAGE_DELAY_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Base.h"
+#include "Circuit.h"
+
+namespace NA {
+
+/// Full-stage delay calculation of cell arcs with the ramp voltage driver model.
+/// A stage is a cell output pin together with the RC net it drives and the
+/// loader capacitors of the receiver pins on the net. For every arc to the
+/// output pin, the effective capacitance (Ceff) of the net is iterated:
+/// NLDM tables give the delay and transition at Ceff, the ramp voltage source
+/// and driver resistor are matched to them on a lumped Ceff load, the net is
+/// simulated with the Simulator, and Ceff is updated by matching the charge
+/// delivered to the net at the end of the ramp, as stated in
+/// F. Dartu, N. Menezes and L. T. Pileggi,
+/// "Performance computation for precharacterized CMOS gates with RC loads,"
+/// IEEE TCAD, vol. 15, no. 5, pp. 544-553, May 1996, doi: 10.1109/43.506141.
+/// Stages are levelized by their fanin, the input transition of a stage
+/// comes from the simulated waveform of the stage driving its input pin,
+/// stages in the same level are calculated in parallel.
+class FullStageDelay {
+  public:
+    /// Timing of one pin on the net driven by the stage, delay is measured
+    /// from the input pin of the arc
+    struct PinTiming {
+      size_t      _nodeId = static_cast<size_t>(-1);
+      std::string _pinName;
+      double      _delay = 0;
+      double      _transition = 0;
+    };
+
+    /// Solution of one arc for one output transition direction
+    struct EdgeResult {
+      bool   _valid = false;
+      double _inputTransition = 0;
+      double _totalCap = 0;
+      double _ceff = 0;
+      double _driverResistance = 0;
+      double _gateDelay = 0;
+      double _gateTransition = 0;
+      size_t _iterations = 0;
+      std::vector<PinTiming> _pins;
+    };
+
+    struct ArcResult {
+      EdgeResult _rise;
+      EdgeResult _fall;
+    };
+
+    FullStageDelay(const Circuit& circuit, const AnalysisParameter& param,
+                   const std::vector<std::string>& outPins);
+
+    void run();
+
+    /// Results are indexed the same way as Circuit::cellArcs()
+    const std::vector<ArcResult>& arcResults() const { return _arcResults; }
+
+  private:
+    struct Stage {
+      size_t              _outputNode;
+      std::vector<size_t> _arcs;
+      std::vector<size_t> _netNodes;
+      std::vector<size_t> _fanins;
+      size_t              _level = 0;
+      bool                _needed = false;
+    };
+
+    bool check() const;
+    void buildStages();
+    bool levelizeStages();
+    void calcStage(Circuit& ckt, const Stage& stage);
+    double inputTransition(const Circuit& ckt, size_t arcId, bool isInputRise) const;
+    bool calcEdge(Circuit& ckt, const Stage& stage, size_t arcId,
+                  bool isRise, double inputTran, EdgeResult& result) const;
+    void printResults() const;
+
+  private:
+    const Circuit&                 _circuit;
+    AnalysisParameter              _param;
+    std::vector<std::string>       _outPins;
+    std::vector<Stage>             _stages;
+    /// Stage ID of the net every node belongs to
+    std::vector<size_t>            _nodeStage;
+    /// Stage IDs of every level
+    std::vector<std::vector<size_t>> _levels;
+    std::vector<size_t>            _arcStage;
+    std::vector<ArcResult>         _arcResults;
+};
+
+}
+
+#endif
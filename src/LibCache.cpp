@@ -0,0 +1,750 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "LibCache.h"
+#include "LibData.h"
+
+namespace NA {
+
+static const char cacheMagic[8] = {'T', 'T', 'L', 'I', 'B', 'B', 'I', 'N'};
+/// Increase when the layout below changes
+static const uint32_t cacheVersion = 3;
+
+/// Layout of the cache file, all sections start at multiples of 8 bytes
+struct CacheSection {
+  uint64_t _offset = 0; /// Bytes from the start of the file
+  uint64_t _count = 0;
+};
+
+struct CacheRange {
+  uint32_t _first = 0;
+  uint32_t _count = 0;
+};
+
+struct CacheLUT {
+  uint64_t _offset = 0; /// Doubles from the start of the data section
+  uint32_t _dim1 = 0;
+  uint32_t _dim2 = 0;
+};
+
+struct CacheWave {
+  double   _index1 = 0;
+  double   _index2 = 0;
+  double   _referenceTime = 0;
+  uint64_t _offset = 0;
+  uint32_t _timeSize = 0;
+  uint32_t _valueSize = 0;
+};
+
+struct CachePinCap {
+  uint32_t _name = 0;
+  uint32_t _pad = 0;
+  double   _rise = 0;
+  double   _fall = 0;
+};
+
+struct CacheNLDMArc {
+  uint32_t _fromPin = 0;
+  uint32_t _toPin = 0;
+  uint32_t _isInverted = 0;
+  uint32_t _pad = 0;
+  /// Rise delay, fall delay, rise transition, fall transition
+  CacheLUT _luts[4];
+};
+
+struct CacheCCBData {
+  uint32_t   _isInverting = 0;
+  uint32_t   _pad = 0;
+  double     _millerCapRise = 0;
+  double     _millerCapFall = 0;
+  CacheLUT   _dcCurrent;
+  CacheRange _riseVoltage;
+  CacheRange _fallVoltage;
+};
+
+struct CacheCCSArc {
+  uint32_t     _fromPin = 0;
+  uint32_t     _toPin = 0;
+  uint32_t     _isInverted = 0;
+  uint32_t     _pad = 0;
+  CacheRange   _riseCurrent;
+  CacheRange   _fallCurrent;
+  CacheRange   _riseRecvCaps;
+  CacheRange   _fallRecvCaps;
+  CacheCCBData _firstStage;
+  CacheCCBData _lastStage;
+};
+
+struct CacheCell {
+  uint32_t   _name = 0;
+  uint32_t   _pad = 0;
+  CacheRange _pinCaps;
+  CacheRange _nldmArcs;
+  CacheRange _ccsArcs;
+};
+
+struct CacheHeader {
+  char         _magic[8];
+  uint32_t     _version = 0;
+  uint32_t     _settings = 0;
+  /// headerChecksum of the header, which holds the section descriptors.
+  /// The payload is not summed, loading stays independent of the file size
+  uint64_t     _checksum = 0;
+  uint64_t     _sourceSize = 0;
+  int64_t      _sourceMtime = 0;
+  double       _delayRiseThres = 0;
+  double       _delayFallThres = 0;
+  double       _transitionRiseLowThres = 0;
+  double       _transitionRiseHighThres = 0;
+  double       _transitionFallHighThres = 0;
+  double       _transitionFallLowThres = 0;
+  double       _voltage = 0;
+  CacheLUT     _riseDriverWaveform;
+  CacheLUT     _fallDriverWaveform;
+  /// Offsets of strings in _chars, strings end with '\0'
+  CacheSection _strings;
+  CacheSection _chars;
+  CacheSection _cells;
+  CacheSection _pinCaps;
+  CacheSection _nldmArcs;
+  CacheSection _ccsArcs;
+  CacheSection _luts;
+  CacheSection _waves;
+  CacheSection _data;
+};
+
+static_assert(sizeof(CacheHeader) % 8 == 0, "Cache sections must be 8 byte aligned");
+
+/// FNV-1a over the 64 bit words of the header, with the checksum field as 0
+static uint64_t
+headerChecksum(const CacheHeader& header)
+{
+  CacheHeader data = header;
+  data._checksum = 0;
+  const char* bytes = reinterpret_cast<const char*>(&data);
+  uint64_t sum = 14695981039346656037ULL;
+  for (size_t i=0; i<sizeof(data); i+=8) {
+    uint64_t word = 0;
+    memcpy(&word, bytes + i, 8);
+    sum = (sum ^ word) * 1099511628211ULL;
+  }
+  return sum;
+}
+
+static bool
+sourceStamp(const char* datFile, uint64_t& size, int64_t& mtime)
+{
+  struct stat st;
+  if (stat(datFile, &st) != 0) {
+    return false;
+  }
+  size = static_cast<uint64_t>(st.st_size);
+  mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+  return true;
+}
+
+/// Flattens the tables and arcs of LibData into the cache sections
+class CacheBuilder {
+  public:
+    uint32_t addString(const std::string& str)
+    {
+      const auto& it = _stringIds.find(str);
+      if (it != _stringIds.end()) {
+        return it->second;
+      }
+      uint32_t id = static_cast<uint32_t>(_strings.size());
+      _strings.push_back(_chars.size());
+      _chars.insert(_chars.end(), str.begin(), str.end());
+      _chars.push_back('\0');
+      _stringIds.insert({str, id});
+      return id;
+    }
+
+    CacheLUT addLUT(const NLDMLUT& lut)
+    {
+      CacheLUT data;
+      if (lut.empty()) {
+        return data;
+      }
+      data._offset = _data.size();
+      data._dim1 = lut.index1Values().size();
+      data._dim2 = lut.index2Values().size();
+      appendData(lut.index1Values());
+      appendData(lut.index2Values());
+      appendData(lut.values());
+      return data;
+    }
+
+    CacheRange addLUTs(const std::vector<NLDMLUT>& luts)
+    {
+      CacheRange range;
+      range._first = _luts.size();
+      range._count = luts.size();
+      for (const NLDMLUT& lut : luts) {
+        _luts.push_back(addLUT(lut));
+      }
+      return range;
+    }
+
+    template <typename LUT>
+    CacheRange addWaves(Span<LUT> tables)
+    {
+      CacheRange range;
+      range._first = _waves.size();
+      range._count = tables.size();
+      for (const LUT& lut : tables) {
+        CacheWave wave;
+        wave._index1 = lut.inputTransition();
+        wave._index2 = lut.outputLoad();
+        wave._referenceTime = waveReferenceTime(lut);
+        wave._offset = _data.size();
+        wave._timeSize = lut.times().size();
+        wave._valueSize = lut.values().size();
+        appendData(lut.times());
+        appendData(lut.values());
+        _waves.push_back(wave);
+      }
+      return range;
+    }
+
+    CacheCCBData addCCBData(const CCBData& ccb)
+    {
+      CacheCCBData data;
+      data._isInverting = ccb.isInverting();
+      data._millerCapRise = ccb.millerCap(true);
+      data._millerCapFall = ccb.millerCap(false);
+      data._dcCurrent = addLUT(ccb.getDcCurrent());
+      data._riseVoltage = addWaves(ccb.getRiseOutputVoltage().tables());
+      data._fallVoltage = addWaves(ccb.getFallOutputVoltage().tables());
+      return data;
+    }
+
+    void addNLDMArcs(const std::vector<NLDMArc>& arcs, CacheRange& range)
+    {
+      range._first = _nldmArcs.size();
+      range._count = arcs.size();
+      for (const NLDMArc& arc : arcs) {
+        CacheNLDMArc data;
+        data._fromPin = addString(arc.fromPin());
+        data._toPin = addString(arc.toPin());
+        data._isInverted = arc.isInverted();
+        data._luts[0] = addLUT(arc.getLUT(LUTType::RiseDelay));
+        data._luts[1] = addLUT(arc.getLUT(LUTType::FallDelay));
+        data._luts[2] = addLUT(arc.getLUT(LUTType::RiseTransition));
+        data._luts[3] = addLUT(arc.getLUT(LUTType::FallTransition));
+        _nldmArcs.push_back(data);
+      }
+    }
+
+    void addCCSArcs(const std::vector<CCSArc>& arcs, CacheRange& range)
+    {
+      range._first = _ccsArcs.size();
+      range._count = arcs.size();
+      for (const CCSArc& arc : arcs) {
+        CacheCCSArc data;
+        data._fromPin = addString(arc.fromPin());
+        data._toPin = addString(arc.toPin());
+        data._isInverted = arc.isInverted();
+        data._riseCurrent = addWaves(arc.getCurrent(LUTType::RiseCurrent).tables());
+        data._fallCurrent = addWaves(arc.getCurrent(LUTType::FallCurrent).tables());
+        data._riseRecvCaps = addLUTs(arc.getRecvCap(LUTType::RiseRecvCap));
+        data._fallRecvCaps = addLUTs(arc.getRecvCap(LUTType::FallRecvCap));
+        data._firstStage = addCCBData(*arc.ccbFirstStageData());
+        data._lastStage = addCCBData(*arc.ccbLastStageData());
+        _ccsArcs.push_back(data);
+      }
+    }
+
+    void addPinCaps(const std::vector<FixedLoadCap>& caps, CacheRange& range)
+    {
+      range._first = _pinCaps.size();
+      range._count = caps.size();
+      for (const FixedLoadCap& cap : caps) {
+        CachePinCap data;
+        data._name = addString(cap.pinName());
+        data._rise = cap.value(true);
+        data._fall = cap.value(false);
+        _pinCaps.push_back(data);
+      }
+    }
+
+    bool write(const std::string& file, CacheHeader& header) const
+    {
+      uint64_t offset = sizeof(CacheHeader);
+      setSection(header._strings, _strings, offset);
+      setSection(header._chars, _chars, offset);
+      setSection(header._cells, _cells, offset);
+      setSection(header._pinCaps, _pinCaps, offset);
+      setSection(header._nldmArcs, _nldmArcs, offset);
+      setSection(header._ccsArcs, _ccsArcs, offset);
+      setSection(header._luts, _luts, offset);
+      setSection(header._waves, _waves, offset);
+      setSection(header._data, _data, offset);
+      header._checksum = headerChecksum(header);
+
+      std::ofstream out(file, std::ios::binary | std::ios::trunc);
+      if (!out) {
+        return false;
+      }
+      out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      writeSection(out, _strings);
+      writeSection(out, _chars);
+      writeSection(out, _cells);
+      writeSection(out, _pinCaps);
+      writeSection(out, _nldmArcs);
+      writeSection(out, _ccsArcs);
+      writeSection(out, _luts);
+      writeSection(out, _waves);
+      writeSection(out, _data);
+      return static_cast<bool>(out);
+    }
+
+    std::vector<CacheCell> _cells;
+
+  private:
+    void appendData(Span<double> values) { _data.insert(_data.end(), values.begin(), values.end()); }
+
+    static double waveReferenceTime(const CCSLUT& lut) { return lut.referenceTime(); }
+    static double waveReferenceTime(const CCBOutputVoltageLUT&) { return 0; }
+
+    static uint64_t padded(uint64_t bytes) { return (bytes + 7) & ~static_cast<uint64_t>(7); }
+
+    template <typename T>
+    static void setSection(CacheSection& section, const std::vector<T>& data, uint64_t& offset)
+    {
+      section._offset = offset;
+      section._count = data.size();
+      offset += padded(data.size() * sizeof(T));
+    }
+
+    template <typename T>
+    static void writeSection(std::ofstream& out, const std::vector<T>& data)
+    {
+      uint64_t bytes = data.size() * sizeof(T);
+      out.write(reinterpret_cast<const char*>(data.data()), bytes);
+      static const char zeros[8] = {0};
+      out.write(zeros, padded(bytes) - bytes);
+    }
+
+  private:
+    std::unordered_map<std::string, uint32_t> _stringIds;
+    std::vector<uint64_t>                     _strings;
+    std::vector<char>                         _chars;
+    std::vector<CachePinCap>                  _pinCaps;
+    std::vector<CacheNLDMArc>                 _nldmArcs;
+    std::vector<CacheCCSArc>                  _ccsArcs;
+    std::vector<CacheLUT>                     _luts;
+    std::vector<CacheWave>                    _waves;
+    std::vector<double>                       _data;
+};
+
+/// Read access to a mapped cache file
+class CacheView {
+  public:
+    CacheView(const char* base, uint64_t size)
+    : _base(base), _size(size),
+      _header(reinterpret_cast<const CacheHeader*>(base)) {}
+
+    /// The header checksum, the sections and every string id, table offset 
+    /// and range in the sections are checked, the cache is rejected as a 
+    /// whole on any violation. The checks read the descriptors only, never
+    /// the table data.
+    bool check() const
+    {
+      const CacheHeader& h = *_header;
+      if (headerChecksum(h) != h._checksum) {
+        return false;
+      }
+      if (checkSection<uint64_t>(h._strings) == false || checkSection<char>(h._chars) == false ||
+          checkSection<CacheCell>(h._cells) == false || checkSection<CachePinCap>(h._pinCaps) == false ||
+          checkSection<CacheNLDMArc>(h._nldmArcs) == false || checkSection<CacheCCSArc>(h._ccsArcs) == false ||
+          checkSection<CacheLUT>(h._luts) == false || checkSection<CacheWave>(h._waves) == false ||
+          checkSection<double>(h._data) == false) {
+        return false;
+      }
+      return checkStrings() && checkLUT(h._riseDriverWaveform) && 
+             checkLUT(h._fallDriverWaveform) && checkCells() && checkArcs() &&
+             checkTables();
+    }
+
+    const CacheHeader& header() const { return *_header; }
+
+    template <typename T>
+    const T* section(const CacheSection& section) const
+    {
+      return reinterpret_cast<const T*>(_base + section._offset);
+    }
+
+    const char* string(uint32_t id) const
+    {
+      return section<char>(_header->_chars) + section<uint64_t>(_header->_strings)[id];
+    }
+
+    const double* data(uint64_t offset) const { return section<double>(_header->_data) + offset; }
+
+    void initLUT(NLDMLUT& lut, const CacheLUT& data) const
+    {
+      if (data._dim1 == 0) {
+        lut.reset();
+      } else {
+        lut.init(this->data(data._offset), data._dim1, data._dim2);
+      }
+    }
+
+    void initLUTs(std::vector<NLDMLUT>& luts, const CacheRange& range) const
+    {
+      const CacheLUT* data = section<CacheLUT>(_header->_luts) + range._first;
+      luts.resize(range._count);
+      for (uint32_t i=0; i<range._count; ++i) {
+        initLUT(luts[i], data[i]);
+      }
+    }
+
+    void initWave(CCSLUT& lut, const CacheWave& wave) const
+    {
+      lut.init(data(wave._offset), wave._referenceTime, wave._index1, wave._index2,
+               wave._timeSize, wave._valueSize);
+    }
+
+    void initWave(CCBOutputVoltageLUT& lut, const CacheWave& wave) const
+    {
+      lut.init(data(wave._offset), wave._index1, wave._index2,
+               wave._timeSize, wave._valueSize);
+    }
+
+    /// Group is CCSGroup with CCSLUT or CCBOutputVoltage with CCBOutputVoltageLUT
+    template <typename LUT, typename Group>
+    void initWaves(Group& group, const CacheRange& range) const
+    {
+      const CacheWave* waves = section<CacheWave>(_header->_waves) + range._first;
+      for (uint32_t i=0; i<range._count; ++i) {
+        LUT lut;
+        initWave(lut, waves[i]);
+        group.addLUT(lut);
+      }
+      group.sortTable();
+    }
+
+    void initCCBData(CCBData& ccb, const CacheCCBData& data) const
+    {
+      ccb.setIsInverting(data._isInverting);
+      ccb.setMillerCaps(data._millerCapRise, data._millerCapFall);
+      initLUT(ccb.getDcCurrent(), data._dcCurrent);
+      initWaves<CCBOutputVoltageLUT>(ccb.getRiseOutputVoltage(), data._riseVoltage);
+      initWaves<CCBOutputVoltageLUT>(ccb.getFallOutputVoltage(), data._fallVoltage);
+    }
+
+  private:
+    template <typename T>
+    bool checkSection(const CacheSection& section) const
+    {
+      return section._offset % 8 == 0 && section._offset <= _size &&
+             section._count <= (_size - section._offset) / sizeof(T);
+    }
+
+    /// Every string starts in the chars section and ends with '\0' in it
+    bool checkStrings() const
+    {
+      const CacheHeader& h = *_header;
+      if (h._strings._count == 0) {
+        return true;
+      }
+      if (h._chars._count == 0 || section<char>(h._chars)[h._chars._count-1] != '\0') {
+        return false;
+      }
+      const uint64_t* strings = section<uint64_t>(h._strings);
+      for (uint64_t i=0; i<h._strings._count; ++i) {
+        if (strings[i] >= h._chars._count) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool checkString(uint32_t id) const { return id < _header->_strings._count; }
+
+    static bool checkRange(const CacheRange& range, const CacheSection& section)
+    {
+      return static_cast<uint64_t>(range._first) + range._count <= section._count;
+    }
+
+    bool checkData(uint64_t offset, uint64_t count) const
+    {
+      uint64_t size = _header->_data._count;
+      return offset <= size && count <= size - offset;
+    }
+
+    /// Empty tables have no data, others hold both indices and the values
+    bool checkLUT(const CacheLUT& lut) const
+    {
+      if (lut._dim1 == 0) {
+        return true;
+      }
+      uint64_t count = static_cast<uint64_t>(lut._dim1) * lut._dim2 + lut._dim1 + lut._dim2;
+      return lut._dim2 > 0 && checkData(lut._offset, count);
+    }
+
+    bool checkCCBData(const CacheCCBData& data) const
+    {
+      return checkLUT(data._dcCurrent) && checkRange(data._riseVoltage, _header->_waves) &&
+             checkRange(data._fallVoltage, _header->_waves);
+    }
+
+    bool checkCells() const
+    {
+      const CacheHeader& h = *_header;
+      const CacheCell* cells = section<CacheCell>(h._cells);
+      for (uint64_t i=0; i<h._cells._count; ++i) {
+        const CacheCell& cell = cells[i];
+        if (checkString(cell._name) == false || checkRange(cell._pinCaps, h._pinCaps) == false ||
+            checkRange(cell._nldmArcs, h._nldmArcs) == false ||
+            checkRange(cell._ccsArcs, h._ccsArcs) == false) {
+          return false;
+        }
+      }
+      const CachePinCap* pinCaps = section<CachePinCap>(h._pinCaps);
+      for (uint64_t i=0; i<h._pinCaps._count; ++i) {
+        if (checkString(pinCaps[i]._name) == false) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool checkArcs() const
+    {
+      const CacheHeader& h = *_header;
+      const CacheNLDMArc* nldmArcs = section<CacheNLDMArc>(h._nldmArcs);
+      for (uint64_t i=0; i<h._nldmArcs._count; ++i) {
+        const CacheNLDMArc& arc = nldmArcs[i];
+        if (checkString(arc._fromPin) == false || checkString(arc._toPin) == false ||
+            checkLUT(arc._luts[0]) == false || checkLUT(arc._luts[1]) == false ||
+            checkLUT(arc._luts[2]) == false || checkLUT(arc._luts[3]) == false) {
+          return false;
+        }
+      }
+      const CacheCCSArc* ccsArcs = section<CacheCCSArc>(h._ccsArcs);
+      for (uint64_t i=0; i<h._ccsArcs._count; ++i) {
+        const CacheCCSArc& arc = ccsArcs[i];
+        if (checkString(arc._fromPin) == false || checkString(arc._toPin) == false ||
+            checkRange(arc._riseCurrent, h._waves) == false ||
+            checkRange(arc._fallCurrent, h._waves) == false ||
+            checkRange(arc._riseRecvCaps, h._luts) == false ||
+            checkRange(arc._fallRecvCaps, h._luts) == false ||
+            checkCCBData(arc._firstStage) == false || checkCCBData(arc._lastStage) == false) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    bool checkTables() const
+    {
+      const CacheHeader& h = *_header;
+      const CacheLUT* luts = section<CacheLUT>(h._luts);
+      for (uint64_t i=0; i<h._luts._count; ++i) {
+        if (checkLUT(luts[i]) == false) {
+          return false;
+        }
+      }
+      const CacheWave* waves = section<CacheWave>(h._waves);
+      for (uint64_t i=0; i<h._waves._count; ++i) {
+        const CacheWave& wave = waves[i];
+        if (checkData(wave._offset, static_cast<uint64_t>(wave._timeSize) + wave._valueSize) == false) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  private:
+    const char*        _base;
+    uint64_t           _size;
+    const CacheHeader* _header;
+};
+
+std::string
+LibCache::cacheFile(const char* datFile)
+{
+  return std::string(datFile) + ".bin";
+}
+
+bool
+LibCache::write(const char* datFile, const LibFileInfo& info) const
+{
+  CacheHeader header;
+  memcpy(header._magic, cacheMagic, sizeof(cacheMagic));
+  header._version = cacheVersion;
+  header._settings = info._settings;
+  if (sourceStamp(datFile, header._sourceSize, header._sourceMtime) == false) {
+    return false;
+  }
+  header._delayRiseThres = _owner->_delayRiseThres;
+  header._delayFallThres = _owner->_delayFallThres;
+  header._transitionRiseLowThres = _owner->_transitionRiseLowThres;
+  header._transitionRiseHighThres = _owner->_transitionRiseHighThres;
+  header._transitionFallHighThres = _owner->_transitionFallHighThres;
+  header._transitionFallLowThres = _owner->_transitionFallLowThres;
+  header._voltage = _owner->_voltage;
+
+  CacheBuilder builder;
+  if (info._settings & LibFileInfo::riseDriverWaveform) {
+    header._riseDriverWaveform = builder.addLUT(_owner->_riseDriverWaveform);
+  }
+  if (info._settings & LibFileInfo::fallDriverWaveform) {
+    header._fallDriverWaveform = builder.addLUT(_owner->_fallDriverWaveform);
+  }
+  for (const std::string& cellName : info._cells) {
+    CacheCell cell;
+    cell._name = builder.addString(cellName);
+    const LibCell* libCell = _owner->findCell(cellName);
+    if (libCell) {
+      builder.addPinCaps(libCell->_loadCaps, cell._pinCaps);
+      builder.addNLDMArcs(libCell->_nldmArcs, cell._nldmArcs);
+      builder.addCCSArcs(libCell->_ccsArcs, cell._ccsArcs);
+    }
+    builder._cells.push_back(cell);
+  }
+
+  /// Write to a temporary file first, so a process reading the cache
+  /// never sees a partial file
+  std::string file = cacheFile(datFile);
+  std::string tmpFile = file + "." + std::to_string(getpid()) + "." + 
+                        std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+  if (builder.write(tmpFile, header) == false ||
+      std::rename(tmpFile.data(), file.data()) != 0) {
+    std::remove(tmpFile.data());
+    printf("WARNING: Cannot write Lib data cache %s\n", file.data());
+    return false;
+  }
+  return true;
+}
+
+bool
+LibCache::load(const char* datFile, LibFileInfo& info)
+{
+  uint64_t sourceSize = 0;
+  int64_t sourceMtime = 0;
+  if (sourceStamp(datFile, sourceSize, sourceMtime) == false) {
+    return false;
+  }
+  std::string file = cacheFile(datFile);
+  int fd = open(file.data(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CacheHeader)) {
+    close(fd);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+  std::shared_ptr<const void> mapping(addr, [size](const void* p) {
+    munmap(const_cast<void*>(p), size);
+  });
+
+  CacheView view(static_cast<const char*>(addr), size);
+  const CacheHeader& header = view.header();
+  if (memcmp(header._magic, cacheMagic, sizeof(cacheMagic)) != 0 ||
+      header._version != cacheVersion ||
+      header._sourceSize != sourceSize ||
+      header._sourceMtime != sourceMtime ||
+      view.check() == false) {
+    return false;
+  }
+
+  const CacheCell* cells = view.section<CacheCell>(header._cells);
+  const CachePinCap* pinCaps = view.section<CachePinCap>(header._pinCaps);
+  const CacheNLDMArc* nldmArcs = view.section<CacheNLDMArc>(header._nldmArcs);
+  const CacheCCSArc* ccsArcs = view.section<CacheCCSArc>(header._ccsArcs);
+
+  for (uint64_t cellIdx=0; cellIdx<header._cells._count; ++cellIdx) {
+    const CacheCell& cell = cells[cellIdx];
+    std::string cellName(view.string(cell._name));
+    SymbolId cellId = _owner->addCell(cellName);
+    if (cellId == invalidSymbol) {
+      continue;
+    }
+    LibCell& libCell = _owner->_cells[cellId];
+    std::vector<FixedLoadCap> caps(cell._pinCaps._count);
+    for (uint32_t i=0; i<cell._pinCaps._count; ++i) {
+      const CachePinCap& pinCap = pinCaps[cell._pinCaps._first+i];
+      caps[i].setPinName(view.string(pinCap._name));
+      caps[i].setCaps(pinCap._rise, pinCap._fall);
+    }
+    libCell._loadCaps = std::move(caps);
+    info._cells.push_back(cellName);
+
+    if (cell._nldmArcs._count > 0) {
+      std::vector<NLDMArc> arcs(cell._nldmArcs._count, NLDMArc(_owner));
+      for (uint32_t i=0; i<cell._nldmArcs._count; ++i) {
+        const CacheNLDMArc& data = nldmArcs[cell._nldmArcs._first+i];
+        NLDMArc& arc = arcs[i];
+        arc.setFromToPin(view.string(data._fromPin), view.string(data._toPin), data._isInverted);
+        view.initLUT(arc.getLUT(LUTType::RiseDelay), data._luts[0]);
+        view.initLUT(arc.getLUT(LUTType::FallDelay), data._luts[1]);
+        view.initLUT(arc.getLUT(LUTType::RiseTransition), data._luts[2]);
+        view.initLUT(arc.getLUT(LUTType::FallTransition), data._luts[3]);
+      }
+      libCell._nldmArcs = std::move(arcs);
+    }
+
+    if (cell._ccsArcs._count > 0) {
+      std::vector<CCSArc> arcs(cell._ccsArcs._count, CCSArc(_owner));
+      for (uint32_t i=0; i<cell._ccsArcs._count; ++i) {
+        const CacheCCSArc& data = ccsArcs[cell._ccsArcs._first+i];
+        CCSArc& arc = arcs[i];
+        arc.reset();
+        arc.setFromToPin(view.string(data._fromPin), view.string(data._toPin), data._isInverted);
+        view.initWaves<CCSLUT>(arc.getCurrent(LUTType::RiseCurrent), data._riseCurrent);
+        view.initWaves<CCSLUT>(arc.getCurrent(LUTType::FallCurrent), data._fallCurrent);
+        view.initLUTs(arc.getRecvCap(LUTType::RiseRecvCap), data._riseRecvCaps);
+        view.initLUTs(arc.getRecvCap(LUTType::FallRecvCap), data._fallRecvCaps);
+        view.initCCBData(arc.ccbFirstStageData(), data._firstStage);
+        view.initCCBData(arc.ccbLastStageData(), data._lastStage);
+      }
+      libCell._ccsArcs = std::move(arcs);
+    }
+  }
+
+  if (header._settings & LibFileInfo::riseTransitionThres) {
+    _owner->_transitionRiseLowThres = header._transitionRiseLowThres;
+    _owner->_transitionRiseHighThres = header._transitionRiseHighThres;
+  }
+  if (header._settings & LibFileInfo::fallTransitionThres) {
+    _owner->_transitionFallHighThres = header._transitionFallHighThres;
+    _owner->_transitionFallLowThres = header._transitionFallLowThres;
+  }
+  if (header._settings & LibFileInfo::delayThres) {
+    _owner->_delayRiseThres = header._delayRiseThres;
+    _owner->_delayFallThres = header._delayFallThres;
+  }
+  if (header._settings & LibFileInfo::voltage) {
+    _owner->_voltage = header._voltage;
+  }
+  if (header._settings & LibFileInfo::riseDriverWaveform) {
+    view.initLUT(_owner->_riseDriverWaveform, header._riseDriverWaveform);
+  }
+  if (header._settings & LibFileInfo::fallDriverWaveform) {
+    view.initLUT(_owner->_fallDriverWaveform, header._fallDriverWaveform);
+  }
+  info._settings = header._settings;
+  _owner->_tables.keep(mapping);
+  return true;
+}
+
+}
@@ -0,0 +1,59 @@
+#ifndef _NA_LIBCACHE_H_
+#define _NA_LIBCACHE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace NA {
+
+class LibData;
+
+/// What one library file added to LibData, filled by LibReader
+struct LibFileInfo {
+  static constexpr unsigned riseTransitionThres = 1 << 0;
+  static constexpr unsigned fallTransitionThres = 1 << 1;
+  static constexpr unsigned delayThres          = 1 << 2;
+  static constexpr unsigned voltage             = 1 << 3;
+  static constexpr unsigned riseDriverWaveform  = 1 << 4;
+  static constexpr unsigned fallDriverWaveform  = 1 << 5;
+
+  /// Cells in the order they are defined in the file
+  std::vector<std::string> _cells;
+  /// Cells defined more than once in the file, only the first is kept
+  std::vector<std::string> _duplicateCells;
+  /// Global settings defined in the file
+  unsigned                 _settings = 0;
+  /// Driver waveforms are scaled by a voltage the file does not define
+  bool                     _needsPriorVoltage = false;
+  /// False if the content can not be reproduced from the file alone
+  bool                     _cacheable = true;
+};
+
+/// Compiled binary form of a library file, written next to it as
+/// "file.dat.bin" when the text file is read the first time.
+/// The cache has a versioned header with the size and modification time
+/// of the text file, a string table, and flat arrays of cells, pin caps,
+/// arcs and table descriptors. Table numbers are stored in one array that
+/// is used in place after the file is mapped with mmap, so loading a
+/// cache does not parse anything or copy any table.
+class LibCache {
+  public:
+    LibCache(LibData* owner)
+    : _owner(owner) {}
+
+    static std::string cacheFile(const char* datFile);
+
+    /// Load the cache of datFile into owner and fill info, false if 
+    /// there is no valid cache for the current datFile
+    bool load(const char* datFile, LibFileInfo& info);
+    /// Write the cache of datFile with the content listed in info
+    bool write(const char* datFile, const LibFileInfo& info) const;
+
+  private:
+    LibData* _owner;
+};
+
+}
+
+#endif
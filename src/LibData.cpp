@@ -1,69 +1,110 @@
 #include <cstdio>
 #include <cstddef>
+#include <cstdint>
+#include <cmath>
 #include <fstream>
 #include <algorithm>
 #include <cassert>
 #include <Eigen/Core>
-#include <Eigen/Dense>
 #include "LibData.h"
+#include "LibCache.h"
+#include "LibertyReader.h"
+#include "Parallel.h"
+#include "Base.h"
 #include "StringUtil.h"
-#include "Debug.h"
 
 namespace NA {
     
 typedef std::unordered_map<std::string, std::vector<NLDMArc>> NLDMMap;
 typedef std::unordered_map<std::string, std::vector<CCSArc>>  CCSMap;
 
-static inline size_t 
-binaryIndex(const std::vector<double>& values, float v)
+/// Tables are small, a chunk holds a few thousands of them
+static const size_t arenaChunkSize = 1 << 16;
+
+double*
+TableArena::allocate(size_t n)
 {
-  size_t lower = 1;
-  size_t upper = values.size()-2;
-  if (v <= values[lower]) {
-    return 0;
-  }
-  if (v >= values[upper]) {
-    return upper;
+  if (_chunks.empty() || _chunkUsed + n > _chunkCapacity) {
+    _chunkCapacity = std::max(n, arenaChunkSize);
+    _chunks.emplace_back(new double[_chunkCapacity]);
+    _chunkUsed = 0;
   }
+  double* data = _chunks.back().get() + _chunkUsed;
+  _chunkUsed += n;
+  _size += n;
+  return data;
+}
+
+void
+TableArena::adopt(TableArena& other)
+{
+  _external.insert(_external.end(), other._external.begin(), other._external.end());
+  _external.insert(_external.end(), other._chunks.begin(), other._chunks.end());
+  _size += other._size;
+  other.clear();
+}
+
+void
+TableArena::clear()
+{
+  _external.clear();
+  _chunks.clear();
+  _chunkCapacity = 0;
+  _chunkUsed = 0;
+  _size = 0;
+}
+
+const double*
+copyToArena(TableArena& arena, const std::vector<double>& times,
+            const std::vector<double>& values)
+{
+  double* data = arena.allocate(times.size() + values.size());
+  std::copy(times.begin(), times.end(), data);
+  std::copy(values.begin(), values.end(), data + times.size());
+  return data;
+}
+
+/// Interval of the table axis that the value falls in, values before the
+/// second point fall in the first interval and values beyond the second to 
+/// last point fall in the last one. Lib table axes are short, so counting 
+/// without branches is faster than a binary search
+static inline size_t 
+intervalIndex(const double* values, size_t size, double v)
+{
   size_t idx = 0;
-  while (upper - lower > 1) {
-    idx = (lower + upper) >> 1;
-    if (values[idx] > v) {
-      upper = idx;
-    } else {
-      lower = idx;
-    }
-  }
-  if (values[idx] > v) {
-    --idx;
+  for (size_t i=1; i+1<size; ++i) {
+    idx += (v > values[i]);
   }
   return idx;
 }
 
-static inline size_t
-axisIndex(const std::vector<double>& values, double val)
+void
+NLDMLUT::init(TableArena& arena, const std::vector<double>& index1, 
+              const std::vector<double>& index2, const std::vector<double>& values)
 {
-  if (val <= values[1]) {
-    return 0;
-  }
-  size_t lastIndex = values.size() - 1;
-  if (val >= values[lastIndex]) {
-    return lastIndex - 1;
+  reset();
+  if (values.empty()) {
+    return;
   }
-  for (size_t index = 1; index < lastIndex; ++index) {
-    if (val < values[index]) {
-      return index - 1;
-    }
+  if (values.size() != index1.size() * index2.size()) {
+    printf("ERROR: Table with %lu x %lu indices has %lu values\n", 
+           index1.size(), index2.size(), values.size());
+    return;
   }
-  /// Suppress compiler warnings
-  return static_cast<size_t>(-1);
+  double* data = arena.allocate(index1.size() + index2.size() + values.size());
+  _data = data;
+  data = std::copy(index1.begin(), index1.end(), data);
+  data = std::copy(index2.begin(), index2.end(), data);
+  std::copy(values.begin(), values.end(), data);
+  _dim1 = index1.size();
+  _dim2 = index2.size();
 }
 
 inline void
-NLDMLUT::indexValues(const std::vector<double>& values, size_t X, size_t Y, 
+NLDMLUT::indexValues(const double* values, size_t X, size_t Y, 
                      double& Z1, double& Z2, double& Z3, double& Z4) const
 {
-  size_t YDim = _index2.size();
+  size_t YDim = _dim2;
   size_t i = 0;
   i = X * YDim + Y;
   Z1 = values[i];
@@ -76,61 +117,72 @@ NLDMLUT::indexValues(const std::vector<double>& values, size_t X, size_t Y,
 size_t 
 NLDMLUT::axis1Index(double value) const
 {
-  return binaryIndex(_index1, value);
+  return intervalIndex(index1Data(), _dim1, value);
 }
 
 size_t 
 NLDMLUT::axis2Index(double value) const
 {
-  return binaryIndex(_index2, value);
+  return intervalIndex(index2Data(), _dim2, value);
 }
 
 double 
 NLDMLUT::value(double inputTran, double outputLoad) const
 {
-  size_t index1 = binaryIndex(_index1, inputTran);
-  size_t index2 = binaryIndex(_index2, outputLoad);
-  //size_t index1 = axisIndex(_index1, inputTran);
-  //size_t index2 = axisIndex(_index2, outputLoad);
+  const double* index1Values = index1Data();
+  const double* index2Values = index1Values + _dim1;
+  size_t index1 = intervalIndex(index1Values, _dim1, inputTran);
+  size_t index2 = intervalIndex(index2Values, _dim2, outputLoad);
 
-  double x1 = _index1[index1];
-  double x2 = _index1[index1+1];
-  double y1 = _index2[index2];
-  double y2 = _index2[index2+1];
+  double x1 = index1Values[index1];
+  double x2 = index1Values[index1+1];
+  double y1 = index2Values[index2];
+  double y2 = index2Values[index2+1];
   double z1, z2, z3, z4;
-  indexValues(_values, index1, index2, z1, z2, z3, z4);
-  if (false) {
-    printf("DEBUG: inputTran: %G ([%G, %G]), outputLoad: %G ([%G, %G])\n", 
-           inputTran, x1, x2, outputLoad, y1, y2);
-    printf("DEBUG:                    (X1) %.6G      (X2) %.6G\n", x1, x2);
-    printf("DEBUG: (Y1) %.6G         (Z1) %.6G      (Z2) %.6G\n", y1, z1, z2);
-    printf("DEBUG: (Y2) %.6G         (Z3) %.6G      (Z4) %.6G\n", x2, z3, z4);
-  }
+  indexValues(index2Values + _dim2, index1, index2, z1, z2, z3, z4);
   /*
                (X)  x1      (X)  x2
   (Y)  y1      (Z)  z1      (Z)  z2
   (Y)  y2      (Z)  z3      (Z)  z4
-
-  z1 = A + B*x1 + C*y1 + D*x1*y1
-  z2 = A + B*x2 + C*y1 + D*x2*y1
-  z3 = A + B*x1 + C*y2 + D*x1*y2
-  z4 = A + B*x2 + C*y2 + D*x2*y2
   */
-  Eigen::MatrixXd A(4, 4);
-  A(0, 0) = 1; A(0, 1) = x1; A(0, 2) = y1; A(0, 3) = x1 * y1;
-  A(1, 0) = 1; A(1, 1) = x2; A(1, 2) = y1; A(1, 3) = x2 * y1;
-  A(2, 0) = 1; A(2, 1) = x1; A(2, 2) = y2; A(2, 3) = x1 * y2;
-  A(3, 0) = 1; A(3, 1) = x2; A(3, 2) = y2; A(3, 3) = x2 * y2;
-  Eigen::Vector4d b;
-  b(0) = z1; b(1) = z2; b(2) = z3; b(3) = z4;
-  Eigen::Vector4d x = A.partialPivLu().solve(b);
-  if (false) {
-    Debug::printEquation(A, b);
-    printf("DEBUG: x = [%.6G, %.6G, %.6G, %.6G]\n", x(0), x(1), x(2), x(3));
-    printf("DEBUG: %G + %G*%G + %G*%G + %G*%G*%G = %G\n", x(0), x(1), inputTran, x(2), outputLoad, x(3), inputTran, outputLoad, 
-    x(0) + x(1) * inputTran + x(2) * outputLoad + x(3) * inputTran * outputLoad);
-  }
-  return x(0) + x(1) * inputTran + x(2) * outputLoad + x(3) * inputTran * outputLoad;
+  return bilinearInterpolate(x1, y1, x2, y2, z1, z3, z2, z4, inputTran, outputLoad);
+}
+
+void
+NLDMLUT::values(const double* inputTrans, const double* outputLoads, 
+                double* results, size_t n) const
+{
+  /// Intervals of a block of queries are counted with Eigen array 
+  /// expressions, which are vectorized, then the corners are gathered 
+  /// and interpolated per query
+  constexpr int blockSize = 256;
+  typedef Eigen::Array<double, Eigen::Dynamic, 1, 0, blockSize, 1> BlockArray;
+  const double* index1Values = index1Data();
+  const double* index2Values = index1Values + _dim1;
+  const double* tableValues = index2Values + _dim2;
+  for (size_t start=0; start<n; start+=blockSize) {
+    Eigen::Index size = std::min(static_cast<size_t>(blockSize), n - start);
+    Eigen::Map<const Eigen::ArrayXd> x(inputTrans + start, size);
+    Eigen::Map<const Eigen::ArrayXd> y(outputLoads + start, size);
+    /// Same counting as intervalIndex, done for the whole block
+    BlockArray interval1 = BlockArray::Zero(size);
+    BlockArray interval2 = BlockArray::Zero(size);
+    for (size_t k=1; k+1<_dim1; ++k) {
+      interval1 += (x > index1Values[k]).cast<double>();
+    }
+    for (size_t k=1; k+1<_dim2; ++k) {
+      interval2 += (y > index2Values[k]).cast<double>();
+    }
+    for (Eigen::Index i=0; i<size; ++i) {
+      size_t index1 = static_cast<size_t>(interval1(i));
+      size_t index2 = static_cast<size_t>(interval2(i));
+      double z1, z2, z3, z4;
+      indexValues(tableValues, index1, index2, z1, z2, z3, z4);
+      results[start+i] = bilinearInterpolate(index1Values[index1], index2Values[index2], 
+                                             index1Values[index1+1], index2Values[index2+1], 
+                                             z1, z3, z2, z4, x(i), y(i));
+    }
+  }
 }
 
 const NLDMLUT&
@@ -264,11 +316,279 @@ CCSGroup::sortTable()
   _transDiv.push_back(_ccsluts.size());
 }
 
+CCSWaveformCache::CCSWaveformCache(const CCSWaveformCache& other)
+{
+  *this = other;
+}
+
+CCSWaveformCache&
+CCSWaveformCache::operator=(const CCSWaveformCache& other)
+{
+  if (this == &other) {
+    return *this;
+  }
+  std::lock_guard<std::mutex> lock(other._mutex);
+  _capacity = other._capacity;
+  _entries = other._entries;
+  _index = other._index;
+  _head = other._head;
+  _tail = other._tail;
+  _stats = other._stats;
+  return *this;
+}
+
+const CCSWaveform*
+CCSWaveformCache::find(uint64_t key)
+{
+  const auto& it = _index.find(key);
+  if (it == _index.end()) {
+    ++_stats._misses;
+    return nullptr;
+  }
+  ++_stats._hits;
+  uint32_t i = it->second;
+  if (i != _head) {
+    unlink(i);
+    pushFront(i);
+  }
+  return &_entries[i]._wave;
+}
+
+CCSWaveform&
+CCSWaveformCache::insert(uint64_t key)
+{
+  uint32_t i;
+  if (_entries.size() < _capacity) {
+    i = static_cast<uint32_t>(_entries.size());
+    _entries.emplace_back();
+  } else {
+    i = _tail;
+    unlink(i);
+    _index.erase(_entries[i]._key);
+  }
+  _entries[i]._key = key;
+  _index.insert({key, i});
+  pushFront(i);
+  return _entries[i]._wave;
+}
+
+void
+CCSWaveformCache::unlink(uint32_t i)
+{
+  Entry& entry = _entries[i];
+  if (entry._prev != noEntry) {
+    _entries[entry._prev]._next = entry._next;
+  } else {
+    _head = entry._next;
+  }
+  if (entry._next != noEntry) {
+    _entries[entry._next]._prev = entry._prev;
+  } else {
+    _tail = entry._prev;
+  }
+  entry._prev = noEntry;
+  entry._next = noEntry;
+}
+
+void
+CCSWaveformCache::pushFront(uint32_t i)
+{
+  Entry& entry = _entries[i];
+  entry._prev = noEntry;
+  entry._next = _head;
+  if (_head != noEntry) {
+    _entries[_head]._prev = i;
+  }
+  _head = i;
+  if (_tail == noEntry) {
+    _tail = i;
+  }
+}
+
+void
+CCSWaveformCache::clear()
+{
+  _entries.clear();
+  _index.clear();
+  _head = noEntry;
+  _tail = noEntry;
+  _stats = CCSCacheStats();
+}
+
+/// Bracket v between axis(lo) and axis(lo+1) of an axis with size points,
+/// returns the weight of axis(lo+1). Waveforms are not extrapolated, so the 
+/// weight is clamped to the table border.
+template <typename Axis>
+static double
+bracket(const Axis& axis, size_t size, double v, size_t& lo)
+{
+  lo = 0;
+  if (size < 2) {
+    return 0;
+  }
+  for (size_t i=1; i+1<size; ++i) {
+    lo += (v > axis(i));
+  }
+  double x0 = axis(lo);
+  double x1 = axis(lo+1);
+  if (x1 == x0) {
+    return 0;
+  }
+  return std::min(1.0, std::max(0.0, (v - x0) / (x1 - x0)));
+}
+
+/// Current of lut at time t, linear between the points and zero outside.
+/// Queries come in increasing time, cursor keeps the last interval.
+static inline double
+currentAt(const CCSLUT& lut, double t, size_t& cursor)
+{
+  Span<double> times = lut.times();
+  Span<double> currents = lut.values();
+  size_t size = std::min(times.size(), currents.size());
+  if (size == 0 || t < times[0] || t > times[size-1]) {
+    return 0;
+  }
+  if (size == 1) {
+    return currents[0];
+  }
+  while (cursor+2 < size && t > times[cursor+1]) {
+    ++cursor;
+  }
+  double t0 = times[cursor];
+  double t1 = times[cursor+1];
+  if (t1 == t0) {
+    return currents[cursor];
+  }
+  return currents[cursor] + (currents[cursor+1] - currents[cursor]) * (t - t0) / (t1 - t0);
+}
+
+bool
+CCSGroup::value(double inputTran, double outputLoad, CCSWaveform& wave) const
+{
+  wave._referenceTime = 0;
+  wave._times.clear();
+  wave._currents.clear();
+  if (_ccsluts.empty() || _transDiv.size() < 2) {
+    return false;
+  }
+  /// Rows of tables with the same input transition, bracket the rows 
+  /// first and then the output loads within each row
+  size_t rows = _transDiv.size() - 1;
+  size_t row = 0;
+  double rowWeight = bracket([this](size_t r) { return _ccsluts[_transDiv[r]].inputTransition(); }, 
+                             rows, inputTran, row);
+  const CCSLUT* corners[4];
+  double weights[4];
+  size_t cornerCount = 0;
+  for (size_t r=0; r<2; ++r) {
+    double weight = (r == 0) ? 1 - rowWeight : rowWeight;
+    size_t rowIdx = std::min(row + r, rows - 1);
+    size_t first = _transDiv[rowIdx];
+    size_t size = _transDiv[rowIdx+1] - first;
+    size_t col = 0;
+    double colWeight = bracket([this, first](size_t c) { return _ccsluts[first+c].outputLoad(); }, 
+                               size, outputLoad, col);
+    for (size_t c=0; c<2; ++c) {
+      double w = weight * ((c == 0) ? 1 - colWeight : colWeight);
+      if (w == 0 || col + c >= size) {
+        continue;
+      }
+      corners[cornerCount] = &_ccsluts[first+col+c];
+      weights[cornerCount] = w;
+      ++cornerCount;
+    }
+  }
+  if (cornerCount == 0) {
+    corners[0] = &_ccsluts[_transDiv[row]];
+    weights[0] = 1;
+    cornerCount = 1;
+  }
+
+  /// Corner waveforms are aligned on the fraction of their own time span 
+  /// and blended point by point, which keeps the shape of the pulse 
+  /// instead of averaging pulses that peak at different times
+  size_t points = 0;
+  for (size_t k=0; k<cornerCount; ++k) {
+    points = std::max(points, std::min(corners[k]->times().size(), corners[k]->values().size()));
+  }
+  if (points == 0) {
+    return false;
+  }
+  wave._times.resize(points);
+  wave._currents.resize(points);
+  std::fill(wave._times.begin(), wave._times.end(), 0);
+  std::fill(wave._currents.begin(), wave._currents.end(), 0);
+  for (size_t k=0; k<cornerCount; ++k) {
+    const CCSLUT& lut = *corners[k];
+    wave._referenceTime += weights[k] * lut.referenceTime();
+    size_t size = std::min(lut.times().size(), lut.values().size());
+    if (size == 0) {
+      continue;
+    }
+    double start = lut.times()[0];
+    double span = lut.times()[size-1] - start;
+    size_t cursor = 0;
+    for (size_t j=0; j<points; ++j) {
+      double frac = (points > 1) ? static_cast<double>(j) / (points - 1) : 0;
+      double t = start + frac * span;
+      wave._times[j] += weights[k] * t;
+      wave._currents[j] += weights[k] * currentAt(lut, t, cursor);
+    }
+  }
+  return true;
+}
+
+/// Snap v to the center of its division of the axis interval bracketing
+/// it, step is the index of the division along the whole axis
+template <typename Axis>
+static double
+snapToAxis(const Axis& axis, size_t size, double v, uint32_t& step)
+{
+  const uint32_t divs = CCSGroup::cacheAxisDivisions;
+  size_t lo = 0;
+  double w = bracket(axis, size, v, lo);
+  uint32_t div = std::min(divs - 1, static_cast<uint32_t>(w * divs));
+  step = static_cast<uint32_t>(lo) * divs + div;
+  if (size < 2) {
+    return axis(0);
+  }
+  return axis(lo) + (div + 0.5) / divs * (axis(lo+1) - axis(lo));
+}
+
+bool
+CCSGroup::cachedValue(double inputTran, double outputLoad, CCSWaveform& wave) const
+{
+  if (_ccsluts.empty() || _transDiv.size() < 2) {
+    return false;
+  }
+  /// The load axis of the row bracketing inputTran from below keys the 
+  /// load, value() brackets the load again in each row
+  size_t rows = _transDiv.size() - 1;
+  uint32_t tranStep = 0;
+  double tran = snapToAxis([this](size_t r) { return _ccsluts[_transDiv[r]].inputTransition(); }, 
+                           rows, inputTran, tranStep);
+  size_t row = std::min<size_t>(tranStep / cacheAxisDivisions, rows - 1);
+  size_t first = _transDiv[row];
+  uint32_t loadStep = 0;
+  double load = snapToAxis([this, first](size_t c) { return _ccsluts[first+c].outputLoad(); }, 
+                           _transDiv[row+1] - first, outputLoad, loadStep);
+  uint64_t key = (static_cast<uint64_t>(tranStep) << 32) | loadStep;
+  std::lock_guard<std::mutex> lock(_cache.mutex());
+  const CCSWaveform* cached = _cache.find(key);
+  if (cached == nullptr) {
+    CCSWaveform& newWave = _cache.insert(key);
+    value(tran, load, newWave);
+    cached = &newWave;
+  }
+  wave = *cached;
+  return wave._times.empty() == false;
+}
+
 class LibReader {
   public:
     LibReader(LibData* owner)
     : _owner(owner) {}
-    void readFile(const char* datFile);
+    bool readFile(const char* datFile, LibFileInfo& info);
   private:
     LibData* _owner;
 };
@@ -320,7 +640,7 @@ parseLineNumber(const std::string& line, double unit)
 }
 
 void
-readNLDMLUT(std::ifstream& infile, NLDMLUT& data, 
+readNLDMLUT(std::ifstream& infile, TableArena& arena, NLDMLUT& data, 
             double index1Unit, double index2Unit, double valueUnit)
 {
   std::string line;
@@ -333,13 +653,11 @@ readNLDMLUT(std::ifstream& infile, NLDMLUT& data,
   std::getline(infile, line);
   line = trim(line);
   std::vector<double> values = parseLineNumbers(line, valueUnit);
-  data.setIndex1(index1);
-  data.setIndex2(index2);
-  data.setValues(values);
+  data.init(arena, index1, index2, values);
 }
 
 void
-readCCSLUT(std::ifstream& infile, CCSLUT& data, 
+readCCSLUT(std::ifstream& infile, TableArena& arena, CCSLUT& data, 
            double timeUnit, double index1Unit, double index2Unit, 
            double index3Unit, double valueUnit)
 {
@@ -359,34 +677,9 @@ readCCSLUT(std::ifstream& infile, CCSLUT& data,
   std::getline(infile, line);
   line = trim(line);
   std::vector<double> values = parseLineNumbers(line, valueUnit);
-  data.init(refTime, index1, index2, index3, values);
+  data.init(arena, refTime, index1, index2, index3, values);
 }
 
-struct SortArcDataByPin {
-  bool operator()(const NLDMArc& a, const NLDMArc& b) const {
-    if (a.toPin() == b.toPin()) {
-      return strcmp(a.fromPin(), b.fromPin()) < 0;
-    }
-    return strcmp(a.toPin(), b.toPin()) < 0;
-  }
-  bool operator()(const CCSArc& a, const CCSArc& b) const {
-    if (a.toPin() == b.toPin()) {
-      return strcmp(a.fromPin(), b.fromPin()) < 0;
-      return a.fromPin() < b.fromPin();
-    }
-    return strcmp(a.toPin(), b.toPin()) < 0;
-  }
-  /// Used to find input pins from output pin
-  bool operator()(const NLDMArc& a, const std::string& toPinToFind) const
-  {
-    return strcmp(a.toPin(), toPinToFind.data()) < 0;
-  }
-  bool operator()(const std::string& toPinToFind, const NLDMArc& a) const
-  {
-    return strcmp(toPinToFind.data(), a.toPin()) < 0;
-  }
-};
-
 struct SortCCBOutputVoltageLUT {
   bool operator()(const CCBOutputVoltageLUT& a, const CCBOutputVoltageLUT& b) const 
   {
@@ -417,7 +710,7 @@ CCBOutputVoltage::sortTable()
 }
 
 void
-readOutputVoltageLUT(std::ifstream& infile, CCBOutputVoltageLUT& data, 
+readOutputVoltageLUT(std::ifstream& infile, TableArena& arena, CCBOutputVoltageLUT& data, 
                      double timeUnit, double capUnit, double voltageUnit)
 {
   std::string line;
@@ -433,11 +726,11 @@ readOutputVoltageLUT(std::ifstream& infile, CCBOutputVoltageLUT& data,
   std::getline(infile, line);
   line = trim(line);
   std::vector<double> values = parseLineNumbers(line, voltageUnit);
-  data.init(index1, index2, index3, values);
+  data.init(arena, index1, index2, index3, values);
 }
 
 void
-readCCBStage(std::ifstream& infile, CCBData& data, 
+readCCBStage(std::ifstream& infile, TableArena& arena, CCBData& data, 
              double timeUnit, double voltageUnit, 
              double currentUnit, double capUnit)
 {
@@ -449,7 +742,7 @@ readCCBStage(std::ifstream& infile, CCBData& data,
   std::getline(infile, line);
   line = trim(line);
   if (line == "DC Current") {
-    readNLDMLUT(infile, data.getDcCurrent(), voltageUnit, voltageUnit, currentUnit);
+    readNLDMLUT(infile, arena, data.getDcCurrent(), voltageUnit, voltageUnit, currentUnit);
   }
   for (size_t i=0; i<2; ++i) {
     std::getline(infile, line);
@@ -467,7 +760,7 @@ readCCBStage(std::ifstream& infile, CCBData& data,
       }
       for (size_t i=0; i<tableCount; ++i) {
         CCBOutputVoltageLUT voltageData;
-        readOutputVoltageLUT(infile, voltageData, timeUnit, capUnit, voltageUnit);
+        readOutputVoltageLUT(infile, arena, voltageData, timeUnit, capUnit, voltageUnit);
         voltageTable->addLUT(voltageData);
       }
       voltageTable->sortTable();
@@ -475,13 +768,13 @@ readCCBStage(std::ifstream& infile, CCBData& data,
   }
 }
 
-void
-LibReader::readFile(const char* datFile)
+bool
+LibReader::readFile(const char* datFile, LibFileInfo& info)
 {
   std::ifstream infile(datFile);
   if (!infile) {
     printf("ERROR: Cannot open %s\n", datFile);
-    return;
+    return false;
   }
   double timeUnit = 1;
   double voltageUnit = 1;
@@ -489,6 +782,8 @@ LibReader::readFile(const char* datFile)
   double capUnit = 1;
   //double resUnit = 1;
   std::string cellName;
+  /// invalidSymbol if the cell is defined again
+  SymbolId cellId = invalidSymbol;
   std::string fromPin;
   std::string toPin;
   bool isInverted;
@@ -512,15 +807,20 @@ LibReader::readFile(const char* datFile)
       if (cellName.size() > 0) {
         if (nldmData.empty() == false) {
           std::sort(nldmData.begin(), nldmData.end(), SortArcDataByPin());
-          _owner->_nldmData.insert({cellName, nldmData});
+          if (cellId != invalidSymbol) {
+            _owner->_cells[cellId]._nldmArcs = nldmData;
+          }
           nldmData.clear();
         }
         if (ccsData.empty() == false) {
           std::sort(ccsData.begin(), ccsData.end(), SortArcDataByPin());
-          _owner->_ccsData.insert({cellName, ccsData});
+          if (cellId != invalidSymbol) {
+            _owner->_cells[cellId]._ccsArcs = ccsData;
+          }
           ccsData.clear();
         }
         cellName.clear();
+        cellId = invalidSymbol;
       }
       std::vector<std::string> strs;
       splitWithAny(line, " ", strs);
@@ -550,29 +850,39 @@ LibReader::readFile(const char* datFile)
             _owner->_transitionRiseLowThres = std::stod(strs[i]);
             ++i;
             _owner->_transitionRiseHighThres = std::stod(strs[i]);
+            info._settings |= LibFileInfo::riseTransitionThres;
           } else if (strs[i] == "F") {
             ++i;
             _owner->_transitionFallHighThres = std::stod(strs[i]);
             ++i;
             _owner->_transitionFallLowThres = std::stod(strs[i]);
+            info._settings |= LibFileInfo::fallTransitionThres;
           } else if (strs[i] == "D") {
             ++i;
             _owner->_delayRiseThres = std::stod(strs[i]);
             ++i;
             _owner->_delayFallThres = std::stod(strs[i]);
+            info._settings |= LibFileInfo::delayThres;
           } else if (strs[i] == "Vol") {
             ++i;
             _owner->_voltage = std::stod(strs[i]);
+            info._settings |= LibFileInfo::voltage;
           }
         }
       } else if (strs[0] == ".DRIVWAVE") {
+        if ((info._settings & LibFileInfo::voltage) == 0) {
+          info._needsPriorVoltage = true;
+          info._cacheable = false;
+        }
         for (size_t i=0; i<2; ++i) {
           std::getline(infile, line);
           line = trim(line);
           if (line == "Rise") {
-            readNLDMLUT(infile, _owner->_riseDriverWaveform, timeUnit, _owner->_voltage, timeUnit);
+            readNLDMLUT(infile, _owner->_tables, _owner->_riseDriverWaveform, timeUnit, _owner->_voltage, timeUnit);
+            info._settings |= LibFileInfo::riseDriverWaveform;
           } else if (line == "Fall") {
-            readNLDMLUT(infile, _owner->_fallDriverWaveform, timeUnit, _owner->_voltage, timeUnit);
+            readNLDMLUT(infile, _owner->_tables, _owner->_fallDriverWaveform, timeUnit, _owner->_voltage, timeUnit);
+            info._settings |= LibFileInfo::fallDriverWaveform;
           }
         }
       } else {
@@ -589,7 +899,14 @@ LibReader::readFile(const char* datFile)
           [](const FixedLoadCap& a, const FixedLoadCap& b) {
             return a.pinName() < b.pinName();
           });
-        _owner->_loadCaps.insert({cellName, pinCaps});
+        cellId = _owner->addCell(cellName);
+        if (cellId != invalidSymbol) {
+          _owner->_cells[cellId]._loadCaps = pinCaps;
+          info._cells.push_back(cellName);
+        } else {
+          info._duplicateCells.push_back(cellName);
+          info._cacheable = false;
+        }
       }
     } else if (numSpace == 2) {
       if (fromPin.size() > 0 || toPin.size() > 0) {
@@ -605,17 +922,17 @@ LibReader::readFile(const char* datFile)
       ccsArc.setFromToPin(fromPin, toPin, isInverted);
     } else if (numSpace == 4) {
       if (line == "Rise Delay") {
-        readNLDMLUT(infile, nldmArc.getLUT(LUTType::RiseDelay), timeUnit, capUnit, timeUnit);
+        readNLDMLUT(infile, _owner->_tables, nldmArc.getLUT(LUTType::RiseDelay), timeUnit, capUnit, timeUnit);
       } else if (line == "Fall Delay") {
-        readNLDMLUT(infile, nldmArc.getLUT(LUTType::FallDelay), timeUnit, capUnit, timeUnit);
+        readNLDMLUT(infile, _owner->_tables, nldmArc.getLUT(LUTType::FallDelay), timeUnit, capUnit, timeUnit);
       } else if (line == "Rise Transition") {
-        readNLDMLUT(infile, nldmArc.getLUT(LUTType::RiseTransition), timeUnit, capUnit, timeUnit);
+        readNLDMLUT(infile, _owner->_tables, nldmArc.getLUT(LUTType::RiseTransition), timeUnit, capUnit, timeUnit);
       } else if (line == "Fall Transition") {
-        readNLDMLUT(infile, nldmArc.getLUT(LUTType::FallTransition), timeUnit, capUnit, timeUnit);
+        readNLDMLUT(infile, _owner->_tables, nldmArc.getLUT(LUTType::FallTransition), timeUnit, capUnit, timeUnit);
       } else if (line == "CCSN First Stage") {
-        readCCBStage(infile, ccsArc.ccbFirstStageData(), timeUnit, voltageUnit, currentUnit, capUnit);
+        readCCBStage(infile, _owner->_tables, ccsArc.ccbFirstStageData(), timeUnit, voltageUnit, currentUnit, capUnit);
       } else if (line == "CCSN Last Stage") {
-        readCCBStage(infile, ccsArc.ccbLastStageData(), timeUnit, voltageUnit, currentUnit, capUnit);
+        readCCBStage(infile, _owner->_tables, ccsArc.ccbLastStageData(), timeUnit, voltageUnit, currentUnit, capUnit);
       } else if (line == "Current Rise") {
         std::string numLine;
         std::getline(infile, numLine);
@@ -624,7 +941,7 @@ LibReader::readFile(const char* datFile)
         CCSGroup& riseCurrents = ccsArc.getCurrent(LUTType::RiseCurrent);
         for (size_t i=0; i<tableCount; ++i) {
           CCSLUT lut;
-          readCCSLUT(infile, lut, timeUnit, timeUnit, capUnit, timeUnit, currentUnit);
+          readCCSLUT(infile, _owner->_tables, lut, timeUnit, timeUnit, capUnit, timeUnit, currentUnit);
           riseCurrents.addLUT(lut);
         }
         riseCurrents.sortTable();
@@ -636,7 +953,7 @@ LibReader::readFile(const char* datFile)
         CCSGroup& fallCurrents = ccsArc.getCurrent(LUTType::FallCurrent);
         for (size_t i=0; i<tableCount; ++i) {
           CCSLUT lut;
-          readCCSLUT(infile, lut, timeUnit, timeUnit, capUnit, timeUnit, currentUnit);
+          readCCSLUT(infile, _owner->_tables, lut, timeUnit, timeUnit, capUnit, timeUnit, currentUnit);
           fallCurrents.addLUT(lut);
         }
         fallCurrents.sortTable();
@@ -648,7 +965,7 @@ LibReader::readFile(const char* datFile)
         std::vector<NLDMLUT> rcvCaps;
         for (size_t i=0; i<tableCount; ++i) {
           NLDMLUT lut;
-          readNLDMLUT(infile, lut, timeUnit, capUnit, timeUnit);
+          readNLDMLUT(infile, _owner->_tables, lut, timeUnit, capUnit, timeUnit);
           rcvCaps.push_back(lut);
         }
         ccsArc.getRecvCap(LUTType::RiseRecvCap) = rcvCaps;
@@ -660,7 +977,7 @@ LibReader::readFile(const char* datFile)
         std::vector<NLDMLUT> rcvCaps;
         for (size_t i=0; i<tableCount; ++i) {
           NLDMLUT lut;
-          readNLDMLUT(infile, lut, timeUnit, capUnit, timeUnit);
+          readNLDMLUT(infile, _owner->_tables, lut, timeUnit, capUnit, timeUnit);
           rcvCaps.push_back(lut);
         }
         ccsArc.getRecvCap(LUTType::FallRecvCap) = rcvCaps;
@@ -671,190 +988,283 @@ LibReader::readFile(const char* datFile)
     if (nldmArc.empty() == false) nldmData.push_back(nldmArc);
     if (ccsArc.empty() == false) ccsData.push_back(ccsArc);
   }
-  if (cellName.size() > 0) {
+  if (cellName.size() > 0 && cellId != invalidSymbol) {
     if (nldmData.empty() == false) {
       std::sort(nldmData.begin(), nldmData.end(), SortArcDataByPin());
-      _owner->_nldmData.insert({cellName, nldmData});
+      _owner->_cells[cellId]._nldmArcs = nldmData;
     }
     if (ccsData.empty() == false) {
       std::sort(ccsData.begin(), ccsData.end(), SortArcDataByPin());
-      _owner->_ccsData.insert({cellName, ccsData});
+      _owner->_cells[cellId]._ccsArcs = ccsData;
     }
   }
+  return true;
 }
 
 LibData::LibData(const std::vector<const char*>& datFiles)
 {
+  read(std::vector<std::string>(datFiles.begin(), datFiles.end()));
+}
+
+bool
+LibData::readFile(const char* datFile, const std::unordered_set<std::string>& cells,
+                  LibFileInfo& info)
+{
+  if (LibertyReader::isLibertyFile(datFile)) {
+    LibertyReader reader(this);
+    return reader.readFile(datFile, cells, info);
+  }
   LibReader reader(this);
-  for (const char* datFile : datFiles) {
-    printf("Reading Lib data file %s\n", datFile);
-    reader.readFile(datFile);
+  return reader.readFile(datFile, info);
+}
+
+bool
+LibData::loadFile(const char* datFile, const std::unordered_set<std::string>& cells,
+                  LibFileInfo& info, bool& fromCache)
+{
+  fromCache = false;
+  LibCache cache(this);
+  if (LibertyReader::isLibertyFile(datFile) == false) {
+    fromCache = cache.load(datFile, info);
+    if (fromCache) {
+      return true;
+    }
+  }
+  if (readFile(datFile, cells, info) == false) {
+    return false;
   }
+  if (info._cacheable) {
+    cache.write(datFile, info);
+  }
+  return true;
 }
 
+void
+LibData::merge(LibData& part, const LibFileInfo& info, const char* datFile,
+               std::unordered_map<std::string, const char*>& cellFiles)
+{
+  _tables.adopt(part._tables);
+  for (const std::string& cellName : info._duplicateCells) {
+    printf("WARNING: Cell %s is defined more than once in %s, only the first one is used\n",
+           cellName.data(), datFile);
+  }
+  for (const std::string& cellName : info._cells) {
+    SymbolId cellId = addCell(cellName);
+    if (cellId == invalidSymbol) {
+      const auto& it = cellFiles.find(cellName);
+      printf("WARNING: Cell %s in %s is already defined in %s, ignored\n", cellName.data(), 
+             datFile, it != cellFiles.end() ? it->second : "a library read before");
+      continue;
+    }
+    cellFiles.insert({cellName, datFile});
+    LibCell& cell = _cells[cellId];
+    cell = std::move(part._cells[part.cellId(cellName)]);
+    for (NLDMArc& arc : cell._nldmArcs) {
+      arc.setOwner(this);
+    }
+    for (CCSArc& arc : cell._ccsArcs) {
+      arc.setOwner(this);
+    }
+  }
+  if (info._settings & LibFileInfo::riseTransitionThres) {
+    _transitionRiseLowThres = part._transitionRiseLowThres;
+    _transitionRiseHighThres = part._transitionRiseHighThres;
+  }
+  if (info._settings & LibFileInfo::fallTransitionThres) {
+    _transitionFallHighThres = part._transitionFallHighThres;
+    _transitionFallLowThres = part._transitionFallLowThres;
+  }
+  if (info._settings & LibFileInfo::delayThres) {
+    _delayRiseThres = part._delayRiseThres;
+    _delayFallThres = part._delayFallThres;
+  }
+  if (info._settings & LibFileInfo::voltage) {
+    _voltage = part._voltage;
+  }
+  if (info._settings & LibFileInfo::riseDriverWaveform) {
+    _riseDriverWaveform = part._riseDriverWaveform;
+  }
+  if (info._settings & LibFileInfo::fallDriverWaveform) {
+    _fallDriverWaveform = part._fallDriverWaveform;
+  }
+}
+
+/// One library file read on its own
+struct LibFilePart {
+  LibData     _data;
+  LibFileInfo _info;
+  bool        _loaded = false;
+  bool        _fromCache = false;
+};
+
 void 
-LibData::read(const std::vector<std::string>& datFiles)
+LibData::read(const std::vector<std::string>& datFiles, const std::vector<std::string>& cells)
 {
-  LibReader reader(this);
-  for (const std::string& datFile : datFiles) {
-    printf("Reading Lib data file %s\n", datFile.data());
-    reader.readFile(datFile.data());
+  std::unordered_set<std::string> cellSet(cells.begin(), cells.end());
+  std::vector<LibFilePart> parts(datFiles.size());
+  parallelFor(datFiles.size(), [&](size_t i) {
+    LibFilePart& part = parts[i];
+    part._loaded = part._data.loadFile(datFiles[i].data(), cellSet, part._info, part._fromCache);
+  });
+  std::unordered_map<std::string, const char*> cellFiles;
+  for (size_t i=0; i<datFiles.size(); ++i) {
+    LibFilePart& part = parts[i];
+    const char* datFile = datFiles[i].data();
+    if (part._fromCache) {
+      printf("Reading Lib data file %s from cache %s\n", datFile, 
+             LibCache::cacheFile(datFile).data());
+    } else {
+      printf("Reading Lib data file %s\n", datFile);
+    }
+    if (part._loaded == false) {
+      continue;
+    }
+    if (part._info._needsPriorVoltage) {
+      /// Read again with the voltage defined by the files before it
+      part._data = LibData();
+      part._data._voltage = _voltage;
+      part._info = LibFileInfo();
+      part._data.readFile(datFile, cellSet, part._info);
+    }
+    merge(part._data, part._info, datFile, cellFiles);
   }
+  buildIndex();
 }
 
-const NLDMArc*
-LibData::findNLDMArc(const char* cell, const char* fromPin, const char* toPin) const
+SymbolId
+LibData::addCell(const std::string& cell)
 {
-  std::string cellStr(cell);
-  std::string fromPinStr(fromPin);
-  std::string toPinStr(toPin);
-  const auto& it = _nldmData.find(cellStr);
-  if (it == _nldmData.end()) {
-    return nullptr;
-  } 
-  const auto& arcs = it->second;
-  NLDMArc tempArc(nullptr);
-  tempArc.setFromToPin(fromPinStr, toPinStr, true);
-  const auto& it2 = std::lower_bound(arcs.begin(), arcs.end(), tempArc, SortArcDataByPin());
-  if (it2 != arcs.end() && 
-      strcmp(it2->fromPin(), fromPin) == 0 && 
-      strcmp(it2->toPin(), toPin) == 0) {
-    return &(*it2);
-  } 
-  return nullptr;
+  if (_cellNames.find(cell) != invalidSymbol) {
+    return invalidSymbol;
+  }
+  SymbolId cellId = _cellNames.intern(cell);
+  _cells.emplace_back();
+  return cellId;
 }
 
-const CCSArc*
-LibData::findCCSArc(const char* cell, const char* fromPin, const char* toPin) const
+const LibCell*
+LibData::findCell(const std::string& cell) const
 {
-  std::string cellStr(cell);
-  std::string fromPinStr(fromPin);
-  std::string toPinStr(toPin);
-  const auto& it = _ccsData.find(cellStr);
-  if (it == _ccsData.end()) {
+  SymbolId id = cellId(cell);
+  if (id == invalidSymbol) {
     return nullptr;
-  } 
-  const auto& arcs = it->second;
-  CCSArc tempArc(nullptr);
-  tempArc.setFromToPin(fromPinStr, toPinStr, true);
-  const auto& it2 = std::lower_bound(arcs.begin(), arcs.end(), tempArc, SortArcDataByPin());
-  if (it2 != arcs.end() && 
-      strcmp(it2->fromPin(), fromPin) == 0 && 
-      strcmp(it2->toPin(), toPin) == 0) {
-    /// TODO: Find out why this strange syntax is needed
-    return &(*it2);
-  } 
-  return nullptr;
+  }
+  return &_cells[id];
 }
 
-bool
-LibData::isOutputPin(const char* cell, const char* pin) const
+void
+LibData::buildIndex()
 {
-  std::string cellStr(cell);
-  std::string pinStr(pin);
-  const auto& it = _loadCaps.find(cellStr);
-  /// We don't allow missing lib data
-  assert(it != _loadCaps.end());
-  const auto& pinCaps = it->second;
-  const auto& it2 = std::lower_bound(pinCaps.begin(), pinCaps.end(), pinStr, 
-                      [](const FixedLoadCap& a, const std::string& b) {
-                        return a.pinName() < b;
-                      });
-
-  if (it2 != pinCaps.end() && it2->pinName() == pinStr) {
-    return false;
+  _pinCapIndex.clear();
+  _nldmArcIndex.clear();
+  _ccsArcIndex.clear();
+  _arcInputPins.clear();
+  for (SymbolId cellId=0; cellId<_cells.size(); ++cellId) {
+    const LibCell& cell = _cells[cellId];
+    for (uint32_t i=0; i<cell._loadCaps.size(); ++i) {
+      SymbolId pin = _pinNames.intern(cell._loadCaps[i].pinName());
+      _pinCapIndex.insert({pinKey(cellId, pin), i});
+    }
+    for (uint32_t i=0; i<cell._nldmArcs.size(); ++i) {
+      const NLDMArc& arc = cell._nldmArcs[i];
+      SymbolId fromPin = _pinNames.intern(arc.fromPin());
+      SymbolId toPin = _pinNames.intern(arc.toPin());
+      _nldmArcIndex.insert({ArcKey{cellId, fromPin, toPin}, i});
+      /// Arcs are sorted by to pin, so input pins keep the old order
+      _arcInputPins[pinKey(cellId, toPin)].push_back(fromPin);
+    }
+    for (uint32_t i=0; i<cell._ccsArcs.size(); ++i) {
+      const CCSArc& arc = cell._ccsArcs[i];
+      SymbolId fromPin = _pinNames.intern(arc.fromPin());
+      SymbolId toPin = _pinNames.intern(arc.toPin());
+      _ccsArcIndex.insert({ArcKey{cellId, fromPin, toPin}, i});
+    }
   }
-  return true;
+}
+
+CCSCacheStats
+LibData::ccsCacheStats() const
+{
+  CCSCacheStats stats;
+  for (const LibCell& cell : _cells) {
+    for (const CCSArc& arc : cell._ccsArcs) {
+      for (LUTType type : {LUTType::RiseCurrent, LUTType::FallCurrent}) {
+        CCSCacheStats arcStats = arc.getCurrent(type).cacheStats();
+        stats._hits += arcStats._hits;
+        stats._misses += arcStats._misses;
+      }
+    }
+  }
+  return stats;
+}
+
+size_t
+LibData::cellCount() const
+{
+  size_t count = 0;
+  for (const LibCell& cell : _cells) {
+    if (cell._nldmArcs.empty() == false) {
+      ++count;
+    }
+  }
+  return count;
 }
 
 const NLDMArc*
-LibData::findNLDMArc(const std::string& cell, const std::string& fromPin, const std::string& toPin) const
+LibData::findNLDMArc(SymbolId cell, SymbolId fromPin, SymbolId toPin) const
 {
-  const auto& it = _nldmData.find(cell);
-  if (it == _nldmData.end()) {
+  const auto& it = _nldmArcIndex.find(ArcKey{cell, fromPin, toPin});
+  if (it == _nldmArcIndex.end()) {
     return nullptr;
-  } 
-  const auto& arcs = it->second;
-  NLDMArc tempArc(nullptr);
-  tempArc.setFromToPin(fromPin, toPin, true);
-  const auto& it2 = std::lower_bound(arcs.begin(), arcs.end(), tempArc, SortArcDataByPin());
-  if (it2 != arcs.end() && 
-      strcmp(it2->fromPin(), fromPin.data()) == 0 && 
-      strcmp(it2->toPin(), toPin.data()) == 0) {
-    return &(*it2);
-  } 
-  return nullptr;
+  }
+  return &(_cells[cell]._nldmArcs[it->second]);
 }
 
 const CCSArc*
-LibData::findCCSArc(const std::string& cell, const std::string& fromPin, const std::string& toPin) const
+LibData::findCCSArc(SymbolId cell, SymbolId fromPin, SymbolId toPin) const
 {
-  const auto& it = _ccsData.find(cell);
-  if (it == _ccsData.end()) {
+  const auto& it = _ccsArcIndex.find(ArcKey{cell, fromPin, toPin});
+  if (it == _ccsArcIndex.end()) {
     return nullptr;
-  } 
-  const auto& arcs = it->second;
-  CCSArc tempArc(nullptr);
-  tempArc.setFromToPin(fromPin, toPin, true);
-  const auto& it2 = std::lower_bound(arcs.begin(), arcs.end(), tempArc, SortArcDataByPin());
-  if (it2 != arcs.end() && 
-      strcmp(it2->fromPin(), fromPin.data()) == 0 && 
-      strcmp(it2->toPin(), toPin.data()) == 0) {
-    /// TODO: Find out why this strange syntax is needed
-    return &(*it2);
-  } 
-  return nullptr;
+  }
+  return &(_cells[cell]._ccsArcs[it->second]);
 }
 
 bool
-LibData::isOutputPin(const std::string& cell, const std::string& pin) const
+LibData::isOutputPin(SymbolId cell, SymbolId pin) const
 {
-  const auto& it = _loadCaps.find(cell);
   /// We don't allow missing lib data
-  assert(it != _loadCaps.end());
-  const auto& pinCaps = it->second;
-  const auto& it2 = std::lower_bound(pinCaps.begin(), pinCaps.end(), pin, 
-                      [](const FixedLoadCap& a, const std::string& b) {
-                        return a.pinName() < b;
-                      });
-
-  if (it2 != pinCaps.end() && it2->pinName() == pin) {
-    return false;
-  }
-  return true;
+  assert(cell < _cells.size());
+  return _pinCapIndex.find(pinKey(cell, pin)) == _pinCapIndex.end();
 }
 
 double
-LibData::fixedLoadCap(const std::string& cell, const std::string& pin, bool isRise) const
+LibData::fixedLoadCap(SymbolId cell, SymbolId pin, bool isRise) const
 {
-  const auto& it = _loadCaps.find(cell);
-  /// We don't allow missing lib data
-  assert(it != _loadCaps.end());
-  const auto& pinCaps = it->second;
-  const auto& it2 = std::lower_bound(pinCaps.begin(), pinCaps.end(), pin, 
-                      [](const FixedLoadCap& a, const std::string& b) {
-                        return a.pinName() < b;
-                      });
+  const auto& it = _pinCapIndex.find(pinKey(cell, pin));
+  if (it == _pinCapIndex.end()) {
+    return 0;
+  }
+  return _cells[cell]._loadCaps[it->second].value(isRise);
+}
 
-  if (it2 != pinCaps.end() && it2->pinName() == pin) {
-    const FixedLoadCap& cap = *it2;
-    return cap.value(isRise);
+const std::vector<SymbolId>&
+LibData::cellArcInputPins(SymbolId cell, SymbolId outPin) const
+{
+  static const std::vector<SymbolId> noPins;
+  const auto& it = _arcInputPins.find(pinKey(cell, outPin));
+  if (it == _arcInputPins.end()) {
+    return noPins;
   }
-  return 0;
+  return it->second;
 }
 
 std::vector<std::string>
 LibData::cellArcInputPins(const std::string& cell, const std::string& outPin) const
 {
   std::vector<std::string> inputPins;
-  const auto& it = _nldmData.find(cell);
-  if (it == _nldmData.end()) {
-    return inputPins;
-  }
-  const std::vector<NLDMArc>& nldmArcs = it->second;
-  const auto& iters = std::equal_range(nldmArcs.begin(), nldmArcs.end(), outPin, SortArcDataByPin{});
-  for (auto it2 = iters.first; it2 != iters.second; ++it2) {
-    inputPins.push_back(it2->fromPin());
+  for (SymbolId pin : cellArcInputPins(cellId(cell), pinId(outPin))) {
+    inputPins.push_back(pinName(pin));
   }
   return inputPins;
 }
@@ -863,12 +1273,11 @@ std::vector<std::string>
 LibData::cellArcOutputPins(const std::string& cell, const std::string& inPin) const
 {
   std::vector<std::string> outputPins;
-  const auto& it = _nldmData.find(cell);
-  if (it == _nldmData.end()) {
+  const LibCell* libCell = findCell(cell);
+  if (libCell == nullptr) {
     return outputPins;
   }
-  const std::vector<NLDMArc>& nldmArcs = it->second;
-  for (const NLDMArc& arc : nldmArcs) {
+  for (const NLDMArc& arc : libCell->_nldmArcs) {
     if (arc.fromPin() == inPin) {
       outputPins.push_back(arc.toPin());
     }
@@ -2,14 +2,22 @@
 #define _NA_LIBDAT_H_
 
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <string>
+#include "Span.h"
+#include "SymbolTable.h"
 
 namespace NA {
 
 class LibData;
 class CCSArc;
+struct LibFileInfo;
 
 enum class LUTType {
   RiseDelay,
@@ -23,44 +31,87 @@ enum class LUTType {
 
 };
 
+/// Numbers of all lookup tables of one LibData. Memory is taken from large
+/// chunks that are never reallocated, tables keep pointers into them instead 
+/// of owning vectors, so loading a library does few allocations and the 
+/// axes and values of one table are next to each other in memory.
+/// Copies of an arena share the chunks, so tables copied along with their
+/// LibData stay valid.
+class TableArena {
+  public:
+    TableArena() = default;
+
+    /// Contiguous space for n doubles, valid as long as the arena lives
+    double* allocate(size_t n);
+    /// Keep storage that tables point to but the arena does not
+    /// allocate, e.g. a mapped library cache, alive with the arena
+    void keep(const std::shared_ptr<const void>& storage) { _external.push_back(storage); }
+    /// Number of doubles allocated
+    size_t size() const { return _size; }
+    /// Take over the storage of other, tables pointing to it stay valid
+    void adopt(TableArena& other);
+    void clear();
+
+  private:
+    std::vector<std::shared_ptr<const void>> _external;
+    std::vector<std::shared_ptr<double[]>> _chunks;
+    size_t                                 _chunkCapacity = 0;
+    size_t                                 _chunkUsed = 0;
+    size_t                                 _size = 0;
+};
+
+/// Copy times and values back to back into arena
+const double* copyToArena(TableArena& arena, const std::vector<double>& times,
+                          const std::vector<double>& values);
+
+/// 2D table, a view of index1, index2 and the row major values 
+/// stored back to back in a TableArena
 class NLDMLUT {
   public:
     NLDMLUT() = default;
-    NLDMLUT(const NLDMLUT& other) = default;
-    /*
-    : _index1(other._index1), 
-      _index2(other._index2), 
-      _values(other._values) {}
-      */
 
     void reset()
     {
-      _index1.clear();
-      _index2.clear();
-      _values.clear();
+      _data = nullptr;
+      _dim1 = 0;
+      _dim2 = 0;
+    }
+    void init(TableArena& arena, const std::vector<double>& index1, 
+              const std::vector<double>& index2, const std::vector<double>& values);
+    /// View of data already laid out as index1, index2 and values
+    void init(const double* data, size_t dim1, size_t dim2)
+    {
+      _data = data;
+      _dim1 = dim1;
+      _dim2 = dim2;
     }
-    void setIndex1(const std::vector<double>& index1) { _index1.assign(index1.begin(), index1.end()); }
-    void setIndex2(const std::vector<double>& index2) { _index2.assign(index2.begin(), index2.end()); }
-    void setValues(const std::vector<double>& values) { _values.assign(values.begin(), values.end()); }
 
     size_t axis1Index(double value) const;
     size_t axis2Index(double value) const;
     
     double value(double inputTran, double outputLoad) const;
+    /// Interpolate n (inputTran, outputLoad) pairs at once, results[i] is
+    /// the same as value(inputTrans[i], outputLoads[i])
+    void values(const double* inputTrans, const double* outputLoads, 
+                double* results, size_t n) const;
 
-    bool empty() const { return _values.empty(); }
+    bool empty() const { return _dim1 == 0; }
 
-    void indexValues(const std::vector<double>& values, size_t X, size_t Y, 
-                     double& Z1, double& Z2, double& Z3, double& Z4) const;
+    Span<double> index1Values() const { return Span<double>(index1Data(), _dim1); }
+    Span<double> index2Values() const { return Span<double>(index2Data(), _dim2); }
+    Span<double> values() const { return Span<double>(valueData(), _dim1 * _dim2); }
 
-    std::vector<double> index1Values() const { return _index1; }
-    std::vector<double> index2Values() const { return _index2; }
-    std::vector<double> values() const { return _values; }
+  private:
+    const double* index1Data() const { return _data; }
+    const double* index2Data() const { return _data + _dim1; }
+    const double* valueData() const { return _data + _dim1 + _dim2; }
+    void indexValues(const double* values, size_t X, size_t Y, 
+                     double& Z1, double& Z2, double& Z3, double& Z4) const;
 
   private:
-    std::vector<double> _index1;
-    std::vector<double> _index2;
-    std::vector<double> _values;
+    const double* _data = nullptr;
+    size_t        _dim1 = 0;
+    size_t        _dim2 = 0;
 };
 
 class NLDMArc {
@@ -93,6 +144,7 @@ class NLDMArc {
                                 _riseTransition.empty() && _fallTransition.empty(); }
 
     const LibData* owner() const { return _owner; }
+    void setOwner(const LibData* owner) { _owner = owner; }
     bool isInverted() const { return _isInverted; }
 
   private:
@@ -106,91 +158,204 @@ class NLDMArc {
     NLDMLUT        _fallTransition;
 };
 
+/// Current waveform at one (inputTran, outputLoad) point, times and 
+/// values are views of a TableArena
 class CCSLUT {
   public:
     CCSLUT() = default;
     
-    void init(double refTime, double index1, double index2,
+    void init(TableArena& arena, double refTime, double index1, double index2,
               const std::vector<double>& index3, 
               const std::vector<double>& values)
     {
       _referenceTime = refTime;
       _index1 = index1;
       _index2 = index2;
-      _index3.assign(index3.begin(), index3.end());
-      _values.assign(values.begin(), values.end());
+      _data = copyToArena(arena, index3, values);
+      _timeSize = index3.size();
+      _valueSize = values.size();
+    }
+    /// View of data already laid out as times and values
+    void init(const double* data, double refTime, double index1, double index2,
+              size_t timeSize, size_t valueSize)
+    {
+      _referenceTime = refTime;
+      _index1 = index1;
+      _index2 = index2;
+      _data = data;
+      _timeSize = timeSize;
+      _valueSize = valueSize;
     }
 
     double inputTransition() const { return _index1; }
     double outputLoad() const { return _index2; }
     double referenceTime() const { return _referenceTime; }
-    std::vector<double> times() const { return _index3; }
-    std::vector<double> values() const { return _values; }
+    Span<double> times() const { return Span<double>(_data, _timeSize); }
+    Span<double> values() const { return Span<double>(_data + _timeSize, _valueSize); }
 
     void reset()
     {
+      _data = nullptr;
       _referenceTime = 0;
       _index1 = 0;
       _index2 = 0;
-      _index3.clear();
-      _values.clear();
+      _timeSize = 0;
+      _valueSize = 0;
+    }
+
+    bool empty() const { return _valueSize == 0; }
+
+  private:
+    const double* _data = nullptr;
+    double        _referenceTime = 0;
+    double        _index1 = 0;
+    double        _index2 = 0;
+    size_t        _timeSize = 0;
+    size_t        _valueSize = 0;
+};
+
+/// Current waveform interpolated from a CCSGroup. The vectors are reused
+/// by later interpolations into the same waveform, so keeping one around 
+/// avoids allocations in loops.
+struct CCSWaveform {
+  double              _referenceTime = 0;
+  std::vector<double> _times;
+  std::vector<double> _currents;
+};
+
+struct CCSCacheStats {
+  size_t _hits = 0;
+  size_t _misses = 0;
+
+  size_t lookups() const { return _hits + _misses; }
+  double hitRate() const { return lookups() ? static_cast<double>(_hits) / lookups() : 0; }
+};
+
+/// Bounded LRU cache of interpolated waveforms of one CCSGroup. 
+/// Entries are kept in a vector linked by indices, so the cache can be 
+/// copied along with its LibData. The circuit copies of parallel analyses
+/// share one LibData, so find() and insert() are called with mutex() held.
+class CCSWaveformCache {
+  public:
+    static constexpr size_t defaultCapacity = 32;
+
+    CCSWaveformCache(size_t capacity = defaultCapacity)
+    : _capacity(capacity) {}
+    /// Copies the entries, not the mutex
+    CCSWaveformCache(const CCSWaveformCache& other);
+    CCSWaveformCache& operator=(const CCSWaveformCache& other);
+
+    /// Waveform of key, nullptr on a miss
+    const CCSWaveform* find(uint64_t key);
+    /// Buffer for a new waveform of key, the least recently used entry
+    /// is reused when the cache is full
+    CCSWaveform& insert(uint64_t key);
+    std::mutex& mutex() const { return _mutex; }
+
+    size_t size() const { return _entries.size(); }
+    size_t capacity() const { return _capacity; }
+    CCSCacheStats stats() const 
+    { 
+      std::lock_guard<std::mutex> lock(_mutex);
+      return _stats; 
     }
+    void clear();
 
-    bool empty() const { return _values.empty(); }
+  private:
+    static constexpr uint32_t noEntry = static_cast<uint32_t>(-1);
+    struct Entry {
+      uint64_t    _key = 0;
+      uint32_t    _prev = noEntry;
+      uint32_t    _next = noEntry;
+      CCSWaveform _wave;
+    };
+    void unlink(uint32_t i);
+    void pushFront(uint32_t i);
 
   private:
-    double              _referenceTime;
-    double              _index1;
-    double              _index2;
-    std::vector<double> _index3;
-    std::vector<double> _values;
+    size_t                                 _capacity;
+    std::vector<Entry>                     _entries;
+    std::unordered_map<uint64_t, uint32_t> _index;
+    uint32_t                               _head = noEntry;
+    uint32_t                               _tail = noEntry;
+    CCSCacheStats                          _stats;
+    mutable std::mutex                     _mutex;
 };
 
 class CCSGroup {
   public:
+    /// Resolution of the cache keys as divisions of each interval of the
+    /// table axes, queries in one division share the waveform interpolated
+    /// at its center. A Ceff iteration moves the load by a fraction of an
+    /// interval, so it lands in few divisions whatever the units.
+    static constexpr uint32_t cacheAxisDivisions = 32;
+
     CCSGroup() = default;
     void addLUT(const CCSLUT& data) { _ccsluts.push_back(data); }
-    CCSLUT value(double inputTran, double outputLoad) const;
+    /// Interpolate the current waveform at (inputTran, outputLoad) into wave,
+    /// false if there is no table
+    bool value(double inputTran, double outputLoad, CCSWaveform& wave) const;
+    /// Same as value() with (inputTran, outputLoad) snapped to the cache 
+    /// resolution, and the result memoized. The cached waveform is copied 
+    /// into wave under the lock of the cache, which is shared by all threads.
+    bool cachedValue(double inputTran, double outputLoad, CCSWaveform& wave) const;
+    CCSCacheStats cacheStats() const { return _cache.stats(); }
     void sortTable();
-    std::vector<size_t> searchSteps() const { return _transDiv; }
+    Span<size_t> searchSteps() const { return _transDiv; }
 
     bool empty() const { return _ccsluts.empty(); }
-    std::vector<CCSLUT> tables() const { return _ccsluts; }
+    Span<CCSLUT> tables() const { return _ccsluts; }
     
     void reset() 
     { 
       _ccsluts.clear(); 
       _transDiv.clear();
+      _cache.clear();
     }
 
   private:
-    std::vector<CCSLUT> _ccsluts;
-    std::vector<size_t> _transDiv;
+    std::vector<CCSLUT>      _ccsluts;
+    std::vector<size_t>      _transDiv;
+    mutable CCSWaveformCache _cache;
 };
 
+/// Output voltage waveform at one (inputTran, outputLoad) point, times and
+/// voltages are views of a TableArena
 class CCBOutputVoltageLUT {
   public:
     CCBOutputVoltageLUT() = default;
-    void init(double inputTran, double outputLoad, 
+    void init(TableArena& arena, double inputTran, double outputLoad, 
               const std::vector<double>& time,
               const std::vector<double>& voltage)
     {
       _inputTran = inputTran;
       _outputLoad = outputLoad;
-      _time.assign(time.begin(), time.end());
-      _voltage.assign(voltage.begin(), voltage.end());
+      _data = copyToArena(arena, time, voltage);
+      _timeSize = time.size();
+      _voltageSize = voltage.size();
+    }
+    /// View of data already laid out as times and voltages
+    void init(const double* data, double inputTran, double outputLoad,
+              size_t timeSize, size_t voltageSize)
+    {
+      _inputTran = inputTran;
+      _outputLoad = outputLoad;
+      _data = data;
+      _timeSize = timeSize;
+      _voltageSize = voltageSize;
     }
     
     double inputTransition() const { return _inputTran; }
     double outputLoad() const { return _outputLoad; }
-    std::vector<double> times() const { return _time; }
-    std::vector<double> values() const { return _voltage; }
+    Span<double> times() const { return Span<double>(_data, _timeSize); }
+    Span<double> values() const { return Span<double>(_data + _timeSize, _voltageSize); }
 
   private:  
-    double _inputTran = 0;
-    double _outputLoad = 0;
-    std::vector<double> _time;
-    std::vector<double> _voltage;
+    const double* _data = nullptr;
+    double        _inputTran = 0;
+    double        _outputLoad = 0;
+    size_t        _timeSize = 0;
+    size_t        _voltageSize = 0;
 };
 
 class CCBOutputVoltage {
@@ -205,8 +370,8 @@ class CCBOutputVoltage {
       _transDiv.clear();
     }
 
-    std::vector<CCBOutputVoltageLUT> tables() const { return _lutData; }
-    std::vector<size_t> searchSteps() const { return _transDiv; }
+    Span<CCBOutputVoltageLUT> tables() const { return _lutData; }
+    Span<size_t> searchSteps() const { return _transDiv; }
   private:  
     std::vector<CCBOutputVoltageLUT> _lutData;
     std::vector<size_t> _transDiv;
@@ -218,6 +383,7 @@ class CCBData {
     void setIsInverting(bool val) { _isInverting = val; }
     void setMillerCaps(double rise, double fall) { _millerCapRise = rise; _millerCapFall = fall; }
     NLDMLUT& getDcCurrent() { return _dcCurrent; }
+    const NLDMLUT& getDcCurrent() const { return _dcCurrent; }
     CCBOutputVoltage& getRiseOutputVoltage() { return _riseVoltage; }
     CCBOutputVoltage& getFallOutputVoltage() { return _fallVoltage; }
     const CCBOutputVoltage& getRiseOutputVoltage() const { return _riseVoltage; }
@@ -302,6 +468,7 @@ class CCSArc {
                                 _riseRecvCaps.empty() && _fallRecvCaps.empty(); }
 
     const LibData* owner() const { return _owner; }
+    void setOwner(const LibData* owner) { _owner = owner; }
 
   private:
     const LibData*        _owner = nullptr;
@@ -335,38 +502,90 @@ class FixedLoadCap {
     double      _fall;
 };
 
+/// Order of the arcs of a LibCell
+struct SortArcDataByPin {
+  bool operator()(const NLDMArc& a, const NLDMArc& b) const {
+    if (strcmp(a.toPin(), b.toPin()) == 0) {
+      return strcmp(a.fromPin(), b.fromPin()) < 0;
+    }
+    return strcmp(a.toPin(), b.toPin()) < 0;
+  }
+  bool operator()(const CCSArc& a, const CCSArc& b) const {
+    if (strcmp(a.toPin(), b.toPin()) == 0) {
+      return strcmp(a.fromPin(), b.fromPin()) < 0;
+    }
+    return strcmp(a.toPin(), b.toPin()) < 0;
+  }
+};
+
+/// Arcs and pin capacitance of one cell
+struct LibCell {
+  /// Sorted by to pin then from pin
+  std::vector<NLDMArc>      _nldmArcs;
+  std::vector<CCSArc>       _ccsArcs;
+  /// Input pins sorted by name
+  std::vector<FixedLoadCap> _loadCaps;
+};
+
 class LibData {
   public:
     LibData() = default;
     LibData(const std::vector<const char*>& datFiles);
 
-    void read(const std::vector<std::string>& datFiles);
-
-    const NLDMArc* findNLDMArc(const char* cell, const char* fromPin, 
-                               const char* toPin) const;
+    /// Files are read in parallel, each into a LibData of its own, then 
+    /// merged in the given order. The first definition of a cell is kept.
+    /// Liberty files only parse the cells listed in cells, or all cells
+    /// if it is empty. Files in the .dat format are always read whole.
+    void read(const std::vector<std::string>& datFiles, 
+              const std::vector<std::string>& cells = std::vector<std::string>());
+
+    /// Cell and pin names are interned to IDs when the library is read,
+    /// lookups by IDs hash integers only. Lookups by names are wrappers
+    /// that find the IDs first.
+    SymbolId cellId(const std::string& cell) const { return _cellNames.find(cell); }
+    SymbolId pinId(const std::string& pin) const { return _pinNames.find(pin); }
+    const std::string& cellName(SymbolId cell) const { return _cellNames.name(cell); }
+    const std::string& pinName(SymbolId pin) const { return _pinNames.name(pin); }
+
+    const NLDMArc* findNLDMArc(SymbolId cell, SymbolId fromPin, SymbolId toPin) const;
+    const CCSArc* findCCSArc(SymbolId cell, SymbolId fromPin, SymbolId toPin) const;
+    /// Pins without pin capacitance are output pins
+    bool isOutputPin(SymbolId cell, SymbolId pin) const;
+    double fixedLoadCap(SymbolId cell, SymbolId pin, bool isRise) const;
+    /// Input pins of the arcs to outPin
+    const std::vector<SymbolId>& cellArcInputPins(SymbolId cell, SymbolId outPin) const;
 
-    const CCSArc* findCCSArc(const char* cell, const char* fromPin, 
-                             const char* toPin) const;
-
-    bool isOutputPin(const char* cell, const char* pin) const;
-    
     const NLDMArc* findNLDMArc(const std::string& cell, const std::string& fromPin, 
-                               const std::string& toPin) const;
-
+                               const std::string& toPin) const
+    {
+      return findNLDMArc(cellId(cell), pinId(fromPin), pinId(toPin));
+    }
     const CCSArc* findCCSArc(const std::string& cell, const std::string& fromPin, 
-                             const std::string& toPin) const;
-
-    bool isOutputPin(const std::string& cell, const std::string& pin) const;
-    double fixedLoadCap(const std::string& cell, const std::string& pin, bool isRise) const;
-
-    NLDMLUT riseDriverWaveform() const { return _riseDriverWaveform; }
-    NLDMLUT fallDriverWaveform() const { return _fallDriverWaveform; }
-
-    size_t cellCount() const { return _nldmData.size(); }
-
+                             const std::string& toPin) const
+    {
+      return findCCSArc(cellId(cell), pinId(fromPin), pinId(toPin));
+    }
+    bool isOutputPin(const std::string& cell, const std::string& pin) const
+    {
+      return isOutputPin(cellId(cell), pinId(pin));
+    }
+    double fixedLoadCap(const std::string& cell, const std::string& pin, bool isRise) const
+    {
+      return fixedLoadCap(cellId(cell), pinId(pin), isRise);
+    }
     std::vector<std::string> cellArcInputPins(const std::string& cell, const std::string& outPin) const;
     std::vector<std::string> cellArcOutputPins(const std::string& cell, const std::string& inPin) const;
 
+    const NLDMLUT& riseDriverWaveform() const { return _riseDriverWaveform; }
+    const NLDMLUT& fallDriverWaveform() const { return _fallDriverWaveform; }
+    /// Storage of all tables, size() is the number of doubles loaded
+    const TableArena& tableArena() const { return _tables; }
+
+    /// Number of cells with NLDM arcs
+    size_t cellCount() const;
+    /// Hit and miss counts of the CCS waveform caches of all arcs
+    CCSCacheStats ccsCacheStats() const;
+
     double voltage() const { return _voltage; }
     double riseTransitionLowThres() const { return _transitionRiseLowThres; }
     double riseTransitionHighThres() const { return _transitionRiseHighThres; }
@@ -375,6 +594,41 @@ class LibData {
     double riseDelayThres() const { return _delayRiseThres; }
     double fallDelayThres() const { return _delayFallThres; }
     
+  private:
+    struct ArcKey {
+      SymbolId _cell;
+      SymbolId _fromPin;
+      SymbolId _toPin;
+      bool operator==(const ArcKey& other) const
+      {
+        return _cell == other._cell && _fromPin == other._fromPin && _toPin == other._toPin;
+      }
+    };
+    struct HashArcKey {
+      size_t operator()(const ArcKey& key) const
+      {
+        uint64_t h = (static_cast<uint64_t>(key._cell) << 32) ^ 
+                     (static_cast<uint64_t>(key._fromPin) << 16) ^ key._toPin;
+        return std::hash<uint64_t>()(h);
+      }
+    };
+    static uint64_t pinKey(SymbolId cell, SymbolId pin) 
+    { 
+      return (static_cast<uint64_t>(cell) << 32) | pin; 
+    }
+
+    /// ID of a new cell, invalidSymbol if the cell is already defined
+    SymbolId addCell(const std::string& cell);
+    const LibCell* findCell(const std::string& cell) const;
+    bool loadFile(const char* datFile, const std::unordered_set<std::string>& cells,
+                  LibFileInfo& info, bool& fromCache);
+    /// Parse datFile, a .dat or a Liberty file
+    bool readFile(const char* datFile, const std::unordered_set<std::string>& cells,
+                  LibFileInfo& info);
+    void merge(LibData& part, const LibFileInfo& info, const char* datFile,
+               std::unordered_map<std::string, const char*>& cellFiles);
+    void buildIndex();
+
   private:
     double    _delayRiseThres = 50;
     double    _delayFallThres = 50;
@@ -383,13 +637,22 @@ class LibData {
     double    _transitionFallHighThres = 90;
     double    _transitionFallLowThres = 10;
     double    _voltage = 0;
+    TableArena _tables;
     NLDMLUT   _riseDriverWaveform;
     NLDMLUT   _fallDriverWaveform;
-    std::unordered_map<std::string, std::vector<NLDMArc>>      _nldmData;
-    std::unordered_map<std::string, std::vector<CCSArc>>       _ccsData;
-    std::unordered_map<std::string, std::vector<FixedLoadCap>> _loadCaps;
+    SymbolTable          _cellNames;
+    SymbolTable          _pinNames;
+    /// Indexed by cell ID
+    std::vector<LibCell> _cells;
+    /// Positions in LibCell vectors, built by buildIndex() after reading
+    std::unordered_map<uint64_t, uint32_t>             _pinCapIndex;
+    std::unordered_map<ArcKey, uint32_t, HashArcKey>   _nldmArcIndex;
+    std::unordered_map<ArcKey, uint32_t, HashArcKey>   _ccsArcIndex;
+    std::unordered_map<uint64_t, std::vector<SymbolId>> _arcInputPins;
 
   friend class LibReader;
+  friend class LibertyReader;
+  friend class LibCache;
 };
 
 }
@@ -0,0 +1,1012 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "LibertyReader.h"
+#include "LibCache.h"
+#include "LibData.h"
+
+namespace NA {
+
+/// "name : value ;" has one value, "name (v1, v2) ;" has the values
+/// in parentheses, quotes are removed
+struct LibertyAttr {
+  std::string_view              _name;
+  std::vector<std::string_view> _values;
+};
+
+/// "type (args) { ... }", all text is a view of the mapped file
+struct LibertyGroup {
+  std::string_view              _type;
+  std::vector<std::string_view> _args;
+  std::vector<LibertyAttr>      _attrs;
+  std::vector<LibertyGroup>     _groups;
+
+  const LibertyAttr* attr(std::string_view name) const
+  {
+    for (const LibertyAttr& attr : _attrs) {
+      if (attr._name == name) {
+        return &attr;
+      }
+    }
+    return nullptr;
+  }
+  std::string_view value(std::string_view name) const
+  {
+    const LibertyAttr* found = attr(name);
+    if (found == nullptr || found->_values.empty()) {
+      return std::string_view();
+    }
+    return found->_values[0];
+  }
+  const LibertyGroup* group(std::string_view type) const
+  {
+    for (const LibertyGroup& group : _groups) {
+      if (group._type == type) {
+        return &group;
+      }
+    }
+    return nullptr;
+  }
+  std::string_view arg() const { return _args.empty() ? std::string_view() : _args[0]; }
+};
+
+/// Bytes of a cell group from the first byte after "{" to the byte after
+/// the matching "}"
+struct LibertyCellRange {
+  std::string_view _name;
+  size_t           _begin;
+  size_t           _end;
+};
+
+enum class LibertyTokenType {
+  Word,
+  String,
+  Punct,
+  End,
+};
+
+struct LibertyToken {
+  LibertyTokenType _type = LibertyTokenType::End;
+  std::string_view _text;
+  size_t           _offset = 0;
+
+  bool isPunct(char c) const { return _type == LibertyTokenType::Punct && _text[0] == c; }
+  bool isValue() const { return _type == LibertyTokenType::Word || _type == LibertyTokenType::String; }
+};
+
+static inline bool
+isSpace(char c)
+{
+  /// A backslash continues a line
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\\';
+}
+
+static inline bool
+isPunct(char c)
+{
+  return c == '(' || c == ')' || c == '{' || c == '}' ||
+         c == ':' || c == ';' || c == ',';
+}
+
+class LibertyLexer {
+  public:
+    LibertyLexer(const char* data, size_t begin, size_t end)
+    : _data(data), _pos(begin), _end(end) {}
+
+    LibertyToken next()
+    {
+      skipSpace();
+      LibertyToken token;
+      token._offset = _pos;
+      if (_pos >= _end) {
+        return token;
+      }
+      char c = _data[_pos];
+      if (isPunct(c)) {
+        token._type = LibertyTokenType::Punct;
+        token._text = std::string_view(_data + _pos, 1);
+        ++_pos;
+      } else if (c == '"') {
+        size_t begin = ++_pos;
+        while (_pos < _end && _data[_pos] != '"') {
+          _pos += (_data[_pos] == '\\') ? 2 : 1;
+        }
+        token._type = LibertyTokenType::String;
+        token._text = std::string_view(_data + begin, std::min(_pos, _end) - begin);
+        ++_pos;
+      } else {
+        size_t begin = _pos;
+        while (_pos < _end && isSpace(_data[_pos]) == false &&
+               isPunct(_data[_pos]) == false && _data[_pos] != '"') {
+          ++_pos;
+        }
+        token._type = LibertyTokenType::Word;
+        token._text = std::string_view(_data + begin, _pos - begin);
+      }
+      return token;
+    }
+
+    LibertyToken peek()
+    {
+      size_t pos = _pos;
+      LibertyToken token = next();
+      _pos = pos;
+      return token;
+    }
+
+    /// Move to the byte after the "}" matching the "{" just read, without
+    /// looking at anything but braces, strings and comments
+    bool skipGroup()
+    {
+      static const SpecialChars special;
+      size_t depth = 1;
+      const char* p = _data + _pos;
+      const char* end = _data + _end;
+      while (p < end) {
+        while (p < end && special._table[static_cast<unsigned char>(*p)] == false) {
+          ++p;
+        }
+        if (p >= end) {
+          break;
+        }
+        char c = *p;
+        if (c == '{') {
+          ++depth;
+        } else if (c == '}') {
+          if (--depth == 0) {
+            _pos = p + 1 - _data;
+            return true;
+          }
+        } else if (c == '"') {
+          /// Strings hold most of the bytes of a library, find their end
+          /// with memchr, a quote after a backslash does not end it
+          do {
+            const void* quote = memchr(p + 1, '"', end - p - 1);
+            p = quote ? static_cast<const char*>(quote) : end;
+          } while (p < end && p[-1] == '\\');
+        } else if (p + 1 < end && p[1] == '*') {
+          p = skipComment(p, end) - 1;
+        }
+        ++p;
+      }
+      _pos = _end;
+      return false;
+    }
+
+    size_t offset() const { return _pos; }
+
+  private:
+    struct SpecialChars {
+      bool _table[256] = {};
+      SpecialChars()
+      {
+        for (char c : {'{', '}', '"', '/'}) {
+          _table[static_cast<unsigned char>(c)] = true;
+        }
+      }
+    };
+
+    static const char* skipComment(const char* p, const char* end)
+    {
+      p += 2;
+      while (p + 1 < end && (p[0] != '*' || p[1] != '/')) {
+        ++p;
+      }
+      return std::min(p + 2, end);
+    }
+
+    void skipSpace()
+    {
+      while (_pos < _end) {
+        char c = _data[_pos];
+        if (isSpace(c)) {
+          ++_pos;
+        } else if (c == '/' && _pos + 1 < _end && _data[_pos+1] == '*') {
+          _pos = skipComment(_data + _pos, _data + _end) - _data;
+        } else {
+          break;
+        }
+      }
+    }
+
+  private:
+    const char* _data;
+    size_t      _pos;
+    size_t      _end;
+};
+
+static void
+syntaxError(const char* file, const char* data, size_t offset)
+{
+  size_t line = 1 + std::count(data, data + offset, '\n');
+  printf("ERROR: Syntax error in %s line %lu\n", file, line);
+}
+
+/// Parse statements into group until its closing "}", or until the end of
+/// the input for the top level (depth 0). Cell groups inside the library
+/// group are skipped and recorded in cells if cells is not null.
+static bool
+parseGroupBody(LibertyLexer& lex, LibertyGroup& group, size_t depth,
+               std::vector<LibertyCellRange>* cells, const char* file, const char* data)
+{
+  while (true) {
+    LibertyToken token = lex.next();
+    if (token._type == LibertyTokenType::End) {
+      if (depth > 0) {
+        syntaxError(file, data, token._offset);
+        return false;
+      }
+      return true;
+    }
+    if (token.isPunct('}') && depth > 0) {
+      return true;
+    }
+    if (token.isPunct(';')) {
+      continue;
+    }
+    if (token._type != LibertyTokenType::Word) {
+      syntaxError(file, data, token._offset);
+      return false;
+    }
+    LibertyToken sep = lex.next();
+    if (sep.isPunct(':')) {
+      LibertyToken value = lex.next();
+      if (value.isValue() == false) {
+        syntaxError(file, data, value._offset);
+        return false;
+      }
+      group._attrs.push_back(LibertyAttr{token._text, {value._text}});
+      continue;
+    }
+    if (sep.isPunct('(') == false) {
+      syntaxError(file, data, sep._offset);
+      return false;
+    }
+    std::vector<std::string_view> args;
+    while (true) {
+      LibertyToken arg = lex.next();
+      if (arg.isPunct(')')) {
+        break;
+      }
+      if (arg.isPunct(',')) {
+        continue;
+      }
+      if (arg.isValue() == false) {
+        syntaxError(file, data, arg._offset);
+        return false;
+      }
+      args.push_back(arg._text);
+    }
+    if (lex.peek().isPunct('{') == false) {
+      group._attrs.push_back(LibertyAttr{token._text, std::move(args)});
+      continue;
+    }
+    lex.next();
+    if (cells && depth == 1 && token._text == "cell") {
+      size_t begin = lex.offset();
+      if (lex.skipGroup() == false) {
+        syntaxError(file, data, begin);
+        return false;
+      }
+      cells->push_back(LibertyCellRange{args.empty() ? std::string_view() : args[0],
+                                        begin, lex.offset()});
+      continue;
+    }
+    group._groups.emplace_back();
+    LibertyGroup& child = group._groups.back();
+    child._type = token._text;
+    child._args = std::move(args);
+    if (parseGroupBody(lex, child, depth + 1, cells, file, data) == false) {
+      return false;
+    }
+  }
+}
+
+/// Append the numbers in text to values, anything that can not start a
+/// number separates them
+static void
+parseNumbers(std::string_view text, double scale, std::vector<double>& values)
+{
+  const char* p = text.data();
+  const char* end = p + text.size();
+  while (p < end) {
+    while (p < end && (*p < '0' || *p > '9') && *p != '-' && *p != '+' && *p != '.') {
+      ++p;
+    }
+    if (p >= end) {
+      break;
+    }
+    /// from_chars does not take a leading "+"
+    if (*p == '+') {
+      ++p;
+    }
+    double value = 0;
+    std::from_chars_result result = std::from_chars(p, end, value);
+    if (result.ec != std::errc()) {
+      ++p;
+      continue;
+    }
+    values.push_back(value * scale);
+    p = result.ptr;
+  }
+}
+
+static double
+parseNumber(std::string_view text, double defaultValue)
+{
+  std::vector<double> values;
+  parseNumbers(text, 1, values);
+  return values.empty() ? defaultValue : values[0];
+}
+
+/// Scale of a unit like "1ns", "1mV" or "ff"
+static double
+unitScale(std::string_view text)
+{
+  double number = 1;
+  size_t pos = 0;
+  while (pos < text.size() && (isdigit(text[pos]) || text[pos] == '.' ||
+         text[pos] == 'e' || text[pos] == '-' || text[pos] == '+')) {
+    ++pos;
+  }
+  if (pos > 0) {
+    number = parseNumber(text.substr(0, pos), 1);
+  }
+  std::string_view suffix = text.substr(pos);
+  if (suffix.size() < 2) {
+    return number;
+  }
+  switch (tolower(suffix[0])) {
+    case 'f': return number * 1e-15;
+    case 'p': return number * 1e-12;
+    case 'n': return number * 1e-9;
+    case 'u': return number * 1e-6;
+    case 'm': return number * 1e-3;
+    case 'k': return number * 1e3;
+    default: return number;
+  }
+}
+
+enum class LibertyVar {
+  None,
+  Transition,
+  Load,
+  Time,
+  InputVoltage,
+  OutputVoltage,
+  NormalizedVoltage,
+  Other,
+};
+
+static LibertyVar
+libertyVar(std::string_view name)
+{
+  if (name == "input_net_transition" || name == "input_transition_time") {
+    return LibertyVar::Transition;
+  } else if (name == "total_output_net_capacitance") {
+    return LibertyVar::Load;
+  } else if (name == "time") {
+    return LibertyVar::Time;
+  } else if (name == "input_voltage") {
+    return LibertyVar::InputVoltage;
+  } else if (name == "output_voltage") {
+    return LibertyVar::OutputVoltage;
+  } else if (name == "normalized_voltage") {
+    return LibertyVar::NormalizedVoltage;
+  }
+  return LibertyVar::Other;
+}
+
+static const char* const indexNames[3] = {"index_1", "index_2", "index_3"};
+
+struct LibertyTemplate {
+  LibertyVar          _vars[3] = {LibertyVar::None, LibertyVar::None, LibertyVar::None};
+  /// Not scaled, the unit depends on the variable
+  std::vector<double> _index[3];
+};
+
+/// Library wide data needed to read the cells
+struct LibertyContext {
+  const char*  _file = nullptr;
+  double       _timeUnit = 1e-9;
+  double       _voltageUnit = 1;
+  double       _currentUnit = 1e-3;
+  double       _capUnit = 1e-12;
+  /// Normalized voltages are scaled by the library voltage
+  double       _voltage = 0;
+  TableArena*  _arena = nullptr;
+  std::unordered_map<std::string_view, LibertyTemplate> _templates;
+
+  double scale(LibertyVar var) const
+  {
+    switch (var) {
+      case LibertyVar::Transition:
+      case LibertyVar::Time:
+        return _timeUnit;
+      case LibertyVar::Load:
+        return _capUnit;
+      case LibertyVar::InputVoltage:
+      case LibertyVar::OutputVoltage:
+        return _voltageUnit;
+      case LibertyVar::NormalizedVoltage:
+        return _voltage;
+      default:
+        return 1;
+    }
+  }
+};
+
+/// Variables and scaled indices of a table, indices the table does not
+/// define come from its template
+static void
+tableAxes(const LibertyContext& ctx, const LibertyGroup& table,
+          LibertyVar vars[3], std::vector<double> index[3])
+{
+  const LibertyTemplate* tmpl = nullptr;
+  const auto& found = ctx._templates.find(table.arg());
+  if (found != ctx._templates.end()) {
+    tmpl = &(found->second);
+  }
+  for (size_t i=0; i<3; ++i) {
+    vars[i] = tmpl ? tmpl->_vars[i] : LibertyVar::None;
+    index[i].clear();
+    const LibertyAttr* attr = table.attr(indexNames[i]);
+    if (attr) {
+      for (std::string_view text : attr->_values) {
+        parseNumbers(text, 1, index[i]);
+      }
+    } else if (tmpl) {
+      index[i] = tmpl->_index[i];
+    }
+    double scale = ctx.scale(vars[i]);
+    for (double& v : index[i]) {
+      v *= scale;
+    }
+  }
+}
+
+static void
+tableValues(const LibertyGroup& table, double scale, std::vector<double>& values)
+{
+  values.clear();
+  const LibertyAttr* attr = table.attr("values");
+  if (attr) {
+    for (std::string_view text : attr->_values) {
+      parseNumbers(text, scale, values);
+    }
+  }
+}
+
+/// Fill lut with table, var1 on the first axis and var2 on the second one
+/// whatever the order of the template. A table without one of the
+/// variables, or with a single point on an axis, is constant along it.
+static bool
+readTable(const LibertyContext& ctx, const LibertyGroup& table, LibertyVar var1, LibertyVar var2,
+          double valueScale, NLDMLUT& lut, const std::string& cellName)
+{
+  LibertyVar vars[3];
+  std::vector<double> index[3];
+  tableAxes(ctx, table, vars, index);
+  bool transpose = false;
+  if (vars[0] == var2 || vars[1] == var1) {
+    transpose = true;
+    std::swap(vars[0], vars[1]);
+    std::swap(index[0], index[1]);
+  }
+  if ((vars[0] != var1 && vars[0] != LibertyVar::None) ||
+      (vars[1] != var2 && vars[1] != LibertyVar::None)) {
+    printf("WARNING: Table %s of cell %s in %s has unsupported variables, ignored\n",
+           std::string(table._type).data(), cellName.data(), ctx._file);
+    return false;
+  }
+  std::vector<double> values;
+  tableValues(table, valueScale, values);
+  for (size_t i=0; i<2; ++i) {
+    if (vars[i] == LibertyVar::None || index[i].empty()) {
+      index[i].assign(1, 0);
+    }
+  }
+  size_t dim1 = index[0].size();
+  size_t dim2 = index[1].size();
+  if (values.size() != dim1 * dim2) {
+    printf("ERROR: Table %s of cell %s in %s has %lu x %lu indices and %lu values\n",
+           std::string(table._type).data(), cellName.data(), ctx._file,
+           dim1, dim2, values.size());
+    return false;
+  }
+  /// Interpolation needs two points on each axis
+  size_t rep1 = (dim1 == 1) ? 2 : 1;
+  size_t rep2 = (dim2 == 1) ? 2 : 1;
+  std::vector<double> lutValues;
+  lutValues.reserve(dim1 * rep1 * dim2 * rep2);
+  for (size_t i=0; i<dim1 * rep1; ++i) {
+    for (size_t j=0; j<dim2 * rep2; ++j) {
+      size_t i1 = i / rep1;
+      size_t i2 = j / rep2;
+      lutValues.push_back(transpose ? values[i2 * dim1 + i1] : values[i1 * dim2 + i2]);
+    }
+  }
+  for (size_t i=0; i<2; ++i) {
+    if (index[i].size() == 1) {
+      index[i].push_back(index[i][0] + 1);
+    }
+  }
+  lut.init(*ctx._arena, index[0], index[1], lutValues);
+  return lut.empty() == false;
+}
+
+/// One waveform of a CCS current or CCSN voltage group
+struct LibertyVector {
+  double              _referenceTime = 0;
+  double              _inputTran = 0;
+  double              _outputLoad = 0;
+  std::vector<double> _times;
+  std::vector<double> _values;
+};
+
+static bool
+readVector(const LibertyContext& ctx, const LibertyGroup& vec, double valueScale,
+           LibertyVector& data, const std::string& cellName)
+{
+  LibertyVar vars[3];
+  std::vector<double> index[3];
+  tableAxes(ctx, vec, vars, index);
+  if (vars[0] == LibertyVar::None) {
+    /// The usual order when the template is not known
+    vars[0] = LibertyVar::Transition;
+    vars[1] = LibertyVar::Load;
+    vars[2] = LibertyVar::Time;
+    for (size_t i=0; i<3; ++i) {
+      double scale = ctx.scale(vars[i]);
+      for (double& v : index[i]) {
+        v *= scale;
+      }
+    }
+  }
+  bool hasTime = false;
+  for (size_t i=0; i<3; ++i) {
+    if (vars[i] == LibertyVar::Time) {
+      data._times = index[i];
+      hasTime = true;
+    } else if (index[i].empty() == false) {
+      if (vars[i] == LibertyVar::Transition) {
+        data._inputTran = index[i][0];
+      } else if (vars[i] == LibertyVar::Load) {
+        data._outputLoad = index[i][0];
+      }
+    }
+  }
+  tableValues(vec, valueScale, data._values);
+  if (hasTime == false || data._times.size() != data._values.size()) {
+    printf("ERROR: Vector of cell %s in %s has %lu times and %lu values\n",
+           cellName.data(), ctx._file, data._times.size(), data._values.size());
+    return false;
+  }
+  data._referenceTime = parseNumber(vec.value("reference_time"), 0) * ctx._timeUnit;
+  return true;
+}
+
+static void
+readCurrents(const LibertyContext& ctx, const LibertyGroup& group, CCSGroup& currents,
+             const std::string& cellName)
+{
+  LibertyVector data;
+  for (const LibertyGroup& vec : group._groups) {
+    if (vec._type != "vector" ||
+        readVector(ctx, vec, ctx._currentUnit, data, cellName) == false) {
+      continue;
+    }
+    CCSLUT lut;
+    lut.init(*ctx._arena, data._referenceTime, data._inputTran, data._outputLoad,
+             data._times, data._values);
+    currents.addLUT(lut);
+  }
+  currents.sortTable();
+}
+
+static void
+readOutputVoltages(const LibertyContext& ctx, const LibertyGroup& group,
+                   CCBOutputVoltage& voltages, const std::string& cellName)
+{
+  LibertyVector data;
+  for (const LibertyGroup& vec : group._groups) {
+    if (vec._type != "vector" ||
+        readVector(ctx, vec, ctx._voltageUnit, data, cellName) == false) {
+      continue;
+    }
+    CCBOutputVoltageLUT lut;
+    lut.init(*ctx._arena, data._inputTran, data._outputLoad, data._times, data._values);
+    voltages.addLUT(lut);
+  }
+  voltages.sortTable();
+}
+
+static void
+readCCBStage(const LibertyContext& ctx, const LibertyGroup& stage, CCBData& data,
+             const std::string& cellName)
+{
+  data.setMillerCaps(parseNumber(stage.value("miller_cap_rise"), 0) * ctx._capUnit,
+                     parseNumber(stage.value("miller_cap_fall"), 0) * ctx._capUnit);
+  const LibertyGroup* dcCurrent = stage.group("dc_current");
+  if (dcCurrent) {
+    readTable(ctx, *dcCurrent, LibertyVar::InputVoltage, LibertyVar::OutputVoltage,
+              ctx._currentUnit, data.getDcCurrent(), cellName);
+  }
+  const LibertyGroup* riseVoltage = stage.group("output_voltage_rise");
+  if (riseVoltage) {
+    readOutputVoltages(ctx, *riseVoltage, data.getRiseOutputVoltage(), cellName);
+  }
+  const LibertyGroup* fallVoltage = stage.group("output_voltage_fall");
+  if (fallVoltage) {
+    readOutputVoltages(ctx, *fallVoltage, data.getFallOutputVoltage(), cellName);
+  }
+}
+
+static void
+readRecvCaps(const LibertyContext& ctx, const LibertyGroup& group, const char* edge,
+             std::vector<NLDMLUT>& caps, const std::string& cellName)
+{
+  std::vector<NLDMLUT> luts;
+  for (const char* which : {"receiver_capacitance1_", "receiver_capacitance2_"}) {
+    const LibertyGroup* table = group.group(std::string(which) + edge);
+    if (table == nullptr) {
+      continue;
+    }
+    NLDMLUT lut;
+    if (readTable(ctx, *table, LibertyVar::Transition, LibertyVar::Load,
+                  ctx._capUnit, lut, cellName)) {
+      luts.push_back(lut);
+    }
+  }
+  if (luts.empty() == false) {
+    caps = luts;
+  }
+}
+
+/// Timing checks and other arcs that are not cell delays
+static bool
+isDelayArc(std::string_view timingType)
+{
+  static const char* const checks[] = {"setup", "hold", "recovery", "removal", "skew",
+                                       "non_seq", "nochange", "min_", "max_", "minimum_"};
+  for (const char* check : checks) {
+    if (timingType.compare(0, strlen(check), check) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static void
+splitPins(std::string_view text, std::vector<std::string>& pins)
+{
+  pins.clear();
+  size_t pos = 0;
+  while (pos < text.size()) {
+    while (pos < text.size() && isSpace(text[pos])) {
+      ++pos;
+    }
+    size_t begin = pos;
+    while (pos < text.size() && isSpace(text[pos]) == false) {
+      ++pos;
+    }
+    if (pos > begin) {
+      pins.emplace_back(text.substr(begin, pos - begin));
+    }
+  }
+}
+
+static void
+readCell(const LibertyContext& ctx, const LibertyGroup& cellGroup, const std::string& cellName,
+         LibData* owner, LibCell& cell)
+{
+  std::unordered_map<std::string_view, const LibertyGroup*> pins;
+  for (const LibertyGroup& group : cellGroup._groups) {
+    if (group._type == "pin") {
+      for (std::string_view pinName : group._args) {
+        pins.insert({pinName, &group});
+      }
+    }
+  }
+
+  std::vector<NLDMArc> nldmArcs;
+  std::vector<CCSArc> ccsArcs;
+  std::vector<std::string> relatedPins;
+  for (const auto& kv : pins) {
+    std::string pinName(kv.first);
+    const LibertyGroup& pin = *kv.second;
+    std::string_view direction = pin.value("direction");
+    if (direction == "input" || direction == "inout") {
+      double cap = parseNumber(pin.value("capacitance"), 0);
+      FixedLoadCap pinCap;
+      pinCap.setPinName(pinName);
+      pinCap.setCaps(parseNumber(pin.value("rise_capacitance"), cap) * ctx._capUnit,
+                     parseNumber(pin.value("fall_capacitance"), cap) * ctx._capUnit);
+      cell._loadCaps.push_back(pinCap);
+    }
+
+    for (const LibertyGroup& timing : pin._groups) {
+      if (timing._type != "timing" || isDelayArc(timing.value("timing_type")) == false) {
+        continue;
+      }
+      bool isInverted = (timing.value("timing_sense") == "negative_unate");
+      splitPins(timing.value("related_pin"), relatedPins);
+      for (const std::string& fromPin : relatedPins) {
+        /// Arcs split into several timing groups, e.g. by timing_type
+        /// combinational_rise and combinational_fall, are merged and
+        /// the first table of each kind is used
+        NLDMArc* nldmArc = nullptr;
+        CCSArc* ccsArc = nullptr;
+        for (size_t i=0; i<nldmArcs.size(); ++i) {
+          if (nldmArcs[i].fromPin() == fromPin && nldmArcs[i].toPin() == pinName) {
+            nldmArc = &nldmArcs[i];
+            ccsArc = &ccsArcs[i];
+            break;
+          }
+        }
+        if (nldmArc == nullptr) {
+          nldmArcs.emplace_back(owner);
+          nldmArcs.back().setFromToPin(fromPin, pinName, isInverted);
+          ccsArcs.emplace_back(owner);
+          ccsArcs.back().reset();
+          ccsArcs.back().setFromToPin(fromPin, pinName, isInverted);
+          nldmArc = &nldmArcs.back();
+          ccsArc = &ccsArcs.back();
+        }
+
+        static const std::pair<const char*, LUTType> nldmTables[] = {
+          {"cell_rise", LUTType::RiseDelay},
+          {"cell_fall", LUTType::FallDelay},
+          {"rise_transition", LUTType::RiseTransition},
+          {"fall_transition", LUTType::FallTransition},
+        };
+        for (const auto& nameType : nldmTables) {
+          NLDMLUT& lut = nldmArc->getLUT(nameType.second);
+          const LibertyGroup* table = timing.group(nameType.first);
+          if (lut.empty() && table) {
+            readTable(ctx, *table, LibertyVar::Transition, LibertyVar::Load,
+                      ctx._timeUnit, lut, cellName);
+          }
+        }
+
+        const LibertyGroup* riseCurrent = timing.group("output_current_rise");
+        if (riseCurrent && ccsArc->getCurrent(LUTType::RiseCurrent).empty()) {
+          readCurrents(ctx, *riseCurrent, ccsArc->getCurrent(LUTType::RiseCurrent), cellName);
+        }
+        const LibertyGroup* fallCurrent = timing.group("output_current_fall");
+        if (fallCurrent && ccsArc->getCurrent(LUTType::FallCurrent).empty()) {
+          readCurrents(ctx, *fallCurrent, ccsArc->getCurrent(LUTType::FallCurrent), cellName);
+        }
+
+        /// Receiver caps and CCSN stages are in the timing group, or
+        /// in the input pin and the output pin for all arcs of the pins
+        const auto& foundRelated = pins.find(fromPin);
+        const LibertyGroup* relatedPin = (foundRelated != pins.end()) ? foundRelated->second : nullptr;
+        const LibertyGroup* recvCaps = &timing;
+        if (timing.group("receiver_capacitance1_rise") == nullptr && relatedPin) {
+          recvCaps = relatedPin->group("receiver_capacitance");
+        }
+        if (recvCaps) {
+          if (ccsArc->getRecvCap(LUTType::RiseRecvCap).empty()) {
+            readRecvCaps(ctx, *recvCaps, "rise", ccsArc->getRecvCap(LUTType::RiseRecvCap), cellName);
+          }
+          if (ccsArc->getRecvCap(LUTType::FallRecvCap).empty()) {
+            readRecvCaps(ctx, *recvCaps, "fall", ccsArc->getRecvCap(LUTType::FallRecvCap), cellName);
+          }
+        }
+        const LibertyGroup* firstStage = timing.group("ccsn_first_stage");
+        if (firstStage == nullptr && relatedPin) {
+          firstStage = relatedPin->group("ccsn_first_stage");
+        }
+        if (firstStage) {
+          readCCBStage(ctx, *firstStage, ccsArc->ccbFirstStageData(), cellName);
+        }
+        const LibertyGroup* lastStage = timing.group("ccsn_last_stage");
+        if (lastStage == nullptr) {
+          lastStage = pin.group("ccsn_last_stage");
+        }
+        if (lastStage) {
+          readCCBStage(ctx, *lastStage, ccsArc->ccbLastStageData(), cellName);
+        }
+      }
+    }
+  }
+
+  std::sort(cell._loadCaps.begin(), cell._loadCaps.end(),
+    [](const FixedLoadCap& a, const FixedLoadCap& b) {
+      return a.pinName() < b.pinName();
+    });
+  for (NLDMArc& arc : nldmArcs) {
+    if (arc.empty() == false) {
+      cell._nldmArcs.push_back(arc);
+    }
+  }
+  for (CCSArc& arc : ccsArcs) {
+    if (arc.empty() == false) {
+      cell._ccsArcs.push_back(arc);
+    }
+  }
+  std::sort(cell._nldmArcs.begin(), cell._nldmArcs.end(), SortArcDataByPin());
+  std::sort(cell._ccsArcs.begin(), cell._ccsArcs.end(), SortArcDataByPin());
+}
+
+bool
+LibertyReader::isLibertyFile(const std::string& file)
+{
+  for (const char* ext : {".lib", ".liberty"}) {
+    size_t size = strlen(ext);
+    if (file.size() >= size && file.compare(file.size() - size, size, ext) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+LibertyReader::readFile(const char* libFile, const std::unordered_set<std::string>& cells,
+                        LibFileInfo& info)
+{
+  /// Cells are picked by the netlist that reads the file, so there is
+  /// no binary cache for Liberty files
+  info._cacheable = false;
+  int fd = open(libFile, O_RDONLY);
+  if (fd < 0) {
+    printf("ERROR: Cannot open %s\n", libFile);
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    close(fd);
+    printf("ERROR: Cannot read %s\n", libFile);
+    return false;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) {
+    printf("ERROR: Cannot read %s\n", libFile);
+    return false;
+  }
+  std::shared_ptr<void> mapping(addr, [size](void* p) {
+    munmap(p, size);
+  });
+  madvise(addr, size, MADV_SEQUENTIAL);
+  const char* data = static_cast<const char*>(addr);
+
+  LibertyLexer lex(data, 0, size);
+  LibertyGroup root;
+  std::vector<LibertyCellRange> cellRanges;
+  if (parseGroupBody(lex, root, 0, &cellRanges, libFile, data) == false) {
+    return false;
+  }
+  const LibertyGroup* library = root.group("library");
+  if (library == nullptr) {
+    printf("ERROR: No library group in %s\n", libFile);
+    return false;
+  }
+
+  LibertyContext ctx;
+  ctx._file = libFile;
+  ctx._arena = &(_owner->_tables);
+  std::string_view unit = library->value("time_unit");
+  if (unit.empty() == false) {
+    ctx._timeUnit = unitScale(unit);
+  }
+  unit = library->value("voltage_unit");
+  if (unit.empty() == false) {
+    ctx._voltageUnit = unitScale(unit);
+  }
+  unit = library->value("current_unit");
+  if (unit.empty() == false) {
+    ctx._currentUnit = unitScale(unit);
+  }
+  const LibertyAttr* capUnit = library->attr("capacitive_load_unit");
+  if (capUnit && capUnit->_values.size() == 2) {
+    ctx._capUnit = parseNumber(capUnit->_values[0], 1) * unitScale(capUnit->_values[1]);
+  }
+
+  std::string_view value = library->value("nom_voltage");
+  if (value.empty() == false) {
+    _owner->_voltage = parseNumber(value, 0) * ctx._voltageUnit;
+    info._settings |= LibFileInfo::voltage;
+  }
+  ctx._voltage = _owner->_voltage;
+  static const struct {
+    const char* _name;
+    double LibData::* _member;
+    unsigned _setting;
+  } thresholds[] = {
+    {"slew_lower_threshold_pct_rise", &LibData::_transitionRiseLowThres, LibFileInfo::riseTransitionThres},
+    {"slew_upper_threshold_pct_rise", &LibData::_transitionRiseHighThres, LibFileInfo::riseTransitionThres},
+    {"slew_upper_threshold_pct_fall", &LibData::_transitionFallHighThres, LibFileInfo::fallTransitionThres},
+    {"slew_lower_threshold_pct_fall", &LibData::_transitionFallLowThres, LibFileInfo::fallTransitionThres},
+    {"output_threshold_pct_rise", &LibData::_delayRiseThres, LibFileInfo::delayThres},
+    {"output_threshold_pct_fall", &LibData::_delayFallThres, LibFileInfo::delayThres},
+  };
+  for (const auto& thres : thresholds) {
+    value = library->value(thres._name);
+    if (value.empty() == false) {
+      _owner->*(thres._member) = parseNumber(value, 0);
+      info._settings |= thres._setting;
+    }
+  }
+
+  for (const LibertyGroup& group : library->_groups) {
+    std::string_view type = group._type;
+    if (type.size() < 9 || type.compare(type.size() - 9, 9, "_template") != 0) {
+      continue;
+    }
+    LibertyTemplate& tmpl = ctx._templates[group.arg()];
+    for (size_t i=0; i<3; ++i) {
+      std::string varName = "variable_" + std::to_string(i+1);
+      std::string_view var = group.value(varName);
+      tmpl._vars[i] = var.empty() ? LibertyVar::None : libertyVar(var);
+      const LibertyAttr* index = group.attr(indexNames[i]);
+      if (index) {
+        for (std::string_view text : index->_values) {
+          parseNumbers(text, 1, tmpl._index[i]);
+        }
+      }
+    }
+  }
+
+  for (const LibertyGroup& group : library->_groups) {
+    if (group._type != "normalized_driver_waveform") {
+      continue;
+    }
+    if ((info._settings & LibFileInfo::voltage) == 0) {
+      info._needsPriorVoltage = true;
+    }
+    std::string_view name = group.value("driver_waveform_name");
+    bool isRise = name.empty() || name.find("fall") == std::string_view::npos;
+    bool isFall = name.empty() || name.find("rise") == std::string_view::npos;
+    NLDMLUT lut;
+    if (readTable(ctx, group, LibertyVar::Transition, LibertyVar::NormalizedVoltage,
+                  ctx._timeUnit, lut, std::string("library")) == false) {
+      continue;
+    }
+    /// A named waveform wins over the default one
+    if (isRise && (name.empty() == false ||
+        (info._settings & LibFileInfo::riseDriverWaveform) == 0)) {
+      _owner->_riseDriverWaveform = lut;
+      info._settings |= LibFileInfo::riseDriverWaveform;
+    }
+    if (isFall && (name.empty() == false ||
+        (info._settings & LibFileInfo::fallDriverWaveform) == 0)) {
+      _owner->_fallDriverWaveform = lut;
+      info._settings |= LibFileInfo::fallDriverWaveform;
+    }
+  }
+
+  for (const LibertyCellRange& range : cellRanges) {
+    std::string cellName(range._name);
+    if (cells.empty() == false && cells.find(cellName) == cells.end()) {
+      continue;
+    }
+    LibertyLexer cellLex(data, range._begin, range._end);
+    LibertyGroup cellGroup;
+    if (parseGroupBody(cellLex, cellGroup, 2, nullptr, libFile, data) == false) {
+      continue;
+    }
+    SymbolId cellId = _owner->addCell(cellName);
+    if (cellId == invalidSymbol) {
+      info._duplicateCells.push_back(cellName);
+      continue;
+    }
+    info._cells.push_back(cellName);
+    readCell(ctx, cellGroup, cellName, _owner, _owner->_cells[cellId]);
+  }
+  return true;
+}
+
+}
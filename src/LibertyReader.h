@@ -0,0 +1,36 @@
+#ifndef _NA_LIBERTYREADER_H_
+#define _NA_LIBERTYREADER_H_
+
+#include <string>
+#include <unordered_set>
+
+namespace NA {
+
+class LibData;
+struct LibFileInfo;
+
+/// Reads Liberty (.lib) files into LibData without converting them first.
+/// The file is mapped with mmap and scanned once, the library attributes
+/// and templates are parsed while every cell group is only skipped over
+/// with its byte range recorded. Then only the cells asked for are parsed
+/// from their ranges, so reading a few cells of a huge library costs one
+/// brace matching pass over the file.
+class LibertyReader {
+  public:
+    LibertyReader(LibData* owner)
+    : _owner(owner) {}
+
+    /// Read the cells in cells from libFile, all cells if cells is empty
+    bool readFile(const char* libFile, const std::unordered_set<std::string>& cells,
+                  LibFileInfo& info);
+
+    /// Files ending with .lib or .liberty are Liberty files
+    static bool isLibertyFile(const std::string& file);
+
+  private:
+    LibData* _owner;
+};
+
+}
+
+#endif
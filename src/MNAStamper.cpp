@@ -6,12 +6,20 @@
 
 namespace NA {
 
+double
+MNAStamper::sourceTime() const
+{
+  if (_BDFCoeff) {
+    return _simResult.currentTime() + simTick();
+  }
+  return _simResult.currentTime();
+}
+
 void
-MNAStamper::stampResistor(Eigen::MatrixXd& G, 
-                          Eigen::MatrixXd& /*C*/, 
+MNAStamper::stampResistor(StampMatrix& G, 
+                          StampMatrix& /*C*/, 
                           Eigen::VectorXd& /*b*/, 
-                          const Device& dev, 
-                          IntegrateMethod /*intMethod*/) const
+                          const Device& dev) const
 {
   double stampValue = 1.0 / dev._value;
   size_t posNodeIndex = _simResult.nodeVectorIndex(dev._posNode);
@@ -29,8 +37,9 @@ MNAStamper::stampResistor(Eigen::MatrixXd& G,
   }
 }
 
+template <>
 inline void
-MNAStamper::updatebCapacitorBE(Eigen::VectorXd& b, 
+MNAStamper::updatebCapacitor<IntegrateMethod::BackwardEuler>(Eigen::VectorXd& b, 
                                const Device& cap) const
 {
   double stampValue = cap._value / simTick();
@@ -51,9 +60,10 @@ MNAStamper::updatebCapacitorBE(Eigen::VectorXd& b,
   }
 }
 
+template <>
 inline void
-MNAStamper::stampCapacitorBE(Eigen::MatrixXd& /*G*/, 
-                             Eigen::MatrixXd& C, 
+MNAStamper::stampCapacitor<IntegrateMethod::BackwardEuler>(StampMatrix& /*G*/, 
+                             StampMatrix& C, 
                              Eigen::VectorXd& b, 
                              const Device& cap) const
 {
@@ -76,12 +86,13 @@ MNAStamper::stampCapacitorBE(Eigen::MatrixXd& /*G*/,
     C(negNodeIndex, posNodeIndex) -= stampValue;
   }
   if (isSDomain() == false) {
-    updatebCapacitorBE(b, cap);
+    updatebCapacitor<IntegrateMethod::BackwardEuler>(b, cap);
   }
 }
 
+template <>
 inline void
-MNAStamper::updatebCapacitorGear2(Eigen::VectorXd& b,
+MNAStamper::updatebCapacitor<IntegrateMethod::Gear2>(Eigen::VectorXd& b,
                                   const Device& cap) const
 {
   double baseValue =  cap._value / simTick();
@@ -106,9 +117,10 @@ MNAStamper::updatebCapacitorGear2(Eigen::VectorXd& b,
   }
 }
 
+template <>
 inline void
-MNAStamper::stampCapacitorGear2(Eigen::MatrixXd& /*G*/, 
-                                Eigen::MatrixXd& C,
+MNAStamper::stampCapacitor<IntegrateMethod::Gear2>(StampMatrix& /*G*/, 
+                                StampMatrix& C,
                                 Eigen::VectorXd& b, 
                                 const Device& cap) const
 {
@@ -126,11 +138,12 @@ MNAStamper::stampCapacitorGear2(Eigen::MatrixXd& /*G*/,
     C(posNodeIndex, negNodeIndex) -= stampValue;
     C(negNodeIndex, posNodeIndex) -= stampValue;
   }
-  updatebCapacitorGear2(b, cap);
+  updatebCapacitor<IntegrateMethod::Gear2>(b, cap);
 }
 
+template <>
 inline void
-MNAStamper::updatebCapacitorTrap(Eigen::VectorXd& b,
+MNAStamper::updatebCapacitor<IntegrateMethod::Trapezoidal>(Eigen::VectorXd& b,
                                  const Device& cap) const
 {
   double baseValue =  cap._value / simTick();
@@ -149,9 +162,10 @@ MNAStamper::updatebCapacitorTrap(Eigen::VectorXd& b,
   }
 }
 
+template <>
 inline void
-MNAStamper::stampCapacitorTrap(Eigen::MatrixXd& /*G*/,
-                               Eigen::MatrixXd& C,
+MNAStamper::stampCapacitor<IntegrateMethod::Trapezoidal>(StampMatrix& /*G*/,
+                               StampMatrix& C,
                                Eigen::VectorXd& b, 
                                const Device& cap) const
 {
@@ -169,57 +183,59 @@ MNAStamper::stampCapacitorTrap(Eigen::MatrixXd& /*G*/,
     C(posNodeIndex, negNodeIndex) -= stampValue;
     C(negNodeIndex, posNodeIndex) -= stampValue;
   }
-  updatebCapacitorTrap(b, cap);
+  updatebCapacitor<IntegrateMethod::Trapezoidal>(b, cap);
 }
 
+template <>
 inline void
-MNAStamper::stampCapacitor(Eigen::MatrixXd& G, Eigen::MatrixXd& C, 
-                           Eigen::VectorXd& b, const Device& cap,
-                           IntegrateMethod intMethod) const
+MNAStamper::updatebCapacitor<IntegrateMethod::BDF>(Eigen::VectorXd& b,
+                                const Device& cap) const
 {
-  if (isSDomain()) {
-    stampCapacitorBE(G, C, b, cap);
-    return;
-  }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      stampCapacitorBE(G, C, b, cap);
-      break;
-    case IntegrateMethod::Gear2:
-      stampCapacitorGear2(G, C, b, cap);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      stampCapacitorTrap(G, C, b, cap);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  double history = 0;
+  for (size_t j=1; j<=_BDFCoeff->_history; ++j) {
+    double voltageDiff = _simResult.nodeVoltageHistory(cap._posNode, j) - 
+                         _simResult.nodeVoltageHistory(cap._negNode, j);
+    history += _BDFCoeff->_alpha[j] * voltageDiff;
+  }
+  double stampValue = -cap._value * history;
+  size_t posNodeIndex = _simResult.nodeVectorIndex(cap._posNode);
+  size_t negNodeIndex = _simResult.nodeVectorIndex(cap._negNode);
+  if (isNodeOmitted(cap._posNode) == false) {
+    b(posNodeIndex) += stampValue;
+  } 
+  if (isNodeOmitted(cap._negNode) == false) {
+    b(negNodeIndex) += -stampValue;
   }
 }
 
+template <>
 inline void
-MNAStamper::updatebCapacitor(Eigen::VectorXd& b, const Device& cap, 
-                             IntegrateMethod intMethod) const
+MNAStamper::stampCapacitor<IntegrateMethod::BDF>(StampMatrix& /*G*/,
+                              StampMatrix& C,
+                              Eigen::VectorXd& b, 
+                              const Device& cap) const
 {
-  if (isSDomain()) {
-    return;
-  }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      updatebCapacitorBE(b, cap);
-      break;
-    case IntegrateMethod::Gear2:
-      updatebCapacitorGear2(b, cap);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      updatebCapacitorTrap(b, cap);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  double stampValue = _BDFCoeff->_alpha[0] * cap._value;
+  size_t posNodeIndex = _simResult.nodeVectorIndex(cap._posNode);
+  size_t negNodeIndex = _simResult.nodeVectorIndex(cap._negNode);
+  if (isNodeOmitted(cap._posNode) == false) {
+    C(posNodeIndex, posNodeIndex) += stampValue;
+  } 
+  if (isNodeOmitted(cap._negNode) == false) {
+    C(negNodeIndex, negNodeIndex) += stampValue;
   }
+  if (isNodeOmitted(cap._posNode) == false && isNodeOmitted(cap._negNode) == false) {
+    C(posNodeIndex, negNodeIndex) -= stampValue;
+    C(negNodeIndex, posNodeIndex) -= stampValue;
+  }
+  updatebCapacitor<IntegrateMethod::BDF>(b, cap);
 }
 
+
+
+template <>
 inline void
-MNAStamper::updatebInductorBE(Eigen::VectorXd& b,
+MNAStamper::updatebInductor<IntegrateMethod::BackwardEuler>(Eigen::VectorXd& b,
                               const Device& ind) const
 {
   double stampValue = ind._value / simTick();
@@ -229,9 +245,10 @@ MNAStamper::updatebInductorBE(Eigen::VectorXd& b,
   b(deviceIndex) += bValue;
 }
 
+template <>
 inline void
-MNAStamper::stampInductorBE(Eigen::MatrixXd& G, 
-                            Eigen::MatrixXd& C, 
+MNAStamper::stampInductor<IntegrateMethod::BackwardEuler>(StampMatrix& G, 
+                            StampMatrix& C, 
                             Eigen::VectorXd& b, 
                             const Device& ind) const
 {
@@ -254,12 +271,13 @@ MNAStamper::stampInductorBE(Eigen::MatrixXd& G,
   }
   C(deviceIndex, deviceIndex) += -stampValue;
   if (isSDomain() == false) {
-    updatebInductorBE(b, ind);
+    updatebInductor<IntegrateMethod::BackwardEuler>(b, ind);
   }
 }
 
+template <>
 inline void
-MNAStamper::updatebInductorGear2(Eigen::VectorXd& b,
+MNAStamper::updatebInductor<IntegrateMethod::Gear2>(Eigen::VectorXd& b,
                                  const Device& ind) const
 {
   double baseValue = ind._value / simTick();
@@ -270,9 +288,10 @@ MNAStamper::updatebInductorGear2(Eigen::VectorXd& b,
   b(deviceIndex) += stampValue;
 }
 
+template <>
 inline void
-MNAStamper::stampInductorGear2(Eigen::MatrixXd& /*G*/,
-                               Eigen::MatrixXd& C, 
+MNAStamper::stampInductor<IntegrateMethod::Gear2>(StampMatrix& /*G*/,
+                               StampMatrix& C, 
                                Eigen::VectorXd& b, 
                                const Device& ind) const
 {
@@ -290,11 +309,12 @@ MNAStamper::stampInductorGear2(Eigen::MatrixXd& /*G*/,
     C(deviceIndex, negNodeIndex) += -1;
   }
   C(deviceIndex, deviceIndex) += -stampValue;
-  updatebInductorGear2(b, ind);
+  updatebInductor<IntegrateMethod::Gear2>(b, ind);
 }
 
+template <>
 inline void
-MNAStamper::updatebInductorTrap(Eigen::VectorXd& b,
+MNAStamper::updatebInductor<IntegrateMethod::Trapezoidal>(Eigen::VectorXd& b,
                                 const Device& ind) const
 {
   double baseValue = ind._value / simTick();
@@ -305,9 +325,10 @@ MNAStamper::updatebInductorTrap(Eigen::VectorXd& b,
   b(deviceIndex) += stampValue;
 }
 
+template <>
 inline void
-MNAStamper::stampInductorTrap(Eigen::MatrixXd& /*G*/,
-                              Eigen::MatrixXd& C,
+MNAStamper::stampInductor<IntegrateMethod::Trapezoidal>(StampMatrix& /*G*/,
+                              StampMatrix& C,
                               Eigen::VectorXd& b, 
                               const Device& ind) const
 {
@@ -325,81 +346,66 @@ MNAStamper::stampInductorTrap(Eigen::MatrixXd& /*G*/,
     C(deviceIndex, negNodeIndex) += -1;
   }
   C(deviceIndex, deviceIndex) += -stampValue;
-  updatebInductorTrap(b, ind);
+  updatebInductor<IntegrateMethod::Trapezoidal>(b, ind);
 }
 
+template <>
 inline void
-MNAStamper::stampInductor(Eigen::MatrixXd& G, Eigen::MatrixXd& C,
-                          Eigen::VectorXd& b, const Device& ind, 
-                          IntegrateMethod intMethod) const
+MNAStamper::updatebInductor<IntegrateMethod::BDF>(Eigen::VectorXd& b,
+                               const Device& ind) const
 {
-  if (isSDomain()) {
-    stampInductorBE(G, C, b, ind);
-    return;
-  }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      stampInductorBE(G, C, b, ind);
-      break;
-    case IntegrateMethod::Gear2:
-      stampInductorGear2(G, C, b, ind);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      stampInductorTrap(G, C, b, ind);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  double history = 0;
+  for (size_t j=1; j<=_BDFCoeff->_history; ++j) {
+    history += _BDFCoeff->_alpha[j] * _simResult.deviceCurrentHistory(ind._devId, j);
   }
+  size_t deviceIndex = _simResult.deviceVectorIndex(ind._devId);
+  b(deviceIndex) += ind._value * history;
 }
 
+template <>
 inline void
-MNAStamper::updatebInductor(Eigen::VectorXd& b, const Device& ind, 
-                            IntegrateMethod intMethod) const
+MNAStamper::stampInductor<IntegrateMethod::BDF>(StampMatrix& G,
+                             StampMatrix& C,
+                             Eigen::VectorXd& b, 
+                             const Device& ind) const
 {
-  if (isSDomain()) {
-    return;
-  }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      updatebInductorBE(b, ind);
-      break;
-    case IntegrateMethod::Gear2:
-      updatebInductorGear2(b, ind);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      updatebInductorTrap(b, ind);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  double stampValue = _BDFCoeff->_alpha[0] * ind._value;
+  size_t posNodeIndex = _simResult.nodeVectorIndex(ind._posNode);
+  size_t negNodeIndex = _simResult.nodeVectorIndex(ind._negNode);
+  size_t deviceIndex = _simResult.deviceVectorIndex(ind._devId);
+  if (isNodeOmitted(ind._posNode) == false) {
+    G(posNodeIndex, deviceIndex) += 1;
+    G(deviceIndex, posNodeIndex) += 1;
+  }
+  if (isNodeOmitted(ind._negNode) == false) {
+    G(negNodeIndex, deviceIndex) += -1;
+    G(deviceIndex, negNodeIndex) += -1;
   }
+  C(deviceIndex, deviceIndex) += -stampValue;
+  updatebInductor<IntegrateMethod::BDF>(b, ind);
 }
 
+
+
 inline void
 MNAStamper::updatebVoltageSource(Eigen::VectorXd& b,
-                                 const Device& dev,
-                                 IntegrateMethod /*intMethod*/) const
+                                 const Device& dev) const
 {
   double value;
   if (isSDomain()) {
     value = 1 * _circuit.scalingFactor();
   } else {
-    if (dev._isPWLValue) {
-      const PWLValue& pwlData = _circuit.PWLData(dev);
-      value = pwlData.valueAtTime(_simResult.currentTime());
-    } else {
-      value = dev._value;
-    }
+    value = _simResult.sourceValue(dev, sourceTime());
   }
   size_t deviceIndex = _simResult.deviceVectorIndex(dev._devId);
   b(deviceIndex) += value;
 }
 
 inline void
-MNAStamper::stampVoltageSource(Eigen::MatrixXd& G, 
-                               Eigen::MatrixXd& /*C*/,
+MNAStamper::stampVoltageSource(StampMatrix& G, 
+                               StampMatrix& /*C*/,
                                Eigen::VectorXd& b, 
-                               const Device& dev,
-                               IntegrateMethod /*intMethod*/) const
+                               const Device& dev) const
 {
   size_t posNodeIndex = _simResult.nodeVectorIndex(dev._posNode);
   size_t negNodeIndex = _simResult.nodeVectorIndex(dev._negNode);
@@ -417,16 +423,10 @@ MNAStamper::stampVoltageSource(Eigen::MatrixXd& G,
 
 inline void
 MNAStamper::updatebCurrentSource(Eigen::VectorXd& b,
-                                 const Device& dev,
-                                 IntegrateMethod /*intMethod*/) const
+                                 const Device& dev) const
 {
   double value;
-  if (dev._isPWLValue) {
-    const PWLValue& pwlData = _circuit.PWLData(dev);
-    value = pwlData.valueAtTime(_simResult.currentTime());
-  } else {
-    value = dev._value;
-  }
+  value = _simResult.sourceValue(dev, sourceTime());
   if (isSDomain()) {
     value = 1 * _circuit.scalingFactor();
   }
@@ -441,21 +441,19 @@ MNAStamper::updatebCurrentSource(Eigen::VectorXd& b,
 }
 
 inline void
-MNAStamper::stampCurrentSource(Eigen::MatrixXd& /*G*/, 
-                               Eigen::MatrixXd& /*C*/, 
+MNAStamper::stampCurrentSource(StampMatrix& /*G*/, 
+                               StampMatrix& /*C*/, 
                                Eigen::VectorXd& b, 
-                               const Device& dev,
-                               IntegrateMethod /*intMethod*/) const
+                               const Device& dev) const
 {
   updatebCurrentSource(b, dev);
 }
 
 inline void
-MNAStamper::stampCCVS(Eigen::MatrixXd& G, 
-                      Eigen::MatrixXd& /*C*/, 
+MNAStamper::stampCCVS(StampMatrix& G, 
+                      StampMatrix& /*C*/, 
                       Eigen::VectorXd& /*b*/, 
-                      const Device& dev, 
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   const Device& sampleDevice = _circuit.device(dev._sampleDevice);
@@ -485,11 +483,10 @@ MNAStamper::stampCCVS(Eigen::MatrixXd& G,
 }
 
 inline void
-MNAStamper::stampVCVS(Eigen::MatrixXd& G, 
-                      Eigen::MatrixXd& /*C*/, 
+MNAStamper::stampVCVS(StampMatrix& G, 
+                      StampMatrix& /*C*/, 
                       Eigen::VectorXd& /*b*/, 
-                      const Device& dev,
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   double value = dev._value;
@@ -511,11 +508,10 @@ MNAStamper::stampVCVS(Eigen::MatrixXd& G,
 }
 
 inline void
-MNAStamper::stampCCCS(Eigen::MatrixXd& G, 
-                      Eigen::MatrixXd& /*C*/,
+MNAStamper::stampCCCS(StampMatrix& G, 
+                      StampMatrix& /*C*/,
                       Eigen::VectorXd& /*b*/, 
-                      const Device& dev,
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   const Device& sampleDevice = _circuit.device(dev._sampleDevice);
@@ -541,11 +537,10 @@ MNAStamper::stampCCCS(Eigen::MatrixXd& G,
 }
 
 inline void
-MNAStamper::stampVCCS(Eigen::MatrixXd& G, 
-                      Eigen::MatrixXd& /*C*/, 
+MNAStamper::stampVCCS(StampMatrix& G, 
+                      StampMatrix& /*C*/, 
                       Eigen::VectorXd& /*b*/, 
-                      const Device& dev,
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   double value = dev._value;
@@ -577,56 +572,55 @@ MNAStamper::stamp(Eigen::MatrixXd& G,
                   Eigen::VectorXd& b, 
                   IntegrateMethod intMethod)
 {
-  static void (MNAStamper::*stampFunc[static_cast<size_t>(DeviceType::Total)])(
-      Eigen::MatrixXd& G, Eigen::MatrixXd& C, Eigen::VectorXd& b, 
-      const Device& dev, IntegrateMethod intMethod) const;
-
-  stampFunc[static_cast<size_t>(DeviceType::Resistor)] = &NA::MNAStamper::stampResistor;
-  stampFunc[static_cast<size_t>(DeviceType::Capacitor)] = &NA::MNAStamper::stampCapacitor;
-  stampFunc[static_cast<size_t>(DeviceType::Inductor)] = &NA::MNAStamper::stampInductor;
-  stampFunc[static_cast<size_t>(DeviceType::VoltageSource)] = &NA::MNAStamper::stampVoltageSource;
-  stampFunc[static_cast<size_t>(DeviceType::CurrentSource)] = &NA::MNAStamper::stampCurrentSource;
-  stampFunc[static_cast<size_t>(DeviceType::VCVS)] = &NA::MNAStamper::stampVCVS;
-  stampFunc[static_cast<size_t>(DeviceType::VCCS)] = &NA::MNAStamper::stampVCCS;
-  stampFunc[static_cast<size_t>(DeviceType::CCVS)] = &NA::MNAStamper::stampCCVS;
-  stampFunc[static_cast<size_t>(DeviceType::CCCS)] = &NA::MNAStamper::stampCCCS;
-
-  const std::vector<Device>& devices = _circuit.devicesToSimulate();
-  for (const Device& device : devices) {
-    (this->*stampFunc[static_cast<size_t>(device._type)])(G, C, b, device, intMethod);
+  /// The s-domain capacitance and inductance are stamped by the BE functions
+  if (isSDomain()) {
+    intMethod = IntegrateMethod::BackwardEuler;
   }
+  StampMatrix denseG(G);
+  StampMatrix denseC(C);
+  StampLoop<MNAStamper>::stamp(*this, denseG, denseC, b, intMethod);
 }
 
 void
-MNAStamper::updatebNoop(Eigen::VectorXd& /*b*/, 
-                        const Device& /*dev*/, 
-                        IntegrateMethod /*intMethod*/) const
+MNAStamper::stamp(std::vector<Eigen::Triplet<double>>& G, 
+                  std::vector<Eigen::Triplet<double>>& C,
+                  Eigen::VectorXd& b, 
+                  IntegrateMethod intMethod)
 {
-  return;
+  if (isSDomain()) {
+    intMethod = IntegrateMethod::BackwardEuler;
+  }
+  StampMatrix tripletG(G);
+  StampMatrix tripletC(C);
+  StampLoop<MNAStamper>::stamp(*this, tripletG, tripletC, b, intMethod);
 }
 
 void 
 MNAStamper::updateb(Eigen::VectorXd& b, IntegrateMethod intMethod)
 {
-  static void (MNAStamper::*updatebFunc[static_cast<size_t>(DeviceType::Total)])(
-      Eigen::VectorXd& b, const Device& dev, IntegrateMethod intMethod) const;
-
-  updatebFunc[static_cast<size_t>(DeviceType::Resistor)] = &NA::MNAStamper::updatebNoop;
-  updatebFunc[static_cast<size_t>(DeviceType::Capacitor)] = &NA::MNAStamper::updatebCapacitor;
-  updatebFunc[static_cast<size_t>(DeviceType::Inductor)] = &NA::MNAStamper::updatebInductor;
-  updatebFunc[static_cast<size_t>(DeviceType::VoltageSource)] = &NA::MNAStamper::updatebVoltageSource;
-  updatebFunc[static_cast<size_t>(DeviceType::CurrentSource)] = &NA::MNAStamper::updatebCurrentSource;
-  updatebFunc[static_cast<size_t>(DeviceType::VCVS)] = &NA::MNAStamper::updatebNoop;
-  updatebFunc[static_cast<size_t>(DeviceType::VCCS)] = &NA::MNAStamper::updatebNoop;
-  updatebFunc[static_cast<size_t>(DeviceType::CCVS)] = &NA::MNAStamper::updatebNoop;
-  updatebFunc[static_cast<size_t>(DeviceType::CCCS)] = &NA::MNAStamper::updatebNoop;
+  assert(isSDomain() == false);
+  b.setZero();
+  StampLoop<MNAStamper>::updateb(*this, b, intMethod);
+}
 
+void
+MNAStamper::stampSources(Eigen::VectorXd& b, double simTime) const
+{
   b.setZero();
-  const std::vector<Device>& devices = _circuit.devicesToSimulate();
-  for (const Device& device : devices) {
-    (this->*updatebFunc[static_cast<size_t>(device._type)])(b, device, intMethod);
+  IndexedSpan<Device> devices = _circuit.devicesToSimulate();
+  for (const Device& dev : devices) {
+    if (dev._type == DeviceType::VoltageSource) {
+      b(_simResult.deviceVectorIndex(dev._devId)) += _simResult.sourceValue(dev, simTime);
+    } else if (dev._type == DeviceType::CurrentSource) {
+      double value = _simResult.sourceValue(dev, simTime);
+      if (isNodeOmitted(dev._posNode) == false) {
+        b(_simResult.nodeVectorIndex(dev._posNode)) -= value;
+      }
+      if (isNodeOmitted(dev._negNode) == false) {
+        b(_simResult.nodeVectorIndex(dev._negNode)) += value;
+      }
+    }
   }
-
 }
 
 }
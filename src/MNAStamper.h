@@ -3,8 +3,11 @@
 
 #include "Base.h"
 #include "Circuit.h"
+#include "StampLoop.h"
+#include <vector>
 #include <Eigen/Core>
 #include <Eigen/Dense>
+#include <Eigen/SparseCore>
 
 namespace NA {
 
@@ -12,80 +15,112 @@ class AnalysisParameter;
 class Circuit;
 class SimResult;
 
+/// Matrix the stamp functions add their values to, either a dense matrix 
+/// or triplets the caller sums into a sparse matrix
+class StampMatrix {
+  public:
+    class Entry {
+      public:
+        Entry(StampMatrix& mat, size_t row, size_t col)
+        : _mat(mat), _row(row), _col(col) {}
+        void operator+=(double value) { _mat.add(_row, _col, value); }
+        void operator-=(double value) { _mat.add(_row, _col, -value); }
+
+      private:
+        StampMatrix& _mat;
+        size_t       _row;
+        size_t       _col;
+    };
+
+    explicit StampMatrix(Eigen::MatrixXd& dense) : _dense(&dense) {}
+    explicit StampMatrix(std::vector<Eigen::Triplet<double>>& triplets) 
+    : _triplets(&triplets) {}
+    Entry operator()(size_t row, size_t col) { return Entry(*this, row, col); }
+    void add(size_t row, size_t col, double value)
+    {
+      if (_dense) {
+        (*_dense)(row, col) += value;
+      } else {
+        _triplets->emplace_back(row, col, value);
+      }
+    }
+
+  private:
+    Eigen::MatrixXd*                     _dense = nullptr;
+    std::vector<Eigen::Triplet<double>>* _triplets = nullptr;
+};
+
 class MNAStamper {
   public:
     MNAStamper(const AnalysisParameter& param, const Circuit& ckt, const SimResult& simResult)
     : _analysisParam(param), _circuit(ckt), _simResult(simResult) {}
     void stamp(Eigen::MatrixXd& G, Eigen::MatrixXd& C, Eigen::VectorXd& b, 
                IntegrateMethod intMethod = IntegrateMethod::Gear2);
+    /// Same as above with G and C collected as triplets, for large 
+    /// s-domain systems that are never formed dense
+    void stamp(std::vector<Eigen::Triplet<double>>& G, 
+               std::vector<Eigen::Triplet<double>>& C, Eigen::VectorXd& b, 
+               IntegrateMethod intMethod = IntegrateMethod::Gear2);
     void updateb(Eigen::VectorXd& b, IntegrateMethod intMethod = IntegrateMethod::Gear2);
+    /// Only the values of the independent sources at simTime in b, for
+    /// methods that keep the sources apart from the history of dynamic devices
+    void stampSources(Eigen::VectorXd& b, double simTime) const;
+    /// Coefficients of the BDF formula stamped for IntegrateMethod::BDF,
+    /// they must outlive the stamper
+    void setBDFCoefficients(const BDFCoefficients* coeff) { _BDFCoeff = coeff; }
 
   private:
     inline double simTick() const { return _analysisParam._simTick; }
+    /// BDF takes sources at the time being solved, the other methods at
+    /// the latest solved time
+    double sourceTime() const;
     inline bool isSDomain() const 
     { 
       return _analysisParam._type == AnalysisType::PZ || 
-             _analysisParam._type == AnalysisType::TF; 
+             _analysisParam._type == AnalysisType::TF ||
+             _analysisParam._type == AnalysisType::AC ||
+             _analysisParam._type == AnalysisType::Elmore; 
     }
     inline bool isNodeOmitted(size_t nodeId) const 
     {
       return _circuit.isGroundNode(nodeId);
     }
     /// Stamp functions for G and C
-    void stampCCVS(Eigen::MatrixXd& G, Eigen::MatrixXd& /*C*/, 
-                   Eigen::VectorXd& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampVCVS(Eigen::MatrixXd& G, Eigen::MatrixXd& /*C*/, 
-                   Eigen::VectorXd& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampCCCS(Eigen::MatrixXd& G, Eigen::MatrixXd& /*C*/, 
-                   Eigen::VectorXd& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampVCCS(Eigen::MatrixXd& G, Eigen::MatrixXd& /*C*/, 
-                   Eigen::VectorXd& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampVoltageSource(Eigen::MatrixXd& G, Eigen::MatrixXd& /*C*/,
-                            Eigen::VectorXd& b, const Device& dev,
-                            IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampCurrentSource(Eigen::MatrixXd& /*G*/, Eigen::MatrixXd& /*C*/, 
-                            Eigen::VectorXd& b, const Device& dev, 
-                            IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampCapacitor(Eigen::MatrixXd& G, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& cap, 
-                        IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampResistor(Eigen::MatrixXd& G, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& dev,
-                       IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampInductor(Eigen::MatrixXd& G, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& ind, 
-                       IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+    void stampCCVS(StampMatrix& G, StampMatrix& /*C*/, 
+                   Eigen::VectorXd& /*b*/, const Device& dev) const;
+    void stampVCVS(StampMatrix& G, StampMatrix& /*C*/, 
+                   Eigen::VectorXd& /*b*/, const Device& dev) const;
+    void stampCCCS(StampMatrix& G, StampMatrix& /*C*/, 
+                   Eigen::VectorXd& /*b*/, const Device& dev) const;
+    void stampVCCS(StampMatrix& G, StampMatrix& /*C*/, 
+                   Eigen::VectorXd& /*b*/, const Device& dev) const;
+    void stampVoltageSource(StampMatrix& G, StampMatrix& /*C*/,
+                            Eigen::VectorXd& b, const Device& dev) const;
+    void stampCurrentSource(StampMatrix& /*G*/, StampMatrix& /*C*/, 
+                            Eigen::VectorXd& b, const Device& dev) const;
+    void stampResistor(StampMatrix& G, StampMatrix& C, Eigen::VectorXd& b, const Device& dev) const;
     /// update functions for b
-    void updatebCapacitor(Eigen::VectorXd& b, const Device& cap, 
-                          IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebInductor(Eigen::VectorXd& b, const Device& ind, 
-                         IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebVoltageSource(Eigen::VectorXd& b, const Device& dev,
-                              IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebCurrentSource(Eigen::VectorXd& b, const Device& dev,
-                              IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebNoop(Eigen::VectorXd& b, const Device& dev,
-                     IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+    void updatebVoltageSource(Eigen::VectorXd& b, const Device& dev) const;
+    void updatebCurrentSource(Eigen::VectorXd& b, const Device& dev) const;
     
-    /// stamp and update functions for specific integration methods
-    void updatebCapacitorBE(Eigen::VectorXd& b, const Device& cap) const;
-    void stampCapacitorBE(Eigen::MatrixXd& G, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& cap) const;
-    void updatebCapacitorGear2(Eigen::VectorXd& b, const Device& cap) const;
-    void stampCapacitorGear2(Eigen::MatrixXd& /*G*/, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& cap) const;
-    void updatebCapacitorTrap(Eigen::VectorXd& b, const Device& cap) const;
-    void stampCapacitorTrap(Eigen::MatrixXd& /*G*/, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& cap) const;
-    void updatebInductorBE(Eigen::VectorXd& b, const Device& ind) const;
-    void stampInductorBE(Eigen::MatrixXd& /*G*/, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& ind) const;
-    void updatebInductorGear2(Eigen::VectorXd& b, const Device& ind) const;
-    void stampInductorGear2(Eigen::MatrixXd& /*G*/, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& ind) const;
-    void updatebInductorTrap(Eigen::VectorXd& b, const Device& ind) const;
-    void stampInductorTrap(Eigen::MatrixXd& /*G*/, Eigen::MatrixXd& C, Eigen::VectorXd& b, const Device& ind) const;
+    /// stamp and update functions of dynamic devices, specialized for each
+    /// integration method
+    template <IntegrateMethod Method>
+    void stampCapacitor(StampMatrix& G, StampMatrix& C, Eigen::VectorXd& b, const Device& cap) const;
+    template <IntegrateMethod Method>
+    void updatebCapacitor(Eigen::VectorXd& b, const Device& cap) const;
+    template <IntegrateMethod Method>
+    void stampInductor(StampMatrix& G, StampMatrix& C, Eigen::VectorXd& b, const Device& ind) const;
+    template <IntegrateMethod Method>
+    void updatebInductor(Eigen::VectorXd& b, const Device& ind) const;
+
+    friend class StampLoop<MNAStamper>;
 
   private:
     AnalysisParameter _analysisParam;
     const Circuit& _circuit;
     const SimResult& _simResult;
+    const BDFCoefficients* _BDFCoeff = nullptr;
 };
 
 }
@@ -83,12 +83,20 @@ stampSymbolDev(const T& t, double v)
   return stampSymbol(t._name, v);
 }
 
+double
+MNASymbolStamper::sourceTime() const
+{
+  if (_BDFCoeff) {
+    return _simResult.currentTime() + simTick();
+  }
+  return _simResult.currentTime();
+}
+
 void
 MNASymbolStamper::stampResistor(StringMatrix& G, 
                                 StringMatrix& /*C*/, 
                                 StringMatrix& /*b*/, 
-                                const Device& dev, 
-                                IntegrateMethod /*intMethod*/) const
+                                const Device& dev) const
 {
   double stampValue = 1.0 / dev._value;
   size_t posNodeIndex = _simResult.nodeVectorIndex(dev._posNode);
@@ -106,8 +114,9 @@ MNASymbolStamper::stampResistor(StringMatrix& G,
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebCapacitorBE(StringMatrix& b, 
+MNASymbolStamper::updatebCapacitor<IntegrateMethod::BackwardEuler>(StringMatrix& b, 
                                const Device& cap) const
 {
   double stampValue = cap._value / simTick();
@@ -131,8 +140,9 @@ MNASymbolStamper::updatebCapacitorBE(StringMatrix& b,
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::stampCapacitorBE(StringMatrix& /*G*/, 
+MNASymbolStamper::stampCapacitor<IntegrateMethod::BackwardEuler>(StringMatrix& /*G*/, 
                              StringMatrix& C, 
                              StringMatrix& b, 
                              const Device& cap) const
@@ -156,12 +166,13 @@ MNASymbolStamper::stampCapacitorBE(StringMatrix& /*G*/,
     C(negNodeIndex, posNodeIndex) -= stampSymbolDev(cap, stampValue);
   }
   if (isSDomain() == false) {
-    updatebCapacitorBE(b, cap);
+    updatebCapacitor<IntegrateMethod::BackwardEuler>(b, cap);
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebCapacitorGear2(StringMatrix& b,
+MNASymbolStamper::updatebCapacitor<IntegrateMethod::Gear2>(StringMatrix& b,
                                   const Device& cap) const
 {
   double baseValue =  cap._value / simTick();
@@ -189,8 +200,9 @@ MNASymbolStamper::updatebCapacitorGear2(StringMatrix& b,
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::stampCapacitorGear2(StringMatrix& /*G*/, 
+MNASymbolStamper::stampCapacitor<IntegrateMethod::Gear2>(StringMatrix& /*G*/, 
                                 StringMatrix& C,
                                 StringMatrix& b, 
                                 const Device& cap) const
@@ -209,11 +221,12 @@ MNASymbolStamper::stampCapacitorGear2(StringMatrix& /*G*/,
     C(posNodeIndex, negNodeIndex) -= stampSymbolDev(cap, stampValue);
     C(negNodeIndex, posNodeIndex) -= stampSymbolDev(cap, stampValue);
   }
-  updatebCapacitorGear2(b, cap);
+  updatebCapacitor<IntegrateMethod::Gear2>(b, cap);
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebCapacitorTrap(StringMatrix& b,
+MNASymbolStamper::updatebCapacitor<IntegrateMethod::Trapezoidal>(StringMatrix& b,
                                  const Device& cap) const
 {
   double baseValue =  cap._value / simTick();
@@ -238,8 +251,9 @@ MNASymbolStamper::updatebCapacitorTrap(StringMatrix& b,
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::stampCapacitorTrap(StringMatrix& /*G*/,
+MNASymbolStamper::stampCapacitor<IntegrateMethod::Trapezoidal>(StringMatrix& /*G*/,
                                StringMatrix& C,
                                StringMatrix& b, 
                                const Device& cap) const
@@ -258,57 +272,66 @@ MNASymbolStamper::stampCapacitorTrap(StringMatrix& /*G*/,
     C(posNodeIndex, negNodeIndex) -= stampSymbolDev(cap, stampValue);
     C(negNodeIndex, posNodeIndex) -= stampSymbolDev(cap, stampValue);
   }
-  updatebCapacitorTrap(b, cap);
+  updatebCapacitor<IntegrateMethod::Trapezoidal>(b, cap);
 }
 
+template <>
 inline void
-MNASymbolStamper::stampCapacitor(StringMatrix& G, StringMatrix& C, 
-                           StringMatrix& b, const Device& cap,
-                           IntegrateMethod intMethod) const
-{
-  if (isSDomain()) {
-    stampCapacitorBE(G, C, b, cap);
-    return;
+MNASymbolStamper::updatebCapacitor<IntegrateMethod::BDF>(StringMatrix& b,
+                                      const Device& cap) const
+{
+  double history = 0;
+  std::string symbol = "-(";
+  for (size_t j=1; j<=_BDFCoeff->_history; ++j) {
+    double voltageDiff = _simResult.nodeVoltageHistory(cap._posNode, j) - 
+                         _simResult.nodeVoltageHistory(cap._negNode, j);
+    history += _BDFCoeff->_alpha[j] * voltageDiff;
+    if (j > 1) {
+      symbol += "+";
+    }
+    symbol += "a" + std::to_string(j) + "*dV(" + cap._name + ")[t" + 
+              (j > 1 ? "-" + std::to_string(j-1) : "") + "]";
   }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      stampCapacitorBE(G, C, b, cap);
-      break;
-    case IntegrateMethod::Gear2:
-      stampCapacitorGear2(G, C, b, cap);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      stampCapacitorTrap(G, C, b, cap);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  symbol += ")*Cap";
+  double stampValue = -cap._value * history;
+  size_t posNodeIndex = _simResult.nodeVectorIndex(cap._posNode);
+  size_t negNodeIndex = _simResult.nodeVectorIndex(cap._negNode);
+  if (isNodeOmitted(cap._posNode) == false) {
+    b(posNodeIndex, 0) += stampSymbol(symbol, stampValue);
+  } 
+  if (isNodeOmitted(cap._negNode) == false) {
+    b(negNodeIndex, 0) -= stampSymbol(symbol, stampValue);
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebCapacitor(StringMatrix& b, const Device& cap, 
-                             IntegrateMethod intMethod) const
+MNASymbolStamper::stampCapacitor<IntegrateMethod::BDF>(StringMatrix& /*G*/,
+                                    StringMatrix& C,
+                                    StringMatrix& b, 
+                                    const Device& cap) const
 {
-  if (isSDomain()) {
-    return;
+  double stampValue = _BDFCoeff->_alpha[0] * cap._value;
+  size_t posNodeIndex = _simResult.nodeVectorIndex(cap._posNode);
+  size_t negNodeIndex = _simResult.nodeVectorIndex(cap._negNode);
+  if (isNodeOmitted(cap._posNode) == false) {
+    C(posNodeIndex, posNodeIndex) += stampSymbolDev(cap, stampValue);
+  } 
+  if (isNodeOmitted(cap._negNode) == false) {
+    C(negNodeIndex, negNodeIndex) += stampSymbolDev(cap, stampValue);
   }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      updatebCapacitorBE(b, cap);
-      break;
-    case IntegrateMethod::Gear2:
-      updatebCapacitorGear2(b, cap);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      updatebCapacitorTrap(b, cap);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  if (isNodeOmitted(cap._posNode) == false && isNodeOmitted(cap._negNode) == false) {
+    C(posNodeIndex, negNodeIndex) -= stampSymbolDev(cap, stampValue);
+    C(negNodeIndex, posNodeIndex) -= stampSymbolDev(cap, stampValue);
   }
+  updatebCapacitor<IntegrateMethod::BDF>(b, cap);
 }
 
+
+
+template <>
 inline void
-MNASymbolStamper::updatebInductorBE(StringMatrix& b,
+MNASymbolStamper::updatebInductor<IntegrateMethod::BackwardEuler>(StringMatrix& b,
                               const Device& ind) const
 {
   double stampValue = ind._value / simTick();
@@ -319,8 +342,9 @@ MNASymbolStamper::updatebInductorBE(StringMatrix& b,
   b(deviceIndex, 0) += stampSymbol(symbol, bValue);
 }
 
+template <>
 inline void
-MNASymbolStamper::stampInductorBE(StringMatrix& G, 
+MNASymbolStamper::stampInductor<IntegrateMethod::BackwardEuler>(StringMatrix& G, 
                             StringMatrix& C, 
                             StringMatrix& b, 
                             const Device& ind) const
@@ -344,12 +368,13 @@ MNASymbolStamper::stampInductorBE(StringMatrix& G,
   }
   C(deviceIndex, deviceIndex) -= stampSymbolDev(ind, stampValue);
   if (isSDomain() == false) {
-    updatebInductorBE(b, ind);
+    updatebInductor<IntegrateMethod::BackwardEuler>(b, ind);
   }
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebInductorGear2(StringMatrix& b,
+MNASymbolStamper::updatebInductor<IntegrateMethod::Gear2>(StringMatrix& b,
                                  const Device& ind) const
 {
   double baseValue = ind._value / simTick();
@@ -361,8 +386,9 @@ MNASymbolStamper::updatebInductorGear2(StringMatrix& b,
   b(deviceIndex, 0) += stampSymbol(symbol, stampValue);
 }
 
+template <>
 inline void
-MNASymbolStamper::stampInductorGear2(StringMatrix& /*G*/,
+MNASymbolStamper::stampInductor<IntegrateMethod::Gear2>(StringMatrix& /*G*/,
                                StringMatrix& C, 
                                StringMatrix& b, 
                                const Device& ind) const
@@ -381,11 +407,12 @@ MNASymbolStamper::stampInductorGear2(StringMatrix& /*G*/,
     C(deviceIndex, negNodeIndex) -= stampSymbolDev(ind, 1);
   }
   C(deviceIndex, deviceIndex) -= stampSymbolDev(ind, stampValue);
-  updatebInductorGear2(b, ind);
+  updatebInductor<IntegrateMethod::Gear2>(b, ind);
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebInductorTrap(StringMatrix& b,
+MNASymbolStamper::updatebInductor<IntegrateMethod::Trapezoidal>(StringMatrix& b,
                                 const Device& ind) const
 {
   double baseValue = ind._value / simTick();
@@ -397,8 +424,9 @@ MNASymbolStamper::updatebInductorTrap(StringMatrix& b,
   b(deviceIndex, 0) += stampSymbol(symbol, stampValue);
 }
 
+template <>
 inline void
-MNASymbolStamper::stampInductorTrap(StringMatrix& /*G*/,
+MNASymbolStamper::stampInductor<IntegrateMethod::Trapezoidal>(StringMatrix& /*G*/,
                               StringMatrix& C,
                               StringMatrix& b, 
                               const Device& ind) const
@@ -417,70 +445,63 @@ MNASymbolStamper::stampInductorTrap(StringMatrix& /*G*/,
     C(deviceIndex, negNodeIndex) -= stampSymbolDev(ind, 1);
   }
   C(deviceIndex, deviceIndex) -= stampSymbolDev(ind, stampValue);
-  updatebInductorTrap(b, ind);
+  updatebInductor<IntegrateMethod::Trapezoidal>(b, ind);
 }
 
+template <>
 inline void
-MNASymbolStamper::stampInductor(StringMatrix& G, StringMatrix& C,
-                          StringMatrix& b, const Device& ind, 
-                          IntegrateMethod intMethod) const
-{
-  if (isSDomain()) {
-    stampInductorBE(G, C, b, ind);
-    return;
-  }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      stampInductorBE(G, C, b, ind);
-      break;
-    case IntegrateMethod::Gear2:
-      stampInductorGear2(G, C, b, ind);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      stampInductorTrap(G, C, b, ind);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+MNASymbolStamper::updatebInductor<IntegrateMethod::BDF>(StringMatrix& b,
+                                     const Device& ind) const
+{
+  double history = 0;
+  std::string symbol = "(";
+  for (size_t j=1; j<=_BDFCoeff->_history; ++j) {
+    history += _BDFCoeff->_alpha[j] * _simResult.deviceCurrentHistory(ind._devId, j);
+    if (j > 1) {
+      symbol += "+";
+    }
+    symbol += "a" + std::to_string(j) + "*I(" + ind._name + ")[t" + 
+              (j > 1 ? "-" + std::to_string(j-1) : "") + "]";
   }
+  symbol += ")*Ind";
+  size_t deviceIndex = _simResult.deviceVectorIndex(ind._devId);
+  b(deviceIndex, 0) += stampSymbol(symbol, ind._value * history);
 }
 
+template <>
 inline void
-MNASymbolStamper::updatebInductor(StringMatrix& b, const Device& ind, 
-                            IntegrateMethod intMethod) const
+MNASymbolStamper::stampInductor<IntegrateMethod::BDF>(StringMatrix& G,
+                                   StringMatrix& C,
+                                   StringMatrix& b, 
+                                   const Device& ind) const
 {
-  if (isSDomain()) {
-    return;
+  double stampValue = _BDFCoeff->_alpha[0] * ind._value;
+  size_t posNodeIndex = _simResult.nodeVectorIndex(ind._posNode);
+  size_t negNodeIndex = _simResult.nodeVectorIndex(ind._negNode);
+  size_t deviceIndex = _simResult.deviceVectorIndex(ind._devId);
+  if (isNodeOmitted(ind._posNode) == false) {
+    G(posNodeIndex, deviceIndex) += stampSymbolDev(ind, 1);
+    G(deviceIndex, posNodeIndex) += stampSymbolDev(ind, 1);
   }
-  switch (intMethod) {
-    case IntegrateMethod::BackwardEuler:
-      updatebInductorBE(b, ind);
-      break;
-    case IntegrateMethod::Gear2:
-      updatebInductorGear2(b, ind);
-      break;
-    case IntegrateMethod::Trapezoidal:
-      updatebInductorTrap(b, ind);
-      break;
-    default:
-      assert(false && "Incorrect integrate method");
+  if (isNodeOmitted(ind._negNode) == false) {
+    G(negNodeIndex, deviceIndex) -= stampSymbolDev(ind, 1);
+    G(deviceIndex, negNodeIndex) -= stampSymbolDev(ind, 1);
   }
+  C(deviceIndex, deviceIndex) -= stampSymbolDev(ind, stampValue);
+  updatebInductor<IntegrateMethod::BDF>(b, ind);
 }
 
+
+
 inline void
 MNASymbolStamper::updatebVoltageSource(StringMatrix& b,
-                                 const Device& dev,
-                                 IntegrateMethod /*intMethod*/) const
+                                 const Device& dev) const
 {
   double value;
   if (isSDomain()) {
     value = 1 * _circuit.scalingFactor();
   } else {
-    if (dev._isPWLValue) {
-      const PWLValue& pwlData = _circuit.PWLData(dev);
-      value = pwlData.valueAtTime(_simResult.currentTime());
-    } else {
-      value = dev._value;
-    }
+    value = _simResult.sourceValue(dev, sourceTime());
   }
   size_t deviceIndex = _simResult.deviceVectorIndex(dev._devId);
   b(deviceIndex, 0) += stampSymbolDev(dev, value);
@@ -490,8 +511,7 @@ inline void
 MNASymbolStamper::stampVoltageSource(StringMatrix& G, 
                                StringMatrix& /*C*/,
                                StringMatrix& b, 
-                               const Device& dev,
-                               IntegrateMethod /*intMethod*/) const
+                               const Device& dev) const
 {
   size_t posNodeIndex = _simResult.nodeVectorIndex(dev._posNode);
   size_t negNodeIndex = _simResult.nodeVectorIndex(dev._negNode);
@@ -509,16 +529,10 @@ MNASymbolStamper::stampVoltageSource(StringMatrix& G,
 
 inline void
 MNASymbolStamper::updatebCurrentSource(StringMatrix& b,
-                                 const Device& dev,
-                                 IntegrateMethod /*intMethod*/) const
+                                 const Device& dev) const
 {
   double value;
-  if (dev._isPWLValue) {
-    const PWLValue& pwlData = _circuit.PWLData(dev);
-    value = pwlData.valueAtTime(_simResult.currentTime());
-  } else {
-    value = dev._value;
-  }
+  value = _simResult.sourceValue(dev, sourceTime());
   if (isSDomain()) {
     value = 1 * _circuit.scalingFactor();
   }
@@ -536,8 +550,7 @@ inline void
 MNASymbolStamper::stampCurrentSource(StringMatrix& /*G*/, 
                                StringMatrix& /*C*/, 
                                StringMatrix& b, 
-                               const Device& dev,
-                               IntegrateMethod /*intMethod*/) const
+                               const Device& dev) const
 {
   updatebCurrentSource(b, dev);
 }
@@ -546,8 +559,7 @@ inline void
 MNASymbolStamper::stampCCVS(StringMatrix& G, 
                       StringMatrix& /*C*/, 
                       StringMatrix& /*b*/, 
-                      const Device& dev, 
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   const Device& sampleDevice = _circuit.device(dev._sampleDevice);
@@ -580,8 +592,7 @@ inline void
 MNASymbolStamper::stampVCVS(StringMatrix& G, 
                       StringMatrix& /*C*/, 
                       StringMatrix& /*b*/, 
-                      const Device& dev,
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   double value = dev._value;
@@ -606,8 +617,7 @@ inline void
 MNASymbolStamper::stampCCCS(StringMatrix& G, 
                       StringMatrix& /*C*/,
                       StringMatrix& /*b*/, 
-                      const Device& dev,
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   const Device& sampleDevice = _circuit.device(dev._sampleDevice);
@@ -636,8 +646,7 @@ inline void
 MNASymbolStamper::stampVCCS(StringMatrix& G, 
                       StringMatrix& /*C*/, 
                       StringMatrix& /*b*/, 
-                      const Device& dev,
-                      IntegrateMethod /*intMethod*/) const
+                      const Device& dev) const
 {
   assert(isSDomain() == false);
   double value = dev._value;
@@ -669,32 +678,10 @@ MNASymbolStamper::stamp(StringMatrix& G,
                   StringMatrix& b, 
                   IntegrateMethod intMethod)
 {
-  static void (MNASymbolStamper::*stampFunc[static_cast<size_t>(DeviceType::Total)])(
-      StringMatrix& G, StringMatrix& C, StringMatrix& b, 
-      const Device& dev, IntegrateMethod intMethod) const;
-
-  stampFunc[static_cast<size_t>(DeviceType::Resistor)] = &NA::MNASymbolStamper::stampResistor;
-  stampFunc[static_cast<size_t>(DeviceType::Capacitor)] = &NA::MNASymbolStamper::stampCapacitor;
-  stampFunc[static_cast<size_t>(DeviceType::Inductor)] = &NA::MNASymbolStamper::stampInductor;
-  stampFunc[static_cast<size_t>(DeviceType::VoltageSource)] = &NA::MNASymbolStamper::stampVoltageSource;
-  stampFunc[static_cast<size_t>(DeviceType::CurrentSource)] = &NA::MNASymbolStamper::stampCurrentSource;
-  stampFunc[static_cast<size_t>(DeviceType::VCVS)] = &NA::MNASymbolStamper::stampVCVS;
-  stampFunc[static_cast<size_t>(DeviceType::VCCS)] = &NA::MNASymbolStamper::stampVCCS;
-  stampFunc[static_cast<size_t>(DeviceType::CCVS)] = &NA::MNASymbolStamper::stampCCVS;
-  stampFunc[static_cast<size_t>(DeviceType::CCCS)] = &NA::MNASymbolStamper::stampCCCS;
-
-  const std::vector<Device>& devices = _circuit.devicesToSimulate();
-  for (const Device& device : devices) {
-    (this->*stampFunc[static_cast<size_t>(device._type)])(G, C, b, device, intMethod);
+  if (isSDomain()) {
+    intMethod = IntegrateMethod::BackwardEuler;
   }
-}
-
-void
-MNASymbolStamper::updatebNoop(StringMatrix& /*b*/, 
-                        const Device& /*dev*/, 
-                        IntegrateMethod /*intMethod*/) const
-{
-  return;
+  StampLoop<MNASymbolStamper>::stamp(*this, G, C, b, intMethod);
 }
 
 }
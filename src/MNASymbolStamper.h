@@ -4,6 +4,7 @@
 #include <string>
 #include "Base.h"
 #include "Circuit.h"
+#include "StampLoop.h"
 
 namespace NA {
 
@@ -109,9 +110,12 @@ class MNASymbolStamper {
     : _analysisParam(param), _circuit(ckt), _simResult(simResult) {}
     void stamp(StringMatrix& G, StringMatrix& C, StringMatrix& b, 
                IntegrateMethod intMethod = IntegrateMethod::Gear2);
+    /// Coefficients of the BDF formula stamped for IntegrateMethod::BDF
+    void setBDFCoefficients(const BDFCoefficients* coeff) { _BDFCoeff = coeff; }
 
   private:
     inline double simTick() const { return _analysisParam._simTick; }
+    double sourceTime() const;
     inline bool isSDomain() const 
     { 
       return _analysisParam._type == AnalysisType::PZ || 
@@ -123,59 +127,40 @@ class MNASymbolStamper {
     }
     /// Stamp functions for G and C
     void stampCCVS(StringMatrix& G, StringMatrix& /*C*/, 
-                   StringMatrix& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+                   StringMatrix& /*b*/, const Device& dev) const;
     void stampVCVS(StringMatrix& G, StringMatrix& /*C*/, 
-                   StringMatrix& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+                   StringMatrix& /*b*/, const Device& dev) const;
     void stampCCCS(StringMatrix& G, StringMatrix& /*C*/, 
-                   StringMatrix& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+                   StringMatrix& /*b*/, const Device& dev) const;
     void stampVCCS(StringMatrix& G, StringMatrix& /*C*/, 
-                   StringMatrix& /*b*/, const Device& dev,
-                   IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+                   StringMatrix& /*b*/, const Device& dev) const;
     void stampVoltageSource(StringMatrix& G, StringMatrix& /*C*/,
-                            StringMatrix& b, const Device& dev,
-                            IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+                            StringMatrix& b, const Device& dev) const;
     void stampCurrentSource(StringMatrix& /*G*/, StringMatrix& /*C*/, 
-                            StringMatrix& b, const Device& dev, 
-                            IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampCapacitor(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& cap, 
-                        IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampResistor(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& dev,
-                       IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void stampInductor(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& ind, 
-                       IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+                            StringMatrix& b, const Device& dev) const;
+    void stampResistor(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& dev) const;
     /// update functions for b
-    void updatebCapacitor(StringMatrix& b, const Device& cap, 
-                          IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebInductor(StringMatrix& b, const Device& ind, 
-                         IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebVoltageSource(StringMatrix& b, const Device& dev,
-                              IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebCurrentSource(StringMatrix& b, const Device& dev,
-                              IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
-    void updatebNoop(StringMatrix& b, const Device& dev,
-                     IntegrateMethod intMethod = IntegrateMethod::BackwardEuler) const;
+    void updatebVoltageSource(StringMatrix& b, const Device& dev) const;
+    void updatebCurrentSource(StringMatrix& b, const Device& dev) const;
     
-    /// stamp and update functions for specific integration methods
-    void updatebCapacitorBE(StringMatrix& b, const Device& cap) const;
-    void stampCapacitorBE(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& cap) const;
-    void updatebCapacitorGear2(StringMatrix& b, const Device& cap) const;
-    void stampCapacitorGear2(StringMatrix& /*G*/, StringMatrix& C, StringMatrix& b, const Device& cap) const;
-    void updatebCapacitorTrap(StringMatrix& b, const Device& cap) const;
-    void stampCapacitorTrap(StringMatrix& /*G*/, StringMatrix& C, StringMatrix& b, const Device& cap) const;
-    void updatebInductorBE(StringMatrix& b, const Device& ind) const;
-    void stampInductorBE(StringMatrix& /*G*/, StringMatrix& C, StringMatrix& b, const Device& ind) const;
-    void updatebInductorGear2(StringMatrix& b, const Device& ind) const;
-    void stampInductorGear2(StringMatrix& /*G*/, StringMatrix& C, StringMatrix& b, const Device& ind) const;
-    void updatebInductorTrap(StringMatrix& b, const Device& ind) const;
-    void stampInductorTrap(StringMatrix& /*G*/, StringMatrix& C, StringMatrix& b, const Device& ind) const;
+    /// stamp and update functions of dynamic devices, specialized for each
+    /// integration method
+    template <IntegrateMethod Method>
+    void stampCapacitor(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& cap) const;
+    template <IntegrateMethod Method>
+    void updatebCapacitor(StringMatrix& b, const Device& cap) const;
+    template <IntegrateMethod Method>
+    void stampInductor(StringMatrix& G, StringMatrix& C, StringMatrix& b, const Device& ind) const;
+    template <IntegrateMethod Method>
+    void updatebInductor(StringMatrix& b, const Device& ind) const;
+
+    friend class StampLoop<MNASymbolStamper>;
 
   private:
     AnalysisParameter _analysisParam;
     const Circuit& _circuit;
     const SimResult& _simResult;
+    const BDFCoefficients* _BDFCoeff = nullptr;
 };
 
 }
@@ -13,7 +13,7 @@ calcMeasureTime(double x1, double y1, double x2, double y2, double value)
 
 static inline bool
 getSimData(const SimResultType& type, const std::string& point, 
-           const SimResult& result, double step, 
+           const SimResult& result, size_t step, 
            double& value, double& nextValue)
 {
   const Circuit* ckt = result.circuit();
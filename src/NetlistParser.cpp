@@ -1,10 +1,16 @@
-#include <fstream>
+#include <charconv>
 #include <unordered_map>
 #include <string>
+#include <string_view>
 #include <cstring>
 #include <cctype>  
 #include <algorithm> 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include "NetlistParser.h"
+#include "Parallel.h"
 #include "Base.h"
 #include "Debug.h"
 #include "StringUtil.h"
@@ -12,18 +18,8 @@
 
 namespace NA {
 
-void
-nodeMapToList(const std::unordered_map<std::string, size_t>& nodeMap,
-              std::vector<std::string>& nodes)
-{
-  nodes.resize(nodeMap.size(), "");
-  for (const auto& kv : nodeMap) {
-    nodes[kv.second] = kv.first;
-  }
-}
-
 char 
-firstChar(const std::string& line)
+firstChar(std::string_view line)
 {
   for (size_t i=0; i<line.size(); ++i) {
     if (std::isspace(line[i]) == false) {
@@ -33,98 +29,216 @@ firstChar(const std::string& line)
   return '\0';
 }
 
+/// White spaces and control characters separate tokens
 static inline bool
-isLineClosed(std::string& line, size_t& parenCounter, std::string& str)
+isDelimiter(char c)
 {
+  return static_cast<unsigned char>(c) <= ' ' || c == 0x7f;
+}
+
+static inline void
+splitTokens(std::string_view line, std::vector<std::string_view>& tokens)
+{
+  tokens.clear();
+  size_t i = 0;
+  while (i < line.size()) {
+    while (i < line.size() && isDelimiter(line[i])) {
+      ++i;
+    }
+    size_t start = i;
+    while (i < line.size() && isDelimiter(line[i]) == false) {
+      ++i;
+    }
+    if (i > start) {
+      tokens.push_back(line.substr(start, i-start));
+    }
+  }
+}
+
+/// Logical lines of a netlist file mapped with mmap. A line continues on 
+/// the next lines while it has open parentheses or ends with '+', and on 
+/// the following lines starting with '+'. A line that does not continue is
+/// a view of the mapped file, only continued lines are joined in a buffer.
+/// Lines starting in [begin, end) are read, the last one may continue
+/// after end.
+class NetlistLineReader {
+  public:
+    NetlistLineReader(const char* data, size_t begin, size_t end, size_t size)
+    : _data(data), _size(size), _pos(begin), _end(end) {}
+
+    /// False when no more line starts before end
+    bool next(std::string_view& line);
+    /// Offset after the last line read
+    size_t position() const { return _pos; }
+
+  private:
+    std::string_view peekLine() const;
+    std::string_view physicalLine();
+
+  private:
+    const char* _data;
+    size_t      _size;
+    size_t      _pos;
+    size_t      _end;
+    std::string _joined;
+};
+
+std::string_view
+NetlistLineReader::peekLine() const
+{
+  const void* found = memchr(_data + _pos, '\n', _size - _pos);
+  size_t end = found ? static_cast<const char*>(found) - _data : _size;
+  return std::string_view(_data + _pos, end - _pos);
+}
+
+std::string_view
+NetlistLineReader::physicalLine()
+{
+  std::string_view line = peekLine();
+  _pos += line.size() + 1;
+  return line;
+}
+
+/// Counts the parentheses of line, true if line ends with a '+' that
+/// continues it on the next line
+static inline bool
+scanLine(std::string_view line, long& parenCounter)
+{
+  /// Most lines have no '(' or '+', memchr finds that much faster than
+  /// the loop below. A ')' alone can not keep such a line open
+  if (parenCounter == 0 && memchr(line.data(), '(', line.size()) == nullptr &&
+      memchr(line.data(), '+', line.size()) == nullptr) {
+    return false;
+  }
   bool tailingPlus = false;
-  for (size_t i=0; i<line.size(); ++i) {
-    char& c = line[i];
+  for (char c : line) {
     if (c == '(') {
       ++parenCounter;
     } else if (c == ')') {
       --parenCounter;
-    }
-    if (iscntrl(c)) {
-      c = ' ';
-    }
-    if (c == '+') {
+    } else if (c == '+') {
       tailingPlus = true;
-    }
-    if (tailingPlus && std::isalnum(c) && c != '+') {
+    } else if (tailingPlus && std::isalnum(static_cast<unsigned char>(c))) {
       tailingPlus = false;
     }
   }
-  if (tailingPlus) {
-    while (line.back() != '+') {
-      line.pop_back();
-    }
-    line.pop_back();
-  }
-  size_t startOffset = static_cast<size_t>(-1);
-  if (firstChar(line) == '+') {
-    for (size_t i=0; i<line.size(); ++i) {
-      if (line[i] == '+') {
-        startOffset = i;
-        break;
-      }
-    }
-  }
-  str.append(" ");
-  str.insert(str.end(), line.begin()+startOffset+1, line.end());
-  return parenCounter == 0 && tailingPlus == false;
+  return tailingPlus;
 }
 
-static bool
-getClosedLine(std::ifstream& infile, std::string& content)
+bool
+NetlistLineReader::next(std::string_view& line)
 {
-  std::string line;
-  size_t parenCounter = 0;
-  std::streampos curPos;
-  while (std::getline(infile, line)) {
-    curPos = infile.tellg();
-    if (isLineClosed(line, parenCounter, content)) {
-      break;
-    }
+  if (_pos >= _end) {
+    return false;
   }
-  while (std::getline(infile, line)) {
-    if (firstChar(line) == '+') {
-      size_t offset = static_cast<size_t>(-1);
-      for (size_t i=0; i<line.size(); ++i) {
-        if (line[i] == '+') {
-          offset = i+1;
-          break;
-        }
-      }
-      content.insert(content.end(), line.begin()+offset, line.end());
+  std::string_view first;
+  size_t pieces = 0;
+  long parenCounter = 0;
+  bool closed = false;
+  while (closed == false && _pos < _size) {
+    std::string_view piece = physicalLine();
+    bool tailingPlus = scanLine(piece, parenCounter);
+    closed = parenCounter <= 0 && tailingPlus == false;
+    if (tailingPlus) {
+      piece = piece.substr(0, piece.rfind('+'));
+    }
+    if (firstChar(piece) == '+') {
+      piece.remove_prefix(piece.find('+') + 1);
+    }
+    if (pieces == 0) {
+      first = piece;
     } else {
-      if (infile.tellg() == -1) {
-        infile.clear();
-        infile.seekg(curPos, std::ios_base::beg);
-      } else {
-        infile.seekg(-line.size()-1, std::ios_base::cur);
+      if (pieces == 1) {
+        _joined.assign(first);
       }
-      break;
+      _joined.push_back(' ');
+      _joined.append(piece);
+    }
+    ++pieces;
+  }
+  while (_pos < _size && firstChar(peekLine()) == '+') {
+    std::string_view piece = physicalLine();
+    piece.remove_prefix(piece.find('+') + 1);
+    if (pieces == 1) {
+      _joined.assign(first);
     }
+    _joined.append(piece);
+    ++pieces;
   }
-  return infile.peek() != EOF;
-  //return content.size() > 1 || (content.empty() == false && content[0] != ' ');
+  if (pieces == 1) {
+    line = first;
+  } else {
+    line = _joined;
+  }
+  return true;
 }
 
 NetlistParser::NetlistParser(const char* fileName) 
+: _fileName(fileName)
 {
-  timespec parseStart;
-  clock_gettime(CLOCK_REALTIME, &parseStart);
+  timespec scanStart;
+  clock_gettime(CLOCK_REALTIME, &scanStart);
   
-  std::ifstream infile(fileName);
-  if (!infile) {
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0) {
     printf("ERROR: Cannot open %s\n", fileName);
+    _devicesParsed = true;
     return;
   }
-  std::string line;
-  std::string content;
-  while (getClosedLine(infile, content)) {
-    parseLine(content);
-    content.clear();
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    printf("ERROR: Cannot read %s\n", fileName);
+    _devicesParsed = true;
+    return;
+  }
+  size_t size = static_cast<size_t>(st.st_size);
+  void* addr = nullptr;
+  if (size > 0) {
+    addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (addr == MAP_FAILED) {
+    printf("ERROR: Cannot read %s\n", fileName);
+    _devicesParsed = true;
+    return;
+  }
+  if (addr != nullptr) {
+    madvise(addr, size, MADV_SEQUENTIAL);
+    _content.reset(static_cast<const char*>(addr), [size](const char* p) {
+      munmap(const_cast<char*>(p), size);
+    });
+    _contentSize = size;
+    scan(_content.get(), _contentSize);
+  }
+
+  timespec scanEnd;
+  clock_gettime(CLOCK_REALTIME, &scanEnd);
+  _scanTimeNs = timeDiffNs(scanEnd, scanStart);
+
+  /// With snapshots the devices may never be needed, they are parsed
+  /// when a circuit can not be loaded from its snapshot
+  if (_useSnapshot) {
+    printf("Time spent in netlist scanning: %.3f milliseconds\n", 1e-6*_scanTimeNs);
+  } else {
+    parseDevices();
+  }
+}
+
+void
+NetlistParser::parseDevices() const
+{
+  if (_devicesParsed) {
+    return;
+  }
+  _devicesParsed = true;
+
+  timespec parseStart;
+  clock_gettime(CLOCK_REALTIME, &parseStart);
+  
+  if (_content) {
+    parse(_content.get(), _contentSize);
+    _content.reset();
   }
 
   timespec parseEnd;
@@ -145,7 +259,7 @@ NetlistParser::NetlistParser(const char* fileName)
          "  %lu CCCS\n"
          "  %lu CCVS\n"
          "  %lu Standard cells\n", 
-    fileName, 
+    _fileName.data(), 
     devCounter[static_cast<unsigned char>(DeviceType::Resistor)],
     devCounter[static_cast<unsigned char>(DeviceType::Capacitor)], 
     devCounter[static_cast<unsigned char>(DeviceType::Inductor)], 
@@ -158,13 +272,15 @@ NetlistParser::NetlistParser(const char* fileName)
     devCounter[static_cast<unsigned char>(DeviceType::Cell)]);
 
   printf("Time spent in netlist parsing: %.3f milliseconds\n",
-         1e-6*timeDiffNs(parseEnd, parseStart));
+         1e-6*(_scanTimeNs + timeDiffNs(parseEnd, parseStart)));
 }
 
+/// Scale of the unit suffix of str, the suffix is removed from str.
+/// One of ignoreChars after the suffix is ignored, e.g. "s" of "1ns".
 static inline double 
-findUnit(std::string& str, const char* ignoreChars)
+findUnit(std::string_view& str, const char* ignoreChars)
 {
-  if (ignoreChars == nullptr) {
+  if (ignoreChars == nullptr || str.empty()) {
     return 1;
   }
   size_t ignoreLength = strlen(ignoreChars);
@@ -173,12 +289,15 @@ findUnit(std::string& str, const char* ignoreChars)
   char lastChar = str[lastIndex];
   for (size_t i=0; i<ignoreLength; ++i) {
     if (lastChar == ignoreChars[i]) {
+      if (actualLastIndex == 0) {
+        return 1;
+      }
       actualLastIndex -= 1;
       lastChar = str[actualLastIndex];
       break;
     }
   }
-  char unitStartIndex = actualLastIndex;
+  size_t unitStartIndex = actualLastIndex;
   double scale = 1;
   switch (lastChar) {
     case 'F':
@@ -215,7 +334,7 @@ findUnit(std::string& str, const char* ignoreChars)
       break;
     case 'G':
     case 'g':
-      if (str.size() > 3 && 
+      if (str.size() > 3 && actualLastIndex >= 2 &&
          (str[actualLastIndex-2] == 'M' || str[actualLastIndex-2] == 'm') && 
          (str[actualLastIndex-1] == 'E' || str[actualLastIndex-1] == 'e')) {
         scale = 1e6;
@@ -228,37 +347,58 @@ findUnit(std::string& str, const char* ignoreChars)
       scale = 1;
       unitStartIndex = lastIndex + 1;
   }
-  for (size_t i=unitStartIndex; i<=lastIndex; ++i) {
-    str[i] = ' ';
-  }
+  str = str.substr(0, unitStartIndex);
   return scale;
 }
 
+/// Number with an optional unit suffix, text after the number is ignored 
+/// like strtod does
 static inline double 
-numericalValue(std::string& str, const char* ignoreChars)
+numericalValue(std::string_view str, const char* ignoreChars)
 {
   double scale = findUnit(str, ignoreChars);
-  return strtod(str.data(), nullptr) * scale;
+  const char* begin = str.data();
+  const char* end = str.data() + str.size();
+  while (begin < end && std::isspace(static_cast<unsigned char>(*begin))) {
+    ++begin;
+  }
+  if (begin < end && *begin == '+') {
+    ++begin;
+  }
+  double value = 0;
+  std::from_chars(begin, end, value);
+  return value * scale;
+}
+
+/// Frequency values may carry a "Hz" suffix, e.g. 1GHz or 10kHz
+static inline double
+frequencyValue(std::string_view str)
+{
+  if (str.size() > 2 && 
+      (str[str.size()-2] == 'H' || str[str.size()-2] == 'h') &&
+      (str.back() == 'Z' || str.back() == 'z')) {
+    str.remove_suffix(2);
+  }
+  return numericalValue(str, "");
 }
 
 static PWLValue
-parsePWLData(std::vector<std::string>& strs, size_t startIndex)
+parsePWLData(const std::vector<std::string_view>& strs, size_t startIndex)
 {
   PWLValue pwlData;
   size_t dataIndex = 0;
   for (size_t i=startIndex; i<strs.size(); ++i) {
-    std::string& str = strs[i];
+    std::string_view str = strs[i];
     if (i == startIndex) {
-      if (strncmp(str.data(), "PWL(", 3) == 0 || 
-          strncmp(str.data(), "pwl", 3) == 0) {
-        str.erase(0, 3);
+      if (str.compare(0, 3, "PWL") == 0 || str.compare(0, 3, "pwl") == 0) {
+        str.remove_prefix(3);
       }
     }
-    if (str[0] == '(') {
-      str.erase(0, 1);
+    if (str.empty() == false && str.front() == '(') {
+      str.remove_prefix(1);
     } 
-    if (str.back() == ')') {
-      str.pop_back();
+    if (str.empty() == false && str.back() == ')') {
+      str.remove_suffix(1);
     }
     if (str.size() > 0) {
       if ((dataIndex & 0x1) == 0) {
@@ -276,225 +416,173 @@ parsePWLData(std::vector<std::string>& strs, size_t startIndex)
   return pwlData;
 }
 
-/*
-struct PWLValue
-pulseToPWLValue(double initValue, double puleValue, double delay, 
-                double riseTime, double fallTime, double width, double period)
-{
-  
-}
-*/
-
-static inline size_t 
-findOrCreateNode(std::unordered_map<std::string, size_t>& nodeMap, 
-                 const std::string& nodeName)
-{
-  auto found = nodeMap.find(nodeName);
-  if (found == nodeMap.end()) {
-    size_t id = nodeMap.size();
-    nodeMap.insert({nodeName, id});
-    return id;
-  } else {
-    return found->second;
-  }
-}
+/// Devices, node names and PWL data parsed from a range of the netlist.
+/// Node IDs and PWL indices are local to the chunk until it is merged.
+struct NetlistChunk {
+  /// Offsets of the first line and after the last line parsed
+  size_t                    _begin = 0;
+  size_t                    _end = 0;
+  std::vector<ParserDevice> _devices;
+  SymbolTable               _nodeNames;
+  std::vector<PWLValue>     _PWLData;
+  /// Messages in file order, printed after all chunks are merged
+  std::vector<std::string>  _messages;
+};
 
-static inline size_t 
-findNode(const std::unordered_map<std::string, size_t>& nodeMap, 
-         const std::string& nodeName)
+static void
+deferMessage(NetlistChunk& chunk, const char* format, std::string_view line)
 {
-  auto found = nodeMap.find(nodeName);
-  if (found == nodeMap.end()) {
-    return static_cast<size_t>(-1);
-  } else {
-    return found->second;
-  }
+  int length = static_cast<int>(line.size());
+  int size = snprintf(nullptr, 0, format, length, line.data());
+  std::string message(size, '\0');
+  snprintf(&message[0], size+1, format, length, line.data());
+  chunk._messages.push_back(std::move(message));
 }
 
 static void
 addTwoTermDevice(DeviceType type, 
-                 std::vector<std::string>& strs,  
-                 std::vector<ParserDevice>& devices, 
+                 const std::vector<std::string_view>& strs,  
+                 NetlistChunk& chunk,
                  const char* units)
 {
   ParserDevice dev;
   dev._type = type;
-  dev._name.assign(strs[0].begin(), strs[0].end());
-  dev._posNode = strs[1]; 
-  dev._negNode = strs[2]; 
+  dev._name.assign(strs[0]);
+  dev._posNode = chunk._nodeNames.intern(strs[1]); 
+  dev._negNode = chunk._nodeNames.intern(strs[2]); 
   dev._value = numericalValue(strs[3], units);
-  devices.push_back(dev);
+  chunk._devices.push_back(std::move(dev));
 }
 
 static void 
-addResistor(const std::string& line, std::vector<ParserDevice>& devices)
+addResistor(std::string_view line, const std::vector<std::string_view>& strs, 
+            NetlistChunk& chunk)
 {
-  std::vector<std::string> strs;
-  splitWithAny(line, " \t\r", strs);
   if (strs.size() < 4) {
-    printf("Unsupported syntax %s\n", line.data());
+    deferMessage(chunk, "Unsupported syntax %.*s\n", line);
     return;
   }
-  addTwoTermDevice(DeviceType::Resistor, strs, devices, "");
+  addTwoTermDevice(DeviceType::Resistor, strs, chunk, "");
 }
 
 static void 
-addCapacitor(const std::string& line, std::vector<ParserDevice>& devices)
+addCapacitor(std::string_view line, const std::vector<std::string_view>& strs, 
+             NetlistChunk& chunk)
 {
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
   if (strs.size() < 4) {
-    printf("Unsupported syntax %s\n", line.data());
+    deferMessage(chunk, "Unsupported syntax %.*s\n", line);
     return;
   }
-  addTwoTermDevice(DeviceType::Capacitor, strs, devices, "");
+  addTwoTermDevice(DeviceType::Capacitor, strs, chunk, "");
 }
 
 static void 
-addInductor(const std::string& line, std::vector<ParserDevice>& devices)
+addInductor(std::string_view line, const std::vector<std::string_view>& strs, 
+            NetlistChunk& chunk)
 {
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
   if (strs.size() < 4) {
-    printf("Unsupported syntax %s\n", line.data());
+    deferMessage(chunk, "Unsupported syntax %.*s\n", line);
     return;
   }
-  addTwoTermDevice(DeviceType::Inductor, strs, devices, "hH");
-}
-
-void 
-addIndependentSource(DeviceType type, const std::string& line, 
-                     std::vector<ParserDevice>& devices, 
-                     std::vector<PWLValue>& PWLData)
-{
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
-  if (strs.size() == 4) {
-    addTwoTermDevice(type, strs, devices, "VvAa");
-  } else if (strs.size() > 4 && 
-            (strncmp(strs[3].data(), "PWL", 3) == 0 || 
-             strncmp(strs[3].data(), "pwl", 3) == 0)) {
-    
-    const PWLValue& pwlData = parsePWLData(strs, 3);
-    ParserDevice dev;
-    dev._type = type;
-    dev._name.assign(strs[0].begin(), strs[0].end());
-    dev._posNode = strs[1]; 
-    dev._negNode = strs[2]; 
-    dev._isPWLValue = true;
-    dev._PWLData = PWLData.size();
-    devices.push_back(dev);
-    PWLData.push_back(pwlData);
-  } else {
-    printf("Unsupported syntax %s\n", line.data());
-  }
-}
-
-static void 
-addVoltageSource(const std::string& line, 
-                 std::vector<ParserDevice>& devices, 
-                 std::vector<PWLValue>& PWLData)
-{
-  addIndependentSource(DeviceType::VoltageSource, line, devices, PWLData);
-}
-
-static void 
-addCurrentSource(const std::string& line, 
-                 std::vector<ParserDevice>& devices, 
-                 std::vector<PWLValue>& PWLData)
-{
-  addIndependentSource(DeviceType::CurrentSource, line, devices, PWLData);
+  addTwoTermDevice(DeviceType::Inductor, strs, chunk, "hH");
 }
 
-static void
-addDependentDevice(DeviceType type,
-                   std::vector<std::string>& strs,
-                   std::vector<ParserDevice>& devices)
+static inline bool
+isKeyword(std::string_view str, const char* upper, const char* lower)
 {
-  ParserDevice dev;
-  dev._type = type;
-  dev._name.assign(strs[0].begin(), strs[0].end());
-  dev._posNode = strs[1]; 
-  dev._negNode = strs[2];
-  dev._posSampleNode = strs[3];
-  dev._negSampleNode = strs[4]; 
-  dev._value = numericalValue(strs[5], "");
-  devices.push_back(dev);
+  return str == upper || str == lower;
 }
 
+/// Syntax: Vname N+ N- [[DC] value | PWL(...)] [AC mag [phase]]
+/// The AC spec only drives AC analysis, the source is 0 in .ac otherwise
 static void 
-addVCVS(const std::string& line, 
-        std::vector<ParserDevice>& devices, 
-        std::vector<PWLValue>& /*PWLData*/)
+addIndependentSource(DeviceType type, std::string_view line, 
+                     const std::vector<std::string_view>& strs, 
+                     NetlistChunk& chunk)
 {
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
-  if (strs.size() != 6) {
-    printf("Unsupported syntax line\"%s\"\n", line.data());
-    return;
+  std::vector<std::string_view> valueStrs(strs);
+  bool hasAC = false;
+  double acMag = 0;
+  double acPhase = 0;
+  for (size_t i=3; i<strs.size(); ++i) {
+    if (isKeyword(strs[i], "AC", "ac")) {
+      if (strs.size() > i + 3) {
+        deferMessage(chunk, "Unsupported syntax %.*s\n", line);
+        return;
+      }
+      acMag = (strs.size() > i + 1) ? numericalValue(strs[i+1], "VvAa") : 1;
+      acPhase = (strs.size() > i + 2) ? numericalValue(strs[i+2], "") : 0;
+      valueStrs.resize(i);
+      hasAC = true;
+      break;
+    }
   }
-  addDependentDevice(DeviceType::VCVS, strs, devices);
-}
-
-static void 
-addVCCS(const std::string& line, 
-        std::vector<ParserDevice>& devices, 
-        std::vector<PWLValue>& /*PWLData*/)
-{
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
-  if (strs.size() != 6) {
-    printf("Unsupported syntax line\"%s\"\n", line.data());
-    return;
+  if (valueStrs.size() > 3 && isKeyword(valueStrs[3], "DC", "dc")) {
+    valueStrs.erase(valueStrs.begin() + 3);
   }
-  addDependentDevice(DeviceType::VCCS, strs, devices);
-}
-
-static void 
-addCCVS(const std::string& line, 
-        std::vector<ParserDevice>& devices, 
-        std::vector<PWLValue>& /*PWLData*/) 
-{
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
-  if (strs.size() != 6) {
-    printf("Unsupported syntax line\"%s\"\n", line.data());
+  if (valueStrs.size() == 3 && hasAC) {
+    /// AC only source
+    valueStrs.push_back("0");
+  }
+  if (valueStrs.size() == 4) {
+    addTwoTermDevice(type, valueStrs, chunk, "VvAa");
+  } else if (valueStrs.size() > 4 && 
+            (valueStrs[3].compare(0, 3, "PWL") == 0 || 
+             valueStrs[3].compare(0, 3, "pwl") == 0)) {
+    
+    ParserDevice dev;
+    dev._type = type;
+    dev._name.assign(valueStrs[0]);
+    dev._posNode = chunk._nodeNames.intern(valueStrs[1]); 
+    dev._negNode = chunk._nodeNames.intern(valueStrs[2]); 
+    dev._isPWLValue = true;
+    dev._PWLData = chunk._PWLData.size();
+    chunk._devices.push_back(std::move(dev));
+    chunk._PWLData.push_back(parsePWLData(valueStrs, 3));
+  } else {
+    deferMessage(chunk, "Unsupported syntax %.*s\n", line);
     return;
   }
-  addDependentDevice(DeviceType::CCVS, strs, devices);
+  chunk._devices.back()._acMag = acMag;
+  chunk._devices.back()._acPhase = acPhase;
 }
 
-static void 
-addCCCS(const std::string& line, 
-        std::vector<ParserDevice>& devices, 
-        std::vector<PWLValue>& /*PWLData*/)
+static void
+addDependentDevice(DeviceType type, std::string_view line,
+                   const std::vector<std::string_view>& strs,
+                   NetlistChunk& chunk)
 {
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
   if (strs.size() != 6) {
-    printf("Unsupported syntax line\"%s\"\n", line.data());
+    deferMessage(chunk, "Unsupported syntax line\"%.*s\"\n", line);
     return;
   }
-  addDependentDevice(DeviceType::CCCS, strs, devices);
+  ParserDevice dev;
+  dev._type = type;
+  dev._name.assign(strs[0]);
+  dev._posNode = chunk._nodeNames.intern(strs[1]); 
+  dev._negNode = chunk._nodeNames.intern(strs[2]);
+  dev._posSampleNode = chunk._nodeNames.intern(strs[3]);
+  dev._negSampleNode = chunk._nodeNames.intern(strs[4]); 
+  dev._value = numericalValue(strs[5], "");
+  chunk._devices.push_back(std::move(dev));
 }
 
 static void 
-addCell(const std::string& line, std::vector<ParserDevice>& devices)
+addCell(std::string_view line, const std::vector<std::string_view>& strs, 
+        NetlistChunk& chunk)
 {
-  std::vector<std::string> strs;
-  splitWithAny(line, " ", strs);
   if (strs.size() < 4) {
-    printf("Unsupported syntax %s\n", line.data());
+    deferMessage(chunk, "Unsupported syntax %.*s\n", line);
     return;
   }
   ParserDevice dev;
   dev._type = DeviceType::Cell;
-  dev._name.assign(strs[0].begin(), strs[0].end());
-  dev._libCellName = strs[1];
-  for (size_t i=2; i<strs.size(); i+=2) {
-    dev._pinMap.insert({strs[i], strs[i+1]});
+  dev._name.assign(strs[0]);
+  dev._libCellName.assign(strs[1]);
+  for (size_t i=2; i+1<strs.size(); i+=2) {
+    dev._pinMap.insert({std::string(strs[i]), chunk._nodeNames.intern(strs[i+1])});
   }
-  devices.push_back(dev);
+  chunk._devices.push_back(std::move(dev));
 }
 
 AnalysisParameter*
@@ -559,6 +647,10 @@ NetlistParser::processOption(const std::string& line)
         intMethod = IntegrateMethod::BackwardEuler;
       } else if (strs[i].compare("trap") == 0) {
         intMethod = IntegrateMethod::Trapezoidal;
+      } else if (strs[i].compare("exp") == 0) {
+        intMethod = IntegrateMethod::Exponential;
+      } else if (strs[i].compare("bdf") == 0) {
+        intMethod = IntegrateMethod::BDF;
       } else {
         intMethod = IntegrateMethod::Gear2;
         printf("Integrate method \"%s\" is not supported, using default gear2\n", strs[i].data());
@@ -575,6 +667,44 @@ NetlistParser::processOption(const std::string& line)
       } else {
         printf("Value provided to post is not supported and ignored\n");
       }
+    } else if (strs[i].compare("reduce") == 0 || strs[i].compare("reducetol") == 0) {
+      if (analysisName.empty()) {
+        analysisName = "tran";
+      }
+      AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
+      bool isTol = strs[i].compare("reducetol") == 0;
+      ++i;
+      if (isTol) {
+        param->_reduceTol = numericalValue(strs[i], "");
+      } else {
+        param->_reduce = strs[i].compare("1") == 0;
+      }
+    } else if (strs[i].compare("maxorder") == 0 || strs[i].compare("reltol") == 0 ||
+               strs[i].compare("vntol") == 0 || strs[i].compare("abstol") == 0) {
+      if (analysisName.empty()) {
+        analysisName = "tran";
+      }
+      AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
+      const std::string& name = strs[i];
+      ++i;
+      if (name.compare("maxorder") == 0) {
+        unsigned order = strtoul(strs[i].data(), nullptr, 10);
+        if (order < 1 || order > BDFCoefficients::maxOrder) {
+          printf("WARNING: maxorder %s is out of range 1 to %lu and ignored\n", 
+                 strs[i].data(), BDFCoefficients::maxOrder);
+        } else {
+          param->_maxOrder = order;
+        }
+      } else if (name.compare("reltol") == 0) {
+        param->_relTol = numericalValue(strs[i], "");
+      } else if (name.compare("vntol") == 0) {
+        param->_vnTol = numericalValue(strs[i], "Vv");
+      } else {
+        param->_absTol = numericalValue(strs[i], "Aa");
+      }
+    } else if (strs[i].compare("snapshot") == 0) {
+      ++i;
+      _useSnapshot = strs[i].compare("1") == 0;
     } else if (strs[i].compare("pzorder") == 0) {
       //AnalysisType paramType = AnalysisType::PZ;
       if (analysisName.empty()) {
@@ -583,6 +713,20 @@ NetlistParser::processOption(const std::string& line)
       AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
       ++i;
       param->_order = strtoul(strs[i].data(), nullptr, 10);
+    } else if (strs[i].compare("pzmethod") == 0) {
+      if (analysisName.empty()) {
+        analysisName = "pz";
+      }
+      AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
+      ++i;
+      if (iequals(strs[i], "arnoldi")) {
+        param->_pzMethod = PZMethod::Arnoldi;
+      } else if (iequals(strs[i], "moment")) {
+        param->_pzMethod = PZMethod::Moment;
+      } else {
+        param->_pzMethod = PZMethod::Arnoldi;
+        printf("PZ method \"%s\" is not supported, using default arnoldi\n", strs[i].data());
+      }
     } else if (strs[i].compare("driver") == 0) {
       //AnalysisType paramType = AnalysisType::FD;
       if (analysisName.empty()) {
@@ -692,8 +836,8 @@ processPlot(const std::string& line,
   splitWithAny(line, " =", strs);
   /// strs[0] == .plot, discard
   toLower(strs[1]);
-  if (strs[1].compare("tran") != 0) {
-    printf("Only tran mode is supported in .plot command\n");
+  if (strs[1].compare("tran") != 0 && strs[1].compare("ac") != 0) {
+    printf("Only tran and ac modes are supported in .plot command\n");
     return;
   }
   PlotData* plotData = nullptr;
@@ -900,36 +1044,41 @@ NetlistParser::processCommands(const std::string& line)
     }
     std::string analysisName;
     size_t index = 1;
-    if (strs.size() == 3) {
+    if (strs.size() > 1 && strs[1].find('(') == std::string::npos) {
+      analysisName = strs[1];
+      index++;
+    } else {
       if (analysisType == AnalysisType::PZ) {
         analysisName = "pz";
       } else if (analysisType == AnalysisType::TF) {
         analysisName = "tf";
       }
-    } else {
-      analysisName = strs[1];
-      index++;
     }
-    char c1 = firstChar(strs[index]);
-    char c2 = firstChar(strs[index+1]);
-    if ((c1 != 'V' && c1 != 'v') ||
-        (c2 != 'I' && c2 != 'i')) {
+    /// Syntax: .pz [name] V(OUT1) [V(OUT2) ...] I(IN)
+    if (strs.size() < index + 2) {
       printf("Invalid syntax in line \"%s\"\n", line.data());
       return;
     }
+    std::vector<std::string> outNodes;
     size_t startIndex, endIndex;
-    if (findNameInParenthesis(strs[index], startIndex, endIndex) == false || 
-        startIndex == strs[index].size() || endIndex == 0) {
-      printf("Invalid syntax in line \"%s\"\n", line.data());
-      return;
+    for (; index<strs.size()-1; ++index) {
+      char c = firstChar(strs[index]);
+      if ((c != 'V' && c != 'v') || 
+          findNameInParenthesis(strs[index], startIndex, endIndex) == false || 
+          startIndex == strs[index].size() || endIndex == 0) {
+        printf("Invalid syntax in line \"%s\"\n", line.data());
+        return;
+      }
+      outNodes.push_back(strs[index].substr(startIndex + 1, endIndex - startIndex - 1));
     }
-    std::string outNode = strs[index].substr(startIndex + 1, endIndex - startIndex - 1);
-    if (findNameInParenthesis(strs[index+1], startIndex, endIndex) == false || 
-        startIndex == strs[index+1].size() || endIndex == 0) {
+    char c = firstChar(strs[index]);
+    if ((c != 'I' && c != 'i') ||
+        findNameInParenthesis(strs[index], startIndex, endIndex) == false || 
+        startIndex == strs[index].size() || endIndex == 0) {
       printf("Invalid syntax in line \"%s\"\n", line.data());
       return;
     }
-    std::string inDev = strs[index+1].substr(startIndex + 1, endIndex - startIndex - 1);
+    std::string inDev = strs[index].substr(startIndex + 1, endIndex - startIndex - 1);
     AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
     if (param->_type != AnalysisType::None && param->_type != analysisType) {
       printf("ERROR: Found another kind of analysis with same analysis name \"%s\"\n", analysisName.data());
@@ -937,20 +1086,94 @@ NetlistParser::processCommands(const std::string& line)
     }
     param->_type = analysisType;
     param->_name = analysisName;
-    param->_outNode = new std::string(outNode);
-    param->_inDev = new std::string(inDev);
+    param->_outNodes = outNodes;
+    param->_inDev = inDev;
     if (param->_order == 0) {
       param->_order = 4;
     }
+  } else if (strs[0] == ".elmore") {
+    /// Syntax: .elmore [name] [V(OUT1) V(OUT2) ...]
+    AnalysisType analysisType = AnalysisType::Elmore;
+    std::string analysisName = "elmore";
+    size_t index = 1;
+    if (strs.size() > 1 && strs[1].find('(') == std::string::npos) {
+      analysisName = strs[1];
+      index++;
+    }
+    std::vector<std::string> outNodes;
+    size_t startIndex, endIndex;
+    for (; index<strs.size(); ++index) {
+      char c = firstChar(strs[index]);
+      if ((c != 'V' && c != 'v') || 
+          findNameInParenthesis(strs[index], startIndex, endIndex) == false || 
+          startIndex == strs[index].size() || endIndex == 0) {
+        printf("Invalid syntax in line \"%s\"\n", line.data());
+        return;
+      }
+      outNodes.push_back(strs[index].substr(startIndex + 1, endIndex - startIndex - 1));
+    }
+    AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
+    if (param->_type != AnalysisType::None && param->_type != analysisType) {
+      printf("ERROR: Found another kind of analysis with same analysis name \"%s\"\n", analysisName.data());
+      exit(1);
+    }
+    param->_type = analysisType;
+    param->_name = analysisName;
+    param->_outNodes = outNodes;
+  } else if (strs[0] == ".ac") {
+    /// Syntax: .ac [name] dec|oct|lin N fstart fstop
+    AnalysisType analysisType = AnalysisType::AC;
+    std::string analysisName;
+    size_t index = 1;
+    if (strs.size() == 5) {
+      analysisName = "ac";
+    } else if (strs.size() == 6) {
+      analysisName = strs[1];
+      index++;
+    } else {
+      printf("Invalid syntax in line \"%s\"\n", line.data());
+      return;
+    }
+    ACSweep sweep;
+    toLower(strs[index]);
+    if (strs[index] == "dec") {
+      sweep = ACSweep::Dec;
+    } else if (strs[index] == "oct") {
+      sweep = ACSweep::Oct;
+    } else if (strs[index] == "lin") {
+      sweep = ACSweep::Lin;
+    } else {
+      printf("Invalid sweep type \"%s\" in line \"%s\"\n", strs[index].data(), line.data());
+      return;
+    }
+    size_t points = strtoul(strs[index+1].data(), nullptr, 10);
+    double fStart = frequencyValue(strs[index+2]);
+    double fStop = frequencyValue(strs[index+3]);
+    if (points == 0 || fStart <= 0 || fStop < fStart) {
+      printf("Invalid frequency range in line \"%s\"\n", line.data());
+      return;
+    }
+    AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
+    if (param->_type != AnalysisType::None && param->_type != analysisType) {
+      printf("ERROR: Found another kind of analysis with same analysis name \"%s\"\n", analysisName.data());
+      exit(1);
+    }
+    param->_type = analysisType;
+    param->_name = analysisName;
+    param->_acSweep = sweep;
+    param->_acPoints = points;
+    param->_fStart = fStart;
+    param->_fStop = fStop;
   } else if (strs[0] == ".delay") {
     AnalysisType analysisType = AnalysisType::FD;
     std::string analysisName;
     size_t index = 1;
-    if (strs.size() % 2 == 0) {
-      analysisName = "fd";
-    } else {
+    /// Pin names are in inst/pin form, so the analysis name has no '/'
+    if (strs.size() > 1 && strs[1].find('/') == std::string::npos) {
       analysisName = strs[1];
       index++;
+    } else {
+      analysisName = "fd";
     }
     AnalysisParameter* param = getAnalysisParameter(analysisName, _analysisParams);
     if (param->_type != AnalysisType::None && param->_type != analysisType) {
@@ -959,6 +1182,13 @@ NetlistParser::processCommands(const std::string& line)
     }
     param->_type = analysisType;
     param->_name = analysisName;
+    /// Options given before .delay are kept
+    if (param->_driverModel == DriverModel::None) {
+      param->_driverModel = DriverModel::RampVoltage;
+    }
+    if (param->_loaderModel == LoaderModel::None) {
+      param->_loaderModel = LoaderModel::Fixed;
+    }
     for (; index<strs.size(); index++) {
       _cellOutPinsToCalc.push_back({strs[index]});
     }
@@ -978,61 +1208,243 @@ NetlistParser::processCommands(const std::string& line)
   }
 }
 
-void
-NetlistParser::parseLine(const std::string& line)
+static void
+parseLine(std::string_view line, std::vector<std::string_view>& tokens, 
+          NetlistChunk& chunk)
 {
   char c = firstChar(line);
   switch (c) {
     case 'R':
     case 'r':
-      addResistor(line, _devices);
+      splitTokens(line, tokens);
+      addResistor(line, tokens, chunk);
       break;
     case 'C':
     case 'c':
-      addCapacitor(line, _devices);
+      splitTokens(line, tokens);
+      addCapacitor(line, tokens, chunk);
       break;
     case 'L':
     case 'l':
-      addInductor(line, _devices);
+      splitTokens(line, tokens);
+      addInductor(line, tokens, chunk);
       break;
     case 'V':
     case 'v':
-      addVoltageSource(line, _devices, _PWLData);
+      splitTokens(line, tokens);
+      addIndependentSource(DeviceType::VoltageSource, line, tokens, chunk);
       break;
     case 'I':
     case 'i':
-      addCurrentSource(line, _devices, _PWLData);
+      splitTokens(line, tokens);
+      addIndependentSource(DeviceType::CurrentSource, line, tokens, chunk);
       break;
     case 'E':
     case 'e':
-      addVCVS(line, _devices, _PWLData);
+      splitTokens(line, tokens);
+      addDependentDevice(DeviceType::VCVS, line, tokens, chunk);
       break;
     case 'F':
     case 'f':
-      addCCCS(line, _devices, _PWLData);
+      splitTokens(line, tokens);
+      addDependentDevice(DeviceType::CCCS, line, tokens, chunk);
       break;
     case 'G':
     case 'g':
-      addVCCS(line, _devices, _PWLData);
+      splitTokens(line, tokens);
+      addDependentDevice(DeviceType::VCCS, line, tokens, chunk);
       break;
     case 'H':
     case 'h':
-      addCCVS(line, _devices, _PWLData);
+      splitTokens(line, tokens);
+      addDependentDevice(DeviceType::CCVS, line, tokens, chunk);
       break;
     case 'X':
     case 'x':
-      addCell(line, _devices);
+      splitTokens(line, tokens);
+      addCell(line, tokens, chunk);
       break;
     case '*':
       break;
     case '.':
-      processCommands(line);
+      /// Commands are processed by NetlistParser::scan
       break;
     case '\0':
       break;
     default:
-      printf("Ignoring line %s\n", line.data());
+      deferMessage(chunk, "Ignoring line %.*s\n", line);
+  }
+}
+
+/// Parse the lines starting in [begin, end) into chunk
+static void
+parseChunk(const char* data, size_t size, size_t begin, size_t end, 
+           NetlistChunk& chunk)
+{
+  chunk = NetlistChunk();
+  chunk._begin = begin;
+  /// Most lines of a large netlist are devices, a parasitic network
+  /// has about one node for every two devices. Reserving for them avoids
+  /// moving the devices and rehashing the node names while parsing
+  size_t lineCount = std::count(data + begin, data + end, '\n') + 1;
+  chunk._devices.reserve(lineCount);
+  chunk._nodeNames.reserve(lineCount / 2);
+  NetlistLineReader reader(data, begin, end, size);
+  std::vector<std::string_view> tokens;
+  std::string_view line;
+  while (reader.next(line)) {
+    parseLine(line, tokens, chunk);
+  }
+  chunk._end = reader.position();
+}
+
+/// Start of the first line at or after offset that does not continue 
+/// the line before it with '+'
+static size_t
+lineStartAfter(const char* data, size_t size, size_t offset)
+{
+  while (offset < size) {
+    const void* found = memchr(data + offset, '\n', size - offset);
+    if (found == nullptr) {
+      return size;
+    }
+    offset = static_cast<const char*>(found) - data + 1;
+    std::string_view next(data + offset, size - offset);
+    if (firstChar(next.substr(0, next.find('\n'))) != '+') {
+      return offset;
+    }
+  }
+  return size;
+}
+
+/// Netlists smaller than this are parsed by one thread
+static const size_t minChunkSize = 4 << 20;
+
+void
+NetlistParser::scan(const char* data, size_t size)
+{
+  /// Commands are processed in file order before any device is parsed.
+  /// The hash covers the device lines only, so changing analysis commands
+  /// or comments keeps the circuit snapshots of the netlist valid
+  NetlistLineReader reader(data, 0, size, size);
+  uint64_t hash = 0;
+  std::string_view line;
+  while (reader.next(line)) {
+    char c = firstChar(line);
+    if (c == '.') {
+      std::string command(line.substr(line.find('.')));
+      for (char& ch : command) {
+        if (std::iscntrl(static_cast<unsigned char>(ch))) {
+          ch = ' ';
+        }
+      }
+      processCommands(command);
+    } else if (c != '*' && c != '\0') {
+      hash = hash * 1099511628211ULL + std::hash<std::string_view>()(line);
+    }
+  }
+  _contentHash = hash;
+}
+
+void
+NetlistParser::parse(const char* data, size_t size) const
+{
+  /// The file is cut into chunks at line starts, and the chunks are parsed
+  /// in parallel into their own devices and node names. A chunk normally
+  /// ends where the next one starts. If a line with open parentheses runs
+  /// across a cut, the next chunk started in the middle of it and is
+  /// parsed again after the end of that line.
+  size_t chunkCount = threadNumber(size / minChunkSize);
+  std::vector<size_t> cuts(chunkCount + 1, size);
+  cuts[0] = 0;
+  for (size_t i=1; i<chunkCount; ++i) {
+    cuts[i] = lineStartAfter(data, size, std::max(cuts[i-1], size / chunkCount * i));
+  }
+  std::vector<NetlistChunk> chunks(chunkCount);
+  parallelFor(chunkCount, [&](size_t i) {
+    parseChunk(data, size, cuts[i], cuts[i+1], chunks[i]);
+  });
+  for (size_t i=1; i<chunkCount; ++i) {
+    size_t begin = chunks[i-1]._end;
+    if (begin != chunks[i]._begin) {
+      parseChunk(data, size, begin, std::max(begin, cuts[i+1]), chunks[i]);
+    }
+  }
+
+  /// Node names are interned chunk by chunk in file order, so node IDs
+  /// and device order are the same as parsing the file in one pass
+  if (chunkCount == 1) {
+    _devices = std::move(chunks[0]._devices);
+    _nodeNames = std::move(chunks[0]._nodeNames);
+    _PWLData = std::move(chunks[0]._PWLData);
+  } else {
+    std::vector<size_t> deviceOffsets(chunkCount + 1, 0);
+    std::vector<size_t> PWLOffsets(chunkCount + 1, 0);
+    size_t nodeCount = 0;
+    for (size_t i=0; i<chunkCount; ++i) {
+      deviceOffsets[i+1] = deviceOffsets[i] + chunks[i]._devices.size();
+      PWLOffsets[i+1] = PWLOffsets[i] + chunks[i]._PWLData.size();
+      nodeCount += chunks[i]._nodeNames.size();
+    }
+    std::vector<std::vector<SymbolId>> nodeIds(chunkCount);
+    _nodeNames.reserve(nodeCount);
+    for (size_t i=0; i<chunkCount; ++i) {
+      const SymbolTable& names = chunks[i]._nodeNames;
+      nodeIds[i].resize(names.size());
+      for (SymbolId id=0; id<names.size(); ++id) {
+        nodeIds[i][id] = _nodeNames.intern(names.name(id));
+      }
+    }
+    _devices.resize(deviceOffsets[chunkCount]);
+    _PWLData.resize(PWLOffsets[chunkCount]);
+    parallelFor(chunkCount, [&](size_t i) {
+      const std::vector<SymbolId>& globalIds = nodeIds[i];
+      auto globalId = [&globalIds](SymbolId id) {
+        return id == invalidSymbol ? id : globalIds[id];
+      };
+      NetlistChunk& chunk = chunks[i];
+      for (size_t j=0; j<chunk._devices.size(); ++j) {
+        ParserDevice& dev = chunk._devices[j];
+        dev._posNode = globalId(dev._posNode);
+        dev._negNode = globalId(dev._negNode);
+        dev._posSampleNode = globalId(dev._posSampleNode);
+        dev._negSampleNode = globalId(dev._negSampleNode);
+        for (auto& kv : dev._pinMap) {
+          kv.second = globalId(kv.second);
+        }
+        if (dev._isPWLValue) {
+          dev._PWLData += PWLOffsets[i];
+        }
+        _devices[deviceOffsets[i] + j] = std::move(dev);
+      }
+      std::move(chunk._PWLData.begin(), chunk._PWLData.end(), 
+                _PWLData.begin() + PWLOffsets[i]);
+      chunk._devices = std::vector<ParserDevice>();
+      chunk._nodeNames = SymbolTable();
+      chunk._PWLData = std::vector<PWLValue>();
+    });
+  }
+
+  for (const NetlistChunk& chunk : chunks) {
+    for (const std::string& message : chunk._messages) {
+      fputs(message.data(), stdout);
+    }
+  }
+}
+
+std::vector<std::string>
+NetlistParser::libCellNames() const
+{
+  parseDevices();
+  std::vector<std::string> cells;
+  for (const ParserDevice& dev : _devices) {
+    if (dev._type == DeviceType::Cell) {
+      cells.push_back(dev._libCellName);
+    }
   }
+  std::sort(cells.begin(), cells.end());
+  cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+  return cells;
 }
 
 bool 
@@ -1,19 +1,23 @@
 #ifndef _TRAN_NLPS_H_
 #define _TRAN_NLPS_H_
 
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
 #include "Base.h"
+#include "SymbolTable.h"
 
 namespace NA {
 
 struct ParserDevice {
   std::string _name;
-  std::string _posNode;
-  std::string _negNode;
-  std::string _posSampleNode;
-  std::string _negSampleNode;
+  /// Nodes are IDs in the node name table of the netlist
+  SymbolId    _posNode = invalidSymbol;
+  SymbolId    _negNode = invalidSymbol;
+  SymbolId    _posSampleNode = invalidSymbol;
+  SymbolId    _negSampleNode = invalidSymbol;
   DeviceType  _type;
   bool        _isPWLValue = false;
   bool        _isInternal = false;
@@ -21,9 +25,13 @@ struct ParserDevice {
     double    _value;
     size_t    _PWLData = 0;
   };
+  /// AC stimulus of independent sources, phase in degrees
+  double      _acMag = 0;
+  double      _acPhase = 0;
   /// For cell type devices
   std::string _libCellName;
-  std::unordered_map<std::string, std::string> _pinMap;
+  /// Pin name to node ID
+  std::unordered_map<std::string, SymbolId> _pinMap;
 };
 
 struct MeasurePoint {
@@ -50,11 +58,16 @@ class NetlistParser {
   public:
     NetlistParser(const char* fileName);
 
-    /// Circuit information
-    std::vector<ParserDevice> devices() const { return _devices; }
-    std::vector<PWLValue> PWLData() const { return _PWLData; }
+    /// Circuit information, devices are parsed on the first call when
+    /// circuit snapshots are enabled
+    const std::vector<ParserDevice>& devices() const { parseDevices(); return _devices; }
+    /// Names of the nodes referenced by devices()
+    const SymbolTable& nodeNames() const { parseDevices(); return _nodeNames; }
+    std::vector<PWLValue> PWLData() const { parseDevices(); return _PWLData; }
     const std::string& userGroundNet() const { return _groundNet; }
     std::vector<std::string> libDataFiles() const { return _libDataFiles; }
+    /// Lib cells instantiated by the netlist
+    std::vector<std::string> libCellNames() const;
 
     /// Plot information
     const std::vector<PlotData>& plotData() const { return _plotData; }
@@ -65,6 +78,12 @@ class NetlistParser {
 
     bool dumpData() const { return _saveData; }
 
+    /// Circuit snapshot information
+    const std::string& fileName() const { return _fileName; }
+    bool useSnapshot() const { return _useSnapshot; }
+    /// Hash of the device lines, commands and comments are not included
+    uint64_t contentHash() const { return _contentHash; }
+
     /// Measure information
     bool haveMeasurePoints(const std::string& simName) const;
     std::vector<MeasurePoint> measurePoints(const std::string& simName) const;
@@ -74,19 +93,32 @@ class NetlistParser {
     std::vector<std::string> cellOutPinsToCalcDelay() const { return _cellOutPinsToCalc; }
 
   private:
-    void parseLine(const std::string& line);
+    /// Process the commands of the mapped netlist and hash its device lines
+    void scan(const char* data, size_t size);
+    /// Parse the devices of the mapped netlist, in parallel when it is large
+    void parse(const char* data, size_t size) const;
+    void parseDevices() const;
     void processCommands(const std::string& line);
     void processOption(const std::string& line);
 
 
   private:
-    std::vector<ParserDevice>         _devices;
-    std::vector<PWLValue>             _PWLData;
+    std::string                       _fileName;
+    /// The mapped file is kept until the devices are parsed
+    mutable std::shared_ptr<const char> _content;
+    size_t                            _contentSize = 0;
+    uint64_t                          _contentHash = 0;
+    double                            _scanTimeNs = 0;
+    mutable std::vector<ParserDevice> _devices;
+    mutable SymbolTable               _nodeNames;
+    mutable std::vector<PWLValue>     _PWLData;
+    mutable bool                      _devicesParsed = false;
     std::vector<std::string>          _libDataFiles;
     std::vector<MeasurePoint>         _measurePoints;
     std::vector<AnalysisParameter>    _analysisParams;
     std::vector<std::string>          _cellOutPinsToCalc;
     bool                              _saveData = false;
+    bool                              _useSnapshot = false;
     int                               _plotWidth = -1;
     int                               _plotHeight = -1;
     std::string                       _groundNet;
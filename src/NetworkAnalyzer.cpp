@@ -4,6 +4,9 @@
 #include "Circuit.h"
 #include "Simulator.h"
 #include "PoleZero.h"
+#include "ACAnalysis.h"
+#include "RCTree.h"
+#include "FullStageDelay.h"
 #include "TR0Writer.h"
 #include "Plotter.h"
 #include "Measure.h"
@@ -22,6 +25,18 @@ NetworkAnalyzer::run(const char* inFile)
   const std::vector<NA::AnalysisParameter>& params = parser.analysisParameters();
   for (const NA::AnalysisParameter& param : params) {
     if (param._type == NA::AnalysisType::FD) {
+      /// Cell arcs refer to the lib data owned by the circuit, 
+      /// so this circuit is kept in place instead of moved into circuits
+      NA::Circuit circuit(parser, param);
+      NA::FullStageDelay fd(circuit, param, parser.cellOutPinsToCalcDelay());
+      printf("Starting full-stage delay calculation\n");
+      timespec start;
+      clock_gettime(CLOCK_REALTIME, &start);
+      fd.run();
+      timespec end;
+      clock_gettime(CLOCK_REALTIME, &end);
+      printf("Full-stage delay calculation finished in %.3f seconds\n", 
+             1e-9*timeDiffNs(end, start));
       continue;
     }
     circuits.push_back(NA::Circuit(parser, param));
@@ -35,8 +50,12 @@ NetworkAnalyzer::run(const char* inFile)
         tranSim.run();
         timespec end;
         clock_gettime(CLOCK_REALTIME, &end);
-        printf("Simulation finished, %lu steps simulated in %.3f seconds\n", 
-               tranSim.simulationResult().size(), 1e-9*timeDiffNs(end, start));
+        /// The scope is the reduced circuit with .option reduce=1, so runs
+        /// with and without reduction can be compared from this line
+        printf("Simulation finished, %lu steps simulated in %.3f seconds, "
+               "%lu nodes and %lu devices simulated\n", 
+               tranSim.simulationResult().size(), 1e-9*timeDiffNs(end, start),
+               circuit.nodesToSimulate().size(), circuit.devicesToSimulate().size());
         results.push_back(tranSim.simulationResult());
         if (parser.dumpData()) {
           std::string tr0File;
@@ -63,6 +82,38 @@ NetworkAnalyzer::run(const char* inFile)
         }
         break;
       }
+      case NA::AnalysisType::AC: {
+        NA::ACAnalysis ac(circuit, param);
+        printf("Starting AC analysis\n");
+        timespec start;
+        clock_gettime(CLOCK_REALTIME, &start);
+        ac.run();
+        timespec end;
+        clock_gettime(CLOCK_REALTIME, &end);
+        printf("AC analysis finished, %lu frequency points solved in %.3f seconds\n", 
+               ac.result().size(), 1e-9*timeDiffNs(end, start));
+        results.push_back(ac.result());
+        if (parser.dumpData()) {
+          std::string ac0File;
+          ac0File = fileNameWithoutSuffix(inFile);
+          ac0File += ".ac0";
+          printf("Writing AC analysis data to %s\n", ac0File.data());
+          NA::TR0Writer writer(circuit, ac0File);
+          writer.writeData(ac.result());
+        }
+        break;
+      }
+      case NA::AnalysisType::Elmore: {
+        NA::RCTreeAnalysis rcTree(circuit, param);
+        timespec start;
+        clock_gettime(CLOCK_REALTIME, &start);
+        rcTree.run();
+        timespec end;
+        clock_gettime(CLOCK_REALTIME, &end);
+        printf("Elmore analysis finished in %.3f milliseconds\n", 1e-6*timeDiffNs(end, start));
+        results.push_back(rcTree.result());
+        break;
+      }
       default:
         // Do nothing for now
         break;
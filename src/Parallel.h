@@ -0,0 +1,60 @@
+#ifndef _NA_PARALLEL_H_
+#define _NA_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace NA {
+
+/// Number of worker threads to use for jobNumber independent jobs,
+/// limited by maxThreads when it is not 0
+inline size_t
+threadNumber(size_t jobNumber, size_t maxThreads = 0)
+{
+  size_t n = std::thread::hardware_concurrency();
+  if (n == 0) {
+    n = 1;
+  }
+  if (maxThreads != 0) {
+    n = std::min(n, maxThreads);
+  }
+  return std::max(static_cast<size_t>(1), std::min(n, jobNumber));
+}
+
+/// Call func(i) for every i in [0, n). Indices are handed out one by one
+/// from a shared counter, so jobs with unbalanced cost are spread evenly.
+/// func must only write to data owned by index i.
+template <typename Func>
+void
+parallelFor(size_t n, Func func, size_t maxThreads = 0)
+{
+  size_t threads = threadNumber(n, maxThreads);
+  if (threads <= 1) {
+    for (size_t i=0; i<n; ++i) {
+      func(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      func(i);
+    }
+  };
+  std::vector<std::thread> pool;
+  pool.reserve(threads - 1);
+  for (size_t i=0; i<threads-1; ++i) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread& t : pool) {
+    t.join();
+  }
+}
+
+}
+
+#endif
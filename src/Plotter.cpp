@@ -170,7 +170,7 @@ Plotter::plot(const PlotData& data, const std::vector<Circuit>& ckts,
       max = std::max(max, nodeMax);
       min = std::min(min, nodeMin);
       std::string l(1, markers[plotCounter]);
-      l += ": Voltage of node ";
+      l += result->isComplex() ? ": Voltage magnitude of node " : ": Voltage of node ";
       l += nodeName;
       legend.push_back(l);
       ++plotCounter;
@@ -197,7 +197,7 @@ Plotter::plot(const PlotData& data, const std::vector<Circuit>& ckts,
       max = std::max(max, devMax);
       min = std::min(min, devMin);
       std::string l(1, markers[plotCounter]);
-      l += ": Current of device ";
+      l += result->isComplex() ? ": Current magnitude of device " : ": Current of device ";
       l += devName;
       legend.push_back(l);
       ++plotCounter;
@@ -242,7 +242,7 @@ Plotter::plotNodeVoltage(const std::string& nodeName, const std::string& simName
     for (const std::string& line : canvas) {
       printf("%s\n", line.data());
     }
-    printf("  Voltage of node %s\n", nodeName.data());
+    printf("  Voltage%s of node %s\n", result->isComplex() ? " magnitude" : "", nodeName.data());
   }
 }
 
@@ -265,7 +265,7 @@ Plotter::plotDeviceCurrent(const std::string& devName, const std::string& simNam
     for (const std::string& line : canvas) {
       printf("%s\n", line.data());
     }
-    printf("  Current of device %s\n", devName.data());
+    printf("  Current%s of device %s\n", result->isComplex() ? " magnitude" : "", devName.data());
   }
 }
 
@@ -1,10 +1,12 @@
 #include <cstdio>
 #include <algorithm>
 #include <Eigen/Eigenvalues>
+#include <Eigen/SparseLU>
 #include "PoleZero.h"
 #include "MNAStamper.h"
 #include "Debug.h"
 #include "rpoly.h"
+#include "Parallel.h"
 
 #include <iostream>
 
@@ -15,20 +17,41 @@ using namespace Eigen;
 PoleZeroAnalysis::PoleZeroAnalysis(const Circuit& circuit, const AnalysisParameter& param)
 : _circuit(circuit), _param(param), _result(&circuit, param._name)
 {
-  _inDev = _circuit.findDeviceByName(*(_param._inDev));
-  _outNode = _circuit.findNodeByName(*(_param._outNode));
+  _inDev = _circuit.findDeviceByName(_param._inDev);
+  resolveOutputNodes();
   _eqnDim = _result.indexMap().size();
 }
 
+void
+PoleZeroAnalysis::resolveOutputNodes()
+{
+  std::vector<bool> added(_circuit.nodeNumber(), false);
+  for (const std::string& name : _param._outNodes) {
+    const std::vector<size_t>& nodeIds = _circuit.findNodesByPattern(name);
+    if (nodeIds.empty()) {
+      _unmatchedOutNodes.push_back(name);
+    }
+    for (size_t nodeId : nodeIds) {
+      if (added[nodeId] == false) {
+        added[nodeId] = true;
+        _outNodes.push_back(_circuit.node(nodeId));
+      }
+    }
+  }
+}
+
 bool 
 PoleZeroAnalysis::check()
 {
   if (_inDev._devId == static_cast<size_t>(-1)) {
-    printf("ERROR: Input device specified as \"%s\" does not exist\n", _param._inDev->data());
+    printf("ERROR: Input device specified as \"%s\" does not exist\n", _param._inDev.data());
     return false;
   }
-  if (_outNode._nodeId == static_cast<size_t>(-1)) {
-    printf("ERROR: Output node specified as \"%s\" does not exist\n", _param._outNode->data());
+  for (const std::string& name : _unmatchedOutNodes) {
+    printf("WARNING: Output node specified as \"%s\" does not exist\n", name.data());
+  }
+  if (_outNodes.empty()) {
+    printf("ERROR: No valid output node specified\n");
     return false;
   }
   if (_param._order > _circuit.order()) {
@@ -36,7 +59,7 @@ PoleZeroAnalysis::check()
            _param._order, _circuit.order());
     _param._order = _circuit.order();
   }
-  if (_circuit.scalingFactor() != 1) {
+  if (_param._pzMethod == PZMethod::Moment && _circuit.scalingFactor() != 1) {
     printf("Moment scaling factor of %G will be used to improve numerical stability\n", 1.0 * _circuit.scalingFactor());
   }
   return true;
@@ -46,23 +69,23 @@ bool
 PoleZeroAnalysis::calcMoments(const MatrixXd& G, 
                               const MatrixXd& C, 
                               const VectorXd& E,
-                              std::vector<double>& inputMoments,
-                              std::vector<double>& outputMoments) const
+                              const std::vector<size_t>& rows,
+                              std::vector<std::vector<double>>& moments) const
 {
   size_t k = _circuit.scalingFactor();
   /// Number of moments should be twice the number of poles to be calculated
   size_t order = _param._order * 2 + 1;
-  inputMoments.clear();
-  inputMoments.reserve(order+1);
-  outputMoments.clear();
-  outputMoments.reserve(order+1);
-  size_t inputIndex = _result.deviceVectorIndex(_inDev._devId);
-  size_t outputIndex = _result.nodeVectorIndex(_outNode._nodeId);
+  moments.assign(rows.size(), std::vector<double>());
+  for (std::vector<double>& m : moments) {
+    m.reserve(order+1);
+  }
+  /// Moment vectors are shared by all outputs, G is factorized once
   Eigen::FullPivLU<Eigen::MatrixXd> GLU = G.fullPivLu();
   Eigen::VectorXd Vprev(_eqnDim);
   Vprev = GLU.solve(E);
-  inputMoments.push_back(Vprev(inputIndex) / k);
-  outputMoments.push_back(Vprev(outputIndex) / k);
+  for (size_t j=0; j<rows.size(); ++j) {
+    moments[j].push_back(Vprev(rows[j]) / k);
+  }
   if (Debug::enabled(DebugModule::PZ)) {
     Debug::printEquation(G, E);
     Debug::printSolution(0, "V0", Vprev, _result.indexMap(), _circuit);
@@ -72,8 +95,9 @@ PoleZeroAnalysis::calcMoments(const MatrixXd& G,
     Eigen::VectorXd V(_eqnDim);
     Eigen::VectorXd RHS = -C * Vprev;
     V = GLU.solve(RHS);
-    inputMoments.push_back(V(inputIndex) / k);
-    outputMoments.push_back(V(outputIndex) / k);
+    for (size_t j=0; j<rows.size(); ++j) {
+      moments[j].push_back(V(rows[j]) / k);
+    }
     if (Debug::enabled(DebugModule::PZ)) {
       char buf[50];
       sprintf(buf, "V%lu", i);
@@ -166,7 +190,11 @@ calcPolynomialRoots(const std::vector<double>& coeff,
   double rootsi[100];
   RPoly<double> rpoly;
   int status = rpoly.findRoots(coeff.data(), coeff.size()-1, rootsr, rootsi);
-  assert(status != -1 && "rpoly failed");
+  /// Happens when the leading coefficient is zero, e.g. the output is 
+  /// driven directly by a voltage source and all moments above m0 are 0
+  if (status == -1) {
+    return false;
+  }
   for (int i=0; i<status; ++i) {
     roots.push_back({rootsr[i], rootsi[i]});
   }
@@ -266,12 +294,326 @@ PoleZeroAnalysis::calcPoleResidue(const std::vector<double>& moments,
   calcTFDenominatorCoeff(moments, denomCoeff);
   std::vector<double> numCoeff;
   calcTFNumeratorCoeff(moments, denomCoeff, numCoeff);
-  calcPoles(denomCoeff, poles);
+  poles.clear();
+  zeros.clear();
+  residues.clear();
+  if (calcPoles(denomCoeff, poles) == false) {
+    return false;
+  }
   calcZeros(numCoeff, zeros);
   calcResidues(poles, moments, 1.0 / denomCoeff[0], residues);
   return true;
 }
 
+/// MNA equations are at most index 2, so the zero eigenvalue of A has
+/// Jordan blocks of size 2 at most, e.g. a capacitor on a node driven by 
+/// a voltage source. Roundoff splits such a block into a pair of tiny 
+/// eigenvalues of opposite signs, which become huge poles in both half 
+/// planes. A^2 removes the nilpotent part, so the first two moment vectors
+/// x0 and x1 are kept exactly and Arnoldi starts from A*x1 instead.
+bool
+PoleZeroAnalysis::calcKrylovBasis(const SparseMatrix<double>& G, 
+                                  const SparseMatrix<double>& C, 
+                                  const VectorXd& E, 
+                                  VectorXd& x0, 
+                                  VectorXd& x1, 
+                                  MatrixXd& V, 
+                                  MatrixXd& H, 
+                                  double& rNorm) const
+{
+  SparseLU<SparseMatrix<double>, COLAMDOrdering<int>> GLU;
+  GLU.analyzePattern(G);
+  GLU.factorize(G);
+  if (GLU.info() != Eigen::Success) {
+    printf("ERROR: Failed to factorize G matrix: %s\n", GLU.lastErrorMessage().data());
+    return false;
+  }
+  x0 = GLU.solve(E);
+  if (x0.norm() == 0) {
+    printf("ERROR: Input excitation does not reach any node\n");
+    return false;
+  }
+  x1 = GLU.solve(-(C * x0));
+  VectorXd r = GLU.solve(-(C * x1));
+  size_t order = _param._order;
+  V.setZero(_eqnDim, order);
+  H.setZero(order, order);
+  rNorm = r.norm();
+  /// Breakdown happens when the Krylov subspace is invariant, 
+  /// all poles observable from the input are found by then
+  const double breakdownTol = 1e-12;
+  size_t q = order;
+  /// |x1|/|x0| is the time scale of A, r of the same scale as x1 is kept
+  double x0Norm = x0.norm();
+  double x1Norm = x1.norm();
+  if (rNorm <= breakdownTol * x1Norm * x1Norm / x0Norm) {
+    /// No dynamic part is left, the response is a polynomial in s
+    q = 0;
+    rNorm = 0;
+  } else {
+    V.col(0) = r / rNorm;
+  }
+  for (size_t j=0; j<q; ++j) {
+    VectorXd w = GLU.solve(-(C * V.col(j)));
+    double wNorm = w.norm();
+    /// Modified Gram-Schmidt, done twice to keep V orthonormal 
+    /// when high orders are requested
+    for (size_t pass=0; pass<2; ++pass) {
+      for (size_t i=0; i<=j; ++i) {
+        double h = V.col(i).dot(w);
+        H(i, j) += h;
+        w -= h * V.col(i);
+      }
+    }
+    if (j + 1 == order) {
+      break;
+    }
+    double h = w.norm();
+    if (h <= breakdownTol * wNorm) {
+      q = j + 1;
+      break;
+    }
+    H(j+1, j) = h;
+    V.col(j+1) = w / h;
+  }
+  if (q < order) {
+    printf("Krylov subspace exhausted at order %lu, %lu poles are used\n", q, q);
+    V.conservativeResize(NoChange, q);
+    H.conservativeResize(q, q);
+  }
+  if (Debug::enabled(DebugModule::PZ)) {
+    printf("Arnoldi Hessenberg matrix H:\n");
+    std::cout << H << std::endl;
+  }
+  return true;
+}
+
+/// RC networks without controlled sources are passive, all their poles
+/// are on the negative real axis
+bool
+PoleZeroAnalysis::isPassiveRC() const
+{
+  for (const Device& dev : _circuit.devicesToSimulate()) {
+    if (dev._type == DeviceType::Inductor || dev._type == DeviceType::VCVS ||
+        dev._type == DeviceType::VCCS || dev._type == DeviceType::CCVS ||
+        dev._type == DeviceType::CCCS) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Zeros beyond this times the fastest pole are not reported
+static const double zeroOutOfBandRatio = 1e3;
+
+bool
+PoleZeroAnalysis::calcKrylovPoleResidue(const VectorXd& x0, 
+                                        const VectorXd& x1, 
+                                        const MatrixXd& V, 
+                                        const MatrixXd& H, 
+                                        double rNorm, size_t rowIndex, 
+                                        bool isPassiveRC,
+                                        std::vector<double>& moments, 
+                                        std::vector<Complex>& poles, 
+                                        std::vector<Complex>& zeros, 
+                                        std::vector<Complex>& residues) const
+{
+  size_t q = H.rows();
+  /// Reduced model: x(s) = x0 + s*x1 + s^2 * rNorm * V * (I - s*H)^-1 * e1,
+  /// so the output is m0 + m1*s + s^2 * c^T * (I - s*H)^-1 * b with
+  /// c^T = V.row(rowIndex)
+  double m0 = x0(rowIndex);
+  double m1 = x1(rowIndex);
+  RowVectorXd c = V.row(rowIndex);
+  VectorXd b = VectorXd::Zero(q);
+  if (q > 0) {
+    b(0) = rNorm;
+  }
+
+  /// Moments implicitly matched by the reduced model, 
+  /// m0, m1 and m_(i+2) = c^T * H^i * b
+  moments.clear();
+  moments.reserve(q + 2);
+  moments.push_back(m0);
+  moments.push_back(m1);
+  VectorXd Hb = b;
+  for (size_t i=0; i<q; ++i) {
+    moments.push_back(c.dot(Hb));
+    Hb = H * Hb;
+  }
+  poles.clear();
+  residues.clear();
+  zeros.clear();
+  if (q == 0) {
+    if (m1 != 0) {
+      zeros.push_back(-m0 / m1);
+    }
+    return true;
+  }
+
+  /// With H = S * diag(lambda) * S^-1, each eigenvalue lambda gives a 
+  /// term s^2 * k / (1 - s*lambda), which is a pole at 1/lambda with 
+  /// residue -k/lambda^3
+  EigenSolver<MatrixXd> es(H);
+  if (es.info() != Eigen::Success) {
+    printf("ERROR: Eigenvalue decomposition of projected matrix failed\n");
+    return false;
+  }
+  const VectorXcd& lambda = es.eigenvalues();
+  const MatrixXcd& S = es.eigenvectors();
+  RowVectorXcd cS = c.cast<Complex>() * S;
+  VectorXcd Sb = S.fullPivLu().solve(b.cast<Complex>());
+  const double zeroTol = 1e-12 * lambda.cwiseAbs().maxCoeff();
+  for (size_t i=0; i<q; ++i) {
+    /// Zero eigenvalues are poles at infinity, and the poles of passive 
+    /// RC networks left of the imaginary axis are kept only
+    if (std::abs(lambda(i)) <= zeroTol || 
+        (isPassiveRC && lambda(i).real() >= 0)) {
+      continue;
+    }
+    Complex k = cS(i) * Sb(i);
+    poles.push_back(1.0 / lambda(i));
+    residues.push_back(-k / (lambda(i) * lambda(i) * lambda(i)));
+  }
+
+  /// With z = 1/s the zeros are those of z*m0 + m1 + c^T * (zI - H)^-1 * b,
+  /// the finite eigenvalues of the pencil ([H b; -c^T -m1], diag(I, m0)).
+  /// The pencil is scaled by the time scale tau of H to keep the blocks
+  /// balanced, a negligible m0 is a zero at s = 0
+  double tau = lambda.cwiseAbs().maxCoeff();
+  double m1s = m1 / tau;
+  if (std::abs(m0) <= 1e-12 * std::abs(m1s)) {
+    m0 = 0;
+  }
+  MatrixXd A = MatrixXd::Zero(q+1, q+1);
+  A.topLeftCorner(q, q) = H / tau;
+  A.topRightCorner(q, 1) = b / (tau * tau);
+  A.bottomLeftCorner(1, q) = -c;
+  A(q, q) = -m1s;
+  MatrixXd B = MatrixXd::Identity(q+1, q+1);
+  B(q, q) = m0;
+  GeneralizedEigenSolver<MatrixXd> zs(A, B, false);
+  if (zs.info() != Eigen::Success) {
+    return true;
+  }
+  /// Zeros at infinity of multiplicity k are split by roundoff into
+  /// zeros around eps^(-1/k), they are dropped together with the zeros 
+  /// far beyond the fastest pole, where the reduced model is not accurate
+  double maxZero = zeroOutOfBandRatio * tau / lambda.cwiseAbs().minCoeff();
+  const VectorXcd& alphas = zs.alphas();
+  const VectorXd& betas = zs.betas();
+  for (Index i=0; i<alphas.size(); ++i) {
+    /// z = alpha/beta, s = 1/z
+    if (std::abs(betas(i)) > maxZero * std::abs(alphas(i))) {
+      continue;
+    }
+    zeros.push_back(betas(i) / alphas(i) / tau);
+  }
+  return true;
+}
+
+inline static void
+printPZResult(const char* target, const std::string& name,
+              const PoleZeroAnalysis::PZResult& result)
+{
+  printf("Moments for %s %s: ", target, name.data());
+  for (double m : result._moments) printf("%.6G ", m);
+  printf("\n");
+  printf("Poles for %s %s: ", target, name.data());
+  for (const Complex& c : result._poles) printCNumber(c);
+  printf("\n");
+  printf("Zeros for %s %s: ", target, name.data());
+  for (const Complex& c : result._zeros) printCNumber(c);
+  printf("\n");
+  printf("Residues for %s %s: ", target, name.data());
+  for (const Complex& c : result._residues) printCNumber(c);
+  printf("\n");
+}
+
+std::vector<size_t>
+PoleZeroAnalysis::resultRows() const
+{
+  std::vector<size_t> rows;
+  rows.reserve(_outNodes.size() + 1);
+  for (const Node& node : _outNodes) {
+    rows.push_back(_result.nodeVectorIndex(node._nodeId));
+  }
+  rows.push_back(_result.deviceVectorIndex(_inDev._devId));
+  return rows;
+}
+
+void
+PoleZeroAnalysis::printResults() const
+{
+  for (size_t i=0; i<_outNodes.size(); ++i) {
+    printPZResult("node", _outNodes[i]._name, _outResults[i]);
+  }
+  printPZResult("driver admittance at", _inDev._name, _admResult);
+}
+
+/// Debug output of the per-output solvers is not thread safe
+static size_t
+maxPZThreads()
+{
+  return Debug::enabled(DebugModule::PZ) ? 1 : 0;
+}
+
+void
+PoleZeroAnalysis::runKrylov(const std::vector<Triplet<double>>& G, 
+                            const std::vector<Triplet<double>>& C, 
+                            const VectorXd& E)
+{
+  /// The Krylov basis is orthonormal, so moment scaling is not needed, 
+  /// undo the scaling applied by MNAStamper to get poles in 1/second
+  double k = _circuit.scalingFactor();
+  SparseMatrix<double> Gs(_eqnDim, _eqnDim);
+  Gs.setFromTriplets(G.begin(), G.end());
+  SparseMatrix<double> Cs(_eqnDim, _eqnDim);
+  Cs.setFromTriplets(C.begin(), C.end());
+  Cs /= k;
+  VectorXd Es = E / k;
+  VectorXd x0;
+  VectorXd x1;
+  MatrixXd V;
+  MatrixXd H;
+  double rNorm = 0;
+  if (calcKrylovBasis(Gs, Cs, Es, x0, x1, V, H, rNorm) == false) {
+    return;
+  }
+  bool passiveRC = isPassiveRC();
+  /// The basis is shared by all outputs, only the projection 
+  /// onto each output row differs
+  std::vector<size_t> rows = resultRows();
+  std::vector<PZResult> results(rows.size());
+  parallelFor(rows.size(), [&](size_t i) {
+    PZResult& r = results[i];
+    calcKrylovPoleResidue(x0, x1, V, H, rNorm, rows[i], passiveRC, 
+                          r._moments, r._poles, r._zeros, r._residues);
+  }, maxPZThreads());
+  _admResult = std::move(results.back());
+  results.pop_back();
+  _outResults = std::move(results);
+}
+
+void
+PoleZeroAnalysis::runMomentMatching(const MatrixXd& G, 
+                                    const MatrixXd& C, 
+                                    const VectorXd& E)
+{
+  std::vector<size_t> rows = resultRows();
+  std::vector<std::vector<double>> moments;
+  calcMoments(G, C, E, rows, moments);
+  std::vector<PZResult> results(rows.size());
+  parallelFor(rows.size(), [&](size_t i) {
+    PZResult& r = results[i];
+    r._moments = std::move(moments[i]);
+    calcPoleResidue(r._moments, r._poles, r._zeros, r._residues);
+  }, maxPZThreads());
+  _admResult = std::move(results.back());
+  results.pop_back();
+  _outResults = std::move(results);
+}
+
 void
 PoleZeroAnalysis::run()
 {
@@ -279,47 +621,24 @@ PoleZeroAnalysis::run()
     return;
   }
   MNAStamper stamper(_param, _circuit, _result);
-  Eigen::MatrixXd G;
-  G.setZero(_eqnDim, _eqnDim);
-  Eigen::MatrixXd C;
-  C.setZero(_eqnDim, _eqnDim);
   Eigen::VectorXd E;
   E.setZero(_eqnDim);
-  stamper.stamp(G, C, E);
-  std::vector<double> inputMoments;
-  std::vector<double> outputMoments;
-  calcMoments(G, C, E, inputMoments, outputMoments);
-  _moments.assign(outputMoments.begin(), outputMoments.end());
-  printf("Moments for node %s: ", _outNode._name.data());
-  for (double m : _moments) printf("%.6G ", m);
-  printf("\n");
-
-  calcPoleResidue(_moments, _poles, _zeros, _residues);
-  printf("Poles for node %s: ", _outNode._name.data());
-  for (const Complex& c : _poles) printCNumber(c);
-  printf("\n");
-  printf("Zeros for node %s: ", _outNode._name.data());
-  for (const Complex& c : _zeros) printCNumber(c);
-  printf("\n");
-  printf("Residues for node %s: ", _outNode._name.data());
-  for (const Complex& c : _residues) printCNumber(c);
-  printf("\n");
-
-  _admMoments.assign(inputMoments.begin(), inputMoments.end());
-  printf("Moments for driver admittance at %s: ", _inDev._name.data());
-  for (double m : _admMoments) printf("%.6G ", m);
-  printf("\n");
-
-  calcPoleResidue(_admMoments, _admPoles, _admZeros, _admResidues);
-  printf("Poles for driver admittance at %s: ", _inDev._name.data());
-  for (const Complex& c : _admPoles) printCNumber(c);
-  printf("\n");
-  printf("Zeros for driver admittance at %s: ", _inDev._name.data());
-  for (const Complex& c : _admZeros) printCNumber(c);
-  printf("\n");
-  printf("Residues for driver admittance at %s: ", _inDev._name.data());
-  for (const Complex& c : _admResidues) printCNumber(c);
-  printf("\n");
+  if (_param._pzMethod == PZMethod::Moment) {
+    Eigen::MatrixXd G;
+    G.setZero(_eqnDim, _eqnDim);
+    Eigen::MatrixXd C;
+    C.setZero(_eqnDim, _eqnDim);
+    stamper.stamp(G, C, E);
+    runMomentMatching(G, C, E);
+  } else {
+    /// The Krylov method only needs sparse G and C, 
+    /// so they are never formed dense
+    std::vector<Eigen::Triplet<double>> G;
+    std::vector<Eigen::Triplet<double>> C;
+    stamper.stamp(G, C, E);
+    runKrylov(G, C, E);
+  }
+  printResults();
   /* a small unit test
   // Below moment values in debugM will give a result of two poles, 1 and 2, 
   // and corresponding residues 1 and 2
@@ -6,6 +6,7 @@
 #include <vector>
 #include <Eigen/Core>
 #include <Eigen/Dense>
+#include <Eigen/SparseCore>
 #include "Base.h"
 #include "Circuit.h"
 #include "SimResult.h"
@@ -17,14 +18,31 @@ class PoleZeroAnalysis {
   public:
     typedef std::complex<double> Complex;
 
+    /// Moments, poles, zeros and residues of one transfer function
+    struct PZResult {
+      std::vector<double>  _moments;
+      std::vector<Complex> _poles;
+      std::vector<Complex> _zeros;
+      std::vector<Complex> _residues;
+    };
+
     PoleZeroAnalysis(const Circuit& circuit, const AnalysisParameter& param);
 
     void run();
 
     const SimResult& result() const { return _result; }
+    const std::vector<Node>& outputNodes() const { return _outNodes; }
+    /// Results are in the same order as outputNodes()
+    const std::vector<PZResult>& outputResults() const { return _outResults; }
+    const PZResult& admittanceResult() const { return _admResult; }
 
   private:
     bool check();
+    void resolveOutputNodes();
+    /// Rows of the MNA solution for all output nodes, followed by 
+    /// the row of input device current
+    std::vector<size_t> resultRows() const;
+    void printResults() const;
 
     bool calcPoleResidue(const std::vector<double>& moments, 
                          std::vector<Complex>& poles, 
@@ -34,8 +52,8 @@ class PoleZeroAnalysis {
     bool calcMoments(const Eigen::MatrixXd& G, 
                      const Eigen::MatrixXd& C,
                      const Eigen::VectorXd& E, 
-                     std::vector<double>& inputMoments,
-                     std::vector<double>& outputMoments) const;
+                     const std::vector<size_t>& rows,
+                     std::vector<std::vector<double>>& moments) const;
 
     bool calcTFDenominatorCoeff(const std::vector<double>& moments, 
                                 std::vector<double>& coeff) const;
@@ -54,21 +72,50 @@ class PoleZeroAnalysis {
                       double k,
                       std::vector<Complex>& residues) const;
 
+    /// Krylov subspace engine. With A = -G^-1*C, the moment vectors 
+    /// x0 = G^-1*E and x1 = A*x0 are returned, and an orthonormal basis V
+    /// of span{r, Ar, ..., A^(q-1)r} with r = A*x1 is built with the 
+    /// Arnoldi process, so that A*V = V*H + h*e^T
+    bool calcKrylovBasis(const Eigen::SparseMatrix<double>& G, 
+                         const Eigen::SparseMatrix<double>& C, 
+                         const Eigen::VectorXd& E, 
+                         Eigen::VectorXd& x0, 
+                         Eigen::VectorXd& x1, 
+                         Eigen::MatrixXd& V, 
+                         Eigen::MatrixXd& H, 
+                         double& rNorm) const;
+
+    /// Poles, zeros and residues of the row rowIndex of the reduced 
+    /// system (x0, x1, H, V, rNorm), the moments matched are also returned
+    bool calcKrylovPoleResidue(const Eigen::VectorXd& x0, 
+                               const Eigen::VectorXd& x1, 
+                               const Eigen::MatrixXd& V, 
+                               const Eigen::MatrixXd& H, 
+                               double rNorm, size_t rowIndex, 
+                               bool isPassiveRC,
+                               std::vector<double>& moments, 
+                               std::vector<Complex>& poles, 
+                               std::vector<Complex>& zeros, 
+                               std::vector<Complex>& residues) const;
+    bool isPassiveRC() const;
+
+    void runMomentMatching(const Eigen::MatrixXd& G, 
+                           const Eigen::MatrixXd& C,
+                           const Eigen::VectorXd& E);
+    void runKrylov(const std::vector<Eigen::Triplet<double>>& G, 
+                   const std::vector<Eigen::Triplet<double>>& C,
+                   const Eigen::VectorXd& E);
+
   private:
     const Circuit&         _circuit;
     AnalysisParameter      _param;
     Device                 _inDev;
-    Node                   _outNode;
+    std::vector<Node>      _outNodes;
+    std::vector<std::string> _unmatchedOutNodes;
     SimResult              _result;
     size_t                 _eqnDim;
-    std::vector<double>    _admMoments;
-    std::vector<Complex>   _admPoles;
-    std::vector<Complex>   _admZeros;
-    std::vector<Complex>   _admResidues;
-    std::vector<double>    _moments;
-    std::vector<Complex>   _poles;
-    std::vector<Complex>   _zeros;
-    std::vector<Complex>   _residues;
+    PZResult               _admResult;
+    std::vector<PZResult>  _outResults;
 };
 
 }
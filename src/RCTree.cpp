@@ -0,0 +1,246 @@
+#include <cstdio>
+#include <cmath>
+#include <Eigen/Core>
+#include <Eigen/SparseCore>
+#include <Eigen/SparseLU>
+#include "RCTree.h"
+#include "MNAStamper.h"
+
+namespace NA {
+
+static const size_t invalidId = static_cast<size_t>(-1);
+
+RCTreeAnalysis::RCTreeAnalysis(const Circuit& circuit, const AnalysisParameter& param)
+: _circuit(circuit), _param(param), _result(&circuit, param._name)
+{
+}
+
+double
+RCTreeAnalysis::d2mDelay(size_t nodeId) const
+{
+  double m1 = moment(1, nodeId);
+  double m2 = moment(2, nodeId);
+  if (m2 <= 0) {
+    return elmoreDelay(nodeId);
+  }
+  return std::log(2) * m1 * m1 / std::sqrt(m2);
+}
+
+double
+RCTreeAnalysis::sigma(size_t nodeId) const
+{
+  double m1 = moment(1, nodeId);
+  double m2 = moment(2, nodeId);
+  double variance = 2 * m2 - m1 * m1;
+  return variance > 0 ? std::sqrt(variance) : 0;
+}
+
+bool
+RCTreeAnalysis::buildTree()
+{
+  size_t nodeNumber = _circuit.nodeNumber();
+  _parent.assign(nodeNumber, invalidId);
+  _parentRes.assign(nodeNumber, 0);
+  _groundCap.assign(nodeNumber, 0);
+  _treeOrder.clear();
+  _rootNode = invalidId;
+  char buf[512];
+  for (size_t devId=0; devId<_circuit.deviceNumber(); ++devId) {
+    const Device& dev = _circuit.device(devId);
+    bool posGround = _circuit.isGroundNode(dev._posNode);
+    bool negGround = _circuit.isGroundNode(dev._negNode);
+    switch (dev._type) {
+      case DeviceType::Resistor:
+        if (posGround || negGround) {
+          snprintf(buf, sizeof(buf), "resistor %s is connected to ground", dev._name.data());
+          _meshReason = buf;
+          return false;
+        }
+        break;
+      case DeviceType::Capacitor:
+        if (posGround == negGround) {
+          snprintf(buf, sizeof(buf), "capacitor %s is not grounded", dev._name.data());
+          _meshReason = buf;
+          return false;
+        }
+        _groundCap[posGround ? dev._negNode : dev._posNode] += dev._value;
+        break;
+      case DeviceType::VoltageSource:
+        if (_rootNode != invalidId || posGround == negGround) {
+          snprintf(buf, sizeof(buf), "voltage source %s is not the only grounded source", dev._name.data());
+          _meshReason = buf;
+          return false;
+        }
+        _rootNode = posGround ? dev._negNode : dev._posNode;
+        break;
+      default:
+        snprintf(buf, sizeof(buf), "device %s is not a resistor or capacitor", dev._name.data());
+        _meshReason = buf;
+        return false;
+    }
+  }
+  if (_rootNode == invalidId) {
+    _meshReason = "no voltage source drives the network";
+    return false;
+  }
+
+  /// Breadth first traversal from the driving point, reaching
+  /// a visited node through another resistor means a loop
+  std::vector<size_t> parentDev(nodeNumber, invalidId);
+  std::vector<bool> visited(nodeNumber, false);
+  visited[_rootNode] = true;
+  _treeOrder.push_back(_rootNode);
+  for (size_t i=0; i<_treeOrder.size(); ++i) {
+    size_t nodeId = _treeOrder[i];
+    for (size_t devId : _circuit.node(nodeId)._connection) {
+      const Device& dev = _circuit.device(devId);
+      if (dev._type != DeviceType::Resistor || devId == parentDev[nodeId]) {
+        continue;
+      }
+      size_t other = (dev._posNode == nodeId) ? dev._negNode : dev._posNode;
+      if (visited[other]) {
+        snprintf(buf, sizeof(buf), "resistor %s closes a loop", dev._name.data());
+        _meshReason = buf;
+        return false;
+      }
+      visited[other] = true;
+      _parent[other] = nodeId;
+      _parentRes[other] = dev._value;
+      parentDev[other] = devId;
+      _treeOrder.push_back(other);
+    }
+  }
+  for (size_t nodeId=0; nodeId<nodeNumber; ++nodeId) {
+    const Node& node = _circuit.node(nodeId);
+    if (visited[nodeId] == false && node._isGround == false &&
+        node._connection.empty() == false) {
+      snprintf(buf, sizeof(buf), "node %s is not reachable from the source through resistors",
+               node._name.data());
+      _meshReason = buf;
+      return false;
+    }
+  }
+  return true;
+}
+
+/// With unit step at the root, m_k(i) = -sum_j R_ij * C_j * m_(k-1)(j),
+/// where R_ij is the resistance shared by the paths from root to i and j.
+/// The sum is split into a leaf-to-root pass accumulating the downstream
+/// C*m_(k-1), and a root-to-leaf pass accumulating R*load along the path
+void
+RCTreeAnalysis::calcTreeMoments()
+{
+  size_t nodeNumber = _circuit.nodeNumber();
+  _moments.assign(momentNumber, std::vector<double>(nodeNumber, 0));
+  for (size_t nodeId : _treeOrder) {
+    _moments[0][nodeId] = 1;
+  }
+  std::vector<double> load(nodeNumber, 0);
+  for (size_t k=1; k<momentNumber; ++k) {
+    const std::vector<double>& prev = _moments[k-1];
+    std::vector<double>& cur = _moments[k];
+    for (size_t nodeId : _treeOrder) {
+      load[nodeId] = _groundCap[nodeId] * prev[nodeId];
+    }
+    for (size_t i=_treeOrder.size()-1; i>0; --i) {
+      size_t nodeId = _treeOrder[i];
+      load[_parent[nodeId]] += load[nodeId];
+    }
+    cur[_rootNode] = 0;
+    for (size_t i=1; i<_treeOrder.size(); ++i) {
+      size_t nodeId = _treeOrder[i];
+      cur[nodeId] = cur[_parent[nodeId]] - _parentRes[nodeId] * load[nodeId];
+    }
+  }
+}
+
+bool
+RCTreeAnalysis::calcMatrixMoments()
+{
+  size_t eqnDim = _result.indexMap().size();
+  MNAStamper stamper(_param, _circuit, _result);
+  Eigen::MatrixXd G;
+  G.setZero(eqnDim, eqnDim);
+  Eigen::MatrixXd C;
+  C.setZero(eqnDim, eqnDim);
+  Eigen::VectorXd E;
+  E.setZero(eqnDim);
+  stamper.stamp(G, C, E);
+  /// Undo the moment scaling applied by MNAStamper in s-domain
+  double k = _circuit.scalingFactor();
+  Eigen::SparseMatrix<double> Gs = G.sparseView();
+  Eigen::SparseMatrix<double> Cs = (C / k).sparseView();
+  Gs.makeCompressed();
+  Eigen::SparseLU<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>> GLU;
+  GLU.analyzePattern(Gs);
+  GLU.factorize(Gs);
+  if (GLU.info() != Eigen::Success) {
+    printf("ERROR: Failed to factorize G matrix: %s\n", GLU.lastErrorMessage().data());
+    return false;
+  }
+  size_t nodeNumber = _circuit.nodeNumber();
+  _moments.assign(momentNumber, std::vector<double>(nodeNumber, 0));
+  Eigen::VectorXd x = GLU.solve(E / k);
+  for (size_t order=0; order<momentNumber; ++order) {
+    if (order > 0) {
+      x = GLU.solve(-(Cs * x));
+    }
+    for (size_t nodeId=0; nodeId<nodeNumber; ++nodeId) {
+      size_t index = _result.nodeVectorIndex(nodeId);
+      if (index != SimResultMap::invalidValue()) {
+        _moments[order][nodeId] = x(index);
+      }
+    }
+  }
+  return true;
+}
+
+void
+RCTreeAnalysis::printResults() const
+{
+  std::vector<size_t> nodeIds;
+  if (_param._outNodes.empty()) {
+    for (size_t nodeId=0; nodeId<_circuit.nodeNumber(); ++nodeId) {
+      if (_circuit.isGroundNode(nodeId) == false && nodeId != _rootNode) {
+        nodeIds.push_back(nodeId);
+      }
+    }
+  } else {
+    for (const std::string& name : _param._outNodes) {
+      const std::vector<size_t>& found = _circuit.findNodesByPattern(name);
+      if (found.empty()) {
+        printf("WARNING: Output node specified as \"%s\" does not exist\n", name.data());
+      }
+      nodeIds.insert(nodeIds.end(), found.begin(), found.end());
+    }
+  }
+  for (size_t nodeId : nodeIds) {
+    printf("Node %s: Elmore %.6G D2M %.6G Sigma %.6G Moments",
+           _circuit.node(nodeId)._name.data(), elmoreDelay(nodeId),
+           d2mDelay(nodeId), sigma(nodeId));
+    for (size_t k=1; k<momentNumber; ++k) {
+      printf(" %.6G", moment(k, nodeId));
+    }
+    printf("\n");
+  }
+}
+
+void
+RCTreeAnalysis::run()
+{
+  _isTree = buildTree();
+  if (_isTree) {
+    printf("RC tree with %lu nodes found, moments are calculated by tree traversal\n",
+           _treeOrder.size());
+    calcTreeMoments();
+  } else {
+    printf("Circuit is not an RC tree as %s, moments are calculated with sparse LU\n",
+           _meshReason.data());
+    if (calcMatrixMoments() == false) {
+      return;
+    }
+  }
+  printResults();
+}
+
+}
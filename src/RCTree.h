@@ -0,0 +1,69 @@
+#ifndef _RC_TREE_H_
+#define _RC_TREE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "Base.h"
+#include "Circuit.h"
+#include "SimResult.h"
+
+namespace NA {
+
+/// Moments and delay metrics of the step response of an RC network
+/// driven by one voltage source.
+/// If the resistors form a tree rooted at the source and every capacitor
+/// is grounded, moments are computed with two tree traversals per moment,
+/// which is linear in the number of nodes. Otherwise moments come from
+/// repeated solves of a sparse LU factorization of G.
+class RCTreeAnalysis {
+  public:
+    /// m0 to m3 are computed, m2 is needed by D2M
+    static constexpr size_t momentNumber = 4;
+
+    RCTreeAnalysis(const Circuit& circuit, const AnalysisParameter& param);
+
+    void run();
+
+    bool isTree() const { return _isTree; }
+    /// Moment of given order for given node ID
+    double moment(size_t order, size_t nodeId) const { return _moments[order][nodeId]; }
+    /// Elmore delay, -m1
+    double elmoreDelay(size_t nodeId) const { return -moment(1, nodeId); }
+    /// D2M delay metric, ln(2)*m1^2/sqrt(m2), as stated in
+    /// C. J. Alpert, A. Devgan and C. Kashyap,
+    /// "A two moment RC delay metric for performance optimization,"
+    /// ISPD 2000, doi: 10.1145/332357.332363.
+    double d2mDelay(size_t nodeId) const;
+    /// Standard deviation of the impulse response, sqrt(2*m2 - m1^2),
+    /// a measure of the output slew
+    double sigma(size_t nodeId) const;
+
+    const SimResult& result() const { return _result; }
+
+  private:
+    bool buildTree();
+    void calcTreeMoments();
+    bool calcMatrixMoments();
+    void printResults() const;
+
+  private:
+    const Circuit&                   _circuit;
+    AnalysisParameter                _param;
+    SimResult                        _result;
+    bool                             _isTree = false;
+    std::string                      _meshReason;
+    size_t                           _rootNode = static_cast<size_t>(-1);
+    /// Tree data indexed by node ID, _treeOrder starts from root and
+    /// every node appears after its parent
+    std::vector<size_t>              _parent;
+    std::vector<double>              _parentRes;
+    std::vector<double>              _groundCap;
+    std::vector<size_t>              _treeOrder;
+    /// _moments[k][nodeId] is the k-th moment of the node voltage
+    std::vector<std::vector<double>> _moments;
+};
+
+}
+
+#endif
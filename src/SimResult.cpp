@@ -24,7 +24,7 @@ std::vector<size_t>
 branchDevices(const Circuit* ckt)
 {
   std::vector<size_t> devIds;
-  const std::vector<Device>& devs = ckt->devicesToSimulate();
+  IndexedSpan<Device> devs = ckt->devicesToSimulate();
   for (const Device& dev : devs) {
     if (needExtraDim(dev)) {
       devIds.push_back(dev._devId);
@@ -45,7 +45,7 @@ branchDevices(const Circuit* ckt)
 void
 SimResult::init(const Circuit* ckt)
 {
-  const std::vector<Node>& nodes = ckt->nodesToSimulate();
+  IndexedSpan<Node> nodes = ckt->nodesToSimulate();
   _map._nodeVoltageMap.assign(ckt->nodeNumber(), SimResultMap::invalidValue());
   size_t index = 0;
   for (const Node& node : nodes) {
@@ -62,6 +62,54 @@ SimResult::init(const Circuit* ckt)
     ++index;
   }
   _map.setDimention(index);
+
+  /// PWL sources in scope are evaluated with cursors, as they are queried
+  /// at increasing times while simulating
+  _PWLEvaluators.clear();
+  _PWLEvaluatorMap.assign(ckt->PWLData().size(), SimResultMap::invalidValue());
+  for (const Device& dev : ckt->devicesToSimulate()) {
+    if (isAnySource(dev) && dev._isPWLValue &&
+        _PWLEvaluatorMap[dev._PWLData] == SimResultMap::invalidValue()) {
+      _PWLEvaluatorMap[dev._PWLData] = _PWLEvaluators.size();
+      _PWLEvaluators.emplace_back(&ckt->PWLData(dev));
+    }
+  }
+
+  /// Nodes driven by voltage sources are not solved, their voltage is the
+  /// largest value of the sources with the node as positive node
+  _nodeSources.assign(ckt->nodeNumber(), NodeSource());
+  for (const Node& node : nodes) {
+    NodeSource& source = _nodeSources[node._nodeId];
+    if (node._isGround) {
+      source._kind = NodeSource::Kind::Fixed;
+      continue;
+    }
+    size_t PWLCount = 0;
+    size_t fixedCount = 0;
+    double fixedVoltage = std::numeric_limits<double>::lowest();
+    for (size_t devId : node._connection) {
+      const Device& dev = ckt->device(devId);
+      if (dev._type == DeviceType::VoltageSource && dev._posNode == node._nodeId) {
+        if (dev._isPWLValue) {
+          source._index = _PWLEvaluatorMap[dev._PWLData];
+          ++PWLCount;
+        } else {
+          fixedVoltage = std::max(fixedVoltage, dev._value);
+          ++fixedCount;
+        }
+      }
+    }
+    if (PWLCount + fixedCount == 0) {
+      source._kind = NodeSource::Kind::Solved;
+      source._index = _map._nodeVoltageMap[node._nodeId];
+    } else if (PWLCount == 0) {
+      source._kind = NodeSource::Kind::Fixed;
+      source._value = fixedVoltage;
+    } else if (PWLCount == 1 && fixedCount == 0 &&
+               source._index != SimResultMap::invalidValue()) {
+      source._kind = NodeSource::Kind::PWL;
+    }
+  }
 }
 
 SimResult::SimResult(const Circuit* ckt, const std::string& name)
@@ -84,6 +132,36 @@ SimResult::nodeVectorIndex(size_t nodeId) const
   return _map._nodeVoltageMap[nodeId];
 }
 
+std::vector<FixedNode>
+SimResult::fixedNodes() const
+{
+  std::vector<FixedNode> fixedNodes;
+  std::vector<size_t> drivers(_ckt->nodeNumber(), 0);
+  std::vector<bool> isSampled(_ckt->deviceNumber(), false);
+  for (const Device& dev : _ckt->devicesToSimulate()) {
+    if (dev._type == DeviceType::VoltageSource || 
+        dev._type == DeviceType::VCVS || 
+        dev._type == DeviceType::CCVS) {
+      ++drivers[dev._posNode];
+    }
+    if (dev._sampleDevice != static_cast<size_t>(-1)) {
+      isSampled[dev._sampleDevice] = true;
+    }
+  }
+  for (const Device& dev : _ckt->devicesToSimulate()) {
+    if (dev._type == DeviceType::VoltageSource &&
+        _ckt->isGroundNode(dev._negNode) &&
+        _ckt->isGroundNode(dev._posNode) == false &&
+        drivers[dev._posNode] == 1 && isSampled[dev._devId] == false) {
+      FixedNode fixed;
+      fixed._nodeIndex = _map._nodeVoltageMap[dev._posNode];
+      fixed._branchIndex = _map._deviceCurrentMap[dev._devId];
+      fixedNodes.push_back(fixed);
+    }
+  }
+  return fixedNodes;
+}
+
 double 
 SimResult::currentTime() const
 {
@@ -104,27 +182,53 @@ SimResult::nodeVoltageImp(size_t nodeId, size_t timeStep) const
 }
 
 double
-SimResult::nodeVoltage(size_t nodeId, size_t timeStep) const
+SimResult::sourceValue(const Device& dev, double simTime) const
 {
-  if (_ckt->isGroundNode(nodeId)) {
-    return .0f;
+  if (dev._isPWLValue == false) {
+    return dev._value;
   }
+  size_t index = _PWLEvaluatorMap[dev._PWLData];
+  if (index == SimResultMap::invalidValue()) {
+    return _ckt->PWLData(dev).valueAtTime(simTime);
+  }
+  return _PWLEvaluators[index].valueAtTime(simTime);
+}
+
+/// Voltage of a node driven by voltage sources at simTime, lowest double
+/// if no voltage source drives the node
+double
+SimResult::sourceVoltage(size_t nodeId, double simTime) const
+{
   double voltage = std::numeric_limits<double>::lowest();
   const Node& node = _ckt->node(nodeId);
   for (size_t devId : node._connection) {
     const Device& dev = _ckt->device(devId);
     if (dev._type == DeviceType::VoltageSource && dev._posNode == nodeId) {
-      double nodeVoltage = 0;
-      if (dev._isPWLValue) {
-        double simTime = stepTime(timeStep);
-        const PWLValue& pwlData = _ckt->PWLData(dev);
-        nodeVoltage = pwlData.valueAtTime(simTime);
-      } else {
-        nodeVoltage = dev._value;
-      }
-      voltage = std::max(voltage, nodeVoltage);
+      voltage = std::max(voltage, sourceValue(dev, simTime));
     }
   }
+  return voltage;
+}
+
+double
+SimResult::nodeVoltage(size_t nodeId, size_t timeStep) const
+{
+  const NodeSource& source = _nodeSources[nodeId];
+  switch (source._kind) {
+    case NodeSource::Kind::Solved:
+      assert(_ticks.size() > timeStep);
+      return _values[timeStep * _map.size() + source._index];
+    case NodeSource::Kind::Fixed:
+      return source._value;
+    case NodeSource::Kind::PWL:
+      return _PWLEvaluators[source._index].valueAtTime(stepTime(timeStep));
+    case NodeSource::Kind::Search:
+      break;
+  }
+  if (_ckt->isGroundNode(nodeId)) {
+    return .0f;
+  }
+  double voltage = sourceVoltage(nodeId, stepTime(timeStep));
   if (voltage != std::numeric_limits<double>::lowest()) {
     return voltage;
   } 
@@ -146,13 +250,7 @@ SimResult::deviceCurrent(size_t deviceId, size_t timeStep) const
 {
   const Device& dev = _ckt->device(deviceId);
   if (dev._type == DeviceType::CurrentSource) {
-    if (dev._isPWLValue) {
-      double simTime = stepTime(timeStep);
-      const PWLValue& pwlData = _ckt->PWLData(dev);
-      return pwlData.valueAtTime(simTime);
-    } else {
-      return dev._value;
-    }
+    return sourceValue(dev, stepTime(timeStep));
   }
   return deviceCurrentImp(deviceId, timeStep);
 }
@@ -176,24 +274,25 @@ SimResult::nodeVoltageBackstepImp(size_t nodeId, size_t steps) const
 double
 SimResult::nodeVoltageBackstep(size_t nodeId, size_t steps) const
 {
-  if (_ckt->isGroundNode(nodeId)) {
-    return .0f;
-  }
   assert(steps > 0 && "Incorrect input parameter");
-  double voltage = std::numeric_limits<double>::lowest();
-  const Node& node = _ckt->node(nodeId);
-  for (size_t devId : node._connection) {
-    const Device& dev = _ckt->device(devId);
-    if (dev._type == DeviceType::VoltageSource && dev._posNode == nodeId) {
-      if (dev._isPWLValue) {
-        const PWLValue& data = _ckt->PWLData(_ckt->device(devId));
-        double simTime = stepTime(size()-steps-1);
-        voltage = std::max(voltage, data.valueAtTime(simTime));
-      } else {
-        voltage = std::max(voltage, dev._value);
+  const NodeSource& source = _nodeSources[nodeId];
+  switch (source._kind) {
+    case NodeSource::Kind::Solved:
+      if (_ticks.size() < steps) {
+        return 0;
       }
-    }
+      return _values[(_ticks.size() - steps) * _map.size() + source._index];
+    case NodeSource::Kind::Fixed:
+      return source._value;
+    case NodeSource::Kind::PWL:
+      return _PWLEvaluators[source._index].valueAtTime(stepTime(size()-steps-1));
+    case NodeSource::Kind::Search:
+      break;
   }
+  if (_ckt->isGroundNode(nodeId)) {
+    return .0f;
+  }
+  double voltage = sourceVoltage(nodeId, stepTime(size()-steps-1));
   if (voltage != std::numeric_limits<double>::lowest()) {
     return voltage;
   } 
@@ -221,17 +320,63 @@ SimResult::deviceCurrentBackstep(size_t deviceId, size_t steps) const
 {
   const Device& dev = _ckt->device(deviceId);
   if (dev._type == DeviceType::CurrentSource) {
-    if (dev._isPWLValue) {
-      const PWLValue& data = _ckt->PWLData(_ckt->device(dev._devId));
-      double simTime = stepTime(size()-steps-1);
-      return data.valueAtTime(simTime);
-    } else {
-      return dev._value;
-    }
+    return sourceValue(dev, stepTime(size()-steps-1));
   }
   return deviceCurrentBackstepImp(deviceId, steps);
 }
 
+double
+SimResult::nodeVoltageHistory(size_t nodeId, size_t steps) const
+{
+  assert(steps > 0 && steps <= _ticks.size() + 1);
+  if (steps <= _ticks.size()) {
+    return nodeVoltage(nodeId, _ticks.size() - steps);
+  }
+  const NodeSource& source = _nodeSources[nodeId];
+  switch (source._kind) {
+    case NodeSource::Kind::Solved:
+      return 0;
+    case NodeSource::Kind::Fixed:
+      return source._value;
+    case NodeSource::Kind::PWL:
+      return _PWLEvaluators[source._index].valueAtTime(0);
+    case NodeSource::Kind::Search:
+      break;
+  }
+  if (_ckt->isGroundNode(nodeId)) {
+    return 0;
+  }
+  double voltage = sourceVoltage(nodeId, 0);
+  if (voltage != std::numeric_limits<double>::lowest()) {
+    return voltage;
+  }
+  return 0;
+}
+
+double
+SimResult::deviceCurrentHistory(size_t devId, size_t steps) const
+{
+  assert(steps > 0 && steps <= _ticks.size() + 1);
+  if (steps <= _ticks.size()) {
+    return deviceCurrent(devId, _ticks.size() - steps);
+  }
+  const Device& dev = _ckt->device(devId);
+  if (dev._type == DeviceType::CurrentSource) {
+    return sourceValue(dev, 0);
+  }
+  return 0;
+}
+
+double
+SimResult::historyTime(size_t steps) const
+{
+  assert(steps > 0 && steps <= _ticks.size() + 1);
+  if (steps <= _ticks.size()) {
+    return _ticks[_ticks.size() - steps];
+  }
+  return 0;
+}
+
 double 
 SimResult::stepSize(size_t steps) const
 {
@@ -361,7 +506,8 @@ SimResult::waveformData(size_t rowIndex, double* max, double* min) const
   size_t resultVectorSize = indexMap().size();
   for (size_t tIndex=0; tIndex<ticks().size(); ++tIndex) {
     size_t valueIndex = tIndex*resultVectorSize+rowIndex;
-    double value = this->value(valueIndex);
+    double value = isComplex() ? std::abs(complexValue(valueIndex)) 
+                               : this->value(valueIndex);
     if (!std::isnan(value) && !std::isinf(value)) {
       if (max != nullptr) *max = std::max(*max, value);
       if (min != nullptr) *min = std::min(*min, value);
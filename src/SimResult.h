@@ -1,9 +1,11 @@
 #ifndef _TRAN_SIMRES_H_
 #define _TRAN_SIMRES_H_
 
+#include <cstdint>
 #include <vector>
 #include <deque>
 #include <limits>
+#include <complex>
 #include "Base.h"
 #include "Circuit.h"
 
@@ -44,6 +46,27 @@ struct SimResultMap {
   void setDimention(size_t val) { _dimension = val; }
 };
 
+/// @brief Where the voltage of a node comes from, precomputed for every node
+///        so that a voltage query does not walk the node connections
+struct NodeSource {
+  enum class Kind : uint8_t {
+    Solved, /// _index is the index in x
+    Fixed,  /// _value is the voltage, ground or constant voltage sources
+    PWL,    /// _index is the PWL evaluator of the driving voltage source
+    Search  /// several PWL sources or out of scope, the connections are searched
+  };
+  Kind   _kind = Kind::Search;
+  size_t _index = 0;
+  double _value = 0;
+};
+
+/// @brief Grounded ideal voltage source and its positive node, indices are
+///        in the full MNA vector
+struct FixedNode {
+  size_t _nodeIndex = 0;
+  size_t _branchIndex = 0;
+};
+
 /// @brief The solution data of every time step produced by solving Ax=b
 class SimResult {
   public:
@@ -54,8 +77,12 @@ class SimResult {
     {
       _name.clear();
       _map.clear();
+      _nodeSources.clear();
+      _PWLEvaluators.clear();
+      _PWLEvaluatorMap.clear();
       _ticks.clear();
       _values.clear();
+      _imagValues.clear();
     }
 
     void copy(const SimResult& other)
@@ -64,8 +91,12 @@ class SimResult {
       _ckt = other._ckt;
       _name = other._name;
       _map.copy(other._map);
+      _nodeSources = other._nodeSources;
+      _PWLEvaluators = other._PWLEvaluators;
+      _PWLEvaluatorMap = other._PWLEvaluatorMap;
       _ticks = other._ticks;
       _values = other._values;
+      _imagValues = other._imagValues;
     }
     
     void swap(SimResult& other)
@@ -73,8 +104,12 @@ class SimResult {
       _ckt = other._ckt;
       _name.swap(other._name);
       _map.swap(other._map);
+      _nodeSources.swap(other._nodeSources);
+      _PWLEvaluators.swap(other._PWLEvaluators);
+      _PWLEvaluatorMap.swap(other._PWLEvaluatorMap);
       _ticks.swap(other._ticks);
       _values.swap(other._values);
+      _imagValues.swap(other._imagValues);
     }
 
     std::string name() const { return _name; }
@@ -89,6 +124,17 @@ class SimResult {
     const std::deque<double>& values() const { return _values; }
     double tick(size_t i) const { return _ticks[i]; }
     double value(size_t i) const { return _values[i]; }
+
+    /// Frequency domain results are complex, ticks() are frequencies, 
+    /// values() hold the real parts and imagValues() the imaginary parts.
+    /// Waveforms of complex results are magnitudes
+    bool isComplex() const { return _imagValues.empty() == false; }
+    const std::deque<double>& imagValues() const { return _imagValues; }
+    std::deque<double>& imagValues() { return _imagValues; }
+    std::complex<double> complexValue(size_t i) const 
+    { 
+      return std::complex<double>(_values[i], _imagValues[i]); 
+    }
     
     /// For Simulator access
     SimResultMap& indexMap() { return _map; }
@@ -99,6 +145,11 @@ class SimResult {
     ///        Index of matrix A, from given node/device id
     size_t nodeVectorIndex(size_t nodeId) const;
     size_t deviceVectorIndex(size_t deviveId) const;
+    /// @brief Nodes tied to ground by an ideal voltage source, whose voltage
+    ///        is the source value. Nodes driven by other voltage sources
+    ///        too, and sources whose current controls another source are
+    ///        not included
+    std::vector<FixedNode> fixedNodes() const;
    
     /// @brief Get accumulated simulation time
     double currentTime() const;
@@ -119,6 +170,8 @@ class SimResult {
     double deviceCurrent(size_t devId, size_t timeStep) const;
     double nodeVoltage(size_t nodeId, double simTime) const;
     double deviceCurrent(size_t devId, double simTime) const;
+    /// @brief Get the value of a voltage or current source at simTime
+    double sourceValue(const Device& dev, double simTime) const;
     /// @brief Get the voltage of given node id
     /// @param nodeId 
     /// @param steps: number of steps BACK with respect to current time
@@ -129,6 +182,20 @@ class SimResult {
     /// @brief Get the current of given device id, parameters are interpreted 
     ///        the same way as nodeVoltageBackstep
     double deviceCurrentBackstep(size_t devId, size_t steps) const;
+    /// @brief Get the voltage, current and time of the tick steps back from
+    ///        the latest one, 1 means the latest tick. Sources are taken at
+    ///        the time of the tick. One step before the first tick is the
+    ///        initial condition at time 0, sources are on and capacitors and
+    ///        inductors are discharged
+    double nodeVoltageHistory(size_t nodeId, size_t steps) const;
+    double deviceCurrentHistory(size_t devId, size_t steps) const;
+    double historyTime(size_t steps) const;
+    /// Drop the latest tick, for steps rejected by step control
+    void removeLastTick()
+    {
+      _ticks.pop_back();
+      _values.erase(_values.end() - _map.size(), _values.end());
+    }
     
     /// @brief Get derivative of voltage and current.
     ///        order controls the order of derivative you need
@@ -157,6 +224,7 @@ class SimResult {
     {
       _ticks.clear();
       _values.clear();
+      _imagValues.clear();
     }
   
   private:
@@ -164,6 +232,7 @@ class SimResult {
     double nodeVoltageImp(size_t nodeId, size_t timeStep) const;
     double deviceCurrentImp(size_t devId, size_t timeStep) const;
     double nodeVoltageBackstepImp(size_t nodeId, size_t steps) const;
+    double sourceVoltage(size_t nodeId, double simTime) const;
     double deviceCurrentBackstepImp(size_t devId, size_t steps) const;
     Waveform waveformData(size_t rowIndex, double* max, double* min) const;
   
@@ -171,8 +240,12 @@ class SimResult {
     const Circuit*      _ckt = nullptr;
     std::string         _name;
     SimResultMap        _map;
+    std::vector<NodeSource> _nodeSources; /// by node ID
+    std::vector<PWLEvaluator> _PWLEvaluators; /// of PWL sources in scope
+    std::vector<size_t> _PWLEvaluatorMap; /// PWL data index to evaluator
     std::vector<double> _ticks;
     std::deque<double>  _values; /// size should be _map.size()*_ticks.size()
+    std::deque<double>  _imagValues; /// empty or same size as _values
   
 };
 }
@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <cmath>
 #include <iostream>
 #include "Simulator.h"
 #include "Circuit.h"
@@ -6,6 +7,7 @@
 #include "StepControl.h"
 #include "Debug.h"
 #include "MNASymbolStamper.h"
+#include "ExponentialIntegrator.h"
 
 namespace NA {
 
@@ -27,6 +29,8 @@ Simulator::integrateMethod() const
     } else {
       method= IntegrateMethod::Trapezoidal;
     }
+  } else if (intMethod() == IntegrateMethod::BDF) {
+    method = IntegrateMethod::BDF;
 /*} else if (intMethod == IntegrateMethod::RK4) {
     if (prevData.ticks().size() < 1) {
       return IntegrateMethod::BackwardEuler;
@@ -56,15 +60,17 @@ Simulator::updateEquation()
     formulateEquation();
   } else {
     MNAStamper stamper(_param, _circuit, _result);
+    stamper.setBDFCoefficients(BDFCoeff());
     stamper.updateb(_b, integrateMethod());
     if (Debug::enabled(DebugModule::Sim)) {
       double prevTime = _result.ticks().back();
       Debug::printVector(prevTime+simulationTick(), "b", _b);
       if (Debug::enabled(DebugModule::Sim, 4)) {
-        StringMatrix GSym(_eqnDim, _eqnDim);
-        StringMatrix CSym(_eqnDim, _eqnDim);
-        StringMatrix bSym(_eqnDim, 1);
+        StringMatrix GSym(_fullDim, _fullDim);
+        StringMatrix CSym(_fullDim, _fullDim);
+        StringMatrix bSym(_fullDim, 1);
         MNASymbolStamper sStamper(_param, _circuit, _result);
+        sStamper.setBDFCoefficients(BDFCoeff());
         sStamper.stamp(GSym, CSym, bSym, integrateMethod());
         printf("b = \n"); bSym.print();
     }
@@ -76,12 +82,15 @@ void
 Simulator::formulateEquation()
 {
   Eigen::MatrixXd G;
-  G.setZero(_eqnDim, _eqnDim);
+  G.setZero(_fullDim, _fullDim);
   Eigen::MatrixXd C;
-  C.setZero(_eqnDim, _eqnDim);
-  _b.setZero(_eqnDim);
+  C.setZero(_fullDim, _fullDim);
+  _b.setZero(_fullDim);
   MNAStamper stamper(_param, _circuit, _result);
+  stamper.setBDFCoefficients(BDFCoeff());
   stamper.stamp(G, C, _b, integrateMethod());
+  _BDFAlpha0 = _BDFCoeff._alpha[0];
+  ++_factorizations;
 
   Eigen::MatrixXd A = G + C;
   
@@ -95,10 +104,11 @@ Simulator::formulateEquation()
     }
     */
     if (Debug::enabled(DebugModule::Sim, 1)) {
-      StringMatrix GSym(_eqnDim, _eqnDim);
-      StringMatrix CSym(_eqnDim, _eqnDim);
-      StringMatrix bSym(_eqnDim, 1);
+      StringMatrix GSym(_fullDim, _fullDim);
+      StringMatrix CSym(_fullDim, _fullDim);
+      StringMatrix bSym(_fullDim, 1);
       MNASymbolStamper sStamper(_param, _circuit, _result);
+      sStamper.setBDFCoefficients(BDFCoeff());
       sStamper.stamp(GSym, CSym, bSym, integrateMethod());
       printf("A = G + C\n");
       printf("G = \n"); GSym.print();
@@ -106,20 +116,195 @@ Simulator::formulateEquation()
       printf("b = \n"); bSym.print();
     }
   }
-  _Alu = A.fullPivLu();
+  if (_fixedNodes.empty()) {
+    factorEquation(A);
+  } else {
+    reduceEquation(A);
+  }
+}
+
+/// A is the reduced equation when there are fixed nodes
+void
+Simulator::factorEquation(const Eigen::MatrixXd& A)
+{
+  if (_factorSmall) {
+    (this->*_factorSmall)(A);
+  } else {
+    _Alu = A.fullPivLu();
+  }
+}
+
+/// Same pivoting as the dynamic path, so a singular A is detected the
+/// same way and left to _Alu
+template <int N>
+void
+Simulator::factorSmall(const Eigen::MatrixXd& A)
+{
+  Eigen::FullPivLU<Eigen::Matrix<double, N, N>> lu(A);
+  _smallFactored = lu.isInvertible();
+  if (_smallFactored == false) {
+    _Alu = A.fullPivLu();
+    return;
+  }
+  Eigen::Map<Eigen::Matrix<double, N, N>> LU(_smallLU);
+  LU = lu.matrixLU();
+  for (int i=0; i<N; ++i) {
+    _smallRowPerm[i] = lu.permutationP().indices()(i);
+    _smallColPerm[i] = lu.permutationQ().indices()(i);
+  }
+}
+
+/// Same as the reduced solve in solveEquation, on the stack. x = Q U^-1 L^-1 P b
+/// with the factors of factorSmall, as FullPivLU::solve does
+template <int N>
+void
+Simulator::solveSmall(Eigen::VectorXd& x) const
+{
+  Eigen::Matrix<double, N, 1> br;
+  for (int i=0; i<N; ++i) {
+    br(i) = _b(_solvedIndex[i]);
+  }
+  for (size_t k=0; k<_fixedNodes.size(); ++k) {
+    br -= _AFixed.col(k) * _b(_fixedNodes[k]._branchIndex);
+  }
+  Eigen::Matrix<double, N, 1> c;
+  for (int i=0; i<N; ++i) {
+    c(_smallRowPerm[i]) = br(i);
+  }
+  Eigen::Map<const Eigen::Matrix<double, N, N>> LU(_smallLU);
+  LU.template triangularView<Eigen::UnitLower>().solveInPlace(c);
+  LU.template triangularView<Eigen::Upper>().solveInPlace(c);
+  for (int i=0; i<N; ++i) {
+    x(_solvedIndex[_smallColPerm[i]]) = c(i);
+  }
+  expandFixedNodes(x);
+}
+
+template <int N>
+void
+Simulator::selectSmallSolver()
+{
+  if (_eqnDim == static_cast<size_t>(N)) {
+    _factorSmall = &Simulator::factorSmall<N>;
+    _solveSmall = &Simulator::solveSmall<N>;
+  } else {
+    selectSmallSolver<N-1>();
+  }
+}
+
+template <>
+void
+Simulator::selectSmallSolver<0>()
+{
+}
+
+/// A node tied to ground by an ideal voltage source has a known voltage,
+/// the source value in b. The node and the branch current of the source
+/// are taken out of the equation
+void
+Simulator::findFixedNodes()
+{
+  _fixedNodes = _result.fixedNodes();
+  std::vector<bool> isFixed(_fullDim, false);
+  for (const FixedNode& fixed : _fixedNodes) {
+    isFixed[fixed._nodeIndex] = true;
+    isFixed[fixed._branchIndex] = true;
+  }
+  _solvedIndex.clear();
+  for (size_t i=0; i<_fullDim; ++i) {
+    if (isFixed[i] == false) {
+      _solvedIndex.push_back(i);
+    }
+  }
+  _eqnDim = _solvedIndex.size();
+}
+
+/// Rows of fixed nodes and branch equations of their sources are dropped,
+/// columns of fixed nodes are kept to move their known voltages to the
+/// right hand side. The branch currents of the sources only appear in the
+/// dropped rows, so they are recovered from the rows of the fixed nodes
+void
+Simulator::reduceEquation(const Eigen::MatrixXd& A)
+{
+  Eigen::MatrixXd Ar(_eqnDim, _eqnDim);
+  _AFixed.resize(_eqnDim, _fixedNodes.size());
+  for (size_t i=0; i<_eqnDim; ++i) {
+    for (size_t j=0; j<_eqnDim; ++j) {
+      Ar(i, j) = A(_solvedIndex[i], _solvedIndex[j]);
+    }
+    for (size_t k=0; k<_fixedNodes.size(); ++k) {
+      _AFixed(i, k) = A(_solvedIndex[i], _fixedNodes[k]._nodeIndex);
+    }
+  }
+  _AFixedRows.resize(_fixedNodes.size(), _fullDim);
+  for (size_t k=0; k<_fixedNodes.size(); ++k) {
+    _AFixedRows.row(k) = A.row(_fixedNodes[k]._nodeIndex);
+    _AFixedRows(k, _fixedNodes[k]._branchIndex) = 0;
+  }
+  if (_eqnDim > 0) {
+    factorEquation(Ar);
+  }
+}
+
+void
+Simulator::expandSolution(const Eigen::VectorXd& xr, Eigen::VectorXd& x) const
+{
+  for (size_t i=0; i<_eqnDim; ++i) {
+    x(_solvedIndex[i]) = xr(i);
+  }
+  expandFixedNodes(x);
+}
+
+void
+Simulator::expandFixedNodes(Eigen::VectorXd& x) const
+{
+  for (const FixedNode& fixed : _fixedNodes) {
+    x(fixed._nodeIndex) = _b(fixed._branchIndex);
+    x(fixed._branchIndex) = 0;
+  }
+  for (size_t k=0; k<_fixedNodes.size(); ++k) {
+    const FixedNode& fixed = _fixedNodes[k];
+    x(fixed._branchIndex) = _b(fixed._nodeIndex) - _AFixedRows.row(k).dot(x);
+  }
 }
 
 void 
 Simulator::initData()
 {
-  _eqnDim = _result.indexMap().size();
+  _fullDim = _result.indexMap().size();
+  _eqnDim = _fullDim;
+  findFixedNodes();
+  _x.resize(_fullDim);
+  _factorSmall = nullptr;
+  _solveSmall = nullptr;
+  _smallFactored = false;
+  selectSmallSolver<maxSmallDim>();
 }
 
 void 
 Simulator::solveEquation()
 {
-  Eigen::VectorXd x(_eqnDim);
-  x = _Alu.solve(_b);
+  Eigen::VectorXd& x = _x;
+  if (_solveSmall && _smallFactored) {
+    (this->*_solveSmall)(x);
+  } else if (_fixedNodes.empty()) {
+    x = _Alu.solve(_b);
+  } else {
+    Eigen::VectorXd fixedVoltages(_fixedNodes.size());
+    Eigen::VectorXd br(_eqnDim);
+    for (size_t k=0; k<_fixedNodes.size(); ++k) {
+      fixedVoltages(k) = _b(_fixedNodes[k]._branchIndex);
+    }
+    for (size_t i=0; i<_eqnDim; ++i) {
+      br(i) = _b(_solvedIndex[i]);
+    }
+    br -= _AFixed * fixedVoltages;
+    Eigen::VectorXd xr(_eqnDim);
+    if (_eqnDim > 0) {
+      xr = _Alu.solve(br);
+    }
+    expandSolution(xr, x);
+  }
   
   std::vector<double>& ticks = _result.ticks();
   std::deque<double>& values = _result.values();
@@ -145,27 +330,115 @@ Simulator::converged() const
     simTime = _result.ticks().back();
   }
   bool converge = true;
+  if (simTime > simEnd() && intMethod() == IntegrateMethod::BDF) {
+    /// The last tick is solved again if it is rejected
+    converge = checkBDFStep()._accepted;
+  }
   return simTime > simEnd() && converge;
 }
 
+void
+Simulator::initBDF()
+{
+  _BDFStartStep = simulationTick();
+  _BDFMinStep = 1e-3 * _BDFStartStep;
+  _BDFMaxStep = std::max(_BDFStartStep, simEnd() / 50);
+  _breakpoints = _circuit.sourceBreakpoints(simEnd());
+  _nextBreakpoint = 0;
+  _BDFUsable = 1;
+  _BDFSteady = 0;
+  /// Changes of the equation come from the coefficients only
+  _prevMethod = IntegrateMethod::BDF;
+  setSimulationTick(limitBDFStep(_BDFStartStep));
+  StepControl::BDFCoefficients(_result, simulationTick(), 1, _BDFUsable, _BDFCoeff);
+}
+
+/// Ticks land on the breakpoints of the sources. A step that would stop
+/// just before a breakpoint is stretched to it, one that would leave a
+/// short step to it is split in two even steps. A stretch within rounding
+/// keeps the step, and with it the factorization of the equation
+double
+Simulator::limitBDFStep(double step)
+{
+  step = std::min(step, _BDFMaxStep);
+  _BDFAtBreakpoint = false;
+  if (_nextBreakpoint < _breakpoints.size()) {
+    double remaining = _breakpoints[_nextBreakpoint] - _result.currentTime();
+    if (step > remaining - _BDFMinStep) {
+      if (std::abs(remaining - step) > 1e-9 * step) {
+        step = remaining;
+      }
+      _BDFAtBreakpoint = true;
+    } else if (2 * step > remaining) {
+      step = remaining / 2;
+    }
+  }
+  return step;
+}
+
+/// Steps below the minimum step are accepted whatever their error
+BDFStep
+Simulator::checkBDFStep() const
+{
+  BDFStep next = StepControl::BDFNextStep(this, _BDFCoeff._order, _BDFUsable + 1, 
+                                          _BDFSteady + 1);
+  if (next._accepted == false && next._step < _BDFMinStep) {
+    next._accepted = true;
+    next._step = _BDFMinStep;
+  }
+  return next;
+}
+
+/// With BDF the LTE of the latest tick decides whether it is kept and the
+/// step and order of the next one. A changed alpha0 needs a new A
 void
 Simulator::adjustSimTick()
 {
-  /*
-  double stepSizeLimit = StepControl::stepLimit(this, relTotal());
-  if (simulationTick() > stepSizeLimit) {
-    printf("WARNING: Current step size %G is larger the LTE limit %G\n", simulationTick(), stepSizeLimit);
+  if (intMethod() != IntegrateMethod::BDF) {
+    return;
+  }
+  BDFStep next = checkBDFStep();
+  if (next._accepted) {
+    ++_BDFUsable;
+    ++_BDFSteady;
+    if (_BDFAtBreakpoint) {
+      /// Sources change slope, the history before is not smooth
+      ++_nextBreakpoint;
+      _BDFUsable = 1;
+      next._order = 1;
+      next._step = std::min(next._step, _BDFStartStep);
+    }
+  } else {
+    _result.removeLastTick();
+    ++_BDFRejected;
+  }
+  next._order = std::min(next._order, _BDFUsable);
+  setSimulationTick(limitBDFStep(next._step));
+  StepControl::BDFCoefficients(_result, simulationTick(), next._order, _BDFUsable, _BDFCoeff);
+  if (_BDFCoeff._alpha[0] != _BDFAlpha0) {
+    _needRebuild = true;
+    _BDFSteady = 0;
   }
-  */
-  /// Implement LTE calculation and adjust simulationTick() based on it
-  /// and set _needUpdateA to true
-  return;
 }
 
 void 
 Simulator::run()
 {
   initData();
+  if (intMethod() == IntegrateMethod::Exponential) {
+    if (_updateFunc) {
+      printf("WARNING: Exponential integration needs sources known ahead, using trap instead of exp\n");
+    } else {
+      ExponentialIntegrator integrator(_circuit, _param, _result);
+      if (integrator.run([this]() { return checkTerminateCondition(); })) {
+        return;
+      }
+    }
+    _param._intMethod = IntegrateMethod::Trapezoidal;
+  }
+  if (intMethod() == IntegrateMethod::BDF) {
+    initBDF();
+  }
   if (_updateFunc) {
     _needRebuild = _updateFunc();
   }
@@ -173,13 +446,26 @@ Simulator::run()
   solveEquation();
   while (!converged()) {
     checkNeedRebuild();
-    if (_updateFunc) {
-      _needRebuild = _updateFunc();
+    /// The update function can only request a rebuild, not cancel the one 
+    /// needed by the change of integration method
+    if (_updateFunc && _updateFunc()) {
+      _needRebuild = true;
     }
     adjustSimTick();
     updateEquation();
     solveEquation();
   }
+  if (intMethod() == IntegrateMethod::BDF && Debug::enabled(DebugModule::Sim)) {
+    printf("BDF: %lu ticks, %lu rejected, %lu factorizations\n", 
+           _result.size(), _BDFRejected, _factorizations);
+  }
+  if (Debug::enabled(DebugModule::CCS)) {
+    CCSCacheStats stats = _circuit.libData()->ccsCacheStats();
+    if (stats.lookups() > 0) {
+      printf("CCS waveform cache: %lu lookups, %lu hits, hit rate %.1f%%\n", 
+             stats.lookups(), stats._hits, stats.hitRate() * 100);
+    }
+  }
 }
 
 void
@@ -8,6 +8,7 @@
 #include <functional>
 #include "Base.h"
 #include "SimResult.h"
+#include "StepControl.h"
 
 namespace NA {
 
@@ -37,6 +38,7 @@ class Simulator {
     double simEnd() const { return _param._simTime; }
     double relTotal() const { return _param._relTotal; }
     IntegrateMethod intMethod() const { return _param._intMethod; }
+    const AnalysisParameter& analysisParameter() const { return _param; }
 
     typedef std::pair<bool, double> TermVoltage;
     void setTerminationVoltage(size_t nodeId, bool isRise, double value)
@@ -55,6 +57,14 @@ class Simulator {
     void setUpdateFunction(const std::function<bool(void)>& f) { _updateFunc = f; }
 
   private:
+    void findFixedNodes();
+    void reduceEquation(const Eigen::MatrixXd& A);
+    void expandSolution(const Eigen::VectorXd& xr, Eigen::VectorXd& x) const;
+    void expandFixedNodes(Eigen::VectorXd& x) const;
+    void factorEquation(const Eigen::MatrixXd& A);
+    template <int N> void selectSmallSolver();
+    template <int N> void factorSmall(const Eigen::MatrixXd& A);
+    template <int N> void solveSmall(Eigen::VectorXd& x) const;
     void formulateEquation();
     void updateEquation();
     bool converged() const;
@@ -62,9 +72,17 @@ class Simulator {
     void solveEquation();
     void checkNeedRebuild();
     bool checkTerminateCondition() const;
+    void initBDF();
+    double limitBDFStep(double step);
+    BDFStep checkBDFStep() const;
+    const BDFCoefficients* BDFCoeff() const 
+    { 
+      return intMethod() == IntegrateMethod::BDF ? &_BDFCoeff : nullptr; 
+    }
 
   private:
-    size_t             _eqnDim = 0;
+    size_t             _eqnDim = 0; /// unknowns solved, fixed nodes excluded
+    size_t             _fullDim = 0; /// unknowns of the full MNA equation
     bool               _needIterate = true;
     bool               _needRebuild = true;
     bool               _needUpdateA = false;
@@ -75,6 +93,35 @@ class Simulator {
     Eigen::VectorXd    _b;
     /// Cache data
     Eigen::FullPivLU<Eigen::MatrixXd>    _Alu;
+    std::vector<FixedNode>               _fixedNodes;
+    std::vector<size_t>                  _solvedIndex; /// solved unknown to full index
+    Eigen::MatrixXd                      _AFixed; /// fixed node columns of solved rows
+    Eigen::MatrixXd                      _AFixedRows; /// fixed node rows, for branch currents
+    Eigen::VectorXd                      _x; /// solution of the latest step
+    /// Equations of at most maxSmallDim unknowns are factorized by a fixed
+    /// size FullPivLU, chosen by _eqnDim in initData. Its LU matrix and
+    /// permutations are kept here. A singular A is factorized by _Alu and
+    /// solved in the dynamic path
+    static constexpr size_t maxSmallDim = 16;
+    void (Simulator::*_factorSmall)(const Eigen::MatrixXd& A) = nullptr;
+    void (Simulator::*_solveSmall)(Eigen::VectorXd& x) const = nullptr;
+    bool                                 _smallFactored = false;
+    double                               _smallLU[maxSmallDim * maxSmallDim];
+    int                                  _smallRowPerm[maxSmallDim];
+    int                                  _smallColPerm[maxSmallDim];
+    /// Variable step BDF, the step and order are chosen in adjustSimTick
+    BDFCoefficients      _BDFCoeff;
+    double               _BDFAlpha0 = 0; /// alpha0 of the factorized A
+    size_t               _BDFUsable = 1; /// ticks since the last breakpoint or time 0, with it
+    size_t               _BDFSteady = 0; /// ticks accepted since A changed
+    double               _BDFStartStep = 0; /// step at time 0 and after breakpoints
+    double               _BDFMinStep = 0;
+    double               _BDFMaxStep = 0;
+    bool                 _BDFAtBreakpoint = false; /// the tick being solved is a breakpoint
+    std::vector<double>  _breakpoints;
+    size_t               _nextBreakpoint = 0;
+    size_t               _BDFRejected = 0;
+    size_t               _factorizations = 0;
 
     std::unordered_map<size_t, TermVoltage>   _termVoltages;
     std::unordered_map<size_t, double>        _termCurrents;
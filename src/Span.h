@@ -0,0 +1,80 @@
+#ifndef _NA_SPAN_H_
+#define _NA_SPAN_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace NA {
+
+/// Read only view of a contiguous range of T owned by someone else,
+/// a stand-in of std::span which is not available in C++17.
+/// The view is invalidated when the owner reallocates its storage.
+template <typename T>
+class Span {
+  public:
+    Span() = default;
+    Span(const T* data, size_t size)
+    : _data(data), _size(size) {}
+    Span(const std::vector<T>& vec)
+    : _data(vec.data()), _size(vec.size()) {}
+
+    const T* data() const { return _data; }
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    const T* begin() const { return _data; }
+    const T* end() const { return _data + _size; }
+    const T& operator[](size_t i) const { return _data[i]; }
+    const T& front() const { return _data[0]; }
+    const T& back() const { return _data[_size-1]; }
+
+    std::vector<T> toVector() const { return std::vector<T>(begin(), end()); }
+
+  private:
+    const T* _data = nullptr;
+    size_t   _size = 0;
+};
+
+/// Read only view of the elements of a vector selected by a list of
+/// indices, both owned by someone else. Iterating the view yields the
+/// selected elements in the order of the index list without copying them.
+template <typename T>
+class IndexedSpan {
+  public:
+    class Iterator {
+      public:
+        Iterator(const T* data, const size_t* index)
+        : _data(data), _index(index) {}
+
+        const T& operator*() const { return _data[*_index]; }
+        const T* operator->() const { return &_data[*_index]; }
+        Iterator& operator++() { ++_index; return *this; }
+        bool operator==(const Iterator& other) const { return _index == other._index; }
+        bool operator!=(const Iterator& other) const { return _index != other._index; }
+
+      private:
+        const T*      _data;
+        const size_t* _index;
+    };
+
+    IndexedSpan() = default;
+    IndexedSpan(const std::vector<T>& vec, const std::vector<size_t>& indices)
+    : _data(vec.data()), _indices(indices) {}
+
+    size_t size() const { return _indices.size(); }
+    bool empty() const { return _indices.empty(); }
+    /// Indices of the selected elements in the owner
+    Span<size_t> indices() const { return _indices; }
+
+    Iterator begin() const { return Iterator(_data, _indices.begin()); }
+    Iterator end() const { return Iterator(_data, _indices.end()); }
+    const T& operator[](size_t i) const { return _data[_indices[i]]; }
+
+  private:
+    const T*     _data = nullptr;
+    Span<size_t> _indices;
+};
+
+}
+
+#endif
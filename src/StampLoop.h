@@ -0,0 +1,127 @@
+#ifndef _NA_STAMPLOOP_H_
+#define _NA_STAMPLOOP_H_
+
+#include <cassert>
+#include "Base.h"
+#include "Circuit.h"
+
+namespace NA {
+
+/// Device loops shared by MNAStamper and MNASymbolStamper. The integration
+/// method is a template parameter of the loops and of the capacitor and
+/// inductor stamp functions, so the method is chosen once per call instead
+/// of once per device, and the stamp functions of each method are inlined
+/// in a loop of their own. Each stamper is a friend of its StampLoop
+template <typename Stamper>
+class StampLoop {
+  public:
+    template <typename Matrix, typename Vector>
+    static void stamp(const Stamper& stamper, Matrix& G, Matrix& C, Vector& b,
+                      IntegrateMethod intMethod)
+    {
+      switch (intMethod) {
+        case IntegrateMethod::BackwardEuler:
+          stamp<IntegrateMethod::BackwardEuler>(stamper, G, C, b);
+          break;
+        case IntegrateMethod::Gear2:
+          stamp<IntegrateMethod::Gear2>(stamper, G, C, b);
+          break;
+        case IntegrateMethod::Trapezoidal:
+          stamp<IntegrateMethod::Trapezoidal>(stamper, G, C, b);
+          break;
+        case IntegrateMethod::BDF:
+          stamp<IntegrateMethod::BDF>(stamper, G, C, b);
+          break;
+        default:
+          assert(false && "Incorrect integrate method");
+      }
+    }
+
+    template <typename Vector>
+    static void updateb(const Stamper& stamper, Vector& b, IntegrateMethod intMethod)
+    {
+      switch (intMethod) {
+        case IntegrateMethod::BackwardEuler:
+          updateb<IntegrateMethod::BackwardEuler>(stamper, b);
+          break;
+        case IntegrateMethod::Gear2:
+          updateb<IntegrateMethod::Gear2>(stamper, b);
+          break;
+        case IntegrateMethod::Trapezoidal:
+          updateb<IntegrateMethod::Trapezoidal>(stamper, b);
+          break;
+        case IntegrateMethod::BDF:
+          updateb<IntegrateMethod::BDF>(stamper, b);
+          break;
+        default:
+          assert(false && "Incorrect integrate method");
+      }
+    }
+
+  private:
+    template <IntegrateMethod Method, typename Matrix, typename Vector>
+    static void stamp(const Stamper& stamper, Matrix& G, Matrix& C, Vector& b)
+    {
+      for (const Device& dev : stamper._circuit.devicesToSimulate()) {
+        switch (dev._type) {
+          case DeviceType::Resistor:
+            stamper.stampResistor(G, C, b, dev);
+            break;
+          case DeviceType::Capacitor:
+            stamper.template stampCapacitor<Method>(G, C, b, dev);
+            break;
+          case DeviceType::Inductor:
+            stamper.template stampInductor<Method>(G, C, b, dev);
+            break;
+          case DeviceType::VoltageSource:
+            stamper.stampVoltageSource(G, C, b, dev);
+            break;
+          case DeviceType::CurrentSource:
+            stamper.stampCurrentSource(G, C, b, dev);
+            break;
+          case DeviceType::VCCS:
+            stamper.stampVCCS(G, C, b, dev);
+            break;
+          case DeviceType::VCVS:
+            stamper.stampVCVS(G, C, b, dev);
+            break;
+          case DeviceType::CCCS:
+            stamper.stampCCCS(G, C, b, dev);
+            break;
+          case DeviceType::CCVS:
+            stamper.stampCCVS(G, C, b, dev);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+
+    /// Only sources and dynamic devices have a b of their own
+    template <IntegrateMethod Method, typename Vector>
+    static void updateb(const Stamper& stamper, Vector& b)
+    {
+      for (const Device& dev : stamper._circuit.devicesToSimulate()) {
+        switch (dev._type) {
+          case DeviceType::Capacitor:
+            stamper.template updatebCapacitor<Method>(b, dev);
+            break;
+          case DeviceType::Inductor:
+            stamper.template updatebInductor<Method>(b, dev);
+            break;
+          case DeviceType::VoltageSource:
+            stamper.updatebVoltageSource(b, dev);
+            break;
+          case DeviceType::CurrentSource:
+            stamper.updatebCurrentSource(b, dev);
+            break;
+          default:
+            break;
+        }
+      }
+    }
+};
+
+}
+
+#endif
@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <cmath>
 #include "StepControl.h"
 #include "Simulator.h"
 #include "Circuit.h"
@@ -107,7 +109,7 @@ LTE::maxLTE(const Simulator* sim)
   lteFunc[static_cast<size_t>(DeviceType::CCCS)] = lteNoop;
 
   double lteValue = .0f;
-  const std::vector<Device>& devices = sim->circuit().devicesToSimulate();
+  IndexedSpan<Device> devices = sim->circuit().devicesToSimulate();
   for (const Device& device : devices) {
     double devLTE = lteFunc[static_cast<size_t>(device._type)](device, sim);
     lteValue = std::max(lteValue, std::abs(devLTE));
@@ -244,7 +246,7 @@ StepControl::stepLimit(const Simulator* sim, double relTol)
   stepSizeFunc[static_cast<size_t>(DeviceType::CCCS)] = stepNoop;
 
   double stepSizeLimit = std::numeric_limits<double>::max();
-  const std::vector<Device>& devices = sim->circuit().devicesToSimulate();
+  IndexedSpan<Device> devices = sim->circuit().devicesToSimulate();
   for (const Device& device : devices) {
     double devStepSize = stepSizeFunc[static_cast<size_t>(device._type)](device, sim, relTol);
     stepSizeLimit = std::min(stepSizeLimit, devStepSize);
@@ -252,5 +254,186 @@ StepControl::stepLimit(const Simulator* sim, double relTol)
   return stepSizeLimit;
 }
 
+/// Fixed leading coefficient form: x(t) is the predictor polynomial P(t)
+/// through the latest order+1 ticks, corrected by (x[n+1]-P(t[n+1]))*w(t)
+/// with w(t[n+1]) = 1, so x'(t[n+1]) ~ P'(t[n+1]) + alpha0*(x[n+1]-P(t[n+1])).
+/// alpha0 is the one of equal steps, so A only changes with the step or 
+/// the order, and the formula is the usual BDF when the steps are equal.
+/// With only order ticks the polynomial through them and x[n+1] is used
+void
+StepControl::BDFCoefficients(const SimResult& result, double step, size_t order, 
+                             size_t points, NA::BDFCoefficients& coeff)
+{
+  assert(order >= 1 && order <= NA::BDFCoefficients::maxOrder && points >= order);
+  size_t history = std::min(points, order + 1);
+  double times[NA::BDFCoefficients::maxOrder+2] = {0};
+  times[0] = result.currentTime() + step;
+  for (size_t j=1; j<=history; ++j) {
+    times[j] = result.historyTime(j);
+  }
+  coeff._order = order;
+  coeff._history = history;
+  coeff._alpha[0] = 0;
+  if (history == order) {
+    for (size_t m=1; m<=order; ++m) {
+      /// Taken from the step so that a restart keeps alpha0 of the same step
+      coeff._alpha[0] += 1 / (step + times[1] - times[m]);
+    }
+  } else {
+    for (size_t m=1; m<=order; ++m) {
+      coeff._alpha[0] += 1.0 / m;
+    }
+    coeff._alpha[0] /= step;
+  }
+  /// Value and derivative at times[0] of the Lagrange basis polynomials of
+  /// the history ticks, and of times[0] too if it is a node
+  for (size_t j=1; j<=history; ++j) {
+    double value = 1;
+    double slope = 0;
+    for (size_t m=(history == order ? 0 : 1); m<=history; ++m) {
+      if (m == j) {
+        continue;
+      }
+      if (m == 0) {
+        /// The basis polynomial is zero at times[0]
+        value = 0;
+        slope = 1 / (times[j] - times[0]);
+      } else {
+        double d = times[0] - times[m];
+        slope = slope * d + value;
+        value *= d;
+        slope /= times[j] - times[m];
+        value /= times[j] - times[m];
+      }
+    }
+    coeff._alpha[j] = slope - (history == order ? 0 : coeff._alpha[0] * value);
+  }
+}
+
+/// Divided difference of values over times, both of count points
+static inline double
+dividedDifference(const double* times, double* values, size_t count)
+{
+  for (size_t level=1; level<count; ++level) {
+    for (size_t i=0; i+level<count; ++i) {
+      values[i] = (values[i] - values[i+1]) / (times[i] - times[i+level]);
+    }
+  }
+  return values[0];
+}
+
+/// The LTE of BDF of order k is x^(k+1)/(k+1)! times the product of
+/// (t[n+1]-t[n+1-j]) for j = 1..k, over alpha0. The derivative is taken
+/// from the divided difference of the latest k+2 ticks
+double
+StepControl::BDFErrorRatio(const Simulator* sim, size_t order, size_t usable)
+{
+  size_t count = order + 2;
+  if (count > usable) {
+    return -1;
+  }
+  const SimResult& result = sim->simulationResult();
+  const AnalysisParameter& param = sim->analysisParameter();
+  double times[NA::BDFCoefficients::maxOrder+3] = {0};
+  for (size_t i=0; i<count; ++i) {
+    times[i] = result.historyTime(i+1);
+  }
+  double alpha0 = 0;
+  double product = 1;
+  for (size_t m=1; m<=order; ++m) {
+    alpha0 += 1 / (times[0] - times[m]);
+    product *= times[0] - times[m];
+  }
+  double scale = product / alpha0;
+
+  double values[NA::BDFCoefficients::maxOrder+3] = {0};
+  double maxRatio = 0;
+  for (const Device& dev : sim->circuit().devicesToSimulate()) {
+    double tol;
+    if (dev._type == DeviceType::Capacitor) {
+      for (size_t i=0; i<count; ++i) {
+        values[i] = result.nodeVoltageHistory(dev._posNode, i+1) - 
+                    result.nodeVoltageHistory(dev._negNode, i+1);
+      }
+      tol = param._vnTol;
+    } else if (dev._type == DeviceType::Inductor) {
+      for (size_t i=0; i<count; ++i) {
+        values[i] = result.deviceCurrentHistory(dev._devId, i+1);
+      }
+      tol = param._absTol;
+    } else {
+      continue;
+    }
+    tol += param._relTol * std::max(std::abs(values[0]), std::abs(values[1]));
+    double lte = scale * dividedDifference(times, values, count);
+    maxRatio = std::max(maxRatio, std::abs(lte) / tol);
+  }
+  return maxRatio;
+}
+
+/// Steps grow at most this much at a time
+static constexpr double maxGrowth = 2;
 
-}
\ No newline at end of file
+/// Step factor allowed by an error ratio of order, at most maxGrowth
+static inline double
+BDFStepFactor(double ratio, size_t order)
+{
+  static constexpr double safety = 0.9;
+  if (ratio <= 0) {
+    return maxGrowth;
+  }
+  return std::min(maxGrowth, safety * std::pow(ratio, -1.0 / (order + 1)));
+}
+
+/// A new step or order needs a new factorization of A, so an accepted tick
+/// keeps them until the step can be doubled, after order+1 steady ticks
+BDFStep
+StepControl::BDFNextStep(const Simulator* sim, size_t order, size_t usable, size_t steady)
+{
+  /// Rejected steps shrink at most this much at a time
+  static constexpr double minFactor = 0.2;
+  BDFStep next;
+  next._order = order;
+  double step = sim->simulationTick();
+  next._step = step;
+  double ratio = BDFErrorRatio(sim, order, usable);
+  if (ratio < 0) {
+    /// Too close to the start or to a breakpoint to tell
+    return next;
+  }
+  next._accepted = ratio <= 1;
+  if (next._accepted && steady < order + 1) {
+    return next;
+  }
+  double factor = BDFStepFactor(ratio, order);
+  /// Order changes are only taken for clearly longer steps, and a rejected
+  /// tick can only lower the order
+  size_t maxOrder = order;
+  if (next._accepted) {
+    maxOrder = std::min<size_t>(sim->analysisParameter()._maxOrder, order + 1);
+  }
+  for (size_t q=std::max<size_t>(order, 2)-1; q<=maxOrder; ++q) {
+    if (q == order) {
+      continue;
+    }
+    double qRatio = BDFErrorRatio(sim, q, usable);
+    if (qRatio < 0) {
+      continue;
+    }
+    double qFactor = BDFStepFactor(qRatio, q);
+    if (qFactor > 1.1 * factor) {
+      factor = qFactor;
+      next._order = q;
+    }
+  }
+  if (next._accepted == false) {
+    next._step = step * std::max(std::min(factor, 0.9), minFactor);
+  } else if (factor < maxGrowth) {
+    next._order = order;
+  } else {
+    next._step = step * maxGrowth;
+  }
+  return next;
+}
+
+}
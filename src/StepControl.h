@@ -1,9 +1,19 @@
 #ifndef _TRAN_STPCTL_H_
 #define _TRAN_STPCTL_H_
 
+#include "Base.h"
+
 namespace NA {
 
 class Simulator;
+class SimResult;
+
+/// Outcome of the LTE check of the latest BDF tick
+struct BDFStep {
+  bool   _accepted = true;
+  size_t _order = 1;   /// order of the next tick
+  double _step = 0;    /// step of the next tick, or of the retry if rejected
+};
 
 class LTE {
   public:
@@ -13,6 +23,21 @@ class LTE {
 class StepControl {
   public:
     static double stepLimit(const Simulator* sim, double relTol);
+
+    /// Coefficients of the BDF formula of order for the tick step after 
+    /// the latest one of result. points is the number of ticks since the
+    /// last source breakpoint or time 0, at least order
+    static void BDFCoefficients(const SimResult& result, double step, size_t order, 
+                                size_t points, NA::BDFCoefficients& coeff);
+    /// LTE of the latest tick over its tolerance, as if it was solved with
+    /// the BDF formula of order. The estimate takes order+2 ticks, usable
+    /// is the number of ticks, the latest included, since the last source
+    /// breakpoint or time 0. Negative if there are not enough of them
+    static double BDFErrorRatio(const Simulator* sim, size_t order, size_t usable);
+    /// Accept or reject the latest tick solved with order, and choose the
+    /// order from order-1 to order+1 that allows the longest next step.
+    /// steady is the number of ticks solved since the step or order changed
+    static BDFStep BDFNextStep(const Simulator* sim, size_t order, size_t usable, size_t steady);
 };
 
 }
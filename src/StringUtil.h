@@ -76,6 +76,41 @@ iequals(const std::string& a, const std::string& b)
          std::equal(a.begin(), a.end(), b.begin(), ichar_equals);
 }
 
+inline bool
+hasWildcard(const std::string& str)
+{
+  return str.find_first_of("*?") != std::string::npos;
+}
+
+/// Glob style matching, '*' matches any sequence and '?' matches 
+/// any single character
+inline bool
+wildcardMatch(const std::string& pattern, const std::string& str)
+{
+  size_t p = 0;
+  size_t s = 0;
+  size_t starP = std::string::npos;
+  size_t starS = 0;
+  while (s < str.size()) {
+    if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == str[s])) {
+      ++p;
+      ++s;
+    } else if (p < pattern.size() && pattern[p] == '*') {
+      starP = p++;
+      starS = s;
+    } else if (starP != std::string::npos) {
+      p = starP + 1;
+      s = ++starS;
+    } else {
+      return false;
+    }
+  }
+  while (p < pattern.size() && pattern[p] == '*') {
+    ++p;
+  }
+  return p == pattern.size();
+}
+
 inline std::string
 fileNameWithoutSuffix(const char* fname)
 {
@@ -0,0 +1,180 @@
+#ifndef _NA_SYMBOLTABLE_H_
+#define _NA_SYMBOLTABLE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace NA {
+
+typedef uint32_t SymbolId;
+static constexpr SymbolId invalidSymbol = static_cast<SymbolId>(-1);
+
+inline uint32_t
+hashSymbolName(std::string_view name)
+{
+  return static_cast<uint32_t>(std::hash<std::string_view>()(name));
+}
+
+/// Interns names to dense integer IDs, the first name gets ID 0.
+/// Names are hashed once when they are interned, later lookups and
+/// comparisons work on the IDs. The index is a flat open addressing
+/// table of hashes and IDs: interning does not allocate per name, names
+/// are looked up as string_views without copying, and copying a table
+/// does not rehash anything.
+class SymbolTable {
+  public:
+    /// ID of name, a new ID is assigned if name is not interned yet
+    SymbolId intern(std::string_view name)
+    {
+      if (_slots.empty()) {
+        rehash(minSlots);
+      }
+      uint32_t hash = hashName(name);
+      size_t slot = findSlot(name, hash);
+      if (_slots[slot]._id != invalidSymbol) {
+        return _slots[slot]._id;
+      }
+      SymbolId id = static_cast<SymbolId>(_names.size());
+      _names.emplace_back(name);
+      _slots[slot] = {hash, id};
+      if (_names.size() * 2 > _slots.size()) {
+        rehash(_slots.size() * 2);
+      }
+      return id;
+    }
+
+    /// ID of name, invalidSymbol if name is not interned
+    SymbolId find(std::string_view name) const
+    {
+      if (_slots.empty()) {
+        return invalidSymbol;
+      }
+      return _slots[findSlot(name, hashName(name))]._id;
+    }
+
+    /// Make room for count names without rehashing
+    void reserve(size_t count)
+    {
+      _names.reserve(count);
+      size_t slots = minSlots;
+      while (slots < count * 2) {
+        slots *= 2;
+      }
+      if (slots > _slots.size()) {
+        rehash(slots);
+      }
+    }
+
+    const std::string& name(SymbolId id) const { return _names[id]; }
+    size_t size() const { return _names.size(); }
+
+  private:
+    struct Slot {
+      uint32_t _hash = 0;
+      SymbolId _id = invalidSymbol;
+    };
+    static constexpr size_t minSlots = 16;
+
+    static uint32_t hashName(std::string_view name) { return hashSymbolName(name); }
+
+    /// Slot of name, or the empty slot where it would be inserted
+    size_t findSlot(std::string_view name, uint32_t hash) const
+    {
+      size_t mask = _slots.size() - 1;
+      for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const Slot& slot = _slots[i];
+        if (slot._id == invalidSymbol ||
+           (slot._hash == hash && _names[slot._id] == name)) {
+          return i;
+        }
+      }
+    }
+
+    /// Slot count is a power of 2, at most half of the slots are used
+    void rehash(size_t slotCount)
+    {
+      std::vector<Slot> slots(slotCount);
+      size_t mask = slotCount - 1;
+      for (const Slot& slot : _slots) {
+        if (slot._id == invalidSymbol) {
+          continue;
+        }
+        size_t i = slot._hash & mask;
+        while (slots[i]._id != invalidSymbol) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = slot;
+      }
+      _slots.swap(slots);
+    }
+
+  private:
+    std::vector<Slot>        _slots;
+    std::vector<std::string> _names;
+};
+
+/// Index from names to the IDs of objects that keep their own names, like
+/// the nodes and devices of a circuit. Only hashes and IDs are stored, the
+/// name of an ID is read back with the nameOf function passed to build()
+/// and find(). When a name is repeated, the smallest ID is found.
+class NameIndex {
+  public:
+    template <typename NameOf>
+    void build(size_t count, NameOf nameOf)
+    {
+      size_t slotCount = minSlots;
+      while (slotCount < count * 2) {
+        slotCount *= 2;
+      }
+      _slots.assign(slotCount, Slot());
+      for (size_t id=0; id<count; ++id) {
+        std::string_view name = nameOf(id);
+        uint32_t hash = hashSymbolName(name);
+        Slot& slot = _slots[findSlot(name, hash, nameOf)];
+        if (slot._id == invalidSymbol) {
+          slot = {hash, static_cast<SymbolId>(id)};
+        }
+      }
+    }
+
+    /// ID of the first object named name, invalidSymbol if there is none
+    template <typename NameOf>
+    SymbolId find(std::string_view name, NameOf nameOf) const
+    {
+      if (_slots.empty()) {
+        return invalidSymbol;
+      }
+      return _slots[findSlot(name, hashSymbolName(name), nameOf)]._id;
+    }
+
+  private:
+    struct Slot {
+      uint32_t _hash = 0;
+      SymbolId _id = invalidSymbol;
+    };
+    static constexpr size_t minSlots = 16;
+
+    template <typename NameOf>
+    size_t findSlot(std::string_view name, uint32_t hash, NameOf nameOf) const
+    {
+      size_t mask = _slots.size() - 1;
+      for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        const Slot& slot = _slots[i];
+        if (slot._id == invalidSymbol ||
+           (slot._hash == hash && nameOf(slot._id) == name)) {
+          return i;
+        }
+      }
+    }
+
+  private:
+    std::vector<Slot> _slots;
+};
+
+}
+
+#endif
@@ -49,11 +49,15 @@ formatNumber(double n, std::string& string,
 }
 
 std::vector<std::pair<int, std::string>>
-columnHeader(const SimResultMap& map, const Circuit& ckt)
+columnHeader(const SimResultMap& map, const Circuit& ckt, bool isComplex)
 {
   std::pair<int, std::string> initValue(0, "");
   std::vector<std::pair<int, std::string>> header(map.size()+1, initValue);
-  header[0] = {1, "TIME"};
+  if (isComplex) {
+    header[0] = {2, "HERTZ"};
+  } else {
+    header[0] = {1, "TIME"};
+  }
   for (size_t nodeId=0; nodeId<map._nodeVoltageMap.size(); ++nodeId) {
     size_t index = map._nodeVoltageMap[nodeId];
     if (index == SimResultMap::invalidValue()) {
@@ -85,7 +89,7 @@ writeHeader(std::ofstream& out, const Circuit& ckt, const SimResult& result)
       << "Data generated by ToyTran, written Bin Tang" << std::endl;
   out << 0 << std::endl;
   const SimResultMap& map = result.indexMap();
-  const std::vector<std::pair<int, std::string>>& headerCol = columnHeader(map, ckt);
+  const std::vector<std::pair<int, std::string>>& headerCol = columnHeader(map, ckt, result.isComplex());
   for (size_t i=0; i<headerCol.size(); ++i) {
     const auto& data = headerCol[i];
     out << data.first << " ";
@@ -97,10 +101,10 @@ writeHeader(std::ofstream& out, const Circuit& ckt, const SimResult& result)
   } 
   for (size_t i=0; i<headerCol.size(); ++i) {
     const auto& data = headerCol[i];
-    if (data.first == 1) {
-      if (i != 0 || data.second.compare("TIME") != 0) {
-        out << "V(";
-      }
+    if (i == 0) {
+      /// TIME or HERTZ
+    } else if (data.first == 1) {
+      out << "V(";
     } else if (data.first == 8) {
       out << "I(";
     } else {
@@ -129,6 +133,11 @@ writeData(std::ofstream& out, const SimResult& result,
       size_t index = t*cols+i;
       formatNumber(result.value(index), outStr, significandWidth, exponentWidth);
       out << outStr;
+      /// Complex values are written as real and imaginary pairs
+      if (result.isComplex()) {
+        formatNumber(result.imagValues()[index], outStr, significandWidth, exponentWidth);
+        out << " " << outStr;
+      }
       if (i == cols-1) {
         out << std::endl;
       } else {